@@ -9,6 +9,7 @@
 
 #### Libraries
 
+qt_find_package(WrapZSTD 1.3 PROVIDED_TARGETS WrapZSTD::WrapZSTD MODULE_NAME remoteobjects QMAKE_LIB zstd)
 
 
 #### Tests
@@ -24,6 +25,12 @@ qt_feature("use_ham" PUBLIC
     CONDITION QNX
 )
 qt_feature_definition("use_ham" "QT_NO_USE_HAM" NEGATE VALUE "1")
+qt_feature("remoteobjects_zstd" PRIVATE
+    LABEL "Zstandard compression"
+    PURPOSE "Allows connections to compress large packets with Zstandard"
+    CONDITION WrapZSTD_FOUND
+)
 qt_configure_add_summary_section(NAME "Qt Remote Objects")
 qt_configure_add_summary_entry(ARGS "use_ham")
+qt_configure_add_summary_entry(ARGS "remoteobjects_zstd")
 qt_configure_end_summary_section() # end of "Qt Remote Objects" section
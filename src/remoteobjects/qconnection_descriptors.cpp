@@ -0,0 +1,343 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qconnection_descriptors_p.h"
+
+#include <QtCore/qdeadlinetimer.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+QT_BEGIN_NAMESPACE
+
+// How long the receiving side waits for a blob the sender had to queue, in milliseconds
+static const int blobWaitTime = 2000;
+
+static void closeFd(int &fd)
+{
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+static qint64 peerPid(int socket)
+{
+    ucred credentials;
+    socklen_t size = sizeof(credentials);
+    if (::getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0)
+        return 0;
+    return credentials.pid;
+}
+
+QtRODescriptorChannel::QtRODescriptorChannel(qintptr connection)
+    : m_peerPid(connection == -1 ? 0 : peerPid(int(connection)))
+{
+}
+
+QtRODescriptorChannel::~QtRODescriptorChannel()
+{
+    reset();
+}
+
+void QtRODescriptorChannel::reset()
+{
+    closeFd(m_listener);
+    closeFd(m_socket);
+    m_address.clear();
+    for (int fd : std::as_const(m_received))
+        ::close(fd);
+    m_received.clear();
+    for (const auto &blob : std::as_const(m_queued))
+        ::close(blob.fd);
+    m_queued.clear();
+    m_sent.clear();
+    m_bufferedBytes = 0;
+    m_acknowledge = false;
+    // May be called from its activated() signal
+    if (m_writeNotifier) {
+        m_writeNotifier->setEnabled(false);
+        m_writeNotifier->deleteLater();
+        m_writeNotifier = nullptr;
+    }
+}
+
+// Binds to an address in the abstract namespace the kernel picks (five hex digits)
+QString QtRODescriptorChannel::listen()
+{
+    reset();
+    if (m_peerPid == 0)
+        return QString();
+    m_listener = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    socklen_t size = sizeof(sa_family_t);
+    if (m_listener == -1 || ::bind(m_listener, reinterpret_cast<sockaddr *>(&address), size) != 0
+        || ::listen(m_listener, 4) != 0) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Unable to listen for a blob channel:"
+                                      << qt_error_string(errno);
+        closeFd(m_listener);
+        return QString();
+    }
+    size = sizeof(address);
+    if (::getsockname(m_listener, reinterpret_cast<sockaddr *>(&address), &size) != 0
+        || size <= offsetof(sockaddr_un, sun_path) + 1) {
+        closeFd(m_listener);
+        return QString();
+    }
+    m_address = QString::fromLatin1(address.sun_path + 1,
+                                    qsizetype(size - offsetof(sockaddr_un, sun_path) - 1));
+    return m_address;
+}
+
+// The client connected before acknowledging, its connection is pending on the listener
+bool QtRODescriptorChannel::accept(const QString &address)
+{
+    if (m_listener == -1 || address != m_address)
+        return false;
+    for (;;) {
+        const int socket = ::accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket == -1)
+            break;
+        if (peerPid(socket) == m_peerPid) {
+            m_socket = socket;
+            break;
+        }
+        qCWarning(QT_REMOTEOBJECT_IO) << "Rejected a blob channel from another process";
+        ::close(socket);
+    }
+    closeFd(m_listener);
+    return m_socket != -1;
+}
+
+bool QtRODescriptorChannel::connectToHost(const QString &address)
+{
+    reset();
+    const QByteArray name = address.toLatin1();
+    sockaddr_un peer = {};
+    peer.sun_family = AF_UNIX;
+    if (name.size() + 1 > qsizetype(sizeof(peer.sun_path)))
+        return false;
+    memcpy(peer.sun_path + 1, name.constData(), size_t(name.size()));
+    const auto size = socklen_t(offsetof(sockaddr_un, sun_path) + 1 + size_t(name.size()));
+    m_socket = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (m_socket == -1 || ::connect(m_socket, reinterpret_cast<sockaddr *>(&peer), size) != 0) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Unable to connect the blob channel:"
+                                      << qt_error_string(errno);
+        closeFd(m_socket);
+        return false;
+    }
+    // Sending must not block, blobs are queued while the peer doesn't keep up
+    ::fcntl(m_socket, F_SETFL, ::fcntl(m_socket, F_GETFL) | O_NONBLOCK);
+    return true;
+}
+
+// One message per blob, <quint64 id> and the descriptor. Without descriptor the message
+// acknowledges the blobs up to id.
+QtRODescriptorChannel::IoResult QtRODescriptorChannel::sendMessage(quint64 id, int fd)
+{
+    iovec iov { &id, sizeof(id) };
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    if (fd != -1) {
+        memset(control.buffer, 0, sizeof(control.buffer));
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    ssize_t written;
+    while ((written = ::sendmsg(m_socket, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR) { }
+    if (written == qsizetype(sizeof(id)))
+        return IoResult::Done;
+    if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return IoResult::WouldBlock;
+    qCWarning(QT_REMOTEOBJECT_IO) << "Unable to pass blob" << id << ":" << qt_error_string(errno);
+    return IoResult::Failed;
+}
+
+// Sends the acknowledgement and the blobs that are waiting, as long as the socket has space
+bool QtRODescriptorChannel::flush()
+{
+    IoResult result = IoResult::Done;
+    if (m_acknowledge) {
+        result = sendMessage(m_taken, -1);
+        m_acknowledge = result != IoResult::Done;
+    }
+    while (result == IoResult::Done && !m_queued.isEmpty()) {
+        result = sendMessage(m_queued.first().id, m_queued.first().fd);
+        if (result == IoResult::Done) {
+            auto blob = m_queued.takeFirst();
+            ::close(blob.fd);
+            m_sent.append({ blob.id, -1, blob.size });
+        }
+    }
+    if (result == IoResult::Failed)
+        return false;
+
+    const bool waiting = result == IoResult::WouldBlock;
+    if (waiting && !m_writeNotifier) {
+        m_writeNotifier = new QSocketNotifier(m_socket, QSocketNotifier::Write);
+        QObject::connect(m_writeNotifier, &QSocketNotifier::activated, m_writeNotifier,
+                         [this]() { onWritable(); });
+    }
+    if (m_writeNotifier)
+        m_writeNotifier->setEnabled(waiting);
+    return true;
+}
+
+void QtRODescriptorChannel::onWritable()
+{
+    receiveMessages();
+    if (!flush()) {
+        // The packets referencing the queued blobs fail to decode on the other side
+        qCWarning(QT_REMOTEOBJECT_IO) << "Dropping" << m_queued.size() << "queued blobs";
+        reset();
+    }
+}
+
+// A full socket only means the peer is slow, the blobs are queued and count as buffered
+// like the packets, so the usual flow control applies
+bool QtRODescriptorChannel::sendBlobs(const QList<QRemoteObjectPackets::OutgoingBlob> &blobs)
+{
+    if (m_socket == -1)
+        return false;
+    receiveMessages();
+    if (!flush())
+        return false;
+    for (const auto &blob : blobs) {
+        m_bufferedBytes += blob.size;
+        if (m_queued.isEmpty()) {
+            const IoResult result = sendMessage(blob.id, blob.fd);
+            if (result == IoResult::Failed)
+                return false;
+            if (result == IoResult::Done) {
+                m_sent.append({ blob.id, -1, blob.size });
+                continue;
+            }
+        }
+        // The packet closes its descriptor once written
+        const int fd = ::fcntl(blob.fd, F_DUPFD_CLOEXEC, 0);
+        if (fd == -1) {
+            qCWarning(QT_REMOTEOBJECT_IO) << "Unable to queue blob" << blob.id << ":"
+                                          << qt_error_string(errno);
+            return false;
+        }
+        m_queued.append({ blob.id, fd, blob.size });
+    }
+    return flush();
+}
+
+qint64 QtRODescriptorChannel::bufferedBytes()
+{
+    receiveMessages();
+    return m_bufferedBytes;
+}
+
+QtRODescriptorChannel::IoResult QtRODescriptorChannel::receiveMessage()
+{
+    quint64 id = 0;
+    iovec iov { &id, sizeof(id) };
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(int))];
+    } control;
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    ssize_t received;
+    while ((received = ::recvmsg(m_socket, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC)) < 0
+           && errno == EINTR) { }
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return IoResult::WouldBlock;
+    if (received <= 0)
+        return IoResult::Failed;
+
+    int fd = -1;
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS
+            && cmsg->cmsg_len >= CMSG_LEN(sizeof(int))) {
+            memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+        }
+    }
+    if (received == qsizetype(sizeof(id)) && fd == -1 && !(message.msg_flags & MSG_CTRUNC)) {
+        // Blobs are taken in the order they were sent, the ones before id were skipped
+        while (!m_sent.isEmpty() && m_sent.first().id <= id)
+            m_bufferedBytes -= m_sent.takeFirst().size;
+        return IoResult::Done;
+    }
+    if (received != qsizetype(sizeof(id)) || fd == -1 || (message.msg_flags & MSG_CTRUNC)
+        || m_received.contains(id)) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Invalid blob received";
+        if (fd != -1)
+            ::close(fd);
+        return IoResult::Done;
+    }
+    m_received.insert(id, fd);
+    return IoResult::Done;
+}
+
+void QtRODescriptorChannel::receiveMessages()
+{
+    if (m_socket == -1)
+        return;
+    while (receiveMessage() == IoResult::Done) { }
+}
+
+QByteArray QtRODescriptorChannel::takeBlob(quint64 id, qsizetype size)
+{
+    if (m_socket == -1 || size <= 0)
+        return QByteArray();
+    QDeadlineTimer deadline(blobWaitTime);
+    while (!m_received.contains(id)) {
+        const IoResult result = receiveMessage();
+        if (result == IoResult::Failed)
+            return QByteArray();
+        // The sender had to queue the blob, it follows the packet shortly
+        pollfd readable = { m_socket, POLLIN, 0 };
+        if (result == IoResult::WouldBlock
+            && (deadline.hasExpired() || ::poll(&readable, 1, int(deadline.remainingTime())) <= 0)) {
+            return QByteArray();
+        }
+    }
+    int fd = m_received.take(id);
+    m_taken = id;
+    m_acknowledge = true;
+    if (!flush())
+        qCWarning(QT_REMOTEOBJECT_IO) << "Unable to acknowledge blob" << id;
+
+    // The sender can't shrink the file, so it can be read without risking SIGBUS
+    QByteArray array;
+    struct stat info;
+    const int seals = ::fcntl(fd, F_GET_SEALS);
+    if (seals != -1 && (seals & F_SEAL_SHRINK) && ::fstat(fd, &info) == 0
+        && info.st_size >= size) {
+        void *data = ::mmap(nullptr, size_t(size), PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            array = QByteArray(static_cast<const char *>(data), size);
+            ::munmap(data, size_t(size));
+        }
+    }
+    closeFd(fd);
+    return array;
+}
+
+QT_END_NAMESPACE
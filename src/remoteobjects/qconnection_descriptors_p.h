@@ -0,0 +1,89 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCONNECTIONDESCRIPTORS_P_H
+#define QCONNECTIONDESCRIPTORS_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qremoteobjectpacket_p.h"
+
+#include <QtCore/qhash.h>
+#include <QtCore/qsocketnotifier.h>
+
+QT_BEGIN_NAMESPACE
+
+/*
+    Passes the blobs of a local: or localabstract: connection on Linux to the peer, as
+    sealed memory files (see QRemoteObjectPackets::CompactPacket::writeBlob()).
+
+    QLocalSocket drops the file descriptors passed with the data, they therefore go
+    through a second Unix domain socket. The host listens on an abstract address picked
+    by the kernel and only accepts the process at the other end of the connection.
+    Each descriptor is sent together with the id of its blob before the packet
+    referencing it, the receiving side finds it on the socket when it decodes the packet.
+    The blob is mapped read-only and copied once into the received QByteArray.
+
+    When the socket is full the blobs are queued until it has space again, the packets are
+    written anyway and the receiving side waits for the blob a while. The receiving side
+    acknowledges the blobs it took with a message without descriptor, until then they
+    count as buffered on the sending side.
+*/
+class QtRODescriptorChannel final : public QRemoteObjectPackets::BlobChannel
+{
+public:
+    // Client side
+    QtRODescriptorChannel() = default;
+    // Host side, connection is the socket the client connected with
+    explicit QtRODescriptorChannel(qintptr connection);
+    ~QtRODescriptorChannel() override;
+
+    QString listen() override;
+    bool isListening() const override { return m_listener != -1; }
+    bool accept(const QString &address) override;
+    bool connectToHost(const QString &address) override;
+    bool sendBlobs(const QList<QRemoteObjectPackets::OutgoingBlob> &blobs) override;
+    qint64 bufferedBytes() override;
+    QByteArray takeBlob(quint64 id, qsizetype size) override;
+
+private:
+    Q_DISABLE_COPY(QtRODescriptorChannel)
+    enum class IoResult { Done, WouldBlock, Failed };
+
+    void reset();
+    IoResult sendMessage(quint64 id, int fd);
+    IoResult receiveMessage();
+    void receiveMessages();
+    bool flush();
+    void onWritable();
+
+    int m_listener = -1;
+    int m_socket = -1;
+    // The process allowed to connect, 0 if unknown
+    qint64 m_peerPid = 0;
+    QString m_address;
+    // Descriptors received ahead of the packets referencing them, by blob id
+    QHash<quint64, int> m_received;
+    // The blobs waiting for space on the socket (with duplicated descriptors), and the
+    // blobs sent that the peer did not acknowledge yet, in the order they were sent
+    QList<QRemoteObjectPackets::OutgoingBlob> m_queued;
+    QList<QRemoteObjectPackets::OutgoingBlob> m_sent;
+    qint64 m_bufferedBytes = 0;
+    // The last blob taken, if the peer wasn't told yet
+    quint64 m_taken = 0;
+    bool m_acknowledge = false;
+    QSocketNotifier *m_writeNotifier = nullptr;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCONNECTIONDESCRIPTORS_P_H
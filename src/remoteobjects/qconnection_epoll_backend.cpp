@@ -0,0 +1,640 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qconnection_epoll_backend_p.h"
+
+#include <QtCore/qsocketnotifier.h>
+#include <QtNetwork/qhostinfo.h>
+
+#include <errno.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+// Events handled per epoll_wait() call, and bytes read per recv() call
+const int epollBatchSize = 256;
+const qint64 epollReadChunkSize = 64 * 1024;
+// Buffer blocks sent per sendmsg() call
+const int epollMaxIoVectors = 64;
+// How long a server waits before accepting again when it ran out of descriptors, in ms
+const int epollAcceptRetryInterval = 100;
+
+}
+
+static void closeFd(int &fd)
+{
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+static bool toSockaddr(const QHostAddress &address, quint16 port, sockaddr_storage &storage,
+                       socklen_t &size)
+{
+    memset(&storage, 0, sizeof(storage));
+    switch (address.protocol()) {
+    case QAbstractSocket::IPv4Protocol: {
+        auto in = reinterpret_cast<sockaddr_in *>(&storage);
+        in->sin_family = AF_INET;
+        in->sin_port = htons(port);
+        in->sin_addr.s_addr = htonl(address.toIPv4Address());
+        size = sizeof(sockaddr_in);
+        return true;
+    }
+    case QAbstractSocket::IPv6Protocol:
+    case QAbstractSocket::AnyIPProtocol: {
+        auto in6 = reinterpret_cast<sockaddr_in6 *>(&storage);
+        in6->sin6_family = AF_INET6;
+        in6->sin6_port = htons(port);
+        const Q_IPV6ADDR ip = address.toIPv6Address();
+        memcpy(&in6->sin6_addr, &ip, sizeof(ip));
+        size = sizeof(sockaddr_in6);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+QtROEpollDispatcher::QtROEpollDispatcher()
+{
+    m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    if (m_epoll == -1) {
+        qCWarning(QT_REMOTEOBJECT) << "Could not create an epoll instance:" << qt_error_string(errno);
+        return;
+    }
+    m_notifier = new QSocketNotifier(m_epoll, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &QtROEpollDispatcher::processEvents);
+}
+
+QtROEpollDispatcher::~QtROEpollDispatcher()
+{
+    delete m_notifier;
+    closeFd(m_epoll);
+}
+
+QSharedPointer<QtROEpollDispatcher> QtROEpollDispatcher::forCurrentThread()
+{
+    static thread_local QWeakPointer<QtROEpollDispatcher> t_dispatcher;
+    QSharedPointer<QtROEpollDispatcher> dispatcher = t_dispatcher.toStrongRef();
+    if (!dispatcher) {
+        dispatcher.reset(new QtROEpollDispatcher);
+        t_dispatcher = dispatcher;
+    }
+    return dispatcher;
+}
+
+// Returns the id the handler is registered with, or 0
+quint64 QtROEpollDispatcher::add(int fd, quint32 events, QtROEpollHandler *handler)
+{
+    if (m_epoll == -1)
+        return 0;
+    const quint64 id = m_nextId++;
+    epoll_event event = {};
+    event.events = events | EPOLLET;
+    event.data.u64 = id;
+    if (::epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+        return 0;
+    m_handlers.insert(id, handler);
+    return id;
+}
+
+void QtROEpollDispatcher::remove(quint64 id, int fd)
+{
+    if (m_handlers.remove(id))
+        ::epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+    m_dirty.remove(id);
+}
+
+void QtROEpollDispatcher::scheduleFlush(quint64 id)
+{
+    m_dirty.insert(id);
+    if (m_flushScheduled)
+        return;
+    m_flushScheduled = true;
+    QMetaObject::invokeMethod(this, &QtROEpollDispatcher::flushPending, Qt::QueuedConnection);
+}
+
+void QtROEpollDispatcher::processEvents()
+{
+    // A handler may close the last socket of the thread
+    const QSharedPointer<QtROEpollDispatcher> self = forCurrentThread();
+    epoll_event events[epollBatchSize];
+    int count;
+    do {
+        while ((count = ::epoll_wait(m_epoll, events, epollBatchSize, 0)) < 0 && errno == EINTR) { }
+        for (int i = 0; i < count; ++i) {
+            if (QtROEpollHandler *handler = m_handlers.value(events[i].data.u64))
+                handler->handleEvents(events[i].events);
+        }
+    } while (count == epollBatchSize);
+}
+
+void QtROEpollDispatcher::flushPending()
+{
+    const QSharedPointer<QtROEpollDispatcher> self = forCurrentThread();
+    m_flushScheduled = false;
+    const QSet<quint64> dirty = std::exchange(m_dirty, {});
+    for (quint64 id : dirty) {
+        if (QtROEpollHandler *handler = m_handlers.value(id))
+            handler->flushWrites();
+    }
+}
+
+QtROEpollSocket::QtROEpollSocket(QObject *parent)
+    : QIODevice(parent)
+{
+}
+
+QtROEpollSocket::~QtROEpollSocket()
+{
+    detach();
+    closeFd(m_fd);
+}
+
+bool QtROEpollSocket::attach()
+{
+    m_dispatcher = QtROEpollDispatcher::forCurrentThread();
+    m_id = m_dispatcher->add(m_fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, this);
+    if (m_id == 0) {
+        m_dispatcher.reset();
+        return false;
+    }
+    if (!m_writeBuffer.isEmpty() && !m_connecting)
+        m_dispatcher->scheduleFlush(m_id);
+    return true;
+}
+
+void QtROEpollSocket::detach()
+{
+    if (m_dispatcher && m_id != 0)
+        m_dispatcher->remove(m_id, m_fd);
+    m_id = 0;
+    m_dispatcher.reset();
+}
+
+bool QtROEpollSocket::setSocketDescriptor(int fd)
+{
+    m_fd = fd;
+    m_connecting = false;
+    m_disconnectEmitted = false;
+    if (!attach()) {
+        closeFd(m_fd);
+        return false;
+    }
+    QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    return true;
+}
+
+void QtROEpollSocket::connectToHost(const QHostAddress &address, quint16 port)
+{
+    close();
+    sockaddr_storage storage;
+    socklen_t size;
+    int error = EAFNOSUPPORT;
+    if (toSockaddr(address, port, storage, size)) {
+        m_fd = ::socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int result = -1;
+        if (m_fd != -1) {
+            while ((result = ::connect(m_fd, reinterpret_cast<sockaddr *>(&storage), size)) < 0
+                   && errno == EINTR) { }
+        }
+        error = result == 0 || errno == EINPROGRESS ? 0 : errno;
+        m_connecting = result != 0;
+    }
+    m_disconnectEmitted = false;
+    if (error == 0 && !attach())
+        error = errno;
+    if (error != 0) {
+        detach();
+        closeFd(m_fd);
+        m_connecting = false;
+        QMetaObject::invokeMethod(this, [this, error]() { emit errorOccurred(error); },
+                                  Qt::QueuedConnection);
+        return;
+    }
+    QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    // The dispatcher reports the socket as writable once connected
+}
+
+qint64 QtROEpollSocket::bytesAvailable() const
+{
+    return QIODevice::bytesAvailable() + m_readBuffer.size();
+}
+
+qint64 QtROEpollSocket::bytesToWrite() const
+{
+    return QIODevice::bytesToWrite() + m_writeBuffer.size();
+}
+
+// Sends what the socket takes right away, like QTcpSocket::abort() the rest is lost
+void QtROEpollSocket::close()
+{
+    flushWrites();
+    const bool wasConnected = m_fd != -1 && !m_connecting;
+    if (isOpen())
+        QIODevice::close();
+    detach();
+    closeFd(m_fd);
+    m_connecting = false;
+    m_readBuffer.clear();
+    m_writeBuffer.clear();
+    if (wasConnected && !m_disconnectEmitted) {
+        m_disconnectEmitted = true;
+        QMetaObject::invokeMethod(this, &QtROEpollSocket::disconnected, Qt::QueuedConnection);
+    }
+}
+
+void QtROEpollSocket::handleEvents(quint32 events)
+{
+    if (m_connecting) {
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+            return;
+        int error = 0;
+        socklen_t size = sizeof(error);
+        if (::getsockopt(m_fd, SOL_SOCKET, SO_ERROR, &error, &size) != 0)
+            error = errno;
+        if (error == 0 && (events & EPOLLHUP))
+            error = ECONNREFUSED;
+        if (error != 0) {
+            handleClosed(error);
+            return;
+        }
+        m_connecting = false;
+        emit connected();
+        // A slot may have closed the socket
+        if (m_fd == -1)
+            return;
+        events |= EPOLLOUT;
+    }
+    if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        receive();
+    if (m_fd != -1 && (events & EPOLLOUT) && !m_writeBuffer.isEmpty())
+        flushWrites();
+}
+
+// Edge-triggered, so everything the socket has is read
+void QtROEpollSocket::receive()
+{
+    qint64 received = 0;
+    bool closed = false;
+    int error = 0;
+    for (;;) {
+        char *buffer = m_readBuffer.reserve(epollReadChunkSize);
+        ssize_t result;
+        while ((result = ::recv(m_fd, buffer, size_t(epollReadChunkSize), 0)) < 0
+               && errno == EINTR) { }
+        if (result > 0) {
+            m_readBuffer.chop(epollReadChunkSize - result);
+            received += result;
+            continue;
+        }
+        m_readBuffer.chop(epollReadChunkSize);
+        if (result == 0) {
+            closed = true;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            closed = true;
+            error = errno;
+        }
+        break;
+    }
+    if (received > 0)
+        emit readyRead();
+    // Let the reader take what the peer sent before it went away
+    if (closed && m_fd != -1)
+        handleClosed(error);
+}
+
+// Gathers the buffered blocks into one sendmsg() call at a time
+void QtROEpollSocket::flushWrites()
+{
+    if (m_fd == -1 || m_connecting)
+        return;
+    qint64 flushed = 0;
+    int error = 0;
+    while (!m_writeBuffer.isEmpty()) {
+        iovec iov[epollMaxIoVectors];
+        int count = 0;
+        qint64 position = 0;
+        while (count < epollMaxIoVectors && position < m_writeBuffer.size()) {
+            qint64 length = 0;
+            const char *data = m_writeBuffer.readPointerAtPosition(position, length);
+            iov[count++] = { const_cast<char *>(data), size_t(length) };
+            position += length;
+        }
+        msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = size_t(count);
+        ssize_t written;
+        while ((written = ::sendmsg(m_fd, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR) { }
+        if (written < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                error = errno;
+            break;
+        }
+        m_writeBuffer.free(written);
+        flushed += written;
+        // The socket is full, the dispatcher reports when it can take more
+        if (written < position)
+            break;
+    }
+    if (flushed > 0)
+        emit bytesWritten(flushed);
+    if (error != 0 && m_fd != -1)
+        handleClosed(error);
+}
+
+void QtROEpollSocket::handleClosed(int error)
+{
+    const bool wasConnected = !m_connecting;
+    if (isOpen())
+        QIODevice::close();
+    detach();
+    closeFd(m_fd);
+    m_connecting = false;
+    m_readBuffer.clear();
+    m_writeBuffer.clear();
+    if (!wasConnected) {
+        emit errorOccurred(error);
+    } else if (!m_disconnectEmitted) {
+        m_disconnectEmitted = true;
+        emit disconnected();
+    }
+}
+
+qint64 QtROEpollSocket::readData(char *data, qint64 maxSize)
+{
+    if (m_readBuffer.isEmpty())
+        return m_fd == -1 ? -1 : 0;
+    return m_readBuffer.read(data, maxSize);
+}
+
+qint64 QtROEpollSocket::writeData(const char *data, qint64 size)
+{
+    if (m_fd == -1)
+        return -1;
+    m_writeBuffer.append(data, size);
+    if (!m_connecting && m_dispatcher)
+        m_dispatcher->scheduleFlush(m_id);
+    return size;
+}
+
+// The sockets of a thread share its dispatcher (see QRemoteObjectNode::setIoThreadEnabled()),
+// a moved socket registers with the dispatcher of its new thread
+bool QtROEpollSocket::event(QEvent *event)
+{
+    if (event->type() == QEvent::ThreadChange && m_id != 0) {
+        detach();
+        QMetaObject::invokeMethod(this, [this]() {
+            if (m_fd != -1 && m_id == 0 && !attach())
+                handleClosed(errno);
+        }, Qt::QueuedConnection);
+    }
+    return QIODevice::event(event);
+}
+
+EpollClientIo::EpollClientIo(QObject *parent)
+    : QtROClientIoDevice(parent)
+    , m_socket(new QtROEpollSocket(this))
+{
+    connect(m_socket, &QIODevice::readyRead, this, &QtROClientIoDevice::readyRead);
+    connect(m_socket, &QtROEpollSocket::connected, this, &QtROIoDeviceBase::initializeDataStream);
+    connect(m_socket, &QtROEpollSocket::errorOccurred, this, [this](int error) {
+        qCDebug(QT_REMOTEOBJECT) << "Could not connect to" << url() << qt_error_string(error);
+        // Host not there, wait and try again
+        if (!isClosing())
+            emit shouldReconnect(this);
+    });
+    connect(m_socket, &QtROEpollSocket::disconnected, this, [this]() {
+        if (!isClosing())
+            emit shouldReconnect(this);
+    });
+}
+
+EpollClientIo::~EpollClientIo()
+{
+    close();
+}
+
+QIODevice *EpollClientIo::connection() const
+{
+    return m_socket;
+}
+
+void EpollClientIo::connectToServer()
+{
+    if (isOpen())
+        return;
+    const QString &host = url().host();
+    QHostAddress address(host);
+    if (address.isNull())
+        address = QHostInfo::fromName(host).addresses().value(0);
+
+    if (address.isNull())
+        qWarning("connectToServer(): Failed to resolve host %s", qUtf8Printable(host));
+    else
+        m_socket->connectToHost(address, quint16(url().port()));
+}
+
+bool EpollClientIo::isOpen() const
+{
+    return !isClosing() && m_socket->isOpen();
+}
+
+void EpollClientIo::doClose()
+{
+    m_socket->close();
+    deleteLater();
+}
+
+void EpollClientIo::doDisconnectFromServer()
+{
+    m_socket->close();
+}
+
+EpollServerIo::EpollServerIo(QtROEpollSocket *socket, QObject *parent)
+    : QtROServerIoDevice(parent)
+    , m_socket(socket)
+{
+    m_socket->setParent(this);
+    connect(m_socket, &QIODevice::readyRead, this, &QtROServerIoDevice::readyRead);
+    connect(m_socket, &QtROEpollSocket::disconnected, this, &QtROServerIoDevice::disconnected);
+}
+
+QIODevice *EpollServerIo::connection() const
+{
+    return m_socket;
+}
+
+void EpollServerIo::doClose()
+{
+    m_socket->close();
+}
+
+EpollServerImpl::EpollServerImpl(QObject *parent)
+    : QConnectionAbstractServer(parent)
+{
+    m_acceptRetryTimer.setSingleShot(true);
+    m_acceptRetryTimer.setInterval(epollAcceptRetryInterval);
+    connect(&m_acceptRetryTimer, &QTimer::timeout, this, [this]() { handleEvents(EPOLLIN); });
+}
+
+EpollServerImpl::~EpollServerImpl()
+{
+    close();
+}
+
+bool EpollServerImpl::hasPendingConnections() const
+{
+    return !m_pending.isEmpty();
+}
+
+QtROServerIoDevice *EpollServerImpl::configureNewConnection()
+{
+    if (m_pending.isEmpty())
+        return nullptr;
+
+    return new EpollServerIo(m_pending.dequeue(), this);
+}
+
+QUrl EpollServerImpl::address() const
+{
+    return m_address;
+}
+
+bool EpollServerImpl::listen(const QUrl &address)
+{
+    close();
+    QHostAddress host(address.host());
+    if (host.isNull()) {
+        if (address.host().isEmpty()) {
+            host = QHostAddress::Any;
+        } else {
+            qCWarning(QT_REMOTEOBJECT) << address.host() << " is not an IP address, trying to resolve it";
+            QHostInfo info = QHostInfo::fromName(address.host());
+            if (info.addresses().isEmpty())
+                host = QHostAddress::Any;
+            else
+                host = info.addresses().constFirst();
+        }
+    }
+
+    sockaddr_storage storage;
+    socklen_t size;
+    if (!toSockaddr(host, quint16(address.port()), storage, size)) {
+        m_error = QAbstractSocket::UnsupportedSocketOperationError;
+        return false;
+    }
+    m_fd = ::socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_fd == -1 && host == QHostAddress::Any) {
+        // No IPv6, listen on IPv4 only
+        toSockaddr(QHostAddress(QHostAddress::AnyIPv4), quint16(address.port()), storage, size);
+        m_fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    }
+    const int one = 1;
+    const int zero = 0;
+    if (m_fd != -1) {
+        ::setsockopt(m_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (storage.ss_family == AF_INET6) {
+            ::setsockopt(m_fd, IPPROTO_IPV6, IPV6_V6ONLY,
+                         host == QHostAddress::Any ? &zero : &one, sizeof(int));
+        }
+    }
+    if (m_fd == -1 || ::bind(m_fd, reinterpret_cast<sockaddr *>(&storage), size) != 0
+        || ::listen(m_fd, SOMAXCONN) != 0) {
+        switch (errno) {
+        case EADDRINUSE:
+            m_error = QAbstractSocket::AddressInUseError;
+            break;
+        case EACCES:
+        case EPERM:
+            m_error = QAbstractSocket::SocketAccessError;
+            break;
+        case EADDRNOTAVAIL:
+            m_error = QAbstractSocket::SocketAddressNotAvailableError;
+            break;
+        default:
+            m_error = QAbstractSocket::UnknownSocketError;
+            break;
+        }
+        closeFd(m_fd);
+        return false;
+    }
+
+    size = sizeof(storage);
+    ::getsockname(m_fd, reinterpret_cast<sockaddr *>(&storage), &size);
+    quint16 port = quint16(address.port());
+    if (storage.ss_family == AF_INET)
+        port = ntohs(reinterpret_cast<sockaddr_in *>(&storage)->sin_port);
+    else if (storage.ss_family == AF_INET6)
+        port = ntohs(reinterpret_cast<sockaddr_in6 *>(&storage)->sin6_port);
+
+    m_dispatcher = QtROEpollDispatcher::forCurrentThread();
+    m_id = m_dispatcher->add(m_fd, EPOLLIN, this);
+    if (m_id == 0) {
+        m_error = QAbstractSocket::UnknownSocketError;
+        close();
+        return false;
+    }
+    m_address.setScheme(QRemoteObjectStringLiterals::tcpEpoll());
+    m_address.setHost(host.toString());
+    m_address.setPort(port);
+    return true;
+}
+
+QAbstractSocket::SocketError EpollServerImpl::serverError() const
+{
+    return m_error;
+}
+
+void EpollServerImpl::close()
+{
+    if (m_dispatcher && m_id != 0)
+        m_dispatcher->remove(m_id, m_fd);
+    m_id = 0;
+    m_dispatcher.reset();
+    m_acceptRetryTimer.stop();
+    closeFd(m_fd);
+    qDeleteAll(m_pending);
+    m_pending.clear();
+}
+
+void EpollServerImpl::handleEvents(quint32 events)
+{
+    Q_UNUSED(events)
+    while (m_fd != -1) {
+        int fd;
+        while ((fd = ::accept4(m_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) < 0
+               && errno == EINTR) { }
+        if (fd == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            // The client gave up while waiting, the next one may be fine
+            if (errno == ECONNABORTED || errno == EPROTO)
+                continue;
+            // The listener is edge-triggered and doesn't report the connections left in the
+            // backlog again, accept them once descriptors or memory may be available
+            qCWarning(QT_REMOTEOBJECT) << "Could not accept a connection:" << qt_error_string(errno);
+            m_acceptRetryTimer.start();
+            break;
+        }
+        auto socket = new QtROEpollSocket;
+        if (!socket->setSocketDescriptor(fd)) {
+            delete socket;
+            continue;
+        }
+        m_pending.enqueue(socket);
+        emit newConnection();
+    }
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,198 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCONNECTIONEPOLLBACKEND_P_H
+#define QCONNECTIONEPOLLBACKEND_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qconnectionfactories_p.h"
+
+#include <QtCore/qhash.h>
+#include <QtCore/qiodevice.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qset.h>
+#include <QtCore/qsharedpointer.h>
+#include <QtCore/qtimer.h>
+#include <QtNetwork/qhostaddress.h>
+
+#include <QtCore/private/qringbuffer_p.h>
+
+QT_BEGIN_NAMESPACE
+
+class QSocketNotifier;
+
+// Receives the events of a socket registered with a QtROEpollDispatcher
+class QtROEpollHandler
+{
+public:
+    virtual ~QtROEpollHandler() = default;
+    virtual void handleEvents(quint32 events) = 0;
+    virtual void flushWrites() {}
+};
+
+/*
+    The sockets of the "tcp+epoll:" backend living in a thread share one edge-triggered
+    epoll instance, which is watched by a single QSocketNotifier. Each activation
+    handles the events of all ready sockets, and the data written to the sockets
+    during an event loop iteration is sent in one pass at its end.
+
+    Sockets are registered by id, so a socket closed while handling the events of
+    a batch doesn't receive the events reported for it in the same batch.
+*/
+class QtROEpollDispatcher final : public QObject
+{
+    Q_OBJECT
+
+public:
+    ~QtROEpollDispatcher() override;
+
+    static QSharedPointer<QtROEpollDispatcher> forCurrentThread();
+
+    quint64 add(int fd, quint32 events, QtROEpollHandler *handler);
+    void remove(quint64 id, int fd);
+    // Calls flushWrites() on the handler once the current event loop iteration is done
+    void scheduleFlush(quint64 id);
+
+private:
+    QtROEpollDispatcher();
+    void processEvents();
+    void flushPending();
+
+    int m_epoll = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    quint64 m_nextId = 1;
+    QHash<quint64, QtROEpollHandler *> m_handlers;
+    QSet<quint64> m_dirty;
+    bool m_flushScheduled = false;
+};
+
+/*
+    A TCP connection of the "tcp+epoll:" backend. Incoming data is read until the
+    socket has no more when the dispatcher reports it, and readyRead() is emitted
+    once for all of it. Written data is buffered and sent by the dispatcher at the
+    end of the event loop iteration, bytesToWrite() and bytesWritten() report it
+    like QTcpSocket does.
+*/
+class QtROEpollSocket final : public QIODevice, public QtROEpollHandler
+{
+    Q_OBJECT
+
+public:
+    explicit QtROEpollSocket(QObject *parent = nullptr);
+    ~QtROEpollSocket() override;
+
+    // Takes ownership of a connected socket
+    bool setSocketDescriptor(int fd);
+    void connectToHost(const QHostAddress &address, quint16 port);
+    bool isConnecting() const { return m_connecting; }
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    void close() override;
+
+    void handleEvents(quint32 events) override;
+    void flushWrites() override;
+
+Q_SIGNALS:
+    void connected();
+    void disconnected();
+    void errorOccurred(int error);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+    bool event(QEvent *event) override;
+
+private:
+    bool attach();
+    void detach();
+    void receive();
+    void handleClosed(int error);
+
+    int m_fd = -1;
+    quint64 m_id = 0;
+    QSharedPointer<QtROEpollDispatcher> m_dispatcher;
+    QRingBuffer m_readBuffer;
+    QRingBuffer m_writeBuffer;
+    bool m_connecting = false;
+    bool m_disconnectEmitted = false;
+};
+
+class EpollClientIo final : public QtROClientIoDevice
+{
+    Q_OBJECT
+
+public:
+    explicit EpollClientIo(QObject *parent = nullptr);
+    ~EpollClientIo() override;
+
+    QIODevice *connection() const override;
+    void connectToServer() override;
+    bool isOpen() const override;
+
+protected:
+    void doClose() override;
+    void doDisconnectFromServer() override;
+
+private:
+    QtROEpollSocket *m_socket;
+};
+
+class EpollServerIo final : public QtROServerIoDevice
+{
+    Q_OBJECT
+
+public:
+    explicit EpollServerIo(QtROEpollSocket *socket, QObject *parent = nullptr);
+
+    QIODevice *connection() const override;
+
+protected:
+    void doClose() override;
+
+private:
+    QtROEpollSocket *m_socket;
+};
+
+class EpollServerImpl final : public QConnectionAbstractServer, public QtROEpollHandler
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(EpollServerImpl)
+
+public:
+    explicit EpollServerImpl(QObject *parent);
+    ~EpollServerImpl() override;
+
+    bool hasPendingConnections() const override;
+    QtROServerIoDevice *configureNewConnection() override;
+    QUrl address() const override;
+    bool listen(const QUrl &address) override;
+    QAbstractSocket::SocketError serverError() const override;
+    void close() override;
+
+    void handleEvents(quint32 events) override;
+
+private:
+    int m_fd = -1;
+    quint64 m_id = 0;
+    QSharedPointer<QtROEpollDispatcher> m_dispatcher;
+    QUrl m_address;
+    QQueue<QtROEpollSocket *> m_pending;
+    QAbstractSocket::SocketError m_error = QAbstractSocket::UnknownSocketError;
+    // Accepts again after running out of descriptors, see handleEvents()
+    QTimer m_acceptRetryTimer;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCONNECTIONEPOLLBACKEND_P_H
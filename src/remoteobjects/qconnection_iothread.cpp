@@ -0,0 +1,437 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qconnection_iothread_p.h"
+
+#include <QtCore/qendian.h>
+
+#include <algorithm>
+
+QT_BEGIN_NAMESPACE
+
+using namespace QtRemoteObjects;
+
+QtROIoThread::QtROIoThread(QObject *parent)
+    : QThread(parent)
+    , m_context(new QObject)
+{
+    setObjectName(QStringLiteral("QtRO I/O"));
+    m_context->moveToThread(this);
+}
+
+QtROIoThread::~QtROIoThread()
+{
+    quit();
+    wait();
+    delete m_context;
+}
+
+QtROIoThreadPool::~QtROIoThreadPool()
+{
+}
+
+void QtROIoThreadPool::setThreadCount(int count)
+{
+    m_threadCount = qMax(count, 1);
+}
+
+QtROIoThread *QtROIoThreadPool::nextThread()
+{
+    const size_t count = size_t(m_threadCount);
+    QtROIoThread *next = nullptr;
+    for (size_t i = 0; i < std::min(count, m_threads.size()); ++i) {
+        QtROIoThread *thread = m_threads[i].get();
+        if (!next || thread->connectionCount() < next->connectionCount())
+            next = thread;
+    }
+    if (m_threads.size() < count && (!next || next->connectionCount() > 0)) {
+        m_threads.push_back(std::make_unique<QtROIoThread>());
+        next = m_threads.back().get();
+        next->start();
+    }
+    return next;
+}
+
+static thread_local QtROIoFanOut *t_fanOut = nullptr;
+
+QtROIoFanOut::QtROIoFanOut()
+    : m_active(!t_fanOut)
+{
+    if (m_active)
+        t_fanOut = this;
+}
+
+QtROIoFanOut::~QtROIoFanOut()
+{
+    if (!m_active)
+        return;
+    t_fanOut = nullptr;
+    for (auto &[thread, transports] : m_threads) {
+        QMetaObject::invokeMethod(thread->context(), [transports = std::move(transports)]() {
+            for (const QPointer<QtROIoTransport> &transport : transports) {
+                if (transport)
+                    transport->flush();
+            }
+        }, Qt::QueuedConnection);
+    }
+}
+
+// Defers waking up the I/O thread of transport until the current QtROIoFanOut is
+// destroyed. Returns false if there is none.
+bool QtROIoFanOut::schedule(QtROIoTransport *transport)
+{
+    QtROIoFanOut *fanOut = t_fanOut;
+    if (!fanOut)
+        return false;
+    QtROIoThread *thread = transport->ioThread();
+    auto it = std::find_if(fanOut->m_threads.begin(), fanOut->m_threads.end(),
+                           [thread](const auto &entry) { return entry.first == thread; });
+    if (it == fanOut->m_threads.end()) {
+        fanOut->m_threads.emplace_back(thread, QList<QPointer<QtROIoTransport>>());
+        it = std::prev(fanOut->m_threads.end());
+    }
+    it->second.append(transport);
+    return true;
+}
+
+// The packet type of frame, a complete packet
+static quint16 frameType(const QByteArray &frame, bool compact)
+{
+    using namespace QRemoteObjectPackets;
+    if (compact) {
+        const int flags = CompactPacketFlagMask | CompactCompressedFlag;
+        return frame.isEmpty() ? quint16(Invalid) : quint16(quint8(frame.at(0)) & ~flags);
+    }
+    return frame.size() >= qsizetype(sizeof(quint16))
+            ? qFromLittleEndian<quint16>(frame.constData()) : quint16(Invalid);
+}
+
+QtROIoTransport::QtROIoTransport(QtROIoDeviceBase *outer, QtROIoDeviceBase *inner)
+    : QObject()
+    , m_device(inner)
+    , m_answerPings(qobject_cast<QtROServerIoDevice *>(inner))
+{
+    outer->d_func()->m_transport = this;
+    // Packets are encoded and decoded by the outer device, so are their blobs
+    outer->d_func()->m_blobChannel = inner->d_func()->m_blobChannel;
+    inner->setParent(this);
+    connect(inner, &QtROIoDeviceBase::readyRead, this, &QtROIoTransport::receive);
+    connect(inner, &QtROIoDeviceBase::disconnected, this, &QtROIoTransport::updateState);
+    connect(inner, &QtROIoDeviceBase::disconnected, outer, &QtROIoDeviceBase::disconnected);
+    // Client backends delete themselves once closed, the outer device follows
+    connect(inner, &QObject::destroyed, outer, &QObject::deleteLater);
+    connect(this, &QtROIoTransport::readyRead, outer, &QtROIoDeviceBase::readyRead);
+    connect(this, &QtROIoTransport::bytesWritten, outer, [outer]() {
+        outer->d_func()->writeBulk();
+    });
+    if (QIODevice *connection = inner->connection()) {
+        connect(connection, &QIODevice::bytesWritten, this,
+                &QtROIoTransport::updateBytesToWrite);
+    }
+}
+
+QtROIoTransport::~QtROIoTransport()
+{
+    if (m_thread)
+        m_thread->m_connections.deref();
+}
+
+void QtROIoTransport::start(QtROIoThread *thread)
+{
+    m_thread = thread;
+    m_thread->m_connections.ref();
+    updateState();
+    moveToThread(thread);
+    // The device might already hold data that won't be announced by readyRead again
+    QMetaObject::invokeMethod(this, &QtROIoTransport::receive, Qt::QueuedConnection);
+}
+
+void QtROIoTransport::detach(QtROIoDeviceBase *outer)
+{
+    outer->d_func()->m_transport = nullptr;
+    deleteLater();
+}
+
+qint64 QtROIoTransport::bytesAvailable() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_frameBytes;
+}
+
+bool QtROIoTransport::takeFrame(QByteArray &frame)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_frames.isEmpty())
+        return false;
+    frame = m_frames.dequeue();
+    m_frameBytes -= frame.size();
+    return true;
+}
+
+void QtROIoTransport::resume(bool compact)
+{
+    QMutexLocker locker(&m_mutex);
+    m_compact = compact;
+    if (!m_paused)
+        return;
+    m_paused = false;
+    locker.unlock();
+    QMetaObject::invokeMethod(this, &QtROIoTransport::receive, Qt::QueuedConnection);
+}
+
+void QtROIoTransport::write(const QByteArray &data)
+{
+    QMutexLocker locker(&m_mutex);
+    const bool wasEmpty = m_outgoing.isEmpty();
+    m_outgoing.append(data);
+    locker.unlock();
+    m_queuedBytes.fetchAndAddRelaxed(data.size());
+    // A flush is already pending otherwise, it will pick up this data as well
+    if (wasEmpty && !QtROIoFanOut::schedule(this))
+        QMetaObject::invokeMethod(this, &QtROIoTransport::flush, Qt::QueuedConnection);
+}
+
+// The socket belongs to the I/O thread, which never waits for the thread of the outer device
+QVariantMap QtROIoTransport::socketOptions() const
+{
+    QVariantMap options;
+    auto read = [this, &options]() {
+        if (m_device)
+            options = m_device->socketOptions();
+    };
+    if (!m_thread || !m_thread->isRunning() || thread() == QThread::currentThread())
+        read();
+    else
+        QMetaObject::invokeMethod(const_cast<QtROIoTransport *>(this), read,
+                                  Qt::BlockingQueuedConnection);
+    return options;
+}
+
+void QtROIoTransport::receive()
+{
+    if (!m_device)
+        return;
+
+    QtROIoDeviceBasePrivate *d = m_device->d_func();
+    bool received = false;
+    for (;;) {
+        bool compact;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_paused)
+                break;
+            compact = m_compact;
+        }
+        if (!d->receiveFrame(compact))
+            break;
+
+        QByteArray frame = std::move(d->m_frame);
+        const quint16 type = frameType(frame, compact);
+        if (type == Ping && m_answerPings) {
+            answerPing(std::move(frame), compact);
+            continue;
+        }
+        const bool handshake = type == Handshake;
+        QMutexLocker locker(&m_mutex);
+        m_frameBytes += frame.size();
+        m_frames.enqueue(std::move(frame));
+        m_paused = handshake;
+        received = true;
+    }
+    if (received)
+        emit readyRead();
+}
+
+// Heartbeats are answered on the I/O thread, so that replicas don't time out while the
+// thread of the node is busy. The Pong packet addresses the object the Ping packet did,
+// by name or by handle, it overtakes the packets waiting to be written.
+void QtROIoTransport::answerPing(QByteArray frame, bool compact)
+{
+    using namespace QRemoteObjectPackets;
+    QByteArray packet;
+    if (compact) {
+        char header[10];
+        const int headerSize = encodeVarint(header, quint64(frame.size()));
+        const int flags = CompactPacketFlagMask | CompactCompressedFlag;
+        frame[0] = char((quint8(frame.at(0)) & flags) | Pong);
+        packet.reserve(headerSize + frame.size());
+        packet.append(header, headerSize);
+    } else {
+        qToLittleEndian<quint16>(Pong, frame.data());
+        packet.resize(sizeof(quint32));
+        qToLittleEndian<quint32>(quint32(frame.size()), packet.data());
+    }
+    packet.append(frame);
+    if (m_device)
+        m_device->write(packet);
+    updateBytesToWrite();
+}
+
+void QtROIoTransport::flush()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_sending.swap(m_outgoing);
+    }
+    qint64 flushed = 0;
+    for (const QByteArray &data : std::as_const(m_sending)) {
+        if (m_device)
+            m_device->write(data);
+        flushed += data.size();
+    }
+    m_sending.clear();
+    m_queuedBytes.fetchAndSubRelaxed(flushed);
+    updateBytesToWrite();
+}
+
+void QtROIoTransport::updateState()
+{
+    m_open.storeRelaxed(m_device && m_device->isOpen());
+}
+
+void QtROIoTransport::updateBytesToWrite()
+{
+    QIODevice *connection = m_device ? m_device->connection() : nullptr;
+    m_deviceBytes.storeRelaxed(connection ? connection->bytesToWrite() : 0);
+    if (m_notifyWritten.loadRelaxed())
+        emit bytesWritten();
+}
+
+void QtROIoTransport::connectToServer()
+{
+    if (auto device = qobject_cast<QtROClientIoDevice *>(m_device.data()))
+        device->connectToServer();
+    updateState();
+}
+
+void QtROIoTransport::disconnectFromServer()
+{
+    if (auto device = qobject_cast<QtROClientIoDevice *>(m_device.data()))
+        device->doDisconnectFromServer();
+    updateState();
+}
+
+void QtROIoTransport::close()
+{
+    flush();
+    if (m_device)
+        m_device->close();
+    updateState();
+}
+
+/*!
+    Runs the client backend \a device on \a thread, see
+    QRemoteObjectNode::setIoThreadEnabled().
+ */
+QtROThreadedClientIo::QtROThreadedClientIo(QtROClientIoDevice *device, QtROIoThread *thread,
+                                           QObject *parent)
+    : QtROClientIoDevice(parent)
+    , m_transport(new QtROIoTransport(this, device))
+{
+    setUrl(device->url());
+    connect(device, &QtROClientIoDevice::setError, this, &QtROClientIoDevice::setError);
+    connect(device, &QtROClientIoDevice::shouldReconnect, m_transport,
+            &QtROIoTransport::updateState);
+    connect(device, &QtROClientIoDevice::shouldReconnect, this, [this]() {
+        emit shouldReconnect(this);
+    });
+    m_transport->start(thread);
+}
+
+QtROThreadedClientIo::~QtROThreadedClientIo()
+{
+    if (!isClosing())
+        close();
+    m_transport->detach(this);
+}
+
+QIODevice *QtROThreadedClientIo::connection() const
+{
+    return nullptr;
+}
+
+void QtROThreadedClientIo::connectToServer()
+{
+    QMetaObject::invokeMethod(m_transport, &QtROIoTransport::connectToServer,
+                              Qt::QueuedConnection);
+}
+
+bool QtROThreadedClientIo::isOpen() const
+{
+    return !isClosing() && m_transport->isOpen();
+}
+
+qint64 QtROThreadedClientIo::bytesAvailable() const
+{
+    return m_transport->bytesAvailable();
+}
+
+QVariantMap QtROThreadedClientIo::socketOptions() const
+{
+    return m_transport->socketOptions();
+}
+
+void QtROThreadedClientIo::doClose()
+{
+    QMetaObject::invokeMethod(m_transport, &QtROIoTransport::close, Qt::QueuedConnection);
+}
+
+void QtROThreadedClientIo::doDisconnectFromServer()
+{
+    QMetaObject::invokeMethod(m_transport, &QtROIoTransport::disconnectFromServer,
+                              Qt::QueuedConnection);
+}
+
+QString QtROThreadedClientIo::deviceType() const
+{
+    return QStringLiteral("QtROThreadedClientIo");
+}
+
+/*!
+    Runs the server backend \a device on \a thread, see
+    QRemoteObjectNode::setIoThreadEnabled().
+ */
+QtROThreadedServerIo::QtROThreadedServerIo(QtROServerIoDevice *device, QtROIoThread *thread,
+                                           QObject *parent)
+    : QtROServerIoDevice(parent)
+    , m_transport(new QtROIoTransport(this, device))
+{
+    m_transport->start(thread);
+}
+
+QtROThreadedServerIo::~QtROThreadedServerIo()
+{
+    m_transport->detach(this);
+}
+
+QIODevice *QtROThreadedServerIo::connection() const
+{
+    return nullptr;
+}
+
+bool QtROThreadedServerIo::isOpen() const
+{
+    return !isClosing() && m_transport->isOpen();
+}
+
+qint64 QtROThreadedServerIo::bytesAvailable() const
+{
+    return m_transport->bytesAvailable();
+}
+
+QVariantMap QtROThreadedServerIo::socketOptions() const
+{
+    return m_transport->socketOptions();
+}
+
+void QtROThreadedServerIo::doClose()
+{
+    QMetaObject::invokeMethod(m_transport, &QtROIoTransport::close, Qt::QueuedConnection);
+}
+
+QString QtROThreadedServerIo::deviceType() const
+{
+    return QStringLiteral("QtROThreadedServerIo");
+}
+
+QT_END_NAMESPACE
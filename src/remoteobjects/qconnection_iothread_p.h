@@ -0,0 +1,204 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCONNECTIONIOTHREAD_P_H
+#define QCONNECTIONIOTHREAD_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qconnectionfactories_p.h"
+
+#include <QtCore/qatomic.h>
+#include <QtCore/qmutex.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qthread.h>
+#include <QtCore/qvarlengtharray.h>
+
+#include <memory>
+#include <vector>
+
+QT_BEGIN_NAMESPACE
+
+class QtROIoTransport;
+
+// A thread transports of a node run on, see QRemoteObjectNode::setIoThreadEnabled()
+class QtROIoThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit QtROIoThread(QObject *parent = nullptr);
+    ~QtROIoThread() override;
+
+    // An object living in this thread, to queue work to it
+    QObject *context() const { return m_context; }
+    int connectionCount() const { return m_connections.loadRelaxed(); }
+
+private:
+    friend class QtROIoTransport;
+    QObject *m_context;
+    QAtomicInt m_connections;
+};
+
+// The I/O threads of a node. Threads are started when the first connection is assigned
+// to them, and each new connection goes to the thread serving the fewest connections.
+class QtROIoThreadPool
+{
+public:
+    QtROIoThreadPool() = default;
+    ~QtROIoThreadPool();
+
+    int threadCount() const { return m_threadCount; }
+    void setThreadCount(int count);
+    QtROIoThread *nextThread();
+
+private:
+    Q_DISABLE_COPY(QtROIoThreadPool)
+    std::vector<std::unique_ptr<QtROIoThread>> m_threads;
+    int m_threadCount = 1;
+};
+
+// Writing a packet to many connections (see CodecBase::send()) hands the packet to each
+// transport without copying it. While a QtROIoFanOut exists, the I/O threads are not
+// woken up for every transport, but once per thread when the QtROIoFanOut is destroyed.
+class QtROIoFanOut
+{
+public:
+    QtROIoFanOut();
+    ~QtROIoFanOut();
+
+    static bool schedule(QtROIoTransport *transport);
+
+private:
+    Q_DISABLE_COPY(QtROIoFanOut)
+    QVarLengthArray<std::pair<QtROIoThread *, QList<QPointer<QtROIoTransport>>>, 4> m_threads;
+    bool m_active;
+};
+
+/*
+    Runs a backend device (the "inner" device, e.g. a TcpClientIo) on an I/O thread
+    on behalf of a device living in the thread of the node (the "outer" device).
+
+    The transport lives on the I/O thread together with the inner device, which
+    does the socket I/O and splits the incoming data into packets. The outer device
+    takes the complete packets with takeFrame() and decodes them, data written to
+    the outer device is handed over with write(). Both directions go through a
+    mutex protected queue, so each thread handles whatever accumulated in the
+    meantime in one go. On the server side, Ping packets are answered by the
+    transport itself and never reach the outer device.
+*/
+class QtROIoTransport : public QObject
+{
+    Q_OBJECT
+
+public:
+    QtROIoTransport(QtROIoDeviceBase *outer, QtROIoDeviceBase *inner);
+    ~QtROIoTransport() override;
+
+    // Called from the thread of the outer device
+    void start(QtROIoThread *thread);
+    void detach(QtROIoDeviceBase *outer);
+    QtROIoThread *ioThread() const { return m_thread; }
+    bool isOpen() const { return m_open.loadRelaxed(); }
+    qint64 bytesAvailable() const;
+    qint64 bufferedBytes() const { return m_queuedBytes.loadRelaxed() + m_deviceBytes.loadRelaxed(); }
+    bool takeFrame(QByteArray &frame);
+    void resume(bool compact);
+    void write(const QByteArray &data);
+    QVariantMap socketOptions() const;
+    // Whether to emit bytesWritten(), while the outer device has packets waiting to be written
+    void setNotifyWritten(bool notify) { m_notifyWritten.storeRelaxed(notify); }
+
+    // Called from the I/O thread
+    void receive();
+    void answerPing(QByteArray frame, bool compact);
+    void flush();
+    void updateState();
+    void updateBytesToWrite();
+    void connectToServer();
+    void disconnectFromServer();
+    void close();
+
+Q_SIGNALS:
+    void readyRead();
+    void bytesWritten();
+
+private:
+    QPointer<QtROIoDeviceBase> m_device;
+    QtROIoThread *m_thread = nullptr;
+    // Server side, Ping packets are answered without waiting for the thread of the node
+    const bool m_answerPings;
+    QAtomicInteger<bool> m_open = false;
+    mutable QMutex m_mutex;
+    // Complete packets received, and their total size
+    QQueue<QByteArray> m_frames;
+    qint64 m_frameBytes = 0;
+    // Framing stops after a Handshake packet until resume() is called
+    bool m_paused = false;
+    bool m_compact = false;
+    // Written by the outer device, m_sending holds the data being written by the I/O
+    // thread. The payloads are shared with the other connections they are sent to.
+    QList<QByteArray> m_outgoing;
+    QList<QByteArray> m_sending;
+    // Bytes not yet handed to the inner device, and those the inner device still has to write
+    QAtomicInteger<qint64> m_queuedBytes = 0;
+    QAtomicInteger<qint64> m_deviceBytes = 0;
+    QAtomicInteger<bool> m_notifyWritten = false;
+};
+
+class QtROThreadedClientIo final : public QtROClientIoDevice
+{
+    Q_OBJECT
+
+public:
+    QtROThreadedClientIo(QtROClientIoDevice *device, QtROIoThread *thread, QObject *parent = nullptr);
+    ~QtROThreadedClientIo() override;
+
+    QIODevice *connection() const override;
+    void connectToServer() override;
+    bool isOpen() const override;
+    qint64 bytesAvailable() const override;
+    QVariantMap socketOptions() const override;
+
+protected:
+    void doClose() override;
+    void doDisconnectFromServer() override;
+    QString deviceType() const override;
+
+private:
+    QtROIoTransport *m_transport;
+};
+
+class QtROThreadedServerIo final : public QtROServerIoDevice
+{
+    Q_OBJECT
+
+public:
+    QtROThreadedServerIo(QtROServerIoDevice *device, QtROIoThread *thread, QObject *parent = nullptr);
+    ~QtROThreadedServerIo() override;
+
+    QIODevice *connection() const override;
+    bool isOpen() const override;
+    qint64 bytesAvailable() const override;
+    QVariantMap socketOptions() const override;
+
+protected:
+    void doClose() override;
+    QString deviceType() const override;
+
+private:
+    QtROIoTransport *m_transport;
+};
+
+QT_END_NAMESPACE
+
+#endif
@@ -3,6 +3,10 @@
 
 #include "qconnection_local_backend_p.h"
 
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#  include "qconnection_descriptors_p.h"
+#endif
+
 QT_BEGIN_NAMESPACE
 
 LocalClientIo::LocalClientIo(QObject *parent)
@@ -12,6 +16,9 @@ LocalClientIo::LocalClientIo(QObject *parent)
     connect(m_socket, &QLocalSocket::readyRead, this, &QtROClientIoDevice::readyRead);
     connect(m_socket, &QLocalSocket::errorOccurred, this, &LocalClientIo::onError);
     connect(m_socket, &QLocalSocket::stateChanged, this, &LocalClientIo::onStateChanged);
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    QtROIoDeviceBasePrivate::get(this)->m_blobChannel.reset(new QtRODescriptorChannel);
+#endif
 }
 
 LocalClientIo::~LocalClientIo()
@@ -97,6 +104,10 @@ LocalServerIo::LocalServerIo(QLocalSocket *conn, QObject *parent)
     m_connection->setParent(this);
     connect(conn, &QIODevice::readyRead, this, &QtROServerIoDevice::readyRead);
     connect(conn, &QLocalSocket::disconnected, this, &QtROServerIoDevice::disconnected);
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    QtROIoDeviceBasePrivate::get(this)->m_blobChannel.reset(
+            new QtRODescriptorChannel(conn->socketDescriptor()));
+#endif
 }
 
 QIODevice *LocalServerIo::connection() const
@@ -0,0 +1,654 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qconnection_shm_backend_p.h"
+
+#include <atomic>
+#include <new>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace {
+
+const quint32 shmMagic = 0x4f527451; // "QtRO"
+const quint32 shmVersion = 1;
+// The size of each ring buffer, a power of two
+const quint32 shmRingSize = 1024 * 1024;
+
+}
+
+static_assert(std::atomic<quint64>::is_always_lock_free && std::atomic<quint32>::is_always_lock_free,
+              "The shm backend needs lock-free atomics to share them between processes");
+
+// One direction of a connection. Both positions only grow, the ring buffer holds the
+// bytes [tail, head). The waiting flags tell the other side to ring the bell.
+struct QtROShmRing
+{
+    // Written by the producer: the number of bytes written so far, and whether it has
+    // data it couldn't write and wants to know when there is space again
+    alignas(64) std::atomic<quint64> head;
+    std::atomic<quint32> writerWaiting;
+    // Written by the consumer: the number of bytes read so far, and whether it wants to
+    // know about the next write
+    alignas(64) std::atomic<quint64> tail;
+    std::atomic<quint32> readerWaiting;
+};
+
+// The shared segment, followed by the data of the rings (server to client first)
+struct QtROShmSegment
+{
+    quint32 magic;
+    quint32 version;
+    quint32 capacity;
+    QtROShmRing serverToClient;
+    QtROShmRing clientToServer;
+};
+
+// Hosts listen on an abstract Unix domain socket, crashed hosts leave no file behind
+static bool shmAddress(const QString &name, sockaddr_un &address, socklen_t &size)
+{
+    const QByteArray path = QByteArrayLiteral("qtro-shm:") + name.toUtf8();
+    if (name.isEmpty() || path.size() + 1 > qsizetype(sizeof(address.sun_path)))
+        return false;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path + 1, path.constData(), size_t(path.size()));
+    size = socklen_t(offsetof(sockaddr_un, sun_path) + 1 + size_t(path.size()));
+    return true;
+}
+
+static void closeFd(int &fd)
+{
+    if (fd != -1) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+static void copyToRing(char *ring, quint32 capacity, quint64 position, const char *data,
+                       qint64 size)
+{
+    const quint32 offset = quint32(position & (capacity - 1));
+    const qint64 first = qMin(size, qint64(capacity - offset));
+    memcpy(ring + offset, data, size_t(first));
+    memcpy(ring, data + first, size_t(size - first));
+}
+
+static void copyFromRing(const char *ring, quint32 capacity, quint64 position, char *data,
+                         qint64 size)
+{
+    const quint32 offset = quint32(position & (capacity - 1));
+    const qint64 first = qMin(size, qint64(capacity - offset));
+    memcpy(data, ring + offset, size_t(first));
+    memcpy(data + first, ring, size_t(size - first));
+}
+
+QtROShmChannel::QtROShmChannel(QObject *parent)
+    : QIODevice(parent)
+{
+}
+
+QtROShmChannel::~QtROShmChannel()
+{
+    detach();
+}
+
+/*
+    Starts using the segment in memory, shared with the peer connected through socket.
+    The channel takes ownership of all file descriptors, also if it fails.
+*/
+bool QtROShmChannel::attach(int socket, int memory, int bell, int peerBell, bool server)
+{
+    detach();
+    m_socket = socket;
+    m_bell = bell;
+    m_peerBell = peerBell;
+
+    // The client can only rely on the size of a segment that can't shrink under it, the
+    // server sealed it before handing it over
+    const int seals = server ? 0 : ::fcntl(memory, F_GET_SEALS);
+    struct stat info;
+    if (seals != -1 && (server || (seals & F_SEAL_SHRINK)) && ::fstat(memory, &info) == 0 && size_t(info.st_size) >= sizeof(QtROShmSegment)) {
+        m_segmentSize = size_t(info.st_size);
+        m_segment = ::mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+        if (m_segment == MAP_FAILED)
+            m_segment = nullptr;
+    }
+    closeFd(memory);
+
+    auto header = static_cast<QtROShmSegment *>(m_segment);
+    // The header is shared with the peer, the server only trusts the size it created
+    const quint32 capacity = server ? shmRingSize : header ? header->capacity : 0;
+    if (!header || header->magic != shmMagic || header->version != shmVersion || capacity == 0
+            || (capacity & (capacity - 1)) != 0
+            || sizeof(QtROShmSegment) + 2 * size_t(capacity) > m_segmentSize) {
+        qCWarning(QT_REMOTEOBJECT) << "Invalid shared memory segment";
+        detach();
+        return false;
+    }
+
+    m_capacity = capacity;
+    char *data = static_cast<char *>(m_segment) + sizeof(QtROShmSegment);
+    m_rx = server ? &header->clientToServer : &header->serverToClient;
+    m_tx = server ? &header->serverToClient : &header->clientToServer;
+    m_rxData = server ? data + capacity : data;
+    m_txData = server ? data : data + capacity;
+
+    m_bellNotifier = new QSocketNotifier(m_bell, QSocketNotifier::Read, this);
+    connect(m_bellNotifier, &QSocketNotifier::activated, this, &QtROShmChannel::onBell);
+    m_socketNotifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
+    connect(m_socketNotifier, &QSocketNotifier::activated, this,
+            &QtROShmChannel::onSocketActivity);
+    m_disconnectEmitted = false;
+    QIODevice::open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+
+    // The peer may have written before we were listening
+    m_rx->readerWaiting.store(1);
+    if (m_rx->head.load() != m_rx->tail.load())
+        ringSelf();
+    return true;
+}
+
+void QtROShmChannel::detach()
+{
+    delete m_bellNotifier;
+    m_bellNotifier = nullptr;
+    delete m_socketNotifier;
+    m_socketNotifier = nullptr;
+    if (m_segment) {
+        ::munmap(m_segment, m_segmentSize);
+        m_segment = nullptr;
+    }
+    m_segmentSize = 0;
+    m_rx = m_tx = nullptr;
+    m_rxData = m_txData = nullptr;
+    m_capacity = 0;
+    closeFd(m_socket);
+    closeFd(m_bell);
+    closeFd(m_peerBell);
+    m_pending.clear();
+}
+
+qint64 QtROShmChannel::bytesAvailable() const
+{
+    qint64 available = QIODevice::bytesAvailable();
+    if (m_rx)
+        available += qint64(qMin(m_rx->head.load() - m_rx->tail.load(), quint64(m_capacity)));
+    return available;
+}
+
+qint64 QtROShmChannel::bytesToWrite() const
+{
+    return QIODevice::bytesToWrite() + m_pending.size();
+}
+
+// Data the peer couldn't read yet is still lost, as with an aborted socket
+void QtROShmChannel::close()
+{
+    const bool attached = m_segment;
+    if (isOpen())
+        QIODevice::close();
+    detach();
+    if (attached && !m_disconnectEmitted) {
+        m_disconnectEmitted = true;
+        QMetaObject::invokeMethod(this, &QtROShmChannel::disconnected, Qt::QueuedConnection);
+    }
+}
+
+qint64 QtROShmChannel::readData(char *data, qint64 maxSize)
+{
+    if (!m_rx)
+        return -1;
+    const quint64 tail = m_rx->tail.load(std::memory_order_relaxed);
+    const quint64 available = m_rx->head.load() - tail;
+    if (available > m_capacity) {
+        qCWarning(QT_REMOTEOBJECT) << "Shared memory segment corrupted by the peer";
+        QMetaObject::invokeMethod(this, &QtROShmChannel::handlePeerClosed, Qt::QueuedConnection);
+        return -1;
+    }
+    const qint64 size = qMin(maxSize, qint64(available));
+    if (size == 0)
+        return 0;
+    copyFromRing(m_rxData, m_capacity, tail, data, size);
+    m_rx->tail.store(tail + size);
+    if (m_rx->writerWaiting.exchange(0))
+        ringPeer();
+    return size;
+}
+
+qint64 QtROShmChannel::writeData(const char *data, qint64 size)
+{
+    if (!m_tx)
+        return -1;
+    qint64 written = 0;
+    if (m_pending.isEmpty()) {
+        written = writeToRing(data, size);
+        if (written < 0)
+            return -1;
+    }
+    if (written < size) {
+        m_pending.append(data + written, size - written);
+        m_tx->writerWaiting.store(1);
+        // The reader may have freed space before it could see the flag
+        if (m_tx->head.load(std::memory_order_relaxed) - m_tx->tail.load() < m_capacity)
+            ringSelf();
+    }
+    return size;
+}
+
+// Writes as much of data as fits, returns the number of bytes written or -1
+qint64 QtROShmChannel::writeToRing(const char *data, qint64 size)
+{
+    const quint64 head = m_tx->head.load(std::memory_order_relaxed);
+    const quint64 used = head - m_tx->tail.load();
+    if (used > m_capacity) {
+        qCWarning(QT_REMOTEOBJECT) << "Shared memory segment corrupted by the peer";
+        QMetaObject::invokeMethod(this, &QtROShmChannel::handlePeerClosed, Qt::QueuedConnection);
+        return -1;
+    }
+    const qint64 written = qMin(size, qint64(m_capacity - used));
+    if (written == 0)
+        return 0;
+    copyToRing(m_txData, m_capacity, head, data, written);
+    m_tx->head.store(head + quint64(written));
+    if (m_tx->readerWaiting.exchange(0))
+        ringPeer();
+    return written;
+}
+
+void QtROShmChannel::flushPending()
+{
+    qint64 flushed = 0;
+    while (!m_pending.isEmpty()) {
+        const qint64 block = m_pending.nextDataBlockSize();
+        const qint64 written = writeToRing(m_pending.readPointer(), block);
+        if (written <= 0)
+            break;
+        m_pending.free(written);
+        flushed += written;
+        if (written < block)
+            break;
+    }
+    if (!m_pending.isEmpty()) {
+        m_tx->writerWaiting.store(1);
+        if (m_tx->head.load(std::memory_order_relaxed) - m_tx->tail.load() < m_capacity)
+            ringSelf();
+    }
+    if (flushed > 0)
+        emit bytesWritten(flushed);
+}
+
+void QtROShmChannel::onBell()
+{
+    quint64 count;
+    while (::read(m_bell, &count, sizeof(count)) < 0 && errno == EINTR) { }
+
+    flushPending();
+    // A slot connected to bytesWritten() may have closed the channel
+    if (!m_rx)
+        return;
+    m_rx->readerWaiting.store(1);
+    if (m_rx->head.load() != m_rx->tail.load(std::memory_order_relaxed))
+        emit readyRead();
+}
+
+// The peer never writes to the socket, it only becomes readable once the peer is gone
+void QtROShmChannel::onSocketActivity()
+{
+    char byte;
+    const ssize_t received = ::recv(m_socket, &byte, 1, MSG_DONTWAIT);
+    if (received > 0 || (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)))
+        return;
+    handlePeerClosed();
+}
+
+void QtROShmChannel::handlePeerClosed()
+{
+    if (!m_rx)
+        return;
+    // Let the reader take what the peer wrote before it went away
+    if (m_rx->head.load() != m_rx->tail.load())
+        emit readyRead();
+    if (!m_rx)
+        return;
+    QIODevice::close();
+    detach();
+    if (!m_disconnectEmitted) {
+        m_disconnectEmitted = true;
+        emit disconnected();
+    }
+}
+
+void QtROShmChannel::ringPeer()
+{
+    const quint64 one = 1;
+    while (::write(m_peerBell, &one, sizeof(one)) < 0 && errno == EINTR) { }
+}
+
+void QtROShmChannel::ringSelf()
+{
+    const quint64 one = 1;
+    while (::write(m_bell, &one, sizeof(one)) < 0 && errno == EINTR) { }
+}
+
+ShmClientIo::ShmClientIo(QObject *parent)
+    : QtROClientIoDevice(parent)
+    , m_channel(new QtROShmChannel(this))
+{
+    connect(m_channel, &QIODevice::readyRead, this, &QtROClientIoDevice::readyRead);
+    connect(m_channel, &QtROShmChannel::disconnected, this, [this]() {
+        if (!isClosing())
+            emit shouldReconnect(this);
+    });
+}
+
+ShmClientIo::~ShmClientIo()
+{
+    close();
+}
+
+QIODevice *ShmClientIo::connection() const
+{
+    return m_channel;
+}
+
+void ShmClientIo::connectToServer()
+{
+    if (isOpen())
+        return;
+
+    sockaddr_un address;
+    socklen_t size;
+    if (!shmAddress(url().path(), address, size)) {
+        qCWarning(QT_REMOTEOBJECT) << "Invalid shm server name" << url().path();
+        emit setError(QRemoteObjectNode::HostUrlInvalid);
+        return;
+    }
+    m_socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_socket == -1 || ::connect(m_socket, reinterpret_cast<sockaddr *>(&address), size) != 0) {
+        const int error = errno;
+        qCDebug(QT_REMOTEOBJECT) << "Could not connect to" << url().path() << qt_error_string(error);
+        abortConnecting();
+        if (error == EACCES || error == EPERM) {
+            emit setError(QRemoteObjectNode::SocketAccessError);
+        } else {
+            // Host not there, wait and try again
+            QMetaObject::invokeMethod(this, [this]() {
+                if (!isClosing())
+                    emit shouldReconnect(this);
+            }, Qt::QueuedConnection);
+        }
+        return;
+    }
+    // The host sends the shared memory segment and the bells as soon as it accepted us
+    m_handshakeNotifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
+    connect(m_handshakeNotifier, &QSocketNotifier::activated, this, &ShmClientIo::onHandshake);
+}
+
+void ShmClientIo::onHandshake()
+{
+    // <quint32 version>, and the segment, our bell and the bell of the host
+    quint32 version = 0;
+    iovec iov { &version, sizeof(version) };
+    union {
+        cmsghdr header;
+        char buffer[CMSG_SPACE(3 * sizeof(int))];
+    } control;
+    msghdr message = {};
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+    const ssize_t received = ::recvmsg(m_socket, &message, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return;
+
+    int fds[3] = { -1, -1, -1 };
+    int fdCount = 0;
+    for (cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        fdCount = int((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        memcpy(fds, CMSG_DATA(cmsg), qMin(fdCount, 3) * sizeof(int));
+    }
+
+    delete m_handshakeNotifier;
+    m_handshakeNotifier = nullptr;
+    const int socket = m_socket;
+    m_socket = -1;
+    if (received != qsizetype(sizeof(version)) || version != shmVersion || fdCount != 3
+            || (message.msg_flags & MSG_CTRUNC)) {
+        if (received > 0)
+            qCWarning(QT_REMOTEOBJECT) << "Invalid shm handshake from" << url().path();
+        ::close(socket);
+        for (int fd : fds) {
+            if (fd != -1)
+                ::close(fd);
+        }
+        emit shouldReconnect(this);
+        return;
+    }
+    if (!m_channel->attach(socket, fds[0], fds[1], fds[2], false)) {
+        emit shouldReconnect(this);
+        return;
+    }
+    initializeDataStream();
+}
+
+void ShmClientIo::abortConnecting()
+{
+    delete m_handshakeNotifier;
+    m_handshakeNotifier = nullptr;
+    closeFd(m_socket);
+}
+
+bool ShmClientIo::isOpen() const
+{
+    return !isClosing() && (m_socket != -1 || m_channel->isOpen());
+}
+
+void ShmClientIo::doClose()
+{
+    abortConnecting();
+    m_channel->close();
+    deleteLater();
+}
+
+void ShmClientIo::doDisconnectFromServer()
+{
+    abortConnecting();
+    m_channel->close();
+}
+
+ShmServerIo::ShmServerIo(QtROShmChannel *channel, QObject *parent)
+    : QtROServerIoDevice(parent)
+    , m_channel(channel)
+{
+    m_channel->setParent(this);
+    connect(m_channel, &QIODevice::readyRead, this, &QtROServerIoDevice::readyRead);
+    connect(m_channel, &QtROShmChannel::disconnected, this, &QtROServerIoDevice::disconnected);
+}
+
+QIODevice *ShmServerIo::connection() const
+{
+    return m_channel;
+}
+
+void ShmServerIo::doClose()
+{
+    m_channel->close();
+}
+
+ShmServerImpl::ShmServerImpl(QObject *parent)
+    : QConnectionAbstractServer(parent)
+{
+}
+
+ShmServerImpl::~ShmServerImpl()
+{
+    close();
+}
+
+bool ShmServerImpl::hasPendingConnections() const
+{
+    return !m_pending.isEmpty();
+}
+
+QtROServerIoDevice *ShmServerImpl::configureNewConnection()
+{
+    if (m_pending.isEmpty())
+        return nullptr;
+
+    return new ShmServerIo(m_pending.dequeue(), this);
+}
+
+QUrl ShmServerImpl::address() const
+{
+    QUrl result;
+    result.setPath(m_serverName);
+    result.setScheme(QRemoteObjectStringLiterals::shm());
+
+    return result;
+}
+
+bool ShmServerImpl::listen(const QUrl &address)
+{
+    close();
+    sockaddr_un socketAddress;
+    socklen_t size;
+    if (!shmAddress(address.path(), socketAddress, size)) {
+        m_error = QAbstractSocket::HostNotFoundError;
+        return false;
+    }
+    m_socket = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m_socket == -1
+            || ::bind(m_socket, reinterpret_cast<sockaddr *>(&socketAddress), size) != 0
+            || ::listen(m_socket, SOMAXCONN) != 0) {
+        switch (errno) {
+        case EADDRINUSE:
+            m_error = QAbstractSocket::AddressInUseError;
+            break;
+        case EACCES:
+        case EPERM:
+            m_error = QAbstractSocket::SocketAccessError;
+            break;
+        default:
+            m_error = QAbstractSocket::UnknownSocketError;
+            break;
+        }
+        closeFd(m_socket);
+        return false;
+    }
+    m_serverName = address.path();
+    m_notifier = new QSocketNotifier(m_socket, QSocketNotifier::Read, this);
+    connect(m_notifier, &QSocketNotifier::activated, this, &ShmServerImpl::onNewConnection);
+    return true;
+}
+
+QAbstractSocket::SocketError ShmServerImpl::serverError() const
+{
+    return m_error;
+}
+
+void ShmServerImpl::close()
+{
+    delete m_notifier;
+    m_notifier = nullptr;
+    closeFd(m_socket);
+    qDeleteAll(m_pending);
+    m_pending.clear();
+}
+
+void ShmServerImpl::onNewConnection()
+{
+    for (;;) {
+        const int socket = ::accept4(m_socket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (socket == -1)
+            break;
+        if (QtROShmChannel *channel = setupChannel(socket)) {
+            m_pending.enqueue(channel);
+            emit newConnection();
+        }
+    }
+}
+
+// Creates the segment and the bells of a new connection, and hands them to the client
+QtROShmChannel *ShmServerImpl::setupChannel(int socket)
+{
+    const size_t size = sizeof(QtROShmSegment) + 2 * size_t(shmRingSize);
+    int memory = ::memfd_create("qtro-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    int serverBell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int clientBell = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    void *segment = MAP_FAILED;
+    // The size is sealed before the client sees it, the client can't make our accesses to
+    // the segment fault by shrinking it
+    if (memory != -1 && ::ftruncate(memory, off_t(size)) == 0
+            && ::fcntl(memory, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == 0)
+        segment = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0);
+
+    bool sent = false;
+    if (segment != MAP_FAILED && serverBell != -1 && clientBell != -1) {
+        auto header = new (segment) QtROShmSegment;
+        header->magic = shmMagic;
+        header->version = shmVersion;
+        header->capacity = shmRingSize;
+        for (QtROShmRing *ring : { &header->serverToClient, &header->clientToServer }) {
+            ring->head.store(0);
+            ring->writerWaiting.store(0);
+            ring->tail.store(0);
+            ring->readerWaiting.store(0);
+        }
+
+        quint32 version = shmVersion;
+        iovec iov { &version, sizeof(version) };
+        union {
+            cmsghdr header;
+            char buffer[CMSG_SPACE(3 * sizeof(int))];
+        } control;
+        memset(control.buffer, 0, sizeof(control.buffer));
+        msghdr message = {};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+        const int fds[3] = { memory, clientBell, serverBell };
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        ssize_t written;
+        while ((written = ::sendmsg(socket, &message, MSG_NOSIGNAL)) < 0 && errno == EINTR) { }
+        sent = written == qsizetype(sizeof(version));
+    }
+    if (segment != MAP_FAILED)
+        ::munmap(segment, size);
+    if (!sent) {
+        qCWarning(QT_REMOTEOBJECT) << "Could not set up a shm connection:" << qt_error_string(errno);
+        closeFd(memory);
+        closeFd(serverBell);
+        closeFd(clientBell);
+        ::close(socket);
+        return nullptr;
+    }
+
+    auto channel = new QtROShmChannel;
+    if (!channel->attach(socket, memory, serverBell, clientBell, true)) {
+        delete channel;
+        return nullptr;
+    }
+    return channel;
+}
+
+QT_END_NAMESPACE
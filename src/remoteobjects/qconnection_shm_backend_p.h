@@ -0,0 +1,161 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QCONNECTIONSHMBACKEND_P_H
+#define QCONNECTIONSHMBACKEND_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qconnectionfactories_p.h"
+
+#include <QtCore/qiodevice.h>
+#include <QtCore/qqueue.h>
+#include <QtCore/qsocketnotifier.h>
+
+#include <QtCore/private/qringbuffer_p.h>
+
+QT_BEGIN_NAMESPACE
+
+struct QtROShmRing;
+
+/*
+    A connection between two processes on the same host, see the "shm:" scheme.
+
+    The peers share a memory segment holding a ring buffer per direction, so the
+    data is copied once, from the writer into the segment, and once more by the
+    reader. Each peer owns an eventfd (its "bell"), which the other side rings when it
+    wrote data the peer waits for, or freed space the peer waits for. The segment and
+    the eventfds are handed to the client over a Unix domain socket, which then stays
+    open so each side notices when the other one goes away.
+
+    Data that doesn't fit into the ring buffer is kept until the reader freed enough
+    space, bytesToWrite() and bytesWritten() report it like a socket would.
+*/
+class QtROShmChannel final : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit QtROShmChannel(QObject *parent = nullptr);
+    ~QtROShmChannel() override;
+
+    bool attach(int socket, int memory, int bell, int peerBell, bool server);
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override;
+    qint64 bytesToWrite() const override;
+    void close() override;
+
+Q_SIGNALS:
+    void disconnected();
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    void detach();
+    void onBell();
+    void onSocketActivity();
+    qint64 writeToRing(const char *data, qint64 size);
+    void flushPending();
+    void ringPeer();
+    void ringSelf();
+    void handlePeerClosed();
+
+    int m_socket = -1;
+    int m_bell = -1;
+    int m_peerBell = -1;
+    void *m_segment = nullptr;
+    size_t m_segmentSize = 0;
+    QtROShmRing *m_rx = nullptr;
+    QtROShmRing *m_tx = nullptr;
+    char *m_rxData = nullptr;
+    char *m_txData = nullptr;
+    quint32 m_capacity = 0;
+    QSocketNotifier *m_bellNotifier = nullptr;
+    QSocketNotifier *m_socketNotifier = nullptr;
+    QRingBuffer m_pending;
+    bool m_disconnectEmitted = false;
+};
+
+class ShmClientIo final : public QtROClientIoDevice
+{
+    Q_OBJECT
+
+public:
+    explicit ShmClientIo(QObject *parent = nullptr);
+    ~ShmClientIo() override;
+
+    QIODevice *connection() const override;
+    void connectToServer() override;
+    bool isOpen() const override;
+
+protected:
+    void doClose() override;
+    void doDisconnectFromServer() override;
+
+private:
+    void onHandshake();
+    void abortConnecting();
+
+    QtROShmChannel *m_channel;
+    // The socket while waiting for the segment, the channel owns it afterwards
+    int m_socket = -1;
+    QSocketNotifier *m_handshakeNotifier = nullptr;
+};
+
+class ShmServerIo final : public QtROServerIoDevice
+{
+    Q_OBJECT
+
+public:
+    explicit ShmServerIo(QtROShmChannel *channel, QObject *parent = nullptr);
+
+    QIODevice *connection() const override;
+
+protected:
+    void doClose() override;
+
+private:
+    QtROShmChannel *m_channel;
+};
+
+class ShmServerImpl final : public QConnectionAbstractServer
+{
+    Q_OBJECT
+    Q_DISABLE_COPY(ShmServerImpl)
+
+public:
+    explicit ShmServerImpl(QObject *parent);
+    ~ShmServerImpl() override;
+
+    bool hasPendingConnections() const override;
+    QtROServerIoDevice *configureNewConnection() override;
+    QUrl address() const override;
+    bool listen(const QUrl &address) override;
+    QAbstractSocket::SocketError serverError() const override;
+    void close() override;
+
+private:
+    void onNewConnection();
+    QtROShmChannel *setupChannel(int socket);
+
+    int m_socket = -1;
+    QSocketNotifier *m_notifier = nullptr;
+    QString m_serverName;
+    QQueue<QtROShmChannel *> m_pending;
+    QAbstractSocket::SocketError m_error = QAbstractSocket::UnknownSocketError;
+};
+
+QT_END_NAMESPACE
+
+#endif // QCONNECTIONSHMBACKEND_P_H
@@ -3,10 +3,102 @@
 
 #include "qconnection_tcpip_backend_p.h"
 
+#include <QtCore/qurlquery.h>
 #include <QtNetwork/qhostinfo.h>
 
 QT_BEGIN_NAMESPACE
 
+namespace {
+
+const auto noDelayOption = QLatin1String("nodelay");
+const auto keepAliveOption = QLatin1String("keepalive");
+const auto sendBufferOption = QLatin1String("sndbuf");
+const auto receiveBufferOption = QLatin1String("rcvbuf");
+
+std::optional<bool> boolOption(const QUrlQuery &query, QLatin1String name)
+{
+    if (!query.hasQueryItem(name))
+        return std::nullopt;
+    const QString value = query.queryItemValue(name).toLower();
+    if (value == QLatin1String("1") || value == QLatin1String("true") || value == QLatin1String("on"))
+        return true;
+    if (value == QLatin1String("0") || value == QLatin1String("false") || value == QLatin1String("off"))
+        return false;
+    qCWarning(QT_REMOTEOBJECT) << "Ignoring invalid value" << value << "of socket option" << name;
+    return std::nullopt;
+}
+
+std::optional<int> sizeOption(const QUrlQuery &query, QLatin1String name)
+{
+    if (!query.hasQueryItem(name))
+        return std::nullopt;
+    bool ok = false;
+    const int value = query.queryItemValue(name).toInt(&ok);
+    if (ok && value > 0)
+        return value;
+    qCWarning(QT_REMOTEOBJECT) << "Ignoring invalid value" << query.queryItemValue(name)
+                               << "of socket option" << name;
+    return std::nullopt;
+}
+
+}
+
+QtROTcpSocketOptions QtROTcpSocketOptions::fromUrl(const QUrl &url)
+{
+    const QUrlQuery query(url);
+    QtROTcpSocketOptions options;
+    options.noDelay = boolOption(query, noDelayOption);
+    options.keepAlive = boolOption(query, keepAliveOption);
+    options.sendBufferSize = sizeOption(query, sendBufferOption);
+    options.receiveBufferSize = sizeOption(query, receiveBufferOption);
+    return options;
+}
+
+void QtROTcpSocketOptions::apply(QAbstractSocket *socket) const
+{
+    if (noDelay)
+        socket->setSocketOption(QAbstractSocket::LowDelayOption, int(*noDelay));
+    if (keepAlive)
+        socket->setSocketOption(QAbstractSocket::KeepAliveOption, int(*keepAlive));
+    if (sendBufferSize)
+        socket->setSocketOption(QAbstractSocket::SendBufferSizeSocketOption, *sendBufferSize);
+    if (receiveBufferSize)
+        socket->setSocketOption(QAbstractSocket::ReceiveBufferSizeSocketOption, *receiveBufferSize);
+}
+
+// Hosts announce their address with the options, replicas connect with the same ones
+void QtROTcpSocketOptions::addTo(QUrl &url) const
+{
+    QUrlQuery query;
+    if (noDelay)
+        query.addQueryItem(noDelayOption, QString::number(int(*noDelay)));
+    if (sendBufferSize)
+        query.addQueryItem(sendBufferOption, QString::number(*sendBufferSize));
+    if (receiveBufferSize)
+        query.addQueryItem(receiveBufferOption, QString::number(*receiveBufferSize));
+    if (keepAlive)
+        query.addQueryItem(keepAliveOption, QString::number(int(*keepAlive)));
+    if (query.isEmpty())
+        url.setQuery(QString());
+    else
+        url.setQuery(query);
+}
+
+QVariantMap QtROTcpSocketOptions::read(const QAbstractSocket *socket)
+{
+    if (socket->state() != QAbstractSocket::ConnectedState)
+        return QVariantMap();
+    // socketOption() isn't const
+    auto s = const_cast<QAbstractSocket *>(socket);
+    return QVariantMap {
+        { noDelayOption, s->socketOption(QAbstractSocket::LowDelayOption).toInt() != 0 },
+        { keepAliveOption, s->socketOption(QAbstractSocket::KeepAliveOption).toInt() != 0 },
+        { sendBufferOption, s->socketOption(QAbstractSocket::SendBufferSizeSocketOption).toInt() },
+        { receiveBufferOption,
+          s->socketOption(QAbstractSocket::ReceiveBufferSizeSocketOption).toInt() }
+    };
+}
+
 TcpClientIo::TcpClientIo(QObject *parent)
     : QtROClientIoDevice(parent)
     , m_socket(new QTcpSocket(this))
@@ -50,10 +142,14 @@ void TcpClientIo::connectToServer()
     if (address.isNull())
         address = QHostInfo::fromName(host).addresses().value(0);
 
-    if (address.isNull())
+    if (address.isNull()) {
         qWarning("connectToServer(): Failed to resolve host %s", qUtf8Printable(host));
-    else
-        m_socket->connectToHost(address, url().port());
+        return;
+    }
+    // Without Nagle's algorithm every write leaves as a segment of its own, so the
+    // packets of an event loop iteration are written together
+    setCoalescingWrites(QtROTcpSocketOptions::fromUrl(url()).noDelay.value_or(false));
+    m_socket->connectToHost(address, url().port());
 }
 
 bool TcpClientIo::isOpen() const
@@ -62,6 +158,11 @@ bool TcpClientIo::isOpen() const
                              || m_socket->state() == QAbstractSocket::ConnectingState));
 }
 
+QVariantMap TcpClientIo::socketOptions() const
+{
+    return QtROTcpSocketOptions::read(m_socket);
+}
+
 void TcpClientIo::onError(QAbstractSocket::SocketError error)
 {
     qCDebug(QT_REMOTEOBJECT) << "onError" << error;
@@ -86,8 +187,10 @@ void TcpClientIo::onStateChanged(QAbstractSocket::SocketState state)
         m_socket->abort();
         emit shouldReconnect(this);
     }
-    if (state == QAbstractSocket::ConnectedState)
+    if (state == QAbstractSocket::ConnectedState) {
+        QtROTcpSocketOptions::fromUrl(url()).apply(m_socket);
         initializeDataStream();
+    }
 }
 
 
@@ -104,6 +207,11 @@ QIODevice *TcpServerIo::connection() const
     return m_connection;
 }
 
+QVariantMap TcpServerIo::socketOptions() const
+{
+    return QtROTcpSocketOptions::read(m_connection);
+}
+
 void TcpServerIo::doClose()
 {
     m_connection->disconnectFromHost();
@@ -127,7 +235,11 @@ QtROServerIoDevice *TcpServerImpl::configureNewConnection()
     if (!m_server.isListening())
         return nullptr;
 
-    return new TcpServerIo(m_server.nextPendingConnection(), this);
+    QTcpSocket *socket = m_server.nextPendingConnection();
+    m_options.apply(socket);
+    auto conn = new TcpServerIo(socket, this);
+    conn->setCoalescingWrites(m_options.noDelay.value_or(false));
+    return conn;
 }
 
 bool TcpServerImpl::hasPendingConnections() const
@@ -156,11 +268,13 @@ bool TcpServerImpl::listen(const QUrl &address)
         }
     }
 
+    m_options = QtROTcpSocketOptions::fromUrl(address);
     bool ret = m_server.listen(host, quint16(address.port()));
     if (ret) {
         m_originalUrl.setScheme(QLatin1String("tcp"));
         m_originalUrl.setHost(m_server.serverAddress().toString());
         m_originalUrl.setPort(m_server.serverPort());
+        m_options.addTo(m_originalUrl);
     }
     return ret;
 }
@@ -20,8 +20,29 @@
 #include <QtNetwork/qtcpserver.h>
 #include <QtNetwork/qtcpsocket.h>
 
+#include <optional>
+
 QT_BEGIN_NAMESPACE
 
+/*
+    Socket options given as query items of a tcp: URL, e.g.
+    tcp://127.0.0.1:9999?nodelay=1&sndbuf=262144&rcvbuf=262144&keepalive=1.
+    Options that are not given keep the default of the operating system.
+*/
+struct QtROTcpSocketOptions
+{
+    static QtROTcpSocketOptions fromUrl(const QUrl &url);
+    void apply(QAbstractSocket *socket) const;
+    void addTo(QUrl &url) const;
+    // The options in effect on a connected socket, by query item name
+    static QVariantMap read(const QAbstractSocket *socket);
+
+    std::optional<bool> noDelay;
+    std::optional<bool> keepAlive;
+    std::optional<int> sendBufferSize;
+    std::optional<int> receiveBufferSize;
+};
+
 class TcpClientIo final : public QtROClientIoDevice
 {
     Q_OBJECT
@@ -33,6 +54,7 @@ public:
     QIODevice *connection() const override;
     void connectToServer() override;
     bool isOpen() const override;
+    QVariantMap socketOptions() const override;
 
 public Q_SLOTS:
     void onError(QAbstractSocket::SocketError error);
@@ -53,6 +75,7 @@ public:
     explicit TcpServerIo(QTcpSocket *conn, QObject *parent = nullptr);
 
     QIODevice *connection() const override;
+    QVariantMap socketOptions() const override;
 protected:
     void doClose() override;
 
@@ -79,6 +102,7 @@ public:
 private:
     QTcpServer m_server;
     QUrl m_originalUrl; // necessary because of a QHostAddress bug
+    QtROTcpSocketOptions m_options;
 };
 
 QT_END_NAMESPACE
@@ -3,12 +3,22 @@
 
 #include "qconnectionfactories_p.h"
 #include "qremoteobjectpacket_p.h"
+#include "qconnection_iothread_p.h"
+
+#include <QtCore/qcoreevent.h>
+#include <QtCore/qvarlengtharray.h>
+
+#include <algorithm>
 
 // BEGIN: Backends
 #if defined(Q_OS_QNX)
 #include "qconnection_qnx_backend_p.h"
 #endif
 #include "qconnection_local_backend_p.h"
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#include "qconnection_epoll_backend_p.h"
+#include "qconnection_shm_backend_p.h"
+#endif
 #include "qconnection_tcpip_backend_p.h"
 // END: Backends
 
@@ -25,11 +35,9 @@ public:
 
 Q_GLOBAL_STATIC(QtROFactoryLoader, loader)
 
-inline bool fromDataStream(QDataStream &in, QRemoteObjectPacketTypeEnum &type, QString &name)
+inline QRemoteObjectPacketTypeEnum packetTypeFromId(quint16 _type)
 {
-    quint16 _type;
-    in >> _type;
-    type = Invalid;
+    QRemoteObjectPacketTypeEnum type = Invalid;
     switch (_type) {
     case Handshake: type = Handshake; break;
     case InitPacket: type = InitPacket; break;
@@ -42,9 +50,22 @@ inline bool fromDataStream(QDataStream &in, QRemoteObjectPacketTypeEnum &type, Q
     case ObjectList: type = ObjectList; break;
     case Ping: type = Ping; break;
     case Pong: type = Pong; break;
+    case Subscribe: type = Subscribe; break;
+    case Fragment: type = Fragment; break;
+    case DatagramChannel: type = DatagramChannel; break;
+    case DatagramResync: type = DatagramResync; break;
+    case ResyncPacket: type = ResyncPacket; break;
     default:
         qCWarning(QT_REMOTEOBJECT_IO) << "Invalid packet received" << _type;
     }
+    return type;
+}
+
+inline bool fromDataStream(QDataStream &in, QRemoteObjectPacketTypeEnum &type, QString &name)
+{
+    quint16 _type;
+    in >> _type;
+    type = packetTypeFromId(_type);
     if (type == Invalid)
         return false;
     if (type == ObjectList)
@@ -54,15 +75,57 @@ inline bool fromDataStream(QDataStream &in, QRemoteObjectPacketTypeEnum &type, Q
     return true;
 }
 
+inline bool fromCompactStream(QDataStream &in, quint8 _type, QRemoteObjectPacketTypeEnum &type,
+                              QString &name, QtROIoDeviceBasePrivate *d)
+{
+    using namespace QRemoteObjectPackets;
+    type = packetTypeFromId(_type & ~CompactPacketFlagMask);
+    if (type == Invalid)
+        return false;
+    if (type == ObjectList)
+        return true;
+    if (!(_type & CompactHandleFlag))
+        name = readCompactString(in);
+    if (_type & CompactPacketFlagMask) {
+        quint64 handle;
+        readVarint(in, handle);
+        if (handle >= quint64(std::numeric_limits<int>::max()))
+            return false;
+        d->m_rxHandle = int(handle);
+        if (_type & CompactAnnounceHandleFlag) {
+            if (d->m_rxHandle >= d->m_handleNames.size()) {
+                d->m_handleNames.resize(d->m_rxHandle + 1);
+                d->m_handleObjects.resize(d->m_rxHandle + 1);
+            }
+            d->m_handleNames[d->m_rxHandle] = name;
+            d->m_handleObjects[d->m_rxHandle].clear();
+        } else {
+            // Handles we assigned ourselves are resolved by the caller
+            name = d->m_handleNames.value(d->m_rxHandle);
+        }
+    }
+    qCDebug(QT_REMOTEOBJECT_IO) << "Packet received of type" << type << "for object" << name
+                                << "handle" << d->m_rxHandle;
+    return true;
+}
+
 /*!
     All communication between nodes happens through some form of QIODevice with
     an associated QDataStream to handle marshalling of Qt types. QtROIoDeviceBase
     is an abstract base class that provides a consistent interface to QtRO, yet
     can be extended to support different types of QIODevice.
  */
-QtROIoDeviceBase::QtROIoDeviceBase(QObject *parent) : QObject(*new QtROIoDeviceBasePrivate, parent) { }
+QtROIoDeviceBase::QtROIoDeviceBase(QObject *parent)
+    : QtROIoDeviceBase(*new QtROIoDeviceBasePrivate, parent)
+{
+}
 
-QtROIoDeviceBase::QtROIoDeviceBase(QtROIoDeviceBasePrivate &dptr, QObject *parent) : QObject(dptr, parent) { }
+QtROIoDeviceBase::QtROIoDeviceBase(QtROIoDeviceBasePrivate &dptr, QObject *parent)
+    : QObject(dptr, parent)
+{
+    // Fragments of the lost connection must not be mixed with those of the next one
+    connect(this, &QtROIoDeviceBase::disconnected, this, [&dptr]() { dptr.resetLanes(); });
+}
 
 QtROIoDeviceBase::~QtROIoDeviceBase()
 {
@@ -73,35 +136,186 @@ bool QtROIoDeviceBase::read(QRemoteObjectPacketTypeEnum &type, QString &name)
     Q_D(QtROIoDeviceBase);
     qCDebug(QT_REMOTEOBJECT_IO) << deviceType() << "read()" << d->m_curReadSize << bytesAvailable();
 
-    if (d->m_curReadSize == 0) {
-        if (bytesAvailable() < static_cast<int>(sizeof(quint32)))
+    const bool compact = d->m_readCodec
+            && d->m_readCodec->wireFormat() == QRemoteObjectPackets::WireFormat::Compact;
+    for (;;) {
+        if (d->m_transport) {
+            // The packet was framed on the I/O thread
+            if (!d->m_transport->takeFrame(d->m_frame))
+                return false;
+            d->m_frameBuffer.seek(0);
+            d->m_frameStream.resetStatus();
+        } else if (!d->receiveFrame(compact)) {
+            return false;
+        }
+        if (!compact || !d->isFragmentFrame())
+            break;
+
+        // Large packets arrive in fragments, possibly interleaved with other packets
+        bool complete = false;
+        if (!d->reassembleFrame(complete)) {
+            qCWarning(QT_REMOTEOBJECT_IO) << deviceType() << "Invalid fragment received";
+            close();
             return false;
+        }
+        if (complete)
+            break;
+    }
 
-        d->m_dataStream >> d->m_curReadSize;
+    const bool ok = d->decodeFrame(compact, type, name);
+    if (ok)
+        ++d->m_receivedPackets[type];
+    if (ok && type == Handshake && d->m_transport) {
+        // Handshakes can switch the codec, and with it the framing of the packets
+        // that follow. The I/O thread waits until the handshake has been handled.
+        QMetaObject::invokeMethod(this, [d]() {
+            if (d->m_transport)
+                d->m_transport->resume(d->m_readCodec
+                        && d->m_readCodec->wireFormat() == QRemoteObjectPackets::WireFormat::Compact);
+        }, Qt::QueuedConnection);
     }
+    return ok;
+}
 
-    qCDebug(QT_REMOTEOBJECT_IO) << deviceType() << "read()-looking for map" << d->m_curReadSize
-                                << bytesAvailable();
+void QtROIoDeviceBase::write(const QByteArray &data)
+{
+    write(data, data.size());
+}
 
-    if (bytesAvailable() < d->m_curReadSize)
-        return false;
+void QtROIoDeviceBase::write(const QByteArray &data, qint64 size)
+{
+    Q_D(QtROIoDeviceBase);
+    if (!d->isDeviceOpen())
+        return;
+
+    if (d->m_writeBufferingMode == QRemoteObjectNode::FlushImmediately && !d->m_coalesceWrites) {
+        d->writeToDevice(data, size);
+        return;
+    }
 
-    d->m_curReadSize = 0;
-    return fromDataStream(d->m_dataStream, type, name);
+    d->m_writeBuffer.append(data.data(), size);
+    if (d->m_writeBufferingThreshold > 0 && d->m_writeBuffer.size() >= d->m_writeBufferingThreshold) {
+        flush();
+        return;
+    }
+    if (!d->m_flushTimer.isActive()) {
+        // A zero timer fires once the event loop has processed the events that are
+        // already pending, i.e. at the end of the current event loop iteration.
+        const auto delay = d->m_writeBufferingMode == QRemoteObjectNode::FlushAfterDelay
+                ? d->m_writeBufferingDelay : std::chrono::microseconds::zero();
+        d->m_flushTimer.start(delay, Qt::PreciseTimer, this);
+    }
 }
 
-void QtROIoDeviceBase::write(const QByteArray &data)
+/*!
+    Writes all data held back by the output buffer to the underlying QIODevice
+    in a single write.
+
+    \sa setWriteBuffering()
+ */
+void QtROIoDeviceBase::flush()
 {
     Q_D(QtROIoDeviceBase);
-    if (connection()->isOpen() && !d->m_isClosing)
-        connection()->write(data);
+    d->m_flushTimer.stop();
+    if (d->m_writeBuffer.isEmpty())
+        return;
+
+    if (d->isDeviceOpen()) {
+        d->writeToDevice(d->m_writeBuffer, d->m_writeBuffer.size());
+    }
+    // Keep the capacity around, the next event loop iteration will most likely need it again
+    d->m_writeBuffer.truncate(0);
 }
 
-void QtROIoDeviceBase::write(const QByteArray &data, qint64 size)
+/*!
+    Configures how data passed to write() is handed to the underlying QIODevice.
+
+    With QRemoteObjectNode::FlushImmediately every packet is written as soon as
+    it has been serialized. The other modes collect the packets in an output
+    buffer and write them in one go, either once control returns to the event
+    loop or after \a delay has elapsed. If \a threshold is larger than \c 0, the
+    buffer is flushed as soon as it holds at least \a threshold bytes.
+ */
+void QtROIoDeviceBase::setWriteBuffering(QRemoteObjectNode::WriteBufferingMode mode,
+                                         std::chrono::microseconds delay, qint64 threshold)
+{
+    Q_D(QtROIoDeviceBase);
+    d->m_writeBufferingMode = mode;
+    d->m_writeBufferingDelay = delay;
+    d->m_writeBufferingThreshold = threshold;
+    if (mode == QRemoteObjectNode::FlushImmediately && !d->m_coalesceWrites)
+        flush();
+}
+
+/*!
+    Makes QRemoteObjectNode::FlushImmediately behave like
+    QRemoteObjectNode::FlushAtEndOfEventLoop on this connection if \a coalesce
+    is \c true.
+
+    Backends call this when the packets would otherwise leave in as many
+    segments as there are writes, e.g. for TCP connections with Nagle's
+    algorithm disabled. The other write buffering modes are not affected.
+ */
+void QtROIoDeviceBase::setCoalescingWrites(bool coalesce)
+{
+    Q_D(QtROIoDeviceBase);
+    d->m_coalesceWrites = coalesce;
+    if (!coalesce && d->m_writeBufferingMode == QRemoteObjectNode::FlushImmediately)
+        flush();
+}
+
+/*!
+    Returns the socket options in effect on the connection, keyed by the names
+    of the URL query items setting them, or an empty map if the backend has
+    none or is not connected.
+
+    \sa QRemoteObjectNode::socketOptions()
+ */
+QVariantMap QtROIoDeviceBase::socketOptions() const
+{
+    return QVariantMap();
+}
+
+QRemoteObjectNode::WriteBufferingMode QtROIoDeviceBase::writeBufferingMode() const
+{
+    Q_D(const QtROIoDeviceBase);
+    return d->m_writeBufferingMode;
+}
+
+/*!
+    Compresses the packets of at least \a threshold bytes sent on this connection
+    with \a algorithm, once the peer announced that it can decompress it.
+
+    \sa QRemoteObjectNode::setCompression()
+ */
+void QtROIoDeviceBase::setCompression(QRemoteObjectNode::CompressionAlgorithm algorithm,
+                                      qint64 threshold)
+{
+    Q_D(QtROIoDeviceBase);
+    d->m_compression = algorithm;
+    d->m_compressionThreshold = threshold;
+    d->updateCompression();
+}
+
+/*!
+    Sends the packets of this connection that are larger than \a size bytes in
+    fragments of at most \a size bytes, once the compact wire format is used.
+
+    \sa QRemoteObjectNode::setTransferChunkSize()
+ */
+void QtROIoDeviceBase::setTransferChunkSize(qint64 size)
 {
     Q_D(QtROIoDeviceBase);
-    if (connection()->isOpen() && !d->m_isClosing)
-        connection()->write(data.data(), size);
+    d->m_fragmentSize = qsizetype(qMax(size, qint64(QtRemoteObjects::minimumFragmentSize)));
+}
+
+void QtROIoDeviceBase::timerEvent(QTimerEvent *event)
+{
+    Q_D(QtROIoDeviceBase);
+    if (event->timerId() == d->m_flushTimer.timerId())
+        flush();
+    else
+        QObject::timerEvent(event);
 }
 
 bool QtROIoDeviceBase::isOpen() const
@@ -112,6 +326,8 @@ bool QtROIoDeviceBase::isOpen() const
 void QtROIoDeviceBase::close()
 {
     Q_D(QtROIoDeviceBase);
+    d->writeBulk(true);
+    flush();
     d->m_isClosing = true;
     doClose();
 }
@@ -265,6 +481,10 @@ QtROServerFactory::QtROServerFactory()
 #endif
 #ifdef Q_OS_LINUX
     registerType<AbstractLocalServerImpl>(QStringLiteral("localabstract"));
+#endif
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    registerType<ShmServerImpl>(QStringLiteral("shm"));
+    registerType<EpollServerImpl>(QStringLiteral("tcp+epoll"));
 #endif
     registerType<LocalServerImpl>(QStringLiteral("local"));
     registerType<TcpServerImpl>(QStringLiteral("tcp"));
@@ -287,6 +507,10 @@ QtROClientFactory::QtROClientFactory()
 #endif
 #ifdef Q_OS_LINUX
     registerType<AbstractLocalClientIo>(QStringLiteral("localabstract"));
+#endif
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    registerType<ShmClientIo>(QStringLiteral("shm"));
+    registerType<EpollClientIo>(QStringLiteral("tcp+epoll"));
 #endif
     registerType<LocalClientIo>(QStringLiteral("local"));
     registerType<TcpClientIo>(QStringLiteral("tcp"));
@@ -355,6 +579,561 @@ QtROIoDeviceBasePrivate::QtROIoDeviceBasePrivate() : QObjectPrivate()
 {
     m_dataStream.setVersion(dataStreamVersion);
     m_dataStream.setByteOrder(QDataStream::LittleEndian);
+    m_frameBuffer.setBuffer(&m_frame);
+    m_frameBuffer.open(QIODevice::ReadOnly);
+    m_frameStream.setDevice(&m_frameBuffer);
+    m_frameStream.setVersion(dataStreamVersion);
+    m_frameStream.setByteOrder(QDataStream::LittleEndian);
+}
+
+QtROIoDeviceBasePrivate::~QtROIoDeviceBasePrivate()
+{
+    QRemoteObjectPackets::releaseBlobChannel(&m_frameBuffer);
+}
+
+bool QtROIoDeviceBasePrivate::isDeviceOpen() const
+{
+    Q_Q(const QtROIoDeviceBase);
+    if (m_isClosing)
+        return false;
+    if (m_transport)
+        return m_transport->isOpen();
+    QIODevice *device = q->connection();
+    return device && device->isOpen();
+}
+
+// The number of bytes written to the device that did not make it to the network yet
+qint64 QtROIoDeviceBasePrivate::unsentBytes() const
+{
+    Q_Q(const QtROIoDeviceBase);
+    qint64 buffered = m_writeBuffer.size();
+    if (m_transport) {
+        buffered += m_transport->bufferedBytes();
+    } else if (QIODevice *device = q->connection()) {
+        buffered += device->bytesToWrite();
+    }
+    return buffered;
+}
+
+// Like unsentBytes(), including the packets waiting for their turn, see writePackets(), and
+// the blobs the peer did not take yet
+qint64 QtROIoDeviceBasePrivate::bufferedBytes() const
+{
+    return unsentBytes() + m_bulkBytes + (m_blobChannel ? m_blobChannel->bufferedBytes() : 0);
+}
+
+void QtROIoDeviceBasePrivate::writeToDevice(const QByteArray &data, qint64 size)
+{
+    Q_Q(QtROIoDeviceBase);
+    // The I/O thread shares data instead of copying it
+    if (m_transport)
+        m_transport->write(size == data.size() ? data : data.first(size));
+    else
+        q->connection()->write(data.constData(), size);
+}
+
+// Packets for child objects keep their order relative to those of the root object,
+// children are named after their parent (see QRemoteObjectSource)
+static QStringView orderingKey(QStringView name)
+{
+    while (name.startsWith(QLatin1String("Class::")) || name.startsWith(QLatin1String("Model::")))
+        name = name.sliced(7);
+    const qsizetype end = name.indexOf(QLatin1String("::"));
+    return end < 0 ? name : name.first(end);
+}
+
+/*
+    Writes the packets of a payload serialized by a codec. Codecs that describe their
+    packets (QCompactCodec) get two priority lanes: packets larger than m_fragmentSize
+    are sent as Fragment packets as the device drains (see writeBulk()), interleaved with
+    the fragments of other large packets, and smaller packets overtake them. Packets
+    addressed to the same object as a waiting packet, and packets concerning the
+    connection, wait for their turn so the packets of an object keep their order. Packets
+    announcing type names concern the connection, as the packets of any object can refer
+    to the names afterwards. Ping and Pong always overtake, heartbeats must not time out
+    while large packets are sent.
+*/
+bool QtROIoDeviceBasePrivate::writePackets(const QByteArray &payload,
+                                           const QList<QRemoteObjectPackets::PacketSpan> *packets)
+{
+    Q_Q(QtROIoDeviceBase);
+    using namespace QRemoteObjectPackets;
+    // Packets too large for the receiver to reassemble are sent whole
+    const auto isLarge = [this](qsizetype size) {
+        return size > m_fragmentSize && size <= maximumUncompressedSize;
+    };
+    const auto hasLargePacket = [packets, &isLarge]() {
+        qsizetype begin = 0;
+        for (const PacketSpan &packet : *packets) {
+            if (isLarge(packet.end - begin))
+                return true;
+            begin = packet.end;
+        }
+        return false;
+    };
+    if (!packets || (m_bulk.isEmpty() && !hasLargePacket())) {
+        q->write(payload);
+        return isDeviceOpen();
+    }
+    if (!isDeviceOpen())
+        return false;
+
+    // Consecutive packets that don't wait are written together
+    qsizetype runBegin = 0;
+    const auto writeRun = [&](qsizetype runEnd) {
+        if (runEnd <= runBegin)
+            return;
+        if (runBegin == 0 && runEnd == payload.size())
+            q->write(payload);
+        else
+            q->write(payload.sliced(runBegin, runEnd - runBegin));
+    };
+    qsizetype begin = 0;
+    for (const PacketSpan &packet : *packets) {
+        const QStringView key = packet.announcesTypes ? QStringView() : orderingKey(packet.object);
+        const bool large = isLarge(packet.end - begin);
+        if (large || (!packet.urgent && mustQueue(key))) {
+            writeRun(begin);
+            BulkPacket bulk { key.toString(), QString(), payload, begin, packet.end, 0, 0, large };
+            if (large) {
+                // Fragments carry the packet without its size
+                while (quint8(payload.at(bulk.begin)) & 0x80)
+                    ++bulk.begin;
+                ++bulk.begin;
+                bulk.object = packet.object;
+                bulk.size = bulk.end - bulk.begin;
+                bulk.stream = m_nextBulkStream++;
+            }
+            m_bulkBytes += bulk.end - bulk.begin;
+            m_bulk.append(std::move(bulk));
+            runBegin = packet.end;
+        }
+        begin = packet.end;
+    }
+    writeRun(begin);
+    writeBulk();
+    return isDeviceOpen();
+}
+
+// Whether a packet for the object with the ordering key has to wait for the waiting packets
+bool QtROIoDeviceBasePrivate::mustQueue(QStringView key) const
+{
+    return std::any_of(m_bulk.cbegin(), m_bulk.cend(), [key](const BulkPacket &packet) {
+        return key.isEmpty() || packet.key.isEmpty() || packet.key == key;
+    });
+}
+
+// The waiting packet to write next. The first waiting packet of each object is eligible,
+// the objects take turns. No other fragmented packet is started while
+// QtRemoteObjects::maximumFragmentStreams of them are being sent.
+qsizetype QtROIoDeviceBasePrivate::nextBulkPacket()
+{
+    const auto isStarted = [](const BulkPacket &packet) {
+        return packet.fragmented && packet.end - packet.begin != packet.size;
+    };
+    const bool canStart = std::count_if(m_bulk.cbegin(), m_bulk.cend(), isStarted)
+            < QtRemoteObjects::maximumFragmentStreams;
+    QVarLengthArray<qsizetype, 8> candidates;
+    for (qsizetype i = 0; i < m_bulk.size(); ++i) {
+        const QString &key = m_bulk.at(i).key;
+        if (key.isEmpty()) {
+            if (i == 0)
+                candidates.append(i);
+            break;
+        }
+        const auto previous = m_bulk.cbegin() + i;
+        if (std::none_of(m_bulk.cbegin(), previous,
+                         [&key](const BulkPacket &packet) { return packet.key == key; })
+            && (canStart || !m_bulk.at(i).fragmented || isStarted(m_bulk.at(i)))) {
+            candidates.append(i);
+        }
+    }
+    // Started packets are always the first of their object
+    Q_ASSERT(!candidates.isEmpty());
+    return candidates.at(m_bulkTurn++ % quint32(candidates.size()));
+}
+
+// Writes waiting packets while the device has less than a fragment left to write, or all
+// of them. The rest is written once the device wrote some of its data.
+void QtROIoDeviceBasePrivate::writeBulk(bool all)
+{
+    Q_Q(QtROIoDeviceBase);
+    using namespace QRemoteObjectPackets;
+    if (m_bulk.isEmpty())
+        return;
+    if (!isDeviceOpen()) {
+        resetLanes();
+        return;
+    }
+    // Set before writing, the I/O thread can finish writing before we are done here
+    if (m_transport)
+        m_transport->setNotifyWritten(true);
+
+    while (!m_bulk.isEmpty() && (all || unsentBytes() < m_fragmentSize)) {
+        const qsizetype index = nextBulkPacket();
+        BulkPacket &packet = m_bulk[index];
+        const qsizetype size = packet.end - packet.begin;
+        if (!packet.fragmented) {
+            q->write(packet.payload.sliced(packet.begin, size));
+            m_bulkBytes -= size;
+            m_bulk.removeAt(index);
+            continue;
+        }
+
+        // <varint size><quint8 Fragment><varint stream><quint8 flags>[<varint packet size>
+        // <string object>]<next bytes of the packet>, the bracketed part in the first fragment
+        const qsizetype chunk = qMin(size, m_fragmentSize);
+        const bool first = size == packet.size;
+        const bool last = chunk == size;
+        QByteArray body;
+        {
+            QDataStream ds(&body, QIODevice::WriteOnly);
+            ds << quint8(Fragment);
+            writeVarint(ds, packet.stream);
+            ds << quint8((first ? FirstFragmentFlag : 0) | (last ? LastFragmentFlag : 0));
+            if (first) {
+                writeVarint(ds, quint64(packet.size));
+                writeCompactString(ds, packet.object);
+            }
+        }
+        char header[10];
+        const int sizeSize = encodeVarint(header, quint64(body.size() + chunk));
+        QByteArray fragment;
+        fragment.reserve(sizeSize + body.size() + chunk);
+        fragment.append(header, sizeSize);
+        fragment.append(body);
+        fragment.append(packet.payload.constData() + packet.begin, chunk);
+        q->write(fragment);
+        packet.begin += chunk;
+        m_bulkBytes -= chunk;
+        if (last)
+            m_bulk.removeAt(index);
+    }
+
+    if (m_transport) {
+        if (m_bulk.isEmpty())
+            m_transport->setNotifyWritten(false);
+    } else if (!m_bulk.isEmpty() && !m_bulkNotifier) {
+        if (QIODevice *device = q->connection()) {
+            m_bulkNotifier = QObject::connect(device, &QIODevice::bytesWritten, q,
+                                              [this]() { writeBulk(); });
+        }
+    }
+}
+
+void QtROIoDeviceBasePrivate::resetLanes()
+{
+    m_bulk.clear();
+    m_bulkBytes = 0;
+    m_fragments.clear();
+    if (m_transport)
+        m_transport->setNotifyWritten(false);
+}
+
+// Reads the size of the next packet from the device, then moves as much of the packet
+// as is available into m_frame. Returns true once the packet is complete.
+bool QtROIoDeviceBasePrivate::receiveFrame(bool compact)
+{
+    Q_Q(QtROIoDeviceBase);
+    if (m_curReadSize == 0) {
+        if (compact) {
+            // The size is a varint, only consume it once it is complete
+            char header[5];
+            const qint64 peeked = q->connection()->peek(header, sizeof(header));
+            quint32 size = 0;
+            qint64 headerSize = 0;
+            for (qint64 i = 0; i < peeked; ++i) {
+                size |= quint32(quint8(header[i]) & 0x7f) << (7 * i);
+                if (!(quint8(header[i]) & 0x80)) {
+                    headerSize = i + 1;
+                    break;
+                }
+            }
+            if (headerSize == 0) {
+                if (peeked == qint64(sizeof(header))) {
+                    qCWarning(QT_REMOTEOBJECT_IO) << q->deviceType() << "Invalid packet size received";
+                    q->close();
+                }
+                return false;
+            }
+            m_dataStream.skipRawData(int(headerSize));
+            m_curReadSize = size;
+        } else {
+            if (q->bytesAvailable() < static_cast<int>(sizeof(quint32)))
+                return false;
+
+            m_dataStream >> m_curReadSize;
+        }
+        startFrame();
+    }
+
+    qCDebug(QT_REMOTEOBJECT_IO) << q->deviceType() << "read()-looking for map" << m_curReadSize
+                                << q->bytesAvailable();
+
+    if (!readFrame())
+        return false;
+
+    m_curReadSize = 0;
+    return true;
+}
+
+bool QtROIoDeviceBasePrivate::isFragmentFrame() const
+{
+    return !m_frame.isEmpty() && quint8(m_frame.at(0)) == Fragment;
+}
+
+// Adds the fragment held by m_frame to its packet, see writeBulk(). Once the last
+// fragment arrived, m_frame holds the complete packet and complete is set.
+bool QtROIoDeviceBasePrivate::reassembleFrame(bool &complete)
+{
+    Q_Q(QtROIoDeviceBase);
+    using namespace QRemoteObjectPackets;
+    quint8 id;
+    quint64 stream;
+    quint8 flags;
+    m_frameStream >> id;
+    if (!readVarint(m_frameStream, stream))
+        return false;
+    m_frameStream >> flags;
+    if (m_frameStream.status() != QDataStream::Ok)
+        return false;
+
+    if (flags & FirstFragmentFlag) {
+        // The sender keeps to the limits (see writePackets()), the size is only a claim
+        // until the data arrived, nothing is allocated for it upfront
+        quint64 size;
+        if (!readVarint(m_frameStream, size) || size > quint64(maximumUncompressedSize)
+                || m_fragments.contains(stream)
+                || m_fragments.size() >= QtRemoteObjects::maximumFragmentStreams) {
+            return false;
+        }
+        const QString object = readCompactString(m_frameStream);
+        if (m_frameStream.status() != QDataStream::Ok)
+            return false;
+        m_fragments.insert(stream, { QByteArray(), object, qsizetype(size) });
+    }
+    const auto it = m_fragments.find(stream);
+    if (it == m_fragments.end())
+        return false;
+
+    const qint64 pos = m_frameBuffer.pos();
+    const qsizetype chunk = m_frame.size() - pos;
+    if (chunk > it->size - it->data.size())
+        return false;
+    it->data.append(m_frame.constData() + pos, chunk);
+    complete = flags & LastFragmentFlag;
+    if (complete && it->data.size() != it->size)
+        return false;
+    const QString object = it->object;
+    const qint64 received = it->data.size();
+    const qint64 total = it->size;
+    if (complete) {
+        // The packet is decoded as if it had been received in one piece
+        m_frame = std::move(it->data);
+        m_fragments.erase(it);
+        m_frameBuffer.seek(0);
+        m_frameStream.resetStatus();
+    }
+    emit q->transferProgress(object, received, total);
+    return !complete || !m_frame.isEmpty();
+}
+
+// Parses the header of the complete packet held by m_frame
+bool QtROIoDeviceBasePrivate::decodeFrame(bool compact, QRemoteObjectPacketTypeEnum &type,
+                                          QString &name)
+{
+    Q_Q(QtROIoDeviceBase);
+    m_rxHandle = -1;
+    if (compact) {
+        quint8 id;
+        m_frameStream >> id;
+        if (id & QRemoteObjectPackets::CompactCompressedFlag) {
+            if (!uncompressFrame()) {
+                qCWarning(QT_REMOTEOBJECT_IO) << q->deviceType()
+                                              << "Invalid compressed packet received";
+                q->close();
+                return false;
+            }
+            id = quint8(id & ~QRemoteObjectPackets::CompactCompressedFlag);
+        }
+        QRemoteObjectPackets::setBlobChannel(&m_frameBuffer, m_blobChannel.data());
+        return fromCompactStream(m_frameStream, id, type, name, this);
+    }
+    return fromDataStream(m_frameStream, type, name);
+}
+
+void QtROIoDeviceBasePrivate::startFrame()
+{
+    // Only reuse the buffer (and its capacity) if nothing else references it, such as
+    // the I/O thread that handed it over or values sharing the last packet's data
+    if (!m_frame.isDetached())
+        m_frame = QByteArray();
+    m_frame.truncate(0);
+    m_frameBuffer.seek(0);
+}
+
+// Moves the available bytes of the packet being received (m_curReadSize bytes) from
+// the device into m_frame. Returns true once the packet is complete, with m_frameStream
+// positioned at its start.
+bool QtROIoDeviceBasePrivate::readFrame()
+{
+    Q_Q(QtROIoDeviceBase);
+    const qsizetype received = m_frame.size();
+    const qint64 missing = qint64(m_curReadSize) - received;
+    const qint64 available = qMin(q->bytesAvailable(), missing);
+    if (available > 0) {
+        m_frame.resize(received + available);
+        const qint64 read = q->connection()->read(m_frame.data() + received, available);
+        m_frame.truncate(received + qMax(read, qint64(0)));
+    }
+    if (m_frame.size() < qsizetype(m_curReadSize))
+        return false;
+
+    m_frameStream.resetStatus();
+    return true;
+}
+
+static QLatin1String compressionAlgorithmName(QRemoteObjectNode::CompressionAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case QRemoteObjectNode::ZlibCompression:
+        return QLatin1String("zlib");
+    case QRemoteObjectNode::ZstdCompression:
+        return QLatin1String("zstd");
+    case QRemoteObjectNode::NoCompression:
+        break;
+    }
+    return QLatin1String();
+}
+
+void QtROIoDeviceBasePrivate::updateCompression()
+{
+    if (!m_codec)
+        return;
+
+    // Fall back to zlib if the peer (or this build) can't handle the requested algorithm
+    const quint8 usable = m_peerCompression & QRemoteObjectPackets::supportedCompressionAlgorithms();
+    QRemoteObjectNode::CompressionAlgorithm algorithm = m_compression;
+    if (algorithm != QRemoteObjectNode::NoCompression && !(usable & (1 << algorithm))) {
+        algorithm = (usable & (1 << QRemoteObjectNode::ZlibCompression))
+                ? QRemoteObjectNode::ZlibCompression : QRemoteObjectNode::NoCompression;
+    }
+    m_codec->setCompression(algorithm, m_compressionThreshold);
+}
+
+void QtROIoDeviceBasePrivate::sendCompressionHandshake()
+{
+    Q_Q(QtROIoDeviceBase);
+    QString handshake = compressionProtocolPrefix;
+    const quint8 supported = QRemoteObjectPackets::supportedCompressionAlgorithms();
+    for (const auto algorithm : {QRemoteObjectNode::ZlibCompression,
+                                 QRemoteObjectNode::ZstdCompression}) {
+        if (!(supported & (1 << algorithm)))
+            continue;
+        if (handshake.size() > compressionProtocolPrefix.size())
+            handshake += QLatin1Char(',');
+        handshake += compressionAlgorithmName(algorithm);
+    }
+    m_codec->serializeHandshakePacket(handshake);
+    m_codec->send(q);
+}
+
+bool QtROIoDeviceBasePrivate::handleCompressionHandshake(const QString &handshake)
+{
+    if (!handshake.startsWith(compressionProtocolPrefix))
+        return false;
+
+    m_peerCompression = 0;
+    const QStringView algorithms = QStringView(handshake).sliced(compressionProtocolPrefix.size());
+    for (const auto name : algorithms.tokenize(QLatin1Char(','))) {
+        for (const auto algorithm : {QRemoteObjectNode::ZlibCompression,
+                                     QRemoteObjectNode::ZstdCompression}) {
+            if (name == compressionAlgorithmName(algorithm))
+                m_peerCompression |= 1 << algorithm;
+        }
+    }
+    updateCompression();
+    return true;
+}
+
+bool QtROIoDeviceBasePrivate::uncompressFrame()
+{
+    // <quint8 id | CompactCompressedFlag><quint8 algorithm><compressed payload>
+    const qint64 pos = m_frameBuffer.pos();
+    if (m_frame.size() - pos < 1)
+        return false;
+    const quint8 algorithm = quint8(m_frame.at(pos));
+    const quint8 supported = QRemoteObjectPackets::supportedCompressionAlgorithms();
+    if (algorithm >= 8 || !(supported & (1 << algorithm)))
+        return false;
+    QByteArray payload = QRemoteObjectPackets::uncompressPayload(
+            QRemoteObjectNode::CompressionAlgorithm(algorithm), m_frame.constData() + pos + 1,
+            m_frame.size() - pos - 1);
+    if (payload.isEmpty())
+        return false;
+    ++m_compressedPackets;
+
+    // The rest of the packet is parsed as if it had been sent uncompressed
+    m_frame = std::move(payload);
+    m_frameBuffer.seek(0);
+    return true;
+}
+
+// Client side, see QtRemoteObjects::descriptorProtocolPrefix
+void QtROIoDeviceBasePrivate::requestBlobChannel()
+{
+    Q_Q(QtROIoDeviceBase);
+    if (!m_blobChannel)
+        return;
+    m_codec->serializeHandshakePacket(descriptorProtocolPrefix);
+    m_codec->send(q);
+}
+
+bool QtROIoDeviceBasePrivate::handleDescriptorHandshake(const QString &handshake)
+{
+    Q_Q(QtROIoDeviceBase);
+    if (!handshake.startsWith(descriptorProtocolPrefix))
+        return false;
+    if (!m_blobChannel)
+        return true;
+
+    const QString address = handshake.sliced(descriptorProtocolPrefix.size());
+    if (address.isEmpty()) {
+        // The client asks for a channel
+        const QString offer = m_blobChannel->listen();
+        if (offer.isEmpty())
+            return true;
+        m_codec->serializeHandshakePacket(descriptorProtocolPrefix + offer);
+        m_codec->send(q);
+    } else if (m_blobChannel->isListening()) {
+        // The client connected to the address we offered
+        if (m_blobChannel->accept(address))
+            m_codec->setBlobThreshold(blobThreshold);
+    } else if (m_blobChannel->connectToHost(address)) {
+        // The host accepts our connection once it gets the acknowledgement
+        m_codec->serializeHandshakePacket(handshake);
+        m_codec->send(q);
+        m_codec->setBlobThreshold(blobThreshold);
+    }
+    qCDebug(QT_REMOTEOBJECT_IO) << q->deviceType() << "Blob channel" << handshake
+                                << "threshold" << m_codec->blobThreshold();
+    return true;
+}
+
+// The blobs have to reach the peer before the packets referencing them are decoded, if they
+// can't be sent the packets can't be decoded either. The channel queues the blobs that don't
+// fit into its socket, the peer waits for them.
+bool QtROIoDeviceBasePrivate::sendBlobs(const QList<QRemoteObjectPackets::OutgoingBlob> *blobs)
+{
+    Q_Q(QtROIoDeviceBase);
+    if (!blobs || blobs->isEmpty())
+        return true;
+    if (m_blobChannel && m_blobChannel->sendBlobs(*blobs))
+        return true;
+    qCWarning(QT_REMOTEOBJECT_IO) << q->deviceType() << "Unable to pass" << blobs->size()
+                                  << "blobs, closing the connection";
+    q->close();
+    return false;
 }
 
 QT_END_NAMESPACE
@@ -49,20 +49,34 @@ public:
     void removeSource(const QString &);
     QSet<QString> remoteObjects() const;
 
+    void setWriteBuffering(QRemoteObjectNode::WriteBufferingMode mode,
+                           std::chrono::microseconds delay, qint64 threshold);
+    QRemoteObjectNode::WriteBufferingMode writeBufferingMode() const;
+    void flush();
+    void setCompression(QRemoteObjectNode::CompressionAlgorithm algorithm, qint64 threshold);
+    void setTransferChunkSize(qint64 size);
+    void setCoalescingWrites(bool coalesce);
+    virtual QVariantMap socketOptions() const;
+
 Q_SIGNALS:
     void readyRead();
     void disconnected();
+    void transferProgress(const QString &name, qint64 bytesReceived, qint64 bytesTotal);
 
 protected:
     explicit QtROIoDeviceBase(QtROIoDeviceBasePrivate &, QObject *parent);
     virtual QString deviceType() const = 0;
     virtual void doClose() = 0;
+    void timerEvent(QTimerEvent *event) override;
 
 private:
     Q_DECLARE_PRIVATE(QtROIoDeviceBase)
     friend class QRemoteObjectNodePrivate;
     friend class QConnectedReplicaImplementation;
     friend class QRemoteObjectSourceIo;
+    friend class QRemoteObjectSourceBase;
+    friend class QRemoteObjectRootSource;
+    friend class QtROIoTransport;
 };
 
 class Q_REMOTEOBJECTS_EXPORT QtROServerIoDevice : public QtROIoDeviceBase
@@ -126,6 +140,7 @@ protected:
 private:
     Q_DECLARE_PRIVATE(QtROClientIoDevice)
     friend class QtROClientFactory;
+    friend class QtROIoTransport;
 };
 
 class QtROServerFactory
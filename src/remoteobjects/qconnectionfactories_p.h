@@ -15,9 +15,12 @@
 // We mean it.
 //
 
+#include <QtCore/qbasictimer.h>
+#include <QtCore/qbuffer.h>
 #include <QtCore/qdatastream.h>
 #include <QtCore/qiodevice.h>
 #include <QtCore/qpointer.h>
+#include <QtCore/qsharedpointer.h>
 #include <QtCore/private/qobject_p.h>
 
 #include <QtRemoteObjects/qtremoteobjectglobal.h>
@@ -32,9 +35,35 @@ namespace QtRemoteObjects {
 
 static const int dataStreamVersion = QDataStream::Qt_6_2;
 static const QLatin1String protocolVersion("QtRO 2.0");
+// Peers that support QCompactCodec offer it by sending a Handshake packet with
+// this name after accepting protocolVersion. The other side accepts by sending
+// the same Handshake back, the offering side then acknowledges the switch.
+// Peers that don't know it ignore the packet and keep using QDataStreamCodec.
+static const QLatin1String compactProtocolVersion("QtRO 2.0 compact");
+// Once the compact codec is used, both sides send a Handshake packet with this
+// prefix followed by a comma separated list of the compression algorithms they
+// can decompress, e.g. "QtRO 2.0 compression:zlib,zstd".
+static const QLatin1String compressionProtocolPrefix("QtRO 2.0 compression:");
+// Compact packets larger than this are sent in Fragment packets of at most this size by
+// default, see QtROIoDeviceBasePrivate::writePackets() and QRemoteObjectNode::setTransferChunkSize()
+static const qsizetype bulkFragmentSize = 32 * 1024;
+static const qsizetype minimumFragmentSize = 1024;
+// At most this many packets are sent in fragments at the same time on a connection, and
+// packets larger than QRemoteObjectPackets::maximumUncompressedSize are sent whole. The
+// receiving side closes connections exceeding either limit.
+static const int maximumFragmentStreams = 16;
+// Clients that can receive large byte arrays out of band (see QRemoteObjectPackets::BlobChannel)
+// ask for it with a Handshake packet of just this prefix, once the compact codec is used.
+// The host answers with the prefix followed by the address to connect to, the client
+// acknowledges with the same packet once it connected. Peers without support ignore it.
+static const QLatin1String descriptorProtocolPrefix("QtRO 2.0 descriptors:");
+// Byte arrays from this size on are passed out of band once the channel is set up
+static const qsizetype blobThreshold = 64 * 1024;
 
 }
 
+class QtROIoTransport;
+
 class QtROExternalIoDevice : public QtROIoDeviceBase
 {
     Q_OBJECT
@@ -55,15 +84,143 @@ class QtROIoDeviceBasePrivate : public QObjectPrivate
 {
 public:
     QtROIoDeviceBasePrivate();
+    ~QtROIoDeviceBasePrivate() override;
+
+    static QtROIoDeviceBasePrivate *get(QtROIoDeviceBase *device) { return device->d_func(); }
 
     // TODO Remove stream()
-    QDataStream &stream() { return m_dataStream; }
+    QDataStream &stream() { return m_frameStream; }
+
+    bool isDeviceOpen() const;
+    qint64 unsentBytes() const;
+    qint64 bufferedBytes() const;
+    void writeToDevice(const QByteArray &data, qint64 size);
+    // Returns false if the connection was closed instead
+    bool writePackets(const QByteArray &payload,
+                      const QList<QRemoteObjectPackets::PacketSpan> *packets);
+    bool mustQueue(QStringView object) const;
+    qsizetype nextBulkPacket();
+    void writeBulk(bool all = false);
+    void resetLanes();
+    bool receiveFrame(bool compact);
+    bool isFragmentFrame() const;
+    bool reassembleFrame(bool &complete);
+    bool decodeFrame(bool compact, QtRemoteObjects::QRemoteObjectPacketTypeEnum &type,
+                     QString &name);
+    void startFrame();
+    bool readFrame();
+    void updateCompression();
+    void sendCompressionHandshake();
+    bool handleCompressionHandshake(const QString &handshake);
+    bool uncompressFrame();
+    void requestBlobChannel();
+    bool handleDescriptorHandshake(const QString &handshake);
+    bool sendBlobs(const QList<QRemoteObjectPackets::OutgoingBlob> *blobs);
+
+    bool isHandleAnnounced(int handle) const
+    {
+        return handle < m_announcedHandles.size() && m_announcedHandles.at(handle);
+    }
+    void setHandleAnnounced(int handle)
+    {
+        if (handle >= m_announcedHandles.size())
+            m_announcedHandles.resize(handle + 1);
+        m_announcedHandles[handle] = true;
+    }
+    bool isHandleRetired(int handle) const
+    {
+        return handle < m_retiredHandles.size() && m_retiredHandles.at(handle);
+    }
+    void retireHandle(int handle)
+    {
+        if (!isHandleAnnounced(handle))
+            return;
+        m_announcedHandles[handle] = false;
+        if (handle >= m_retiredHandles.size())
+            m_retiredHandles.resize(handle + 1);
+        m_retiredHandles[handle] = true;
+    }
 
     bool m_isClosing = false;
     quint32 m_curReadSize = 0;
     QDataStream m_dataStream;
+    // The packet being received. Its bytes are moved from the device into m_frame as
+    // they arrive, the complete packet is decoded from m_frameStream. m_frame keeps
+    // its capacity from packet to packet, unless a large QByteArray value decoded from
+    // it still shares its data (see readCompactByteArray()).
+    QByteArray m_frame;
+    QBuffer m_frameBuffer;
+    QDataStream m_frameStream;
     QSet<QString> m_remoteObjects;
+    // Codec used for the packets we send, and codec (and framing) of the packets we
+    // receive. They differ while a codec switch is being negotiated.
     std::unique_ptr<QRemoteObjectPackets::CodecBase> m_codec { nullptr };
+    std::unique_ptr<QRemoteObjectPackets::CodecBase> m_readCodec { nullptr };
+    // Numeric object handles (compact codec only). m_rxHandle is the handle the last
+    // packet read was addressed to, or -1. m_handleNames and m_handleObjects hold the
+    // handles the peer announced and the receiving objects resolved for them, indexed
+    // by handle. m_announcedHandles tracks the handles we announced to the peer, and
+    // m_retiredHandles those of removed objects. The peer can still send packets for the
+    // removed object by its handle, so objects that get a retired handle are addressed by
+    // name on this connection.
+    int m_rxHandle = -1;
+    QList<QString> m_handleNames;
+    QList<QWeakPointer<QObject>> m_handleObjects;
+    QList<bool> m_announcedHandles;
+    QList<bool> m_retiredHandles;
+    // Output buffering (corking), see QRemoteObjectNode::setWriteBuffering()
+    QRemoteObjectNode::WriteBufferingMode m_writeBufferingMode = QRemoteObjectNode::FlushImmediately;
+    std::chrono::microseconds m_writeBufferingDelay { 0 };
+    qint64 m_writeBufferingThreshold = 0;
+    // Set by backends whose writes aren't coalesced by the kernel, see setCoalescingWrites()
+    bool m_coalesceWrites = false;
+    QByteArray m_writeBuffer;
+    QBasicTimer m_flushTimer;
+    // Priority lanes (compact codec only), see writePackets(). Packets waiting for their
+    // turn, the number of their bytes not yet written, and the stream id of the next
+    // fragmented packet. Packets with an empty ordering key wait for all packets before them.
+    // m_fragmentSize is the size of the fragments, see QRemoteObjectNode::setTransferChunkSize().
+    struct BulkPacket
+    {
+        QString key;
+        QString object;
+        QByteArray payload;
+        qsizetype begin;
+        qsizetype end;
+        qsizetype size;
+        quint32 stream;
+        bool fragmented;
+    };
+    QList<BulkPacket> m_bulk;
+    qint64 m_bulkBytes = 0;
+    quint32 m_nextBulkStream = 0;
+    quint32 m_bulkTurn = 0;
+    qsizetype m_fragmentSize = QtRemoteObjects::bulkFragmentSize;
+    QMetaObject::Connection m_bulkNotifier;
+    // The large packets being received, by stream id. The first fragment tells the size
+    // of the packet and the object it addresses, for QtROIoDeviceBase::transferProgress().
+    struct IncomingPacket
+    {
+        QByteArray data;
+        QString object;
+        qsizetype size;
+    };
+    QHash<quint64, IncomingPacket> m_fragments;
+    // Compression, see QRemoteObjectNode::setCompression(). m_peerCompression is the
+    // mask of algorithms the peer announced it can decompress.
+    QRemoteObjectNode::CompressionAlgorithm m_compression = QRemoteObjectNode::NoCompression;
+    qint64 m_compressionThreshold = 0;
+    quint8 m_peerCompression = 0;
+    // Passes large byte arrays out of band, set by the backends supporting it. Shared with
+    // the backend device when the connection runs on an I/O thread.
+    QSharedPointer<QRemoteObjectPackets::BlobChannel> m_blobChannel;
+    // Set if the transport runs on an I/O thread, see QRemoteObjectNode::setIoThreadEnabled().
+    // The packets are then framed there and read() only decodes them.
+    QtROIoTransport *m_transport = nullptr;
+    // The packets received, by type, and how many of them were compressed. Checked by the
+    // auto tests.
+    qint64 m_receivedPackets[QtRemoteObjects::ResyncPacket + 1] = {};
+    qint64 m_compressedPackets = 0;
     Q_DECLARE_PUBLIC(QtROIoDeviceBase)
 };
 
@@ -0,0 +1,116 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#include "qremoteobjectdatagram_p.h"
+
+#include "qconnectionfactories_p.h"
+
+#include <QtCore/qrandom.h>
+#include <QtNetwork/qudpsocket.h>
+
+QT_BEGIN_NAMESPACE
+
+namespace QRemoteObjectPackets {
+
+static constexpr quint32 datagramMagic = 0x51524f44; // "QROD"
+
+// <magic><token><name><sequence><property index><value>
+QByteArray serializeDatagram(const DatagramUpdate &update)
+{
+    QByteArray datagram;
+    QDataStream ds(&datagram, QIODevice::WriteOnly);
+    ds.setVersion(QtRemoteObjects::dataStreamVersion);
+    ds << datagramMagic << update.token << update.name << update.sequence
+       << qint32(update.propertyIndex) << update.value;
+    return datagram;
+}
+
+bool deserializeDatagram(const QByteArray &datagram, DatagramUpdate &update)
+{
+    QDataStream ds(datagram);
+    ds.setVersion(QtRemoteObjects::dataStreamVersion);
+    quint32 magic = 0;
+    ds >> magic;
+    if (magic != datagramMagic)
+        return false;
+    qint32 propertyIndex;
+    ds >> update.token >> update.name >> update.sequence >> propertyIndex >> update.value;
+    update.propertyIndex = propertyIndex;
+    return ds.status() == QDataStream::Ok && propertyIndex >= 0;
+}
+
+bool parseDatagramAddress(const QUrl &address, QHostAddress *group, quint16 *port)
+{
+    if (address.scheme() != QRemoteObjectStringLiterals::udp() || address.port() <= 0)
+        return false;
+    const QHostAddress host(address.host());
+    if (!host.isMulticast())
+        return false;
+    if (group)
+        *group = host;
+    if (port)
+        *port = quint16(address.port());
+    return true;
+}
+
+} // namespace QRemoteObjectPackets
+
+QtRODatagramSender::QtRODatagramSender(const QHostAddress &group, quint16 port,
+                                       const QUrl &address, const QList<int> &properties,
+                                       QObject *parent)
+    : QObject(parent)
+    , m_socket(new QUdpSocket(this))
+    , m_group(group)
+    , m_port(port)
+    , m_address(address)
+    , m_token(QRandomGenerator::system()->generate64())
+    , m_properties(properties)
+{
+    // Replicas on the same host receive the datagrams as well
+    m_socket->bind(group.protocol() == QAbstractSocket::IPv6Protocol ? QHostAddress::AnyIPv6
+                                                                      : QHostAddress::AnyIPv4);
+    m_socket->setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+    m_watermarkTimer.setSingleShot(true);
+    m_watermarkTimer.setInterval(250);
+    connect(&m_watermarkTimer, &QTimer::timeout, this, &QtRODatagramSender::watermarkDue);
+}
+
+QtRODatagramSender::~QtRODatagramSender()
+    = default;
+
+bool QtRODatagramSender::send(const QString &name, int internalIndex, const QVariant &value)
+{
+    QRemoteObjectPackets::DatagramUpdate update;
+    update.token = m_token;
+    update.name = name;
+    update.sequence = m_sequence + 1;
+    update.propertyIndex = internalIndex;
+    update.value = value;
+    const QByteArray datagram = QRemoteObjectPackets::serializeDatagram(update);
+    if (datagram.size() > maxDatagramSize) {
+        qCDebug(QT_REMOTEOBJECT_IO) << "Update of" << name << internalIndex << "too large for a datagram:"
+                                    << datagram.size();
+        return false;
+    }
+    if (m_socket->writeDatagram(datagram, m_group, m_port) != datagram.size()) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Could not send datagram to" << m_address
+                                      << m_socket->errorString();
+        return false;
+    }
+    ++m_sequence;
+    if (!m_watermarkTimer.isActive())
+        m_watermarkTimer.start();
+    return true;
+}
+
+QRemoteObjectPackets::DatagramChannelInfo QtRODatagramSender::channelInfo() const
+{
+    QRemoteObjectPackets::DatagramChannelInfo info;
+    info.address = m_address;
+    info.token = m_token;
+    info.sequence = m_sequence;
+    info.properties = m_properties;
+    return info;
+}
+
+QT_END_NAMESPACE
@@ -0,0 +1,110 @@
+// Copyright (C) 2025 The Qt Company Ltd.
+// SPDX-License-Identifier: LicenseRef-Qt-Commercial OR LGPL-3.0-only OR GPL-2.0-only OR GPL-3.0-only
+
+#ifndef QREMOTEOBJECTDATAGRAM_P_H
+#define QREMOTEOBJECTDATAGRAM_P_H
+
+//
+//  W A R N I N G
+//  -------------
+//
+// This file is not part of the Qt API.  It exists purely as an
+// implementation detail.  This header file may change from version to
+// version without notice, or even be removed.
+//
+// We mean it.
+//
+
+#include "qremoteobjectpacket_p.h"
+
+#include <QtCore/qobject.h>
+#include <QtCore/qset.h>
+#include <QtCore/qstringlist.h>
+#include <QtCore/qtimer.h>
+#include <QtCore/qurl.h>
+#include <QtNetwork/qhostaddress.h>
+
+QT_BEGIN_NAMESPACE
+
+class QUdpSocket;
+class QtROIoDeviceBase;
+
+namespace QRemoteObjectPackets {
+
+// One update of a lossy property, sent as a single datagram. The token identifies the
+// channel it belongs to, datagrams of a stale or foreign channel are ignored.
+struct DatagramUpdate
+{
+    quint64 token = 0;
+    QString name;
+    quint64 sequence = 0;
+    int propertyIndex = -1;
+    QVariant value;
+};
+
+QByteArray serializeDatagram(const DatagramUpdate &update);
+bool deserializeDatagram(const QByteArray &datagram, DatagramUpdate &update);
+
+// Parses a "udp://<multicast group>:<port>" address
+bool parseDatagramAddress(const QUrl &address, QHostAddress *group, quint16 *port);
+
+} // namespace QRemoteObjectPackets
+
+// See QRemoteObjectHostBase::setDatagramChannel()
+struct QtRODatagramChannelSettings
+{
+    QUrl address;
+    QStringList lossyProperties;
+};
+
+/*
+    Sends the changes of the lossy properties of a root source to its multicast group.
+    Every datagram gets the next sequence number. Replicas that joined the group are
+    members, the source stops sending them the changes over their connection.
+
+    As the last datagrams of a burst can be lost without a later one revealing it,
+    watermarkDue() is emitted a little after the last send, for the source to tell the
+    members the current sequence number over their connections.
+*/
+class QtRODatagramSender final : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Datagrams larger than this are likely to be fragmented, such updates are sent over
+    // the connections instead
+    static constexpr qsizetype maxDatagramSize = 1400;
+
+    QtRODatagramSender(const QHostAddress &group, quint16 port, const QUrl &address,
+                       const QList<int> &properties, QObject *parent = nullptr);
+    ~QtRODatagramSender() override;
+
+    bool isLossy(int internalIndex) const { return m_properties.contains(internalIndex); }
+    bool hasMembers() const { return !m_members.isEmpty(); }
+    bool isMember(QtROIoDeviceBase *io) const { return m_members.contains(io); }
+    void addMember(QtROIoDeviceBase *io) { m_members.insert(io); }
+    void removeMember(QtROIoDeviceBase *io) { m_members.remove(io); }
+    const QSet<QtROIoDeviceBase *> &members() const { return m_members; }
+
+    // Returns false if the update could not be sent as a datagram
+    bool send(const QString &name, int internalIndex, const QVariant &value);
+    QRemoteObjectPackets::DatagramChannelInfo channelInfo() const;
+
+Q_SIGNALS:
+    void watermarkDue();
+
+private:
+    QUdpSocket *m_socket;
+    QHostAddress m_group;
+    quint16 m_port;
+    QUrl m_address;
+    quint64 m_token;
+    quint64 m_sequence = 0;
+    QList<int> m_properties;
+    QSet<QtROIoDeviceBase *> m_members;
+    QTimer m_watermarkTimer;
+};
+
+QT_END_NAMESPACE
+
+#endif // QREMOTEOBJECTDATAGRAM_P_H
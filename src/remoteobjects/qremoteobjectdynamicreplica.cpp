@@ -125,9 +125,10 @@ int QRemoteObjectDynamicReplica::qt_metacall(QMetaObject::Call call, int id, voi
                 args << QVariant(mp.metaType(), argv[0]);
             QRemoteObjectReplica::send(QMetaObject::WriteProperty, saved_id, args);
         } else {
-            if (mp.userType() == QMetaType::QVariant)
+            if (mp.userType() == QMetaType::QVariant) {
+                d_impl->subscribeProperty(id);
                 *reinterpret_cast<QVariant*>(argv[0]) = impl->m_propertyStorage[id];
-            else {
+            } else {
                 const QVariant value = propAsVariant(id);
                 mp.metaType().destruct(argv[0]);
                 mp.metaType().construct(argv[0], value.data());
@@ -15,9 +15,17 @@
 #include "qremoteobjectsource_p.h"
 #include "qremoteobjectabstractitemmodelreplica_p.h"
 #include "qremoteobjectabstractitemmodeladapter_p.h"
+#include "qremoteobjectdatagram_p.h"
 #include <QtCore/qabstractitemmodel.h>
+#include <QtCore/qdir.h>
+#include <QtCore/qfile.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qsavefile.h>
+#include <QtNetwork/qnetworkdatagram.h>
+#include <QtNetwork/qudpsocket.h>
 #include <memory>
 #include <algorithm>
+#include <cmath>
 
 QT_BEGIN_NAMESPACE
 
@@ -35,9 +43,12 @@ struct ManagedGadgetTypeEntry
 
     void unregisterMetaTypes()
     {
+        QRemoteObjectPackets::forgetCodecPlan(gadgetMetaType);
         QMetaType::unregisterMetaType(gadgetMetaType);
-        for (auto enumMetaType : enumMetaTypes)
+        for (auto enumMetaType : enumMetaTypes) {
+            QRemoteObjectPackets::forgetCodecPlan(enumMetaType);
             QMetaType::unregisterMetaType(enumMetaType);
+        }
     }
 };
 
@@ -243,7 +254,6 @@ bool map_contains(const QMap<K,V> &map, const Query &key, typename QMap<K,V>::co
 QRemoteObjectNodePrivate::QRemoteObjectNodePrivate()
     : QObjectPrivate()
     , registry(nullptr)
-    , retryInterval(250)
     , lastError(QRemoteObjectNode::NoError)
     , persistedStore(nullptr)
 { }
@@ -273,19 +283,25 @@ void QRemoteObjectNode::timerEvent(QTimerEvent*)
 {
     Q_D(QRemoteObjectNode);
 
-    for (auto it = d->pendingReconnect.begin(), end = d->pendingReconnect.end(); it != end; /*erasing*/) {
-        const auto &conn = *it;
+    // connectToServer() can report a failure right away, which calls onShouldReconnect()
+    const auto connections = d->pendingReconnect.keys();
+    for (QtROClientIoDevice *conn : connections) {
+        auto it = d->pendingReconnect.find(conn);
+        if (it == d->pendingReconnect.end() || !it->due.hasExpired())
+            continue;
+        // The previous attempt is still in progress, check again later
         if (conn->isOpen()) {
-            it = d->pendingReconnect.erase(it);
-        } else {
-            conn->connectToServer();
-            ++it;
+            it->due.setRemainingTime(d->reconnectDelay(it->attempts + 1));
+            continue;
         }
+        ++it->attempts;
+        it->due.setRemainingTime(d->reconnectDelay(it->attempts + 1));
+        it->announced = false;
+        qRODebug(this) << "Reconnecting to" << conn->url() << "attempt" << it->attempts;
+        conn->connectToServer();
     }
 
-    if (d->pendingReconnect.isEmpty())
-        d->reconnectTimer.stop();
-
+    d->startReconnectTimer();
     qRODebug(this) << "timerEvent" << d->pendingReconnect.size();
 }
 
@@ -300,6 +316,12 @@ void QRemoteObjectNode::timerEvent(QTimerEvent*)
     connection. This function can help with that detection since the client will
     only detect that the server is unavailable when it tries to send data.
 
+    Between nodes of Qt Remote Objects 6.9 or later, heartbeat messages and
+    other small packets are not held up by large packets, such as the initial
+    data of a large model: packets larger than transferChunkSize() are sent in
+    fragments, and smaller packets are sent in between. Packets for the same
+    object keep their order.
+
     A value of \c 0 (the default) will disable the heartbeat.
 */
 
@@ -331,6 +353,624 @@ void QRemoteObjectNode::setHeartbeatInterval(int interval)
     emit heartbeatIntervalChanged(interval);
 }
 
+/*!
+    \enum QRemoteObjectNode::WriteBufferingMode
+    \since 6.9
+
+    This enum describes when the packets queued for a connection are handed to
+    the underlying QIODevice.
+
+    \value FlushImmediately Every packet is written as soon as it is
+        serialized. This is the default and favors latency.
+    \value FlushAtEndOfEventLoop Packets are collected in a per-connection
+        output buffer and written in one go once control returns to the event
+        loop.
+    \value FlushAfterDelay Packets are collected in a per-connection output
+        buffer and written in one go once the configured delay has elapsed.
+
+    \sa setWriteBuffering()
+*/
+
+/*!
+    \since 6.9
+
+    Returns the write buffering mode used for the connections of this node.
+
+    \sa setWriteBuffering()
+*/
+QRemoteObjectNode::WriteBufferingMode QRemoteObjectNode::writeBufferingMode() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_writeBufferingMode;
+}
+
+/*!
+    \since 6.9
+
+    Returns the delay used with \l FlushAfterDelay.
+
+    \sa setWriteBuffering()
+*/
+std::chrono::microseconds QRemoteObjectNode::writeBufferingDelay() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_writeBufferingDelay;
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of buffered bytes that triggers an early flush, or \c 0
+    if the output buffer is only flushed according to the write buffering mode.
+
+    \sa setWriteBuffering()
+*/
+qint64 QRemoteObjectNode::writeBufferingThreshold() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_writeBufferingThreshold;
+}
+
+/*!
+    \since 6.9
+
+    Sets the write buffering \a mode for the connections of this node, trading
+    latency for throughput.
+
+    With \l FlushAtEndOfEventLoop and \l FlushAfterDelay, everything queued
+    for a connection (property changes, signal emissions, method invocations)
+    is collected and written with a single write to the QIODevice. \a delay is
+    only used with \l FlushAfterDelay. If \a threshold is larger than \c 0,
+    the output buffer is flushed as soon as it holds at least \a threshold
+    bytes, regardless of the mode.
+
+    The setting applies to existing connections as well as to connections
+    established later, on both the client and the host side.
+*/
+void QRemoteObjectNode::setWriteBuffering(WriteBufferingMode mode, std::chrono::microseconds delay,
+                                          qint64 threshold)
+{
+    Q_D(QRemoteObjectNode);
+    d->m_writeBufferingMode = mode;
+    d->m_writeBufferingDelay = delay;
+    d->m_writeBufferingThreshold = threshold;
+    const auto connections = findChildren<QtROIoDeviceBase *>(Qt::FindDirectChildrenOnly);
+    for (QtROIoDeviceBase *connection : connections)
+        d->applyWriteBuffering(connection);
+    if (auto sourceIo = findChild<QRemoteObjectSourceIo *>(Qt::FindDirectChildrenOnly))
+        sourceIo->setWriteBuffering(mode, delay, threshold);
+}
+
+/*!
+    \enum QRemoteObjectNode::CompressionAlgorithm
+    \since 6.9
+
+    This enum describes the algorithms a connection can use to compress large
+    packets.
+
+    \value NoCompression Packets are sent uncompressed. This is the default.
+    \value ZlibCompression Packets are compressed with zlib, see qCompress().
+    \value ZstdCompression Packets are compressed with Zstandard, which is
+        considerably faster than zlib. This is only available if Qt Remote
+        Objects was built with Zstandard support, otherwise zlib is used.
+
+    \sa setCompression()
+*/
+
+/*!
+    \enum QRemoteObjectNode::SubscriptionMode
+    \since 6.9
+
+    This enum describes which signals and property updates the source sends to
+    a replica, see setSubscription().
+
+    \value SubscribeAll The source sends every signal and property change.
+        This is the default.
+    \value SubscribeExplicitly The source only sends the members passed to
+        setSubscription().
+    \value SubscribeOnUse The source sends the members passed to
+        setSubscription(), and the members the replica uses: signals that
+        are connected to and properties that are read or whose notify signal
+        is connected to.
+*/
+
+/*!
+    \since 6.9
+
+    Returns the compression algorithm used for connections with the URL
+    \a scheme, or for connections without a scheme specific setting if
+    \a scheme is empty.
+
+    \sa setCompression()
+*/
+QRemoteObjectNode::CompressionAlgorithm QRemoteObjectNode::compression(const QString &scheme) const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->compressionSettings(scheme).algorithm;
+}
+
+/*!
+    \since 6.9
+
+    Returns the packet size, in bytes, from which packets are compressed on
+    connections with the URL \a scheme, or on connections without a scheme
+    specific setting if \a scheme is empty.
+
+    \sa setCompression()
+*/
+qint64 QRemoteObjectNode::compressionThreshold(const QString &scheme) const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->compressionSettings(scheme).threshold;
+}
+
+/*!
+    \since 6.9
+
+    Enables compression of packets of at least \a threshold bytes with
+    \a algorithm. If \a scheme is empty, the setting applies to all
+    connections that don't have a setting for their URL scheme, otherwise only
+    to connections using \a scheme. This allows, for example, to compress the
+    traffic of \c tcp connections while leaving \c local connections
+    uncompressed:
+
+    \code
+        node.setCompression(QRemoteObjectNode::ZstdCompression, 512, QStringLiteral("tcp"));
+    \endcode
+
+    Compression is negotiated with the peer when the connection is established.
+    A packet is only sent compressed if both nodes support it and compressing
+    it actually reduces its size. If the peer can't decompress \a algorithm,
+    zlib is used instead. Connections to nodes using Qt versions before 6.9
+    are not compressed.
+
+    The setting applies to existing connections as well as to connections
+    established later, on both the client and the host side.
+*/
+void QRemoteObjectNode::setCompression(CompressionAlgorithm algorithm, qint64 threshold,
+                                       const QString &scheme)
+{
+    Q_D(QRemoteObjectNode);
+    const QRemoteObjectNodePrivate::CompressionSettings settings{algorithm,
+                                                                 qMax(threshold, qint64(0))};
+    if (scheme.isEmpty())
+        d->m_compression = settings;
+    else
+        d->m_schemeCompression.insert(scheme, settings);
+    const auto connections = findChildren<QtROIoDeviceBase *>(Qt::FindDirectChildrenOnly);
+    for (QtROIoDeviceBase *connection : connections)
+        d->applyCompression(connection);
+    if (auto sourceIo = findChild<QRemoteObjectSourceIo *>(Qt::FindDirectChildrenOnly))
+        d->applyCompression(sourceIo);
+}
+
+/*!
+    \since 6.9
+
+    Returns the size of the chunks large packets are sent in.
+
+    \sa setTransferChunkSize()
+*/
+qint64 QRemoteObjectNode::transferChunkSize() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_transferChunkSize;
+}
+
+/*!
+    \since 6.9
+
+    Sets the size of the chunks large packets are sent in to \a size bytes.
+    The default is 32 KiB, values below 1 KiB are raised to 1 KiB.
+
+    A packet larger than \a size, such as a property holding a large
+    QByteArray or container, or a method call with large arguments, is sent in
+    chunks of at most \a size bytes. The next chunk is only handed to the
+    connection once it has less than \a size bytes left to send, so the memory
+    a connection uses for a large value stays bounded by the serialized value
+    itself, which is shared by all connections it is sent to. Smaller packets,
+    such as heartbeats, are sent in between the chunks.
+
+    While a large packet is received, QRemoteObjectReplica::transferProgress()
+    is emitted for every chunk. The value is decoded once all chunks arrived.
+
+    Chunked transfers require both nodes to use Qt Remote Objects 6.9 or later,
+    connections to older nodes send every packet in one piece. The setting
+    applies to existing connections as well as to connections established
+    later, on both the client and the host side.
+
+    \sa QRemoteObjectReplica::transferProgress()
+*/
+void QRemoteObjectNode::setTransferChunkSize(qint64 size)
+{
+    Q_D(QRemoteObjectNode);
+    d->m_transferChunkSize = qMax(size, qint64(QtRemoteObjects::minimumFragmentSize));
+    const auto connections = findChildren<QtROIoDeviceBase *>(Qt::FindDirectChildrenOnly);
+    for (QtROIoDeviceBase *connection : connections)
+        connection->setTransferChunkSize(d->m_transferChunkSize);
+    if (auto sourceIo = findChild<QRemoteObjectSourceIo *>(Qt::FindDirectChildrenOnly))
+        sourceIo->setTransferChunkSize(d->m_transferChunkSize);
+}
+
+/*!
+    \since 6.9
+
+    Returns the socket options in effect on the connection of this node to
+    \a address, as reported by the socket, or an empty map if there is no
+    such connection, it is not established yet, or its backend has no socket
+    options.
+
+    For \c tcp connections, the map holds the \c nodelay and \c keepalive
+    flags as \c bool and the \c sndbuf and \c rcvbuf buffer sizes in bytes,
+    which the operating system may have adjusted. They are set with the query
+    items of the same names of the URL, for example
+    \c{tcp://192.168.1.1:9999?nodelay=1&sndbuf=262144}. The host applies the
+    options of its URL to the connections it accepts and announces them with
+    its address, so replicas connecting through the registry use them as well.
+
+    If \a address is the \l {QRemoteObjectHost::hostUrl()}{host URL} of this
+    node, the options of the connections it accepted are returned.
+
+    With \c nodelay enabled, the packets written during an event loop
+    iteration are sent together at its end, as with \l FlushAtEndOfEventLoop,
+    so disabling Nagle's algorithm does not result in a segment per packet.
+*/
+QVariantMap QRemoteObjectNode::socketOptions(const QUrl &address) const
+{
+    const auto connections = findChildren<QtROClientIoDevice *>(Qt::FindDirectChildrenOnly);
+    for (QtROClientIoDevice *connection : connections) {
+        if (connection->url() == address && !connection->isClosing())
+            return connection->socketOptions();
+    }
+    const auto sourceIo = findChild<QRemoteObjectSourceIo *>(Qt::FindDirectChildrenOnly);
+    if (sourceIo && (address == sourceIo->m_address || address == sourceIo->serverAddress())) {
+        for (QtROIoDeviceBase *connection : std::as_const(sourceIo->m_connections)) {
+            const QVariantMap options = connection->socketOptions();
+            if (!options.isEmpty())
+                return options;
+        }
+    }
+    return QVariantMap();
+}
+
+/*!
+    \since 6.9
+
+    Returns the delay before the first attempt to reconnect to a node that
+    was lost. The default is 250 milliseconds.
+
+    \sa setReconnectBackoff()
+*/
+std::chrono::milliseconds QRemoteObjectNode::reconnectInitialDelay() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_reconnectInitialDelay;
+}
+
+/*!
+    \since 6.9
+
+    Returns the longest delay between two attempts to reconnect to a node.
+    The default is 30 seconds.
+
+    \sa setReconnectBackoff()
+*/
+std::chrono::milliseconds QRemoteObjectNode::reconnectMaximumDelay() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_reconnectMaximumDelay;
+}
+
+/*!
+    \since 6.9
+
+    Returns the part of a reconnect delay that is random, between 0 and 1.
+    The default is 0.5.
+
+    \sa setReconnectBackoff()
+*/
+double QRemoteObjectNode::reconnectJitter() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_reconnectJitter;
+}
+
+/*!
+    \since 6.9
+
+    Sets how this node reconnects to the nodes it connected to with
+    connectToNode() when their connection is lost. Nodes found through the
+    registry are reconnected when the registry announces them again.
+
+    The first attempt is made after \a initialDelay, and the delay doubles
+    for every further attempt until it reaches \a maximumDelay. Each connection
+    keeps its own schedule, which starts over once it is reconnected. Every
+    delay is shortened by a random part of up to \a jitter (between 0 and 1)
+    of it, so that the nodes of a host that restarts don't all reconnect at
+    the same moment. With a \a jitter of 0, the delays are exact.
+
+    Before Qt Remote Objects 6.9, the nodes retried every 250 milliseconds.
+    The new settings apply to the attempts scheduled from now on.
+
+    \sa reconnectScheduled(), reconnected()
+*/
+void QRemoteObjectNode::setReconnectBackoff(std::chrono::milliseconds initialDelay,
+                                            std::chrono::milliseconds maximumDelay, double jitter)
+{
+    Q_D(QRemoteObjectNode);
+    d->m_reconnectInitialDelay = qMax(initialDelay, std::chrono::milliseconds::zero());
+    d->m_reconnectMaximumDelay = qMax(maximumDelay, d->m_reconnectInitialDelay);
+    d->m_reconnectJitter = qBound(0.0, jitter, 1.0);
+}
+
+/*!
+    \fn void QRemoteObjectNode::reconnectScheduled(const QUrl &address, int attempt, int delay)
+    \since 6.9
+
+    This signal is emitted when the connection to \a address was lost, or an
+    attempt to reconnect to it failed, and attempt number \a attempt is made
+    in \a delay milliseconds.
+
+    \sa setReconnectBackoff(), reconnected()
+*/
+
+/*!
+    \fn void QRemoteObjectNode::reconnected(const QUrl &address, int attempts)
+    \since 6.9
+
+    This signal is emitted when this node reconnected to \a address after
+    \a attempts attempts.
+
+    \sa reconnectScheduled()
+*/
+
+/*!
+    \since 6.9
+
+    Returns \c true if the connections of this node run on a dedicated I/O
+    thread.
+
+    \sa setIoThreadEnabled()
+*/
+bool QRemoteObjectNode::isIoThreadEnabled() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_ioThreadEnabled;
+}
+
+/*!
+    \since 6.9
+
+    If \a enabled is \c true, connections established from now on run their
+    transport on a dedicated I/O thread owned by this node. The sockets are
+    read and written on that thread, which also splits the received data into
+    packets. Packets are still decoded, and sources and replicas are still
+    updated, in the thread of the node, so no additional locking is required
+    by the application. This keeps a busy node responsive to its peers, and
+    allows the socket I/O of a node exchanging large amounts of data to run
+    in parallel with the serialization of the packets. On the host side, the
+    I/O thread also answers the heartbeats of replicas (see heartbeatInterval),
+    so they don't time out while the thread of the node is busy.
+
+    The setting applies to connections established later, on both the client
+    and the host side, but not to devices passed to addClientSideConnection()
+    or QRemoteObjectHostBase::addHostSideConnection(). The default is
+    \c false, which runs all connections in the thread of the node.
+
+    \sa setIoThreadCount()
+*/
+void QRemoteObjectNode::setIoThreadEnabled(bool enabled)
+{
+    Q_D(QRemoteObjectNode);
+    d->m_ioThreadEnabled = enabled;
+    if (auto sourceIo = findChild<QRemoteObjectSourceIo *>(Qt::FindDirectChildrenOnly))
+        sourceIo->setIoThreads(d->ioThreads());
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of I/O threads the connections of this node are
+    distributed across.
+
+    \sa setIoThreadCount(), setIoThreadEnabled()
+*/
+int QRemoteObjectNode::ioThreadCount() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_ioThreads.threadCount();
+}
+
+/*!
+    \since 6.9
+
+    Distributes the connections of this node across up to \a count I/O
+    threads, once the I/O thread is enabled with setIoThreadEnabled(). Each
+    new connection is assigned to the thread serving the fewest connections.
+    The default is \c 1.
+
+    This lets a host serving many replicas scale with the number of cores:
+    when a source changes, the packet is serialized once in the thread of the
+    node and shared with all I/O threads, which then write it to their
+    connections in parallel.
+
+    Threads are started as connections are assigned to them. The setting
+    applies to connections established later.
+*/
+void QRemoteObjectNode::setIoThreadCount(int count)
+{
+    Q_D(QRemoteObjectNode);
+    d->m_ioThreads.setThreadCount(count);
+}
+
+/*!
+    \since 6.9
+
+    Returns the minimum interval in milliseconds between two updates of a
+    property that replicas of this node named \a name request from their
+    source, or \c 0 if every change is sent.
+
+    \sa setMinimumUpdateInterval()
+*/
+int QRemoteObjectNode::minimumUpdateInterval(const QString &name) const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_minimumUpdateIntervals.value(name);
+}
+
+/*!
+    \since 6.9
+
+    Limits the rate at which the source sends updates of each property to the
+    replicas of this node named \a name, including their child objects, to one
+    update every \a msecs milliseconds. Changes made within that interval
+    after an update are not sent individually; when it ends, the source sends
+    the latest value of the property. The replica therefore always ends up
+    with the final value, while skipping intermediate values that sensor-like
+    sources produce faster than they are consumed. Signals that are not
+    notify signals of a property are always sent.
+
+    The source can also declare a minimum interval for individual properties
+    with the \c THROTTLE flag of \c PROP in the \l {Qt Remote Objects Compiler}
+    {.rep file}, for instance \c {PROP(double speed READONLY THROTTLE=50)}.
+    The larger of the two intervals applies.
+
+    The interval is sent to the source when the replica subscribes to it, so it
+    has to be set before the replica is acquired. A value of \c 0, the default,
+    sends every change.
+
+    \sa minimumUpdateInterval()
+*/
+void QRemoteObjectNode::setMinimumUpdateInterval(const QString &name, int msecs)
+{
+    Q_D(QRemoteObjectNode);
+    if (msecs > 0)
+        d->m_minimumUpdateIntervals.insert(name, msecs);
+    else
+        d->m_minimumUpdateIntervals.remove(name);
+}
+
+/*!
+    \since 6.9
+
+    Returns the subscription mode of the replicas of this node named \a name.
+
+    \sa setSubscription(), subscribedMembers()
+*/
+QRemoteObjectNode::SubscriptionMode QRemoteObjectNode::subscriptionMode(const QString &name) const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_subscriptions.value(name).mode;
+}
+
+/*!
+    \since 6.9
+
+    Returns the members the replicas of this node named \a name subscribed to
+    with setSubscription().
+
+    \sa subscriptionMode()
+*/
+QStringList QRemoteObjectNode::subscribedMembers(const QString &name) const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_subscriptions.value(name).members;
+}
+
+/*!
+    \since 6.9
+
+    Sets which signals and property updates the source sends to the replicas
+    of this node named \a name. With SubscribeAll, the default, every signal
+    and property change is sent. Otherwise the source only sends the
+    \a members, given by the names of properties and signals, and with
+    SubscribeOnUse also the members the replicas use. Subscribing to a
+    property subscribes to its notify signal.
+
+    This avoids sending updates a replica does not need, for instance when it
+    only uses a few properties of a large interface:
+
+    \code
+    node.setSubscription("Engine", QRemoteObjectNode::SubscribeExplicitly,
+                         { "rpm", "temperature" });
+    \endcode
+
+    The properties of a replica are initialized with the values of the source
+    when the replica connects. After that, the properties the replica is not
+    subscribed to are no longer updated. Once the replica subscribes to a
+    property again, the source sends its current value. Properties holding
+    child objects are always updated; the child replicas have their own
+    subscription.
+
+    Members the replicas used are not unsubscribed automatically. The
+    subscription can be changed at any time, and applies to the replicas
+    already acquired. Filtering requires both nodes to use the compact
+    encoding of this version of Qt Remote Objects, other sources keep sending
+    everything.
+
+    \sa subscriptionMode(), subscribedMembers()
+*/
+void QRemoteObjectNode::setSubscription(const QString &name, SubscriptionMode mode,
+                                        const QStringList &members)
+{
+    Q_D(QRemoteObjectNode);
+    if (mode == SubscribeAll)
+        d->m_subscriptions.remove(name);
+    else
+        d->m_subscriptions.insert(name, {mode, members});
+
+    QSharedPointer<QRemoteObjectReplicaImplementation> rep =
+            qSharedPointerCast<QRemoteObjectReplicaImplementation>(d->replicas.value(name).toStrongRef());
+    if (rep && !rep->isShortCircuit())
+        static_cast<QConnectedReplicaImplementation *>(rep.data())->setSubscriptionMode(mode);
+}
+
+/*!
+    \since 6.9
+
+    Returns the directory the class definitions of dynamic replicas are cached
+    in, or an empty string if they are not cached.
+
+    \sa setTypeCacheDirectory()
+*/
+QString QRemoteObjectNode::typeCacheDirectory() const
+{
+    Q_D(const QRemoteObjectNode);
+    return d->m_typeCacheDirectory;
+}
+
+/*!
+    \since 6.9
+
+    Caches the class definitions dynamic replicas of this node receive in the
+    directory \a path, which is created if needed.
+
+    A dynamic replica is created from the definition of the class of its
+    source, its signals, methods, properties and enums, which the source sends
+    along with the initial values. When a node acquires many dynamic replicas,
+    this makes up most of the data exchanged on startup. With a cache, a
+    replica whose source implements a class from a \l {Qt Remote Objects
+    Compiler} {.rep file} tells the source that it already has the definition
+    of the class, identified by its signature, and the source only sends the
+    values. Definitions of sources without a signature, such as QObjects
+    remoted with their own API, are not cached.
+
+    The files in the directory are named after the signatures, and persist
+    across runs. The directory can be shared by several nodes and processes.
+    Sources of Qt versions before 6.9 always send the definition. An empty
+    \a path, the default, disables the cache.
+
+    The cache has to be set before the replicas are acquired.
+
+    \sa typeCacheDirectory(), acquireDynamic()
+*/
+void QRemoteObjectNode::setTypeCacheDirectory(const QString &path)
+{
+    Q_D(QRemoteObjectNode);
+    d->m_typeCacheDirectory = path;
+    d->m_cachedDefinitions.clear();
+}
+
 /*!
     \since 5.12
     \typedef QRemoteObjectNode::RemoteObjectSchemaHandler
@@ -709,8 +1349,10 @@ QRemoteObjectAbstractPersistedStorePrivate::~QRemoteObjectAbstractPersistedStore
 QRemoteObjectMetaObjectManager::~QRemoteObjectMetaObjectManager()
 {
     for (QMetaObject *mo : dynamicTypes) {
-        for (auto metaType : enumTypes[mo])
+        for (auto metaType : enumTypes[mo]) {
+            QRemoteObjectPackets::forgetCodecPlan(metaType);
             QMetaType::unregisterMetaType(metaType);
+        }
         enumTypes.remove(mo);
         free(mo); //QMetaObjectBuilder uses malloc, not new
     }
@@ -1185,6 +1827,8 @@ bool QRemoteObjectNodePrivate::initConnection(const QUrl &address)
         qROPrivWarning() << "Could not create QtROClientIoDevice for client. Invalid url/scheme provided?" << address;
         return false;
     }
+    if (QtROIoThreadPool *threads = ioThreads())
+        connection = new QtROThreadedClientIo(connection, threads->nextThread(), q);
     qROPrivDebug() << "Opening connection to" << address.toString();
     qROPrivDebug() << "Replica Connection isValid" << connection->isOpen();
     QObject::connect(connection, &QtROClientIoDevice::shouldReconnect, q, [this, connection]() {
@@ -1193,8 +1837,13 @@ bool QRemoteObjectNodePrivate::initConnection(const QUrl &address)
     QObject::connect(connection, &QtROIoDeviceBase::readyRead, q, [this, connection]() {
         onClientRead(connection);
     });
+    connect(connection, &QtROIoDeviceBase::transferProgress, this,
+            &QRemoteObjectNodePrivate::onTransferProgress);
     connect(connection, &QtROClientIoDevice::setError, this,
             &QRemoteObjectNodePrivate::setLastError);
+    applyWriteBuffering(connection);
+    applyCompression(connection);
+    connection->setTransferChunkSize(m_transferChunkSize);
     connection->connectToServer();
 
     return true;
@@ -1298,18 +1947,76 @@ void QRemoteObjectNodePrivate::onShouldReconnect(QtROClientIoDevice *ioDevice)
     }
     if (requestedUrls.contains(ioDevice->url())) {
         // Only try to reconnect to URLs requested via connectToNode
-        // If we connected via registry, wait for the registry to see the node/source again
-        pendingReconnect.insert(ioDevice);
-        if (!reconnectTimer.isActive()) {
-            reconnectTimer.start(retryInterval, q);
+        // If we connected via registry, wait for the registry to see the node/source again.
+        // A failed attempt keeps the schedule, the next attempt is announced once.
+        auto it = pendingReconnect.find(ioDevice);
+        if (it == pendingReconnect.end()) {
+            it = pendingReconnect.insert(ioDevice, ReconnectState());
+            it->due.setRemainingTime(reconnectDelay(1));
+            startReconnectTimer();
             qROPrivDebug() << "Starting reconnect timer";
         }
+        if (!it->announced) {
+            it->announced = true;
+            emit q->reconnectScheduled(ioDevice->url(), it->attempts + 1,
+                                       int(qMax(it->due.remainingTime(), qint64(0))));
+        }
     } else {
         qROPrivDebug() << "Url" << ioDevice->url().toDisplayString().toLatin1()
                        << "lost.  We will reconnect Replicas if they reappear on the Registry.";
     }
 }
 
+// The delay before the given reconnect attempt (starting at 1): the initial delay, doubled for
+// every further attempt up to the maximum. Each delay is shortened by a random part of up to
+// the jitter, so nodes that lost the same host don't reconnect at the same time.
+std::chrono::milliseconds QRemoteObjectNodePrivate::reconnectDelay(int attempt) const
+{
+    const double initial = double(m_reconnectInitialDelay.count());
+    const double maximum = qMax(double(m_reconnectMaximumDelay.count()), initial);
+    const double base = qMin(maximum, std::ldexp(initial, qBound(0, attempt - 1, 62)));
+    const double random = QRandomGenerator::global()->generateDouble();
+    return std::chrono::milliseconds(qint64(base * (1.0 - m_reconnectJitter * random)));
+}
+
+void QRemoteObjectNodePrivate::startReconnectTimer()
+{
+    Q_Q(QRemoteObjectNode);
+    if (pendingReconnect.isEmpty()) {
+        reconnectTimer.stop();
+        return;
+    }
+    QDeadlineTimer next(QDeadlineTimer::Forever);
+    for (const ReconnectState &state : std::as_const(pendingReconnect))
+        next = qMin(next, state.due);
+    reconnectTimer.start(int(qMax(next.remainingTime(), qint64(0))), q);
+}
+
+// The host greeted connection, which ends its reconnection if there was one
+void QRemoteObjectNodePrivate::finishReconnect(QtROIoDeviceBase *connection)
+{
+    Q_Q(QRemoteObjectNode);
+    auto client = qobject_cast<QtROClientIoDevice *>(connection);
+    const auto it = pendingReconnect.constFind(client);
+    if (!client || it == pendingReconnect.cend())
+        return;
+    const int attempts = it->attempts;
+    pendingReconnect.erase(it);
+    startReconnectTimer();
+    qROPrivDebug() << "Reconnected to" << client->url() << "after" << attempts << "attempts";
+    emit q->reconnected(client->url(), attempts);
+}
+
+// A chunk of a large packet for the replica name arrived, see QRemoteObjectNode::setTransferChunkSize()
+void QRemoteObjectNodePrivate::onTransferProgress(const QString &name, qint64 bytesReceived,
+                                                  qint64 bytesTotal)
+{
+    QSharedPointer<QRemoteObjectReplicaImplementation> rep =
+            qSharedPointerCast<QRemoteObjectReplicaImplementation>(replicas.value(name).toStrongRef());
+    if (rep)
+        rep->emitTransferProgress(bytesReceived, bytesTotal);
+}
+
 //This version of handleNewAcquire creates a QConnectedReplica. If this is a
 //host node, the QRemoteObjectHostBasePrivate overload is called instead.
 QReplicaImplementationInterface *QRemoteObjectNodePrivate::handleNewAcquire(const QMetaObject *meta, QRemoteObjectReplica *instance, const QString &name)
@@ -1375,13 +2082,33 @@ QReplicaImplementationInterface *QRemoteObjectHostBasePrivate::handleNewAcquire(
     return QRemoteObjectNodePrivate::handleNewAcquire(meta, instance, name);
 }
 
+QSharedPointer<QRemoteObjectReplicaImplementation> QRemoteObjectNodePrivate::replicaForPacket(QtROIoDeviceBase *connection)
+{
+    // Packets addressed by handle are dispatched through the connection's handle table,
+    // the name lookup is only needed the first time a handle is seen
+    auto d = connection->d_func();
+    const int handle = d->m_rxHandle;
+    if (handle >= 0 && handle < d->m_handleObjects.size()) {
+        if (auto object = d->m_handleObjects.at(handle).toStrongRef())
+            return qSharedPointerCast<QRemoteObjectReplicaImplementation>(object);
+    }
+
+    auto rep = qSharedPointerCast<QRemoteObjectReplicaImplementation>(replicas.value(rxName).toStrongRef());
+    if (rep && handle >= 0 && handle < d->m_handleObjects.size() && !rep->isShortCircuit()) {
+        d->m_handleObjects[handle] = rep;
+        static_cast<QConnectedReplicaImplementation *>(rep.data())->m_sourceHandle = handle;
+    }
+    return rep;
+}
+
 void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
 {
     using namespace QRemoteObjectPackets;
     QtROIoDeviceBase *connection = qobject_cast<QtROIoDeviceBase*>(obj);
     QRemoteObjectPacketTypeEnum packetType;
     Q_ASSERT(connection);
-    auto &codec = connection->d_func()->m_codec;
+    // Incoming packets are decoded by m_readCodec, m_codec is used for replies
+    auto &codec = connection->d_func()->m_readCodec;
 
     do {
         if (!connection->read(packetType, rxName))
@@ -1397,7 +2124,7 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
         switch (packetType) {
         case QRemoteObjectPacketTypeEnum::Pong:
         {
-            QSharedPointer<QRemoteObjectReplicaImplementation> rep = qSharedPointerCast<QRemoteObjectReplicaImplementation>(replicas.value(rxName).toStrongRef());
+            QSharedPointer<QRemoteObjectReplicaImplementation> rep = replicaForPacket(connection);
             if (rep)
                 rep->notifyAboutReply(0, {});
             else //replica has been deleted, remove from list
@@ -1405,13 +2132,33 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
             break;
         }
         case QRemoteObjectPacketTypeEnum::Handshake:
-            if (rxName != QtRemoteObjects::protocolVersion) {
+            if (codec && connection->d_func()->handleCompressionHandshake(rxName)) {
+                qROPrivDebug() << "Host supports compression" << rxName;
+            } else if (codec && connection->d_func()->handleDescriptorHandshake(rxName)) {
+                qROPrivDebug() << "Host offers out of band blobs" << rxName;
+            } else if (codec && rxName == QtRemoteObjects::compactProtocolVersion) {
+                // The host accepted our offer, acknowledge it and switch both directions
+                auto &writeCodec = connection->d_func()->m_codec;
+                writeCodec->serializeHandshakePacket(QtRemoteObjects::compactProtocolVersion);
+                writeCodec->send(connection);
+                writeCodec.reset(new QRemoteObjectPackets::QCompactCodec);
+                codec.reset(new QRemoteObjectPackets::QCompactCodec);
+                connection->d_func()->sendCompressionHandshake();
+                connection->d_func()->requestBlobChannel();
+                qROPrivDebug() << "Switched to the compact codec";
+            } else if (rxName != QtRemoteObjects::protocolVersion) {
                 qWarning() << "*** Protocol Mismatch, closing connection ***. Got" << rxName << "expected" << QtRemoteObjects::protocolVersion;
                 setLastError(QRemoteObjectNode::ProtocolMismatch);
                 connection->close();
             } else {
+                finishReconnect(connection);
                 // TODO should have some sort of manager for the codec
                 codec.reset(new QRemoteObjectPackets::QDataStreamCodec);
+                auto &writeCodec = connection->d_func()->m_codec;
+                writeCodec.reset(new QRemoteObjectPackets::QDataStreamCodec);
+                // Offer the compact codec. Hosts that don't support it ignore the packet.
+                writeCodec->serializeHandshakePacket(QtRemoteObjects::compactProtocolVersion);
+                writeCodec->send(connection);
             }
             break;
         case QRemoteObjectPacketTypeEnum::ObjectList:
@@ -1440,11 +2187,28 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
         case QRemoteObjectPacketTypeEnum::InitPacket:
         {
             qROPrivDebug() << "InitPacket-->" << rxName << this;
-            QSharedPointer<QConnectedReplicaImplementation> rep = qSharedPointerCast<QConnectedReplicaImplementation>(replicas.value(rxName).toStrongRef());
+            QSharedPointer<QConnectedReplicaImplementation> rep = qSharedPointerCast<QConnectedReplicaImplementation>(replicaForPacket(connection));
+            // A dynamic replica that announced the definition as cached gets the values only.
+            // Its class was built when announcing it, it registers the types of the values.
+            const QMetaObject *meta = nullptr;
+            if (rep && rep->needsDynamicInitialization()) {
+                meta = rep->m_cachedMetaObject;
+                if (!meta) {
+                    // Ask again without announcing the definition, the source sends it then
+                    qROPrivWarning() << "Missing the cached definition of" << rxName
+                                     << ", requesting the definition";
+                    dropCachedDefinition(connectedSources.value(rxName).objectSignature);
+                    rep->requestRemoteObjectSource();
+                    break;
+                }
+            }
             //Use m_rxArgs (a QVariantList to hold the properties QVariantList)
             codec->deserializeInitPacket(connection->d_func()->stream(), rxArgs);
-            if (rep)
-            {
+            if (meta) {
+                rep->setDynamicMetaObject(meta);
+                handlePointerToQObjectProperties(rep.data(), rxArgs);
+                rep->setDynamicProperties(std::move(rxArgs));
+            } else if (rep) {
                 handlePointerToQObjectProperties(rep.data(), rxArgs);
                 rep->initialize(std::move(rxArgs));
             } else { //replica has been deleted, remove from list
@@ -1455,9 +2219,19 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
         case QRemoteObjectPacketTypeEnum::InitDynamicPacket:
         {
             qROPrivDebug() << "InitDynamicPacket-->" << rxName << this;
-            const QMetaObject *meta = dynamicTypeManager.addDynamicType(connection, connection->d_func()->stream());
-            codec->deserializeInitPacket(connection->d_func()->stream(), rxArgs);
-            QSharedPointer<QConnectedReplicaImplementation> rep = qSharedPointerCast<QConnectedReplicaImplementation>(replicas.value(rxName).toStrongRef());
+            QDataStream &stream = connection->d_func()->stream();
+            const qint64 definitionStart = stream.device()->pos();
+            const QMetaObject *meta = dynamicTypeManager.addDynamicType(connection, stream);
+            const QByteArray signature = connectedSources.value(rxName).objectSignature;
+            if (!m_typeCacheDirectory.isEmpty() && !signature.isEmpty()
+                && stream.status() == QDataStream::Ok) {
+                QIODevice *device = stream.device();
+                const qint64 definitionEnd = device->pos();
+                device->seek(definitionStart);
+                cacheDefinition(signature, device->read(definitionEnd - definitionStart));
+            }
+            codec->deserializeInitPacket(stream, rxArgs);
+            QSharedPointer<QConnectedReplicaImplementation> rep = qSharedPointerCast<QConnectedReplicaImplementation>(replicaForPacket(connection));
             if (rep)
             {
                 rep->setDynamicMetaObject(meta);
@@ -1472,6 +2246,7 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
         {
             qROPrivDebug() << "RemoveObject-->" << rxName << this;
             connectedSources.remove(rxName);
+            datagramChannels.remove(rxName);
             connection->removeSource(rxName);
             if (replicas.contains(rxName)) { //We have a replica using the removed source
                 QSharedPointer<QConnectedReplicaImplementation> rep = qSharedPointerCast<QConnectedReplicaImplementation>(replicas.value(rxName).toStrongRef());
@@ -1487,8 +2262,19 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
         case QRemoteObjectPacketTypeEnum::PropertyChangePacket:
         {
             int propertyIndex;
-            codec->deserializePropertyChangePacket(connection->d_func()->stream(), propertyIndex, rxValue);
-            QSharedPointer<QRemoteObjectReplicaImplementation> rep = qSharedPointerCast<QRemoteObjectReplicaImplementation>(replicas.value(rxName).toStrongRef());
+            QSharedPointer<QRemoteObjectReplicaImplementation> rep = replicaForPacket(connection);
+            // repc generated replicas read the value straight into their storage
+            auto typedRep = rep && !rep->isShortCircuit()
+                    ? static_cast<QConnectedReplicaImplementation *>(rep.data()) : nullptr;
+            if (typedRep && typedRep->m_deserializeCompactProperty) {
+                if (codec->deserializePropertyChangePacket(connection->d_func()->stream(),
+                                                           propertyIndex, rxValue,
+                                                           typedRep->m_deserializeCompactProperty,
+                                                           typedRep->m_propertyStorage))
+                    break;
+            } else {
+                codec->deserializePropertyChangePacket(connection->d_func()->stream(), propertyIndex, rxValue);
+            }
             if (rep) {
                 QConnectedReplicaImplementation *connectedRep = nullptr;
                 if (!rep->isShortCircuit()) {
@@ -1500,7 +2286,11 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
                     rep->setProperty(propertyIndex, handlePointerToQObjectProperty(connectedRep, propertyIndex, rxValue));
                 else {
                     const QMetaProperty property = rep->m_metaObject->property(propertyIndex + rep->m_metaObject->propertyOffset());
-                    if (property.userType() == QMetaType::QVariant && rxValue.canConvert<QRO_>()) {
+                    if (rxValue.metaType() == QMetaType::fromType<GadgetDelta>()) {
+                        // Only the changed fields were sent, apply them to our copy
+                        rxValue = applyGadgetDelta(rep->getProperty(propertyIndex),
+                                                   std::move(*static_cast<GadgetDelta *>(rxValue.data())));
+                    } else if (property.userType() == QMetaType::QVariant && rxValue.canConvert<QRO_>()) {
                         // This is a type that requires registration
                         QRO_ typeInfo = rxValue.value<QRO_>();
                         QDataStream in(typeInfo.classDefinition);
@@ -1508,7 +2298,7 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
                         QDataStream ds(typeInfo.parameters);
                         ds >> rxValue;
                     }
-                    rep->setProperty(propertyIndex, decodeVariant(std::move(rxValue), property.metaType()));
+                    rep->setProperty(propertyIndex, decodeVariant(std::move(rxValue), rep->m_propertyPlans.value(propertyIndex)));
                 }
             } else { //replica has been deleted, remove from list
                 replicas.remove(rxName);
@@ -1519,7 +2309,7 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
         {
             int call, index, serialId, propertyIndex;
             codec->deserializeInvokePacket(connection->d_func()->stream(), call, index, rxArgs, serialId, propertyIndex);
-            QSharedPointer<QRemoteObjectReplicaImplementation> rep = qSharedPointerCast<QRemoteObjectReplicaImplementation>(replicas.value(rxName).toStrongRef());
+            QSharedPointer<QRemoteObjectReplicaImplementation> rep = replicaForPacket(connection);
             if (rep) {
                 static QVariant null(QMetaType::fromType<QObject *>(), nullptr);
                 QVariant paramValue;
@@ -1527,12 +2317,13 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
                 QVarLengthArray<void*, 10> param(rxArgs.size() + 1);
                 param[0] = null.data(); //Never a return value
                 if (rxArgs.size()) {
-                    auto signal = rep->m_metaObject->method(index+rep->m_signalOffset);
+                    const CodecPlanList plans = rep->m_signalPlans.value(index);
                     for (int i = 0; i < rxArgs.size(); i++) {
-                        if (signal.parameterType(i) == QMetaType::QVariant)
+                        const CodecPlan plan = plans.value(i);
+                        if (plan.kind == CodecPlan::Dynamic)
                             param[i + 1] = const_cast<void*>(reinterpret_cast<const void*>(&rxArgs.at(i)));
                         else {
-                            rxArgs[i] = decodeVariant(std::move(rxArgs[i]), signal.parameterMetaType(i));
+                            rxArgs[i] = decodeVariant(std::move(rxArgs[i]), plan);
                             param[i + 1] = const_cast<void *>(rxArgs.at(i).data());
                         }
                     }
@@ -1554,7 +2345,7 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
         {
             int ackedSerialId;
             codec->deserializeInvokeReplyPacket(connection->d_func()->stream(), ackedSerialId, rxValue);
-            QSharedPointer<QRemoteObjectReplicaImplementation> rep = qSharedPointerCast<QRemoteObjectReplicaImplementation>(replicas.value(rxName).toStrongRef());
+            QSharedPointer<QRemoteObjectReplicaImplementation> rep = replicaForPacket(connection);
             if (rep) {
                 qROPrivDebug() << "Received InvokeReplyPacket ack'ing serial id:" << ackedSerialId;
                 rxValue = decodeVariant(std::move(rxValue), {});
@@ -1564,14 +2355,279 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
             }
             break;
         }
+        case QRemoteObjectPacketTypeEnum::DatagramChannel:
+        {
+            DatagramChannelInfo info;
+            codec->deserializeDatagramChannelPacket(connection->d_func()->stream(), info);
+            QSharedPointer<QRemoteObjectReplicaImplementation> rep = replicaForPacket(connection);
+            if (rep) {
+                if (!rep->isShortCircuit())
+                    handleDatagramChannel(connection, static_cast<QConnectedReplicaImplementation *>(rep.data()), std::move(info));
+            } else { //replica has been deleted, remove from list
+                replicas.remove(rxName);
+            }
+            break;
+        }
+        case QRemoteObjectPacketTypeEnum::ResyncPacket:
+        {
+            PropertyVersion version;
+            QList<int> properties;
+            codec->deserializeResyncPacket(connection->d_func()->stream(), version, properties, rxArgs);
+            QSharedPointer<QRemoteObjectReplicaImplementation> rep = replicaForPacket(connection);
+            if (rep) {
+                if (!rep->isShortCircuit())
+                    static_cast<QConnectedReplicaImplementation *>(rep.data())->resync(version, properties, std::move(rxArgs));
+            } else { //replica has been deleted, remove from list
+                replicas.remove(rxName);
+            }
+            break;
+        }
         case QRemoteObjectPacketTypeEnum::AddObject:
         case QRemoteObjectPacketTypeEnum::Invalid:
         case QRemoteObjectPacketTypeEnum::Ping:
+        case QRemoteObjectPacketTypeEnum::DatagramResync:
             qROPrivWarning() << "Unexpected packet received";
         }
     } while (connection->bytesAvailable()); // have bytes left over, so do another iteration
 }
 
+// The source of rep announced its datagram channel (a new token or address has to be joined
+// again), or sent the current sequence number, with the values of the lossy properties if
+// we asked for them
+void QRemoteObjectNodePrivate::handleDatagramChannel(QtROIoDeviceBase *connection,
+                                                     QConnectedReplicaImplementation *rep,
+                                                     QRemoteObjectPackets::DatagramChannelInfo &&info)
+{
+    const QString name = rep->m_objectName;
+    if (info.address.isEmpty()) {
+        datagramChannels.remove(name);
+        return;
+    }
+
+    auto it = datagramChannels.find(name);
+    if (it == datagramChannels.end() || it->connection != connection || it->token != info.token
+        || it->address != info.address) {
+        DatagramChannelState channel;
+        channel.connection = connection;
+        channel.address = info.address;
+        channel.token = info.token;
+        channel.sequence = info.sequence;
+        channel.properties = info.properties;
+        if (!joinDatagramGroup(info.address)) {
+            datagramChannels.remove(name);
+            requestDatagramResync(rep, channel, false);
+            return;
+        }
+        it = datagramChannels.insert(name, channel);
+        qROPrivDebug() << "Joined datagram channel" << info.address << "of" << name;
+        requestDatagramResync(rep, *it);
+        return;
+    }
+
+    if (info.values.isEmpty()) {
+        // Datagrams got lost after the last one we received
+        if (info.sequence > it->sequence && !it->resyncPending)
+            requestDatagramResync(rep, *it);
+        return;
+    }
+
+    it->resyncPending = false;
+    it->sequence = qMax(it->sequence, info.sequence);
+    QList<int> changed;
+    for (qsizetype i = 0; i < info.properties.size(); ++i) {
+        const int index = info.properties.at(i);
+        // A datagram newer than the values got here first
+        quint64 &propertySequence = it->propertySequences[index];
+        if (propertySequence > info.sequence)
+            continue;
+        propertySequence = info.sequence;
+        changed << int(i);
+    }
+    for (int i : std::as_const(changed))
+        applyLossyProperty(rep, info.properties.at(i), std::move(info.values[i]));
+}
+
+void QRemoteObjectNodePrivate::requestDatagramResync(QConnectedReplicaImplementation *rep,
+                                                     DatagramChannelState &channel, bool joined)
+{
+    if (!rep->connectionToSource)
+        return;
+    channel.resyncPending = joined;
+    auto codec = rep->codecForSource();
+    codec->serializeDatagramResyncPacket(rep->m_objectName, joined);
+    codec->send(rep->connectionToSource.data());
+}
+
+// Channels with the same address share a socket
+bool QRemoteObjectNodePrivate::joinDatagramGroup(const QUrl &address)
+{
+    if (datagramSockets.contains(address))
+        return true;
+    QHostAddress group;
+    quint16 port;
+    if (!QRemoteObjectPackets::parseDatagramAddress(address, &group, &port))
+        return false;
+
+    Q_Q(QRemoteObjectNode);
+    QUdpSocket *socket = new QUdpSocket(q);
+    const QHostAddress any = group.protocol() == QAbstractSocket::IPv6Protocol
+            ? QHostAddress::AnyIPv6 : QHostAddress::AnyIPv4;
+    if (!socket->bind(any, port, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint)
+        || !socket->joinMulticastGroup(group)) {
+        qROPrivWarning() << "Cannot join datagram channel" << address << socket->errorString();
+        delete socket;
+        return false;
+    }
+    QObject::connect(socket, &QUdpSocket::readyRead, q, [this, socket]() {
+        onDatagramsReady(socket);
+    });
+    datagramSockets.insert(address, socket);
+    return true;
+}
+
+void QRemoteObjectNodePrivate::onDatagramsReady(QUdpSocket *socket)
+{
+    using namespace QRemoteObjectPackets;
+    while (socket->hasPendingDatagrams()) {
+        DatagramUpdate update;
+        if (!deserializeDatagram(socket->receiveDatagram().data(), update))
+            continue;
+        const auto it = datagramChannels.find(update.name);
+        if (it == datagramChannels.end() || it->token != update.token
+            || !it->properties.contains(update.propertyIndex)) {
+            continue;
+        }
+        auto rep = qSharedPointerCast<QRemoteObjectReplicaImplementation>(replicas.value(update.name).toStrongRef());
+        if (!rep || rep->isShortCircuit())
+            continue;
+        auto connectedRep = static_cast<QConnectedReplicaImplementation *>(rep.data());
+        if (!it->connection || connectedRep->connectionToSource != it->connection)
+            continue;
+        // Datagrams can arrive out of order, only newer values are applied
+        quint64 &propertySequence = it->propertySequences[update.propertyIndex];
+        if (update.sequence <= propertySequence)
+            continue;
+        propertySequence = update.sequence;
+        if (update.sequence > it->sequence + 1 && !it->resyncPending)
+            requestDatagramResync(connectedRep, *it);
+        it->sequence = qMax(it->sequence, update.sequence);
+        applyLossyProperty(connectedRep, update.propertyIndex, std::move(update.value));
+    }
+}
+
+void QRemoteObjectNodePrivate::applyLossyProperty(QConnectedReplicaImplementation *rep, int index,
+                                                  QVariant &&value)
+{
+    const QMetaObject *meta = rep->m_metaObject;
+    if (!meta || index < 0 || index >= meta->propertyCount() - rep->m_propertyOffset)
+        return;
+    rep->setProperty(index, QRemoteObjectPackets::decodeVariant(std::move(value), rep->m_propertyPlans.value(index)));
+    const int notifyIndex = meta->property(index + rep->m_propertyOffset).notifySignalIndex();
+    if (notifyIndex < 0)
+        return;
+    QVariant current = rep->getProperty(index);
+    void *args[] = { nullptr, current.data() };
+    QMetaObject::activate(rep, rep->metaObject(), notifyIndex, args);
+}
+
+static constexpr quint32 cachedDefinitionMagic = 0x51524f54; // "QROT"
+
+static QString cachedDefinitionFile(const QString &directory, const QByteArray &signature)
+{
+    return directory + QLatin1Char('/') + QString::fromLatin1(signature.toHex())
+            + QLatin1String(".qrotype");
+}
+
+// The cached definition of the class with signature, see
+// QRemoteObjectNode::setTypeCacheDirectory(). It is encoded like in an InitDynamicPacket.
+QByteArray QRemoteObjectNodePrivate::cachedDefinition(const QByteArray &signature)
+{
+    if (m_typeCacheDirectory.isEmpty() || signature.isEmpty())
+        return QByteArray();
+    const auto it = m_cachedDefinitions.constFind(signature);
+    if (it != m_cachedDefinitions.cend())
+        return *it;
+
+    // Misses are remembered as well, until cacheDefinition() replaces them
+    QByteArray &definition = m_cachedDefinitions[signature];
+    QFile file(cachedDefinitionFile(m_typeCacheDirectory, signature));
+    if (!file.open(QIODevice::ReadOnly))
+        return definition;
+    QDataStream ds(&file);
+    ds.setVersion(QtRemoteObjects::dataStreamVersion);
+    quint32 magic = 0;
+    QString protocol;
+    ds >> magic >> protocol;
+    // The encoding of the definition belongs to the protocol
+    if (magic != cachedDefinitionMagic || protocol != QtRemoteObjects::protocolVersion) {
+        qROPrivDebug() << "Ignoring cached definition" << file.fileName() << protocol;
+        return definition;
+    }
+    QByteArray data;
+    ds >> data;
+    if (ds.status() == QDataStream::Ok)
+        definition = std::move(data);
+    return definition;
+}
+
+void QRemoteObjectNodePrivate::cacheDefinition(const QByteArray &signature,
+                                               const QByteArray &definition)
+{
+    if (m_typeCacheDirectory.isEmpty() || signature.isEmpty() || definition.isEmpty())
+        return;
+    if (m_cachedDefinitions.value(signature) == definition)
+        return;
+    m_cachedDefinitions.insert(signature, definition);
+
+    if (!QDir().mkpath(m_typeCacheDirectory)) {
+        qROPrivWarning() << "Unable to create the type cache directory" << m_typeCacheDirectory;
+        return;
+    }
+    // Other nodes can read the file at the same time, it is replaced once complete
+    QSaveFile file(cachedDefinitionFile(m_typeCacheDirectory, signature));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qROPrivWarning() << "Unable to cache the definition in" << file.fileName()
+                         << file.errorString();
+        return;
+    }
+    QDataStream ds(&file);
+    ds.setVersion(QtRemoteObjects::dataStreamVersion);
+    ds << cachedDefinitionMagic << QString(QtRemoteObjects::protocolVersion) << definition;
+    if (!file.commit())
+        qROPrivWarning() << "Unable to cache the definition in" << file.fileName()
+                         << file.errorString();
+}
+
+// Forgets the cached definition of the class with signature, also the file
+void QRemoteObjectNodePrivate::dropCachedDefinition(const QByteArray &signature)
+{
+    if (m_typeCacheDirectory.isEmpty() || signature.isEmpty())
+        return;
+    // Remembered as a miss, until cacheDefinition() replaces it
+    m_cachedDefinitions.insert(signature, QByteArray());
+    QFile::remove(cachedDefinitionFile(m_typeCacheDirectory, signature));
+}
+
+// Builds the class of a dynamic replica from the cached definition, for a source that
+// skips it in the init packet. A definition that doesn't decode is dropped.
+const QMetaObject *QRemoteObjectNodePrivate::addCachedDynamicType(QtROIoDeviceBase *connection,
+                                                                  const QByteArray &signature)
+{
+    const QByteArray definition = cachedDefinition(signature);
+    if (definition.isEmpty())
+        return nullptr;
+    QDataStream ds(definition);
+    ds.setVersion(QtRemoteObjects::dataStreamVersion);
+    ds.setByteOrder(QDataStream::LittleEndian);
+    const QMetaObject *meta = dynamicTypeManager.addDynamicType(connection, ds);
+    if (ds.status() == QDataStream::Ok)
+        return meta;
+    qROPrivWarning() << "Dropping the invalid cached definition"
+                     << cachedDefinitionFile(m_typeCacheDirectory, signature);
+    dropCachedDefinition(signature);
+    return nullptr;
+}
+
 /*!
     \class QRemoteObjectNode
     \inmodule QtRemoteObjects
@@ -1700,6 +2756,35 @@ void QRemoteObjectNodePrivate::onClientRead(QObject *obj)
     \sa QRemoteObjectHost
 */
 
+/*!
+    \enum QRemoteObjectHostBase::BackPressurePolicy
+    \since 6.9
+
+    This enum describes what a host does with a connection whose peer does
+    not read the data sent to it fast enough, once more than the high-water
+    mark is waiting to be written to it.
+
+    \value NoBackPressure All data is sent, however much of it accumulates.
+    This is the default.
+    \value ConflatePropertyChanges Property changes are not sent to the
+    congested connection. Once it has caught up, only the latest value of
+    each property that changed in the meantime is sent. Other signals are
+    still sent.
+    \value PauseUpdates Neither property changes nor signals are sent to the
+    congested connection. Once it has caught up, the latest values of the
+    properties that changed are sent. Other signals emitted in the meantime
+    are dropped, not queued, as queuing them would let the memory used for
+    the connection grow without bounds (see droppedSignalCount()).
+    \value DisconnectConsumer The congested connection is closed.
+
+    A connection has caught up once less than half of the high-water mark is
+    waiting to be written. Packets the protocol relies on, such as the
+    initial values of a source, replies to method calls and pings, are
+    always sent.
+
+    \sa QRemoteObjectHostBase::setBackPressure()
+*/
+
 /*!
     \fn template <class ObjectType> ObjectType *QRemoteObjectNode::acquire(const QString &name)
 
@@ -1724,6 +2809,34 @@ void QRemoteObjectNodePrivate::initialize()
     QAbstractItemModelSourceAdapter::registerTypes();
 }
 
+void QRemoteObjectNodePrivate::applyWriteBuffering(QtROIoDeviceBase *connection) const
+{
+    connection->setWriteBuffering(m_writeBufferingMode, m_writeBufferingDelay,
+                                  m_writeBufferingThreshold);
+}
+
+void QRemoteObjectNodePrivate::applyCompression(QtROIoDeviceBase *connection) const
+{
+    // Connections added with addClientSideConnection() have no URL and use the default
+    QString scheme;
+    if (auto clientIo = qobject_cast<QtROClientIoDevice *>(connection))
+        scheme = clientIo->url().scheme();
+    const CompressionSettings settings = compressionSettings(scheme);
+    connection->setCompression(settings.algorithm, settings.threshold);
+}
+
+void QRemoteObjectNodePrivate::applyCompression(QRemoteObjectSourceIo *sourceIo) const
+{
+    const CompressionSettings settings = compressionSettings(sourceIo->m_address.scheme());
+    sourceIo->setCompression(settings.algorithm, settings.threshold);
+}
+
+// The threads new connections run on, or nullptr if they run in the thread of the node
+QtROIoThreadPool *QRemoteObjectNodePrivate::ioThreads()
+{
+    return m_ioThreadEnabled ? &m_ioThreads : nullptr;
+}
+
 bool QRemoteObjectNodePrivate::checkSignatures(const QByteArray &a, const QByteArray &b)
 {
     // if any of a or b is empty it means it's a dynamic ojects or an item model
@@ -1978,6 +3091,13 @@ bool QRemoteObjectHostBasePrivate::setHostUrlBaseImpl(
     }
     if (socketOptions != QLocalServer::NoOptions)
         remoteObjectIo->setSocketOptions(socketOptions);
+    remoteObjectIo->setWriteBuffering(m_writeBufferingMode, m_writeBufferingDelay,
+                                      m_writeBufferingThreshold);
+    applyCompression(remoteObjectIo);
+    remoteObjectIo->setTransferChunkSize(m_transferChunkSize);
+    remoteObjectIo->setIoThreads(ioThreads());
+    applyBackPressure(remoteObjectIo);
+    applyDatagramChannels(remoteObjectIo);
 
     if (allowedSchemas == QRemoteObjectHostBase::AllowedSchemas::BuiltInSchemasOnly && !remoteObjectIo->startListening()) {
         setLastError(QRemoteObjectHostBase::ListenFailed);
@@ -2320,9 +3440,14 @@ void QRemoteObjectNode::addClientSideConnection(QIODevice *ioDevice)
         return;
     }
     QtROExternalIoDevice *device = new QtROExternalIoDevice(ioDevice, this);
+    d->applyWriteBuffering(device);
+    d->applyCompression(device);
+    device->setTransferChunkSize(d->m_transferChunkSize);
     connect(device, &QtROIoDeviceBase::readyRead, this, [d, device]() {
         d->onClientRead(device);
     });
+    QObjectPrivate::connect(device, &QtROIoDeviceBase::transferProgress, d,
+                            &QRemoteObjectNodePrivate::onTransferProgress);
     if (device->bytesAvailable())
         d->onClientRead(device);
 }
@@ -2603,12 +3728,182 @@ void QRemoteObjectHostBase::addHostSideConnection(QIODevice *ioDevice)
         qWarning() << "A null or closed QIODevice was passed to addHostSideConnection().  Ignoring.";
         return;
     }
-    if (!d->remoteObjectIo)
+    if (!d->remoteObjectIo) {
         d->remoteObjectIo = new QRemoteObjectSourceIo(this);
+        d->remoteObjectIo->setWriteBuffering(d->m_writeBufferingMode, d->m_writeBufferingDelay,
+                                             d->m_writeBufferingThreshold);
+        d->applyCompression(d->remoteObjectIo);
+        d->remoteObjectIo->setTransferChunkSize(d->m_transferChunkSize);
+        d->applyBackPressure(d->remoteObjectIo);
+        d->applyDatagramChannels(d->remoteObjectIo);
+    }
     QtROExternalIoDevice *device = new QtROExternalIoDevice(ioDevice, this);
     return d->remoteObjectIo->newConnection(device);
 }
 
+/*!
+    \since 6.9
+
+    Returns the policy applied to connections that cannot keep up with the
+    data sent to them.
+
+    \sa setBackPressure(), highWaterMark()
+*/
+QRemoteObjectHostBase::BackPressurePolicy QRemoteObjectHostBase::backPressurePolicy() const
+{
+    Q_D(const QRemoteObjectHostBase);
+    return d->m_backPressurePolicy;
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of bytes that can be waiting to be written to a
+    connection before backPressurePolicy() is applied to it.
+
+    \sa setBackPressure()
+*/
+qint64 QRemoteObjectHostBase::highWaterMark() const
+{
+    Q_D(const QRemoteObjectHostBase);
+    return d->m_highWaterMark;
+}
+
+/*!
+    \since 6.9
+
+    Sets the \a policy applied to a connection once more than
+    \a highWaterMark bytes sent to it are still waiting to be written, for
+    instance because the peer is slow to read them or the network is
+    saturated. This keeps a slow replica from making the memory use of the
+    host grow without bounds, and from delaying the updates to the other
+    replicas. The highWaterMarkReached() signal is emitted whenever a
+    connection reaches the high-water mark.
+
+    The count includes the data held back by the write buffering configured
+    with QRemoteObjectNode::setWriteBuffering(), and the data queued for the
+    I/O threads (see QRemoteObjectNode::setIoThreadEnabled()).
+
+    The settings apply to all connections of this host, including the ones
+    established already.
+
+    \sa backPressureCount()
+*/
+void QRemoteObjectHostBase::setBackPressure(BackPressurePolicy policy, qint64 highWaterMark)
+{
+    Q_D(QRemoteObjectHostBase);
+    d->m_backPressurePolicy = policy;
+    d->m_highWaterMark = qMax(highWaterMark, qint64(1));
+    if (d->remoteObjectIo)
+        d->applyBackPressure(d->remoteObjectIo);
+}
+
+/*!
+    \since 6.9
+
+    Returns how often \a policy has been applied by this host: the number of
+    property changes conflated for \l ConflatePropertyChanges, the number of
+    property changes held back for \l PauseUpdates, and the number of
+    connections closed for \l DisconnectConsumer.
+
+    \sa setBackPressure(), droppedSignalCount()
+*/
+qint64 QRemoteObjectHostBase::backPressureCount(BackPressurePolicy policy) const
+{
+    Q_D(const QRemoteObjectHostBase);
+    if (!d->remoteObjectIo || policy < NoBackPressure || policy > DisconnectConsumer)
+        return 0;
+    return d->remoteObjectIo->m_backPressureCounts[policy];
+}
+
+/*!
+    \since 6.9
+
+    Returns the number of signals, other than property change notifications,
+    that were not sent to congested connections under the \l PauseUpdates
+    policy. Unlike property changes, they are not sent once the connection
+    has caught up.
+
+    \sa setBackPressure(), backPressureCount()
+*/
+qint64 QRemoteObjectHostBase::droppedSignalCount() const
+{
+    Q_D(const QRemoteObjectHostBase);
+    return d->remoteObjectIo ? d->remoteObjectIo->m_droppedSignals : 0;
+}
+
+/*!
+    \since 6.9
+
+    Sends the changes of the \a lossyProperties of the source named \a name
+    as UDP datagrams to the multicast group of \a address, which has the
+    form \c{udp://<group>:<port>}, e.g. \c{udp://239.255.43.21:45454}.
+    This suits properties that change at a high rate, where a replica only
+    needs the latest value: a lost datagram is not sent again, and sending
+    one datagram to all replicas is cheaper than writing the change to every
+    connection.
+
+    Replicas that can receive the datagrams join the group. The source no
+    longer sends them the changes of the lossy properties over their
+    connections, other replicas get them as before. Every datagram carries
+    a sequence number, and the source regularly tells the members the last
+    one it sent. When a replica notices it missed datagrams, it asks the
+    source for the current values of the lossy properties over its
+    connection, so it always catches up with the source. Datagrams that
+    arrive late are dropped.
+
+    Only nodes that negotiated the compact wire format join a channel.
+    Changes of lossy properties sent as datagrams are not throttled (see
+    QRemoteObjectNode::setMinimumUpdateInterval()), and changes too large
+    for a single datagram are sent over the connections. A datagram always
+    carries the full value of the property.
+
+    The channel applies to sources enabled before and after the call.
+    Passing an empty \a address removes the channel of \a name. Returns
+    \c false if \a address is not a multicast \c udp address.
+
+    \sa datagramChannel()
+*/
+bool QRemoteObjectHostBase::setDatagramChannel(const QString &name, const QUrl &address,
+                                               const QStringList &lossyProperties)
+{
+    Q_D(QRemoteObjectHostBase);
+    if (address.isEmpty()) {
+        d->m_datagramChannels.remove(name);
+    } else if (!QRemoteObjectPackets::parseDatagramAddress(address, nullptr, nullptr)) {
+        qROWarning(this) << "Invalid datagram channel address" << address;
+        return false;
+    } else {
+        d->m_datagramChannels.insert(name, QtRODatagramChannelSettings{address, lossyProperties});
+    }
+    if (d->remoteObjectIo)
+        d->applyDatagramChannels(d->remoteObjectIo);
+    return true;
+}
+
+/*!
+    \since 6.9
+
+    Returns the address of the datagram channel of the source named
+    \a name, or an empty URL if it has none.
+
+    \sa setDatagramChannel()
+*/
+QUrl QRemoteObjectHostBase::datagramChannel(const QString &name) const
+{
+    Q_D(const QRemoteObjectHostBase);
+    return d->m_datagramChannels.value(name).address;
+}
+
+/*!
+    \fn void QRemoteObjectHostBase::highWaterMarkReached(qint64 bufferedBytes)
+    \since 6.9
+
+    This signal is emitted when a connection of this host has
+    \a bufferedBytes waiting to be written, reaching the high-water mark
+    set with setBackPressure().
+*/
+
 /*!
     Returns a pointer to a \l Replica which is specifically derived from \l
     QAbstractItemModel. The \a name provided must match the name used with the
@@ -2635,6 +3930,19 @@ QRemoteObjectHostBasePrivate::QRemoteObjectHostBasePrivate()
 QRemoteObjectHostBasePrivate::~QRemoteObjectHostBasePrivate()
 { }
 
+void QRemoteObjectHostBasePrivate::applyBackPressure(QRemoteObjectSourceIo *sourceIo)
+{
+    Q_Q(QRemoteObjectHostBase);
+    sourceIo->setBackPressure(m_backPressurePolicy, m_highWaterMark);
+    QObject::connect(sourceIo, &QRemoteObjectSourceIo::highWaterMarkReached, q,
+                     &QRemoteObjectHostBase::highWaterMarkReached, Qt::UniqueConnection);
+}
+
+void QRemoteObjectHostBasePrivate::applyDatagramChannels(QRemoteObjectSourceIo *sourceIo)
+{
+    sourceIo->setDatagramChannels(m_datagramChannels);
+}
+
 QRemoteObjectHostPrivate::QRemoteObjectHostPrivate()
     : QRemoteObjectHostBasePrivate()
 { }
@@ -11,6 +11,7 @@
 #include <QtRemoteObjects/qremoteobjectregistry.h>
 #include <QtRemoteObjects/qremoteobjectdynamicreplica.h>
 
+#include <chrono>
 #include <functional>
 
 QT_BEGIN_NAMESPACE
@@ -67,6 +68,27 @@ public:
     };
     Q_ENUM(ErrorCode)
 
+    enum WriteBufferingMode {
+        FlushImmediately,
+        FlushAtEndOfEventLoop,
+        FlushAfterDelay
+    };
+    Q_ENUM(WriteBufferingMode)
+
+    enum CompressionAlgorithm {
+        NoCompression,
+        ZlibCompression,
+        ZstdCompression
+    };
+    Q_ENUM(CompressionAlgorithm)
+
+    enum SubscriptionMode {
+        SubscribeAll,
+        SubscribeExplicitly,
+        SubscribeOnUse
+    };
+    Q_ENUM(SubscriptionMode)
+
     QRemoteObjectNode(QObject *parent = nullptr);
     QRemoteObjectNode(const QUrl &registryAddress, QObject *parent = nullptr);
     ~QRemoteObjectNode() override;
@@ -108,6 +130,46 @@ public:
     int heartbeatInterval() const;
     void setHeartbeatInterval(int interval);
 
+    WriteBufferingMode writeBufferingMode() const;
+    std::chrono::microseconds writeBufferingDelay() const;
+    qint64 writeBufferingThreshold() const;
+    void setWriteBuffering(WriteBufferingMode mode,
+                           std::chrono::microseconds delay = std::chrono::microseconds::zero(),
+                           qint64 threshold = 0);
+
+    CompressionAlgorithm compression(const QString &scheme = QString()) const;
+    qint64 compressionThreshold(const QString &scheme = QString()) const;
+    void setCompression(CompressionAlgorithm algorithm, qint64 threshold = 1024,
+                        const QString &scheme = QString());
+
+    qint64 transferChunkSize() const;
+    void setTransferChunkSize(qint64 size);
+
+    QVariantMap socketOptions(const QUrl &address) const;
+
+    std::chrono::milliseconds reconnectInitialDelay() const;
+    std::chrono::milliseconds reconnectMaximumDelay() const;
+    double reconnectJitter() const;
+    void setReconnectBackoff(std::chrono::milliseconds initialDelay,
+                             std::chrono::milliseconds maximumDelay = std::chrono::seconds(30),
+                             double jitter = 0.5);
+
+    bool isIoThreadEnabled() const;
+    void setIoThreadEnabled(bool enabled);
+    int ioThreadCount() const;
+    void setIoThreadCount(int count);
+
+    int minimumUpdateInterval(const QString &name) const;
+    void setMinimumUpdateInterval(const QString &name, int msecs);
+
+    SubscriptionMode subscriptionMode(const QString &name) const;
+    QStringList subscribedMembers(const QString &name) const;
+    void setSubscription(const QString &name, SubscriptionMode mode,
+                         const QStringList &members = QStringList());
+
+    QString typeCacheDirectory() const;
+    void setTypeCacheDirectory(const QString &path);
+
     typedef std::function<void (QUrl)> RemoteObjectSchemaHandler;
     void registerExternalSchema(const QString &schema, RemoteObjectSchemaHandler handler);
 
@@ -117,6 +179,8 @@ Q_SIGNALS:
 
     void error(QRemoteObjectNode::ErrorCode errorCode);
     void heartbeatIntervalChanged(int heartbeatInterval);
+    void reconnectScheduled(const QUrl &address, int attempt, int delay);
+    void reconnected(const QUrl &address, int attempts);
 
 protected:
     QRemoteObjectNode(QRemoteObjectNodePrivate &, QObject *parent);
@@ -139,6 +203,13 @@ class Q_REMOTEOBJECTS_EXPORT QRemoteObjectHostBase : public QRemoteObjectNode
 public:
     enum AllowedSchemas { BuiltInSchemasOnly, AllowExternalRegistration };
     Q_ENUM(AllowedSchemas)
+    enum BackPressurePolicy {
+        NoBackPressure,
+        ConflatePropertyChanges,
+        PauseUpdates,
+        DisconnectConsumer
+    };
+    Q_ENUM(BackPressurePolicy)
     ~QRemoteObjectHostBase() override;
     void setName(const QString &name) override;
 
@@ -153,6 +224,16 @@ public:
     Q_INVOKABLE bool disableRemoting(QObject *remoteObject);
     void addHostSideConnection(QIODevice *ioDevice);
 
+    BackPressurePolicy backPressurePolicy() const;
+    qint64 highWaterMark() const;
+    void setBackPressure(BackPressurePolicy policy, qint64 highWaterMark = 4 * 1024 * 1024);
+    qint64 backPressureCount(BackPressurePolicy policy) const;
+    qint64 droppedSignalCount() const;
+
+    bool setDatagramChannel(const QString &name, const QUrl &address,
+                            const QStringList &lossyProperties);
+    QUrl datagramChannel(const QString &name) const;
+
     typedef std::function<bool(QStringView, QStringView)> RemoteObjectNameFilter;
     bool proxy(const QUrl &registryUrl, const QUrl &hostUrl={},
                RemoteObjectNameFilter filter=[](QStringView, QStringView) {return true; });
@@ -160,6 +241,9 @@ public:
     // QRemoteObjectRegistryHost for now. Consider enabling it also for QRemoteObjectHost.
     bool reverseProxy(RemoteObjectNameFilter filter=[](QStringView, QStringView) {return true; });
 
+Q_SIGNALS:
+    void highWaterMarkReached(qint64 bufferedBytes);
+
 protected:
     virtual QUrl hostUrl() const;
     virtual bool setHostUrl(const QUrl &hostAddress, AllowedSchemas allowedSchemas=BuiltInSchemasOnly);
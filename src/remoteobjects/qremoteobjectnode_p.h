@@ -17,14 +17,18 @@
 
 #include <QtCore/private/qobject_p.h>
 #include "qremoteobjectsourceio_p.h"
+#include "qconnection_iothread_p.h"
 #include "qremoteobjectreplica.h"
 #include "qremoteobjectnode.h"
 
 #include <QtCore/qbasictimer.h>
+#include <QtCore/qdeadlinetimer.h>
 #include <QtCore/qmutex.h>
 
 QT_BEGIN_NAMESPACE
 
+class QUdpSocket;
+
 #define qRODebug(x) qCDebug(QT_REMOTEOBJECT) << qPrintable(QtPrivate::deref_for_methodcall(x).objectName())
 #define qROWarning(x) qCWarning(QT_REMOTEOBJECT) << qPrintable(QtPrivate::deref_for_methodcall(x).objectName())
 #define qROCritical(x) qCCritical(QT_REMOTEOBJECT) << qPrintable(QtPrivate::deref_for_methodcall(x).objectName())
@@ -37,6 +41,7 @@ QT_BEGIN_NAMESPACE
 class QRemoteObjectRegistry;
 class QRegistrySource;
 class QConnectedReplicaImplementation;
+class QRemoteObjectReplicaImplementation;
 
 class QRemoteObjectAbstractPersistedStorePrivate : public QObjectPrivate
 {
@@ -117,16 +122,35 @@ public:
     void handlePointerToQObjectProperties(QConnectedReplicaImplementation *rep, QVariantList &properties);
 
     void onClientRead(QObject *obj);
+    QSharedPointer<QRemoteObjectReplicaImplementation> replicaForPacket(QtROIoDeviceBase *connection);
     void onRemoteObjectSourceAdded(const QRemoteObjectSourceLocation &entry);
     void onRemoteObjectSourceRemoved(const QRemoteObjectSourceLocation &entry);
     void onRegistryInitialized();
     void onShouldReconnect(QtROClientIoDevice *ioDevice);
+    std::chrono::milliseconds reconnectDelay(int attempt) const;
+    void startReconnectTimer();
+    void finishReconnect(QtROIoDeviceBase *connection);
+    void onTransferProgress(const QString &name, qint64 bytesReceived, qint64 bytesTotal);
+    void handleDatagramChannel(QtROIoDeviceBase *connection, QConnectedReplicaImplementation *rep,
+                               QRemoteObjectPackets::DatagramChannelInfo &&info);
+    bool joinDatagramGroup(const QUrl &address);
+    void onDatagramsReady(QUdpSocket *socket);
+    void applyLossyProperty(QConnectedReplicaImplementation *rep, int index, QVariant &&value);
+    QByteArray cachedDefinition(const QByteArray &signature);
+    void cacheDefinition(const QByteArray &signature, const QByteArray &definition);
+    void dropCachedDefinition(const QByteArray &signature);
+    const QMetaObject *addCachedDynamicType(QtROIoDeviceBase *connection,
+                                            const QByteArray &signature);
 
     virtual QReplicaImplementationInterface *handleNewAcquire(const QMetaObject *meta, QRemoteObjectReplica *instance, const QString &name);
     void handleReplicaConnection(const QString &name);
     void handleReplicaConnection(const QByteArray &sourceSignature, QConnectedReplicaImplementation *rep, QtROIoDeviceBase *connection);
     void initialize();
     bool setRegistryUrlNodeImpl(const QUrl &registryAddr);
+    void applyWriteBuffering(QtROIoDeviceBase *connection) const;
+    void applyCompression(QtROIoDeviceBase *connection) const;
+    void applyCompression(QRemoteObjectSourceIo *sourceIo) const;
+    QtROIoThreadPool *ioThreads();
 
 private:
     bool checkSignatures(const QByteArray &a, const QByteArray &b);
@@ -139,16 +163,57 @@ public:
         QByteArray objectSignature;
     };
 
+    struct CompressionSettings
+    {
+        QRemoteObjectNode::CompressionAlgorithm algorithm = QRemoteObjectNode::NoCompression;
+        qint64 threshold = 1024;
+    };
+    // The datagram channel of the source of a replica, see
+    // QRemoteObjectHostBase::setDatagramChannel(). sequence is the highest sequence number
+    // seen, propertySequences holds the one of the value each lossy property has.
+    struct DatagramChannelState
+    {
+        QPointer<QtROIoDeviceBase> connection;
+        QUrl address;
+        quint64 token = 0;
+        quint64 sequence = 0;
+        QList<int> properties;
+        QHash<int, quint64> propertySequences;
+        bool resyncPending = false;
+    };
+    void requestDatagramResync(QConnectedReplicaImplementation *rep, DatagramChannelState &channel,
+                               bool joined = true);
+    // Reconnection of a connection to a requested URL, see QRemoteObjectNode::setReconnectBackoff().
+    // attempts counts the attempts made, due is when the next one is made, announced whether
+    // QRemoteObjectNode::reconnectScheduled() was emitted for it.
+    struct ReconnectState
+    {
+        int attempts = 0;
+        QDeadlineTimer due;
+        bool announced = false;
+    };
+    struct SubscriptionSettings
+    {
+        QRemoteObjectNode::SubscriptionMode mode = QRemoteObjectNode::SubscribeAll;
+        QStringList members;
+    };
+    CompressionSettings compressionSettings(const QString &scheme) const
+    {
+        return m_schemeCompression.value(scheme, m_compression);
+    }
+
     QMutex mutex;
     QUrl registryAddress;
     QHash<QString, QWeakPointer<QReplicaImplementationInterface> > replicas;
     QMap<QString, SourceInfo> connectedSources;
     QMap<QString, QRemoteObjectNode::RemoteObjectSchemaHandler> schemaHandlers;
-    QSet<QtROClientIoDevice*> pendingReconnect;
+    QHash<QtROClientIoDevice*, ReconnectState> pendingReconnect;
     QSet<QUrl> requestedUrls;
     QRemoteObjectRegistry *registry;
-    int retryInterval;
     QBasicTimer reconnectTimer;
+    std::chrono::milliseconds m_reconnectInitialDelay { 250 };
+    std::chrono::milliseconds m_reconnectMaximumDelay = std::chrono::seconds(30);
+    double m_reconnectJitter = 0.5;
     QRemoteObjectNode::ErrorCode lastError;
     QString rxName;
     QRemoteObjectPackets::ObjectInfoList rxObjects;
@@ -156,7 +221,23 @@ public:
     QVariant rxValue;
     QRemoteObjectAbstractPersistedStore *persistedStore;
     int m_heartbeatInterval = 0;
+    QRemoteObjectNode::WriteBufferingMode m_writeBufferingMode = QRemoteObjectNode::FlushImmediately;
+    std::chrono::microseconds m_writeBufferingDelay { 0 };
+    qint64 m_writeBufferingThreshold = 0;
+    CompressionSettings m_compression;
+    QHash<QString, CompressionSettings> m_schemeCompression;
+    qint64 m_transferChunkSize = QtRemoteObjects::bulkFragmentSize;
+    bool m_ioThreadEnabled = false;
+    QtROIoThreadPool m_ioThreads;
+    QHash<QString, int> m_minimumUpdateIntervals;
+    QHash<QString, SubscriptionSettings> m_subscriptions;
+    QHash<QString, DatagramChannelState> datagramChannels;
+    QHash<QUrl, QUdpSocket *> datagramSockets;
     QRemoteObjectMetaObjectManager dynamicTypeManager;
+    // The definitions of the classes of dynamic replicas by signature, as read from (or
+    // written to) m_typeCacheDirectory. Empty if there is none.
+    QString m_typeCacheDirectory;
+    QHash<QByteArray, QByteArray> m_cachedDefinitions;
     Q_DECLARE_PUBLIC(QRemoteObjectNode)
 };
 
@@ -171,9 +252,15 @@ public:
                             QRemoteObjectHostBase::AllowedSchemas allowedSchemas =
                                     QRemoteObjectHostBase::BuiltInSchemasOnly);
 
+    void applyBackPressure(QRemoteObjectSourceIo *sourceIo);
+    void applyDatagramChannels(QRemoteObjectSourceIo *sourceIo);
+
 public:
     QRemoteObjectSourceIo *remoteObjectIo;
     ProxyInfo *proxyInfo = nullptr;
+    QRemoteObjectHostBase::BackPressurePolicy m_backPressurePolicy = QRemoteObjectHostBase::NoBackPressure;
+    qint64 m_highWaterMark = 4 * 1024 * 1024;
+    QHash<QString, QtRODatagramChannelSettings> m_datagramChannels;
     Q_DECLARE_PUBLIC(QRemoteObjectHostBase);
 };
 
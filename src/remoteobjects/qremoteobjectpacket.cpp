@@ -3,16 +3,35 @@
 
 #include <QtCore/qabstractitemmodel.h>
 #include <QtCore/qbytearrayview.h>
+#include <QtCore/qendian.h>
+#include <QtCore/qreadwritelock.h>
+#include <QtCore/qscopedvaluerollback.h>
+#include <QtCore/qvarlengtharray.h>
 
 #include "qremoteobjectcontainers_p.h"
 #include "qremoteobjectpendingcall.h"
+#include "qremoteobjectreplica.h"
 #include "qremoteobjectsource.h"
 #include "qremoteobjectsource_p.h"
 #include "qremoteobjectpacket_p.h"
 #include "qconnectionfactories.h"
 #include "qconnectionfactories_p.h"
+#include "qconnection_iothread_p.h"
+#include <QtRemoteObjects/private/qtremoteobjects-config_p.h>
+#include <algorithm>
 #include <cstring>
 
+#if QT_CONFIG(remoteobjects_zstd)
+#  include <zstd.h>
+#endif
+
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <unistd.h>
+#endif
+
 //#define QTRO_VERBOSE_PROTOCOL
 QT_BEGIN_NAMESPACE
 
@@ -34,36 +53,6 @@ inline size_t qHash(const QMetaEnum &key, size_t seed=0) Q_DECL_NOTHROW
            ^ qHash(static_cast<const void *>(key.enumName()), seed) ^ qHash(static_cast<const void *>(key.scope()), seed);
 }
 
-static bool isSequentialGadgetType(QMetaType metaType)
-{
-    if (QMetaType::canConvert(metaType, QMetaType::fromType<QSequentialIterable>())) {
-        static QHash<int, bool> lookup;
-        if (!lookup.contains(metaType.id())) {
-            auto stubVariant = QVariant(metaType, nullptr);
-            auto asIterable = stubVariant.value<QSequentialIterable>();
-            auto valueMetaType = asIterable.metaContainer().valueMetaType();
-            lookup[metaType.id()] = valueMetaType.flags().testFlag(QMetaType::IsGadget);
-        }
-        return lookup[metaType.id()];
-    }
-    return false;
-}
-
-static bool isAssociativeGadgetType(QMetaType metaType)
-{
-    if (QMetaType::canConvert(metaType, QMetaType::fromType<QAssociativeIterable>())) {
-        static QHash<int, bool> lookup;
-        if (!lookup.contains(metaType.id())) {
-            auto stubVariant = QVariant(metaType, nullptr);
-            auto asIterable = stubVariant.value<QAssociativeIterable>();
-            auto valueMetaType = asIterable.metaContainer().mappedMetaType();
-            lookup[metaType.id()] = valueMetaType.flags().testFlag(QMetaType::IsGadget);
-        }
-        return lookup[metaType.id()];
-    }
-    return false;
-}
-
 using namespace QtRemoteObjects;
 
 namespace QRemoteObjectPackets {
@@ -83,6 +72,83 @@ QMetaType transferTypeForEnum(QMetaType enumType)
     }
 }
 
+static CodecPlan resolveCodecPlan(QMetaType metaType)
+{
+    CodecPlan plan;
+    plan.type = metaType;
+    if (metaType == QMetaType::fromType<QVariant>()) {
+        plan.kind = CodecPlan::Dynamic;
+    } else if (metaType.flags().testFlag(QMetaType::IsEnumeration)) {
+        plan.kind = CodecPlan::Enum;
+        plan.transferType = transferTypeForEnum(metaType);
+    } else if (metaType == QMetaType::fromType<QtROSequentialContainer>()) {
+        plan.kind = CodecPlan::Sequential;
+    } else if (metaType == QMetaType::fromType<QtROAssociativeContainer>()) {
+        plan.kind = CodecPlan::Associative;
+    } else if (QMetaType::canConvert(metaType, QMetaType::fromType<QSequentialIterable>())) {
+        auto stubVariant = QVariant(metaType, nullptr);
+        auto asIterable = stubVariant.value<QSequentialIterable>();
+        plan.valueType = asIterable.metaContainer().valueMetaType();
+        if (plan.valueType.flags().testFlag(QMetaType::IsGadget))
+            plan.kind = CodecPlan::Sequential;
+    } else if (QMetaType::canConvert(metaType, QMetaType::fromType<QAssociativeIterable>())) {
+        auto stubVariant = QVariant(metaType, nullptr);
+        auto asIterable = stubVariant.value<QAssociativeIterable>();
+        plan.keyType = asIterable.metaContainer().keyMetaType();
+        plan.valueType = asIterable.metaContainer().mappedMetaType();
+        if (plan.valueType.flags().testFlag(QMetaType::IsGadget))
+            plan.kind = CodecPlan::Associative;
+    }
+    return plan;
+}
+
+namespace {
+struct CodecPlanCache
+{
+    QReadWriteLock lock;
+    QHash<int, CodecPlan> plans;
+};
+}
+
+Q_GLOBAL_STATIC(CodecPlanCache, codecPlanCache)
+
+// Returns the plan for metaType, resolving it on first use. Nodes in different threads
+// share the cache, so it is guarded by a lock.
+CodecPlan codecPlan(QMetaType metaType)
+{
+    if (!metaType.isValid())
+        return CodecPlan();
+    const int id = metaType.id();
+    CodecPlanCache *cache = codecPlanCache();
+    {
+        QReadLocker locker(&cache->lock);
+        const auto it = cache->plans.constFind(id);
+        if (it != cache->plans.cend())
+            return *it;
+    }
+    const CodecPlan plan = resolveCodecPlan(metaType);
+    QWriteLocker locker(&cache->lock);
+    cache->plans.insert(id, plan);
+    return plan;
+}
+
+void forgetCodecPlan(QMetaType metaType)
+{
+    if (codecPlanCache.isDestroyed())
+        return;
+    CodecPlanCache *cache = codecPlanCache();
+    QWriteLocker locker(&cache->lock);
+    cache->plans.remove(metaType.id());
+}
+
+// QSQ_/QAS_ carry type names, use the type we already know when the names agree
+static QMetaType metaTypeFromName(const QByteArray &name, QMetaType known)
+{
+    if (known.isValid() && name == known.name())
+        return known;
+    return QMetaType::fromName(name.constData());
+}
+
 // QDataStream sends QVariants of custom types by sending their typename, allowing decode
 // on the receiving side.  For QtRO and enums, this won't work, as the enums have different
 // scopes.  E.g., the examples have ParentClassSource::MyEnum and ParentClassReplica::MyEnum.
@@ -92,62 +158,77 @@ QMetaType transferTypeForEnum(QMetaType enumType)
 // decode the integer variant into an enum variant (via decodeVariant).
 QVariant encodeVariant(const QVariant &value)
 {
+    // Builtin types are always sent as is
     const auto metaType = value.metaType();
-    if (metaType.flags().testFlag(QMetaType::IsEnumeration)) {
+    if (metaType.id() < QMetaType::User)
+        return value;
+    return encodeVariant(value, codecPlan(metaType));
+}
+
+QVariant encodeVariant(const QVariant &value, const CodecPlan &plan)
+{
+    switch (plan.kind) {
+    case CodecPlan::Plain:
+        return value;
+    case CodecPlan::Dynamic:
+        return encodeVariant(value);
+    case CodecPlan::Enum:
+    {
+        if (value.metaType() != plan.type)
+            return encodeVariant(value);
         auto converted = QVariant(value);
-        auto transferType = transferTypeForEnum(metaType);
-        converted.convert(transferType);
+        converted.convert(plan.transferType);
 #ifdef QTRO_VERBOSE_PROTOCOL
-        qDebug() << "Converting from enum to integer type" << transferType.sizeOf() << converted << value;
+        qDebug() << "Converting from enum to integer type" << plan.transferType.sizeOf() << converted << value;
 #endif
         return converted;
     }
-    if (isSequentialGadgetType(metaType)) { // Doesn't include QtROSequentialContainer
+    case CodecPlan::Sequential:
+    {
         // TODO Way to create the QVariant without copying the QSQ_?
         QSQ_ sequence(value);
 #ifdef QTRO_VERBOSE_PROTOCOL
-        qDebug() << "Encoding sequential container" << metaType.name() << "to QSQ_ to transmit";
-#endif
-        return QVariant::fromValue<QSQ_>(sequence);
-    }
-    if (metaType == QMetaType::fromType<QtROSequentialContainer>()) {
-        QSQ_ sequence(value);
-#ifdef QTRO_VERBOSE_PROTOCOL
-        qDebug() << "Encoding QtROSequentialContainer container to QSQ_ to transmit";
+        qDebug() << "Encoding sequential container" << plan.type.name() << "to QSQ_ to transmit";
 #endif
         return QVariant::fromValue<QSQ_>(sequence);
     }
-    if (isAssociativeGadgetType(metaType)) { // Doesn't include QtROAssociativeContainer
+    case CodecPlan::Associative:
+    {
         QAS_ map(value);
 #ifdef QTRO_VERBOSE_PROTOCOL
-        qDebug() << "Encoding associative container" << metaType.name() << "to QAS_ to transmit";
+        qDebug() << "Encoding associative container" << plan.type.name() << "to QAS_ to transmit";
 #endif
         return QVariant::fromValue<QAS_>(map);
     }
-    if (metaType == QMetaType::fromType<QtROAssociativeContainer>()) {
-        QAS_ map(value);
-#ifdef QTRO_VERBOSE_PROTOCOL
-        qDebug() << "Encoding QtROAssociativeContainer container to QAS_ to transmit";
-#endif
-        return QVariant::fromValue<QAS_>(map);
     }
     return value;
 }
 
 QVariant decodeVariant(QVariant &&value, QMetaType metaType)
 {
-    if (metaType.flags().testFlag(QMetaType::IsEnumeration)) {
+    // Only enums and QSQ_/QAS_ need decoding, skip the plan lookup for anything else
+    const auto valueType = value.metaType();
+    if (!metaType.flags().testFlag(QMetaType::IsEnumeration)
+        && valueType != QMetaType::fromType<QRemoteObjectPackets::QSQ_>()
+        && valueType != QMetaType::fromType<QRemoteObjectPackets::QAS_>())
+        return std::move(value);
+    return decodeVariant(std::move(value), codecPlan(metaType));
+}
+
+QVariant decodeVariant(QVariant &&value, const CodecPlan &plan)
+{
+    if (plan.kind == CodecPlan::Enum) {
 #ifdef QTRO_VERBOSE_PROTOCOL
         QVariant encoded(value);
 #endif
-        value.convert(metaType);
+        value.convert(plan.type);
 #ifdef QTRO_VERBOSE_PROTOCOL
         qDebug() << "Converting to enum from integer type" << value << encoded;
 #endif
     } else if (value.metaType() == QMetaType::fromType<QRemoteObjectPackets::QSQ_>()) {
         const auto *qsq_ = static_cast<const QRemoteObjectPackets::QSQ_ *>(value.constData());
         QDataStream in(qsq_->values);
-        auto containerType = QMetaType::fromName(qsq_->typeName.constData());
+        auto containerType = metaTypeFromName(qsq_->typeName, plan.type);
         bool isRegistered = containerType.isRegistered();
         if (isRegistered) {
             QVariant seq{containerType, nullptr};
@@ -166,7 +247,9 @@ QVariant decodeVariant(QVariant &&value, QMetaType metaType)
             quint32 count;
             in >> valueTypeName;
             in >> count;
-            QMetaType valueType = QMetaType::fromName(valueTypeName.constData());
+            const QMetaType knownValueType = containerType == plan.type
+                    ? plan.valueType : seqIter.metaContainer().valueMetaType();
+            QMetaType valueType = metaTypeFromName(valueTypeName, knownValueType);
             QVariant tmp{valueType, nullptr};
             for (quint32 i = 0; i < count; i++) {
                 if (!valueType.load(in, tmp.data())) {
@@ -199,7 +282,7 @@ QVariant decodeVariant(QVariant &&value, QMetaType metaType)
     } else if (value.metaType() == QMetaType::fromType<QRemoteObjectPackets::QAS_>()) {
         const auto *qas_ = static_cast<const QRemoteObjectPackets::QAS_ *>(value.constData());
         QDataStream in(qas_->values);
-        auto containerType = QMetaType::fromName(qas_->typeName.constData());
+        auto containerType = metaTypeFromName(qas_->typeName, plan.type);
         bool isRegistered = containerType.isRegistered();
         if (isRegistered) {
             QVariant map{containerType, nullptr};
@@ -214,22 +297,23 @@ QVariant decodeVariant(QVariant &&value, QMetaType metaType)
                            << "(Unable to insert values)";
                 return QVariant();
             }
+            const bool knownContainer = containerType == plan.type;
             QByteArray keyTypeName, valueTypeName;
             quint32 count;
             in >> keyTypeName;
-            QMetaType keyType = QMetaType::fromName(keyTypeName.constData());
+            QMetaType keyType = metaTypeFromName(keyTypeName, knownContainer ? plan.keyType : QMetaType());
             if (!keyType.isValid()) {
                 // This happens for class enums, where the passed keyType is <ClassName>::<enum>
                 // For a compiled replica, the keyType is <ClassName>Replica::<enum>
                 // Since the full typename is registered, we can pull the keyType from there
-                keyType = mapIter.metaContainer().keyMetaType();
+                keyType = knownContainer ? plan.keyType : mapIter.metaContainer().keyMetaType();
             }
             QMetaType transferType = keyType;
             if (keyType.flags().testFlag(QMetaType::IsEnumeration))
                 transferType = transferTypeForEnum(keyType);
             QVariant key{transferType, nullptr};
             in >> valueTypeName;
-            QMetaType valueType = QMetaType::fromName(valueTypeName.constData());
+            QMetaType valueType = metaTypeFromName(valueTypeName, knownContainer ? plan.valueType : QMetaType());
             QVariant val{valueType, nullptr};
             in >> count;
             for (quint32 i = 0; i < count; i++) {
@@ -319,13 +403,13 @@ void QDataStreamCodec::serializeProperty(QDataStream &ds, const QRemoteObjectSou
             return;
         }
     }
-    ds << encodeVariant(value);
+    ds << encodeVariant(value, source->m_propertyPlans.at(internalIndex));
 }
 
-void QDataStreamCodec::serializeHandshakePacket()
+void QDataStreamCodec::serializeHandshakePacket(const QString &protocol)
 {
     m_packet.setId(Handshake);
-    m_packet << QString(protocolVersion);
+    m_packet << protocol;
     m_packet.finishPacket();
 }
 
@@ -393,6 +477,49 @@ void QDataStreamCodec::serializeInitDynamicPacket(const QRemoteObjectRootSource
     m_packet.finishPacket();
 }
 
+// A stream encoding like the packets, for the parts serialized on their own
+static void initPartStream(QDataStream &ds)
+{
+    ds.setVersion(QtRemoteObjects::dataStreamVersion);
+    ds.setByteOrder(QDataStream::LittleEndian);
+}
+
+void QDataStreamCodec::serializeInitParts(const QRemoteObjectRootSource *source,
+                                          QByteArray *definition, QByteArray *properties)
+{
+    if (definition) {
+        QDataStream ds(definition, QIODevice::WriteOnly);
+        initPartStream(ds);
+        serializeDefinition(ds, source);
+    }
+    QDataStream ds(properties, QIODevice::WriteOnly);
+    initPartStream(ds);
+    const int numProperties = source->m_api->propertyCount();
+    ds << quint32(numProperties);
+    for (int internalIndex = 0; internalIndex < numProperties; ++internalIndex)
+        serializeProperty(ds, source, internalIndex);
+}
+
+void QDataStreamCodec::serializeInitPacket(const QRemoteObjectRootSource *source,
+                                           const QByteArray &properties)
+{
+    m_packet.setId(InitPacket);
+    m_packet << source->name();
+    m_packet.writeRawData(properties.constData(), int(properties.size()));
+    m_packet.finishPacket();
+}
+
+void QDataStreamCodec::serializeInitDynamicPacket(const QRemoteObjectRootSource *source,
+                                                  const QByteArray &definition,
+                                                  const QByteArray &properties)
+{
+    m_packet.setId(InitDynamicPacket);
+    m_packet << source->name();
+    m_packet.writeRawData(definition.constData(), int(definition.size()));
+    m_packet.writeRawData(properties.constData(), int(properties.size()));
+    m_packet.finishPacket();
+}
+
 static ObjectType getObjectType(const QString &typeName)
 {
     if (typeName == QLatin1String("QAbstractItemModelAdapter"))
@@ -673,9 +800,10 @@ void QDataStreamCodec::serializeDefinition(QDataStream &ds, const QRemoteObjectS
         const int count = api->signalParameterCount(i);
         for (int pi = 0; pi < count; ++pi) {
             const auto metaType = QMetaType(api->signalParameterType(i, pi));
-            if (isSequentialGadgetType(metaType))
+            const auto kind = codecPlan(metaType).kind;
+            if (kind == CodecPlan::Sequential)
                 signature.replace(metaType.name(), "QtROSequentialContainer");
-            else if (isAssociativeGadgetType(metaType))
+            else if (kind == CodecPlan::Associative)
                 signature.replace(metaType.name(), "QtROAssociativeContainer");
         }
 #ifdef QTRO_VERBOSE_PROTOCOL
@@ -695,9 +823,10 @@ void QDataStreamCodec::serializeDefinition(QDataStream &ds, const QRemoteObjectS
         const int count = api->methodParameterCount(i);
         for (int pi = 0; pi < count; ++pi) {
             const auto metaType = QMetaType(api->methodParameterType(i, pi));
-            if (isSequentialGadgetType(metaType))
+            const auto kind = codecPlan(metaType).kind;
+            if (kind == CodecPlan::Sequential)
                 signature.replace(metaType.name(), "QtROSequentialContainer");
-            else if (isAssociativeGadgetType(metaType))
+            else if (kind == CodecPlan::Associative)
                 signature.replace(metaType.name(), "QtROAssociativeContainer");
         }
         auto typeName = api->typeName(i);
@@ -729,12 +858,13 @@ void QDataStreamCodec::serializeDefinition(QDataStream &ds, const QRemoteObjectS
             qDebug() << "    Type:" << (objectType == ObjectType::CLASS ? "QObject*" : "QAbstractItemModel*");
 #endif
         } else {
-            if (isSequentialGadgetType(metaProperty.metaType())) {
+            const auto kind = codecPlan(metaProperty.metaType()).kind;
+            if (kind == CodecPlan::Sequential) {
                 ds << "QtROSequentialContainer";
 #ifdef QTRO_VERBOSE_PROTOCOL
                 qDebug() << "    Type:" << "QtROSequentialContainer";
 #endif
-            } else if (isAssociativeGadgetType(metaProperty.metaType())) {
+            } else if (kind == CodecPlan::Associative) {
                 ds << "QtROAssociativeContainer";
 #ifdef QTRO_VERBOSE_PROTOCOL
                 qDebug() << "    Type:" << "QtROAssociativeContainer";
@@ -762,17 +892,118 @@ void QDataStreamCodec::serializeDefinition(QDataStream &ds, const QRemoteObjectS
     }
 }
 
-void QDataStreamCodec::serializeAddObjectPacket(const QString &name, bool isDynamic)
+void QDataStreamCodec::serializeAddObjectPacket(const QString &name, bool isDynamic,
+                                                int updateInterval, const PropertyVersion &since,
+                                                const QByteArray &cachedSignature)
 {
     m_packet.setId(AddObject);
     m_packet << name;
     m_packet << isDynamic;
+    // Optional, older sources would misread the next packet. The version is only known
+    // from sources that understand it.
+    if (updateInterval > 0 || since.epoch != 0 || !cachedSignature.isEmpty())
+        m_packet << qint32(updateInterval);
+    if (since.epoch != 0 || !cachedSignature.isEmpty())
+        m_packet << since.epoch << since.version;
+    if (!cachedSignature.isEmpty())
+        m_packet << cachedSignature;
     m_packet.finishPacket();
 }
 
-void QDataStreamCodec::deserializeAddObjectPacket(QDataStream &ds, bool &isDynamic)
+void QDataStreamCodec::deserializeAddObjectPacket(QDataStream &ds, bool &isDynamic,
+                                                  int &updateInterval, PropertyVersion &since,
+                                                  QByteArray &cachedSignature)
 {
     ds >> isDynamic;
+    qint32 interval = 0;
+    if (!ds.atEnd())
+        ds >> interval;
+    updateInterval = interval;
+    since = PropertyVersion();
+    if (!ds.atEnd())
+        ds >> since.epoch >> since.version;
+    cachedSignature.clear();
+    if (!ds.atEnd())
+        ds >> cachedSignature;
+    if (ds.status() != QDataStream::Ok) {
+        since = PropertyVersion();
+        cachedSignature.clear();
+    }
+}
+
+void QDataStreamCodec::serializeSubscribePacket(const QString &name, const QBitArray &signalMask)
+{
+    m_packet.setId(Subscribe);
+    m_packet << name;
+    m_packet << signalMask;
+    m_packet.finishPacket();
+}
+
+void QDataStreamCodec::deserializeSubscribePacket(QDataStream &ds, QBitArray &signalMask)
+{
+    ds >> signalMask;
+}
+
+void QDataStreamCodec::serializeDatagramChannelPacket(const QString &name,
+                                                      const DatagramChannelInfo &info)
+{
+    m_packet.setId(DatagramChannel);
+    m_packet << name;
+    m_packet << info.address << info.token << info.sequence << info.properties << info.values;
+    m_packet.finishPacket();
+}
+
+void QDataStreamCodec::deserializeDatagramChannelPacket(QDataStream &ds, DatagramChannelInfo &info)
+{
+    ds >> info.address >> info.token >> info.sequence >> info.properties >> info.values;
+}
+
+void QDataStreamCodec::serializeDatagramResyncPacket(const QString &name, bool joined)
+{
+    m_packet.setId(DatagramResync);
+    m_packet << name;
+    m_packet << joined;
+    m_packet.finishPacket();
+}
+
+void QDataStreamCodec::deserializeDatagramResyncPacket(QDataStream &ds, bool &joined)
+{
+    ds >> joined;
+}
+
+void QDataStreamCodec::serializeResyncPacket(const QRemoteObjectRootSource *source,
+                                             const PropertyVersion &version,
+                                             const QList<int> &properties)
+{
+    m_packet.setId(ResyncPacket);
+    m_packet << source->name();
+    m_packet << version.epoch << version.version;
+    m_packet << quint32(properties.size());
+    for (int internalIndex : properties) {
+        m_packet << qint32(internalIndex);
+        serializeProperty(source, internalIndex);
+    }
+    m_packet.finishPacket();
+}
+
+void QDataStreamCodec::deserializeResyncPacket(QDataStream &ds, PropertyVersion &version,
+                                               QList<int> &properties, QVariantList &values)
+{
+    properties.clear();
+    values.clear();
+    quint32 count = 0;
+    ds >> version.epoch >> version.version >> count;
+    for (quint32 i = 0; i < count && !ds.atEnd(); ++i) {
+        qint32 internalIndex;
+        ds >> internalIndex;
+        properties << internalIndex;
+        ds >> values.emplace_back();
+    }
+    if (ds.status() != QDataStream::Ok || properties.size() != qsizetype(count)) {
+        version = PropertyVersion();
+        properties.clear();
+        values.clear();
+    }
 }
 
 void QDataStreamCodec::serializeRemoveObjectPacket(const QString &name)
@@ -866,141 +1097,1343 @@ void QDataStreamCodec::serializePongPacket(const QString &name)
     m_packet.finishPacket();
 }
 
-QRO_::QRO_(QRemoteObjectSourceBase *source)
-    : name(source->name())
-    , typeName(source->m_api->typeName())
-    , type(source->m_adapter ? ObjectType::MODEL : getObjectType(typeName))
-    , isNull(source->m_object == nullptr)
-    , classDefinition()
-    , parameters()
-{}
+// Type tags of the compact value encoding. Values of other types are sent as a
+// QVariant (Variant tag), just like QDataStreamCodec does.
+enum class CompactTag : quint8
+{
+    Invalid,
+    False,
+    True,
+    Int8,
+    UInt8,
+    Int16,
+    UInt16,
+    Int32,
+    UInt32,
+    Int64,
+    UInt64,
+    Float,
+    Double,
+    String,
+    ByteArray,
+    Blob,                // ByteArray sent out of band, see CompactPacket::writeBlob()
+    Map = 0xfb,          // QAS_, with CompactTypeTable references instead of the type names
+    Sequence = 0xfc,     // QSQ_, likewise
+    TypedVariant = 0xfd, // Custom type, CompactTypeTable reference and the value
+    GadgetDelta = 0xfe,
+    Variant = 0xff
+};
+
+// Type name references are a varint, 0 for a name sent without id, otherwise
+// (id << 1 | 1) + 1 if the name follows (announcement) and (id << 1) + 1 if not.
+static constexpr int CompactMaxTypeId = 0xffff;
+
+namespace {
+struct CompactTypeIds
+{
+    QReadWriteLock lock;
+    QHash<QByteArray, int> ids;
+};
+}
 
-QRO_::QRO_(const QVariant &value)
-    : type(ObjectType::GADGET)
-    , isNull(false)
+Q_GLOBAL_STATIC(CompactTypeIds, compactTypeIds)
+
+// The ids are shared by all connections, so that a packet serialized once for several
+// connections refers to a type by the same id on all of them. Returns -1 once all ids
+// are taken.
+static int compactTypeId(const QByteArray &name)
 {
-    const auto metaType = value.metaType();
-    auto meta = metaType.metaObject();
-    QDataStream out(&classDefinition, QIODevice::WriteOnly);
-    const int numProperties = meta->propertyCount();
-    const auto name = metaType.name();
-    const auto typeName = QByteArray::fromRawData(name, qsizetype(qstrlen(name)));
-    out << quint32(0) << quint32(1);
-    out << typeName;
-    out << numProperties;
-#ifdef QTRO_VERBOSE_PROTOCOL
-    qDebug("Serializing POD definition to QRO_ (name = %s)", typeName.constData());
-#endif
-    for (int i = 0; i < numProperties; ++i) {
-        const auto property = meta->property(i);
-#ifdef QTRO_VERBOSE_PROTOCOL
-        qDebug("  Data member %d (name = %s, type = %s):", i, property.name(), property.typeName());
-#endif
-        out << QByteArray::fromRawData(property.name(), qsizetype(qstrlen(property.name())));
-        out << QByteArray::fromRawData(property.typeName(), qsizetype(qstrlen(property.typeName())));
+    CompactTypeIds *typeIds = compactTypeIds();
+    {
+        QReadLocker locker(&typeIds->lock);
+        const auto it = typeIds->ids.constFind(name);
+        if (it != typeIds->ids.cend())
+            return *it;
     }
-    int enumCount = meta->enumeratorCount() - meta->enumeratorOffset();
-    out << quint32(enumCount);
-    for (int j = meta->enumeratorOffset(); j < meta->enumeratorCount(); j++) {
-        auto const enumMeta = meta->enumerator(j);
-        serializeEnum(out, enumMeta);
+    QWriteLocker locker(&typeIds->lock);
+    auto it = typeIds->ids.find(name);
+    if (it == typeIds->ids.end()) {
+        const int id = int(typeIds->ids.size());
+        if (id > CompactMaxTypeId)
+            return -1;
+        // name may be raw data, e.g. a QMetaType name
+        it = typeIds->ids.insert(QByteArray(name.constData(), name.size()), id);
     }
-    QDataStream ds(&parameters, QIODevice::WriteOnly);
-    ds << value;
-#ifdef QTRO_VERBOSE_PROTOCOL
-    qDebug() << "  Value:" << value;
-#endif
+    return *it;
 }
 
-QDataStream &operator<<(QDataStream &stream, const QRO_ &info)
+static void writeCompactName(QDataStream &ds, const QByteArray &name)
 {
-    stream << info.name << info.typeName << quint8(info.type) << info.classDefinition << info.isNull;
-    qCDebug(QT_REMOTEOBJECT) << "Serializing " << info;
-    // info.parameters will be filled in by serializeProperty
-    return stream;
+    writeVarint(ds, quint64(name.size()));
+    ds.writeRawData(name.constData(), int(name.size()));
 }
 
-QDataStream &operator>>(QDataStream &stream, QRO_ &info)
+static bool readCompactName(QDataStream &ds, QByteArray &name)
 {
-    quint8 tmpType;
-    stream >> info.name >> info.typeName >> tmpType >> info.classDefinition >> info.isNull;
-    info.type = static_cast<ObjectType>(tmpType);
-    qCDebug(QT_REMOTEOBJECT) << "Deserializing " << info;
-    if (!info.isNull)
-        stream >> info.parameters;
-    return stream;
+    quint64 size;
+    if (!readVarint(ds, size))
+        return false;
+    if (size > quint64(std::numeric_limits<int>::max())) {
+        ds.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    name = QByteArray("", 0);
+    name.resize(qsizetype(size));
+    if (ds.readRawData(name.data(), int(size)) != int(size)) {
+        ds.setStatus(QDataStream::ReadPastEnd);
+        return false;
+    }
+    return true;
 }
 
-QSQ_::QSQ_(const QVariant &variant)
+void CompactTypeTable::writeReference(QDataStream &ds, const QByteArray &name)
 {
-    QSequentialIterable sequence;
-    QMetaType valueType;
-    if (variant.metaType() == QMetaType::fromType<QtROSequentialContainer>()) {
-        auto container = static_cast<const QtROSequentialContainer *>(variant.constData());
-        typeName = container->m_typeName;
-        valueType = container->m_valueType;
-        valueTypeName = container->m_valueTypeName;
-        sequence = QSequentialIterable(reinterpret_cast<const QVariantList *>(variant.constData()));
-    } else {
-        sequence = variant.value<QSequentialIterable>();
-        typeName = QByteArray(variant.metaType().name());
-        valueType = sequence.metaContainer().valueMetaType();
-        valueTypeName = QByteArray(valueType.name());
+    const int id = compactTypeId(name);
+    if (id < 0) {
+        writeVarint(ds, 0);
+        writeCompactName(ds, name);
+        return;
     }
-#ifdef QTRO_VERBOSE_PROTOCOL
-    qDebug("Serializing POD sequence to QSQ_ (type = %s, valueType = %s) with size = %lld",
-           typeName.constData(), valueTypeName.constData(), sequence.size());
-#endif
-    QDataStream ds(&values, QIODevice::WriteOnly);
-    ds << valueTypeName;
-    auto pos = ds.device()->pos();
-    ds << quint32(sequence.size());
-    for (const auto &v : sequence) {
-        if (!valueType.save(ds, v.data())) {
-            ds.device()->seek(pos);
-            ds.resetStatus();
-            ds << quint32(0);
-            values.resize(ds.device()->pos());
-            qWarning("QSQ_: unable to save type '%s', sending empty list.", valueType.name());
-            break;
-        }
+    // Announce the name until every connection the packet is sent to has seen it. An
+    // earlier packet of the same payload announces it to all of them.
+    const bool announced = m_pending.contains(id)
+            || (isAnnounced(id)
+                && std::all_of(m_peers.cbegin(), m_peers.cend(), [id](CompactTypeTable *peer) {
+                       return peer->isAnnounced(id);
+                   }));
+    writeVarint(ds, ((quint64(id) << 1) | (announced ? 0 : 1)) + 1);
+    if (!announced) {
+        m_pending.append(id);
+        ++m_announcements;
+        writeCompactName(ds, name);
     }
 }
 
-QDataStream &operator<<(QDataStream &stream, const QSQ_ &sequence)
+bool CompactTypeTable::readReference(QDataStream &ds, ReceivedType &type)
 {
-    stream << sequence.typeName << sequence.valueTypeName << sequence.values;
-    qCDebug(QT_REMOTEOBJECT) << "Serializing " << sequence;
-    return stream;
+    quint64 value;
+    if (!readVarint(ds, value))
+        return false;
+    if (value == 0) {
+        if (!readCompactName(ds, type.name))
+            return false;
+        type.metaType = QMetaType::fromName(type.name);
+        return true;
+    }
+    const quint64 id = (value - 1) >> 1;
+    if (id > quint64(CompactMaxTypeId)) {
+        ds.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    const qsizetype index = qsizetype(id);
+    if ((value - 1) & 1) {
+        if (index >= m_received.size())
+            m_received.resize(index + 1);
+        ReceivedType &received = m_received[index];
+        if (!readCompactName(ds, received.name))
+            return false;
+        received.metaType = QMetaType::fromName(received.name);
+    } else if (index >= m_received.size() || m_received.at(index).name.isNull()) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Received reference to unknown type" << id;
+        ds.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    ReceivedType &received = m_received[index];
+    // Dynamic replicas register their types once the definition has been received
+    if (!received.metaType.isValid())
+        received.metaType = QMetaType::fromName(received.name);
+    type = received;
+    return true;
 }
 
-QDataStream &operator>>(QDataStream &stream, QSQ_ &sequence)
+// The packet being serialized by a codec sending blobs, see CompactPacket::writeBlob()
+static thread_local CompactPacket *t_compactBlobPacket = nullptr;
+
+static bool writeCompactBlob(QDataStream &ds, const QByteArray &array)
 {
-    stream >> sequence.typeName >> sequence.valueTypeName >> sequence.values;
-    qCDebug(QT_REMOTEOBJECT) << "Deserializing " << sequence;
-    return stream;
+    CompactPacket *packet = t_compactBlobPacket;
+    return packet == &ds && packet->writeBlob(array);
 }
 
-QAS_::QAS_(const QVariant &variant)
+// Arrays from this size on share the received frame instead of being copied, see
+// readCompactByteArray(). They are followed by a '\0', which terminates the slice.
+static constexpr qsizetype CompactSharedSliceSize = 4096;
+
+// Writes the types the compact format encodes natively, returns false for all others
+static bool writeCompactScalar(QDataStream &ds, const void *data, QMetaType type)
 {
-    QAssociativeIterable map;
-    QMetaType keyType, transferType, valueType;
-    const QtROAssociativeContainer *container = nullptr;
-    if (variant.metaType() == QMetaType::fromType<QtROAssociativeContainer>()) {
-        container = static_cast<const QtROAssociativeContainer *>(variant.constData());
-        typeName = container->m_typeName;
-        keyType = container->m_keyType;
-        keyTypeName = container->m_keyTypeName;
-        valueType = container->m_valueType;
-        valueTypeName = container->m_valueTypeName;
-        map = QAssociativeIterable(reinterpret_cast<const QVariantMap *>(variant.constData()));
-    } else {
-        map = variant.value<QAssociativeIterable>();
-        typeName = QByteArray(variant.metaType().name());
-        keyType = map.metaContainer().keyMetaType();
-        keyTypeName = QByteArray(keyType.name());
-        valueType = map.metaContainer().mappedMetaType();
-        valueTypeName = QByteArray(valueType.name());
+    auto writeSigned = [&ds](CompactTag tag, qint64 v) {
+        ds << quint8(tag);
+        writeVarint(ds, zigZagEncode(v));
+    };
+    auto writeUnsigned = [&ds](CompactTag tag, quint64 v) {
+        ds << quint8(tag);
+        writeVarint(ds, v);
+    };
+
+    switch (type.id()) {
+    case QMetaType::UnknownType:
+        ds << quint8(CompactTag::Invalid);
+        return true;
+    case QMetaType::Bool:
+        ds << quint8(*static_cast<const bool *>(data) ? CompactTag::True : CompactTag::False);
+        return true;
+    case QMetaType::SChar:
+        writeSigned(CompactTag::Int8, *static_cast<const qint8 *>(data));
+        return true;
+    case QMetaType::UChar:
+        writeUnsigned(CompactTag::UInt8, *static_cast<const quint8 *>(data));
+        return true;
+    case QMetaType::Short:
+        writeSigned(CompactTag::Int16, *static_cast<const qint16 *>(data));
+        return true;
+    case QMetaType::UShort:
+        writeUnsigned(CompactTag::UInt16, *static_cast<const quint16 *>(data));
+        return true;
+    case QMetaType::Int:
+        writeSigned(CompactTag::Int32, *static_cast<const qint32 *>(data));
+        return true;
+    case QMetaType::UInt:
+        writeUnsigned(CompactTag::UInt32, *static_cast<const quint32 *>(data));
+        return true;
+    case QMetaType::LongLong:
+        writeSigned(CompactTag::Int64, *static_cast<const qint64 *>(data));
+        return true;
+    case QMetaType::ULongLong:
+        writeUnsigned(CompactTag::UInt64, *static_cast<const quint64 *>(data));
+        return true;
+    case QMetaType::Float: {
+        quint32 bits;
+        memcpy(&bits, data, sizeof(bits));
+        ds << quint8(CompactTag::Float) << bits;
+        return true;
+    }
+    case QMetaType::Double: {
+        quint64 bits;
+        memcpy(&bits, data, sizeof(bits));
+        ds << quint8(CompactTag::Double) << bits;
+        return true;
+    }
+    case QMetaType::QString: {
+        const auto &string = *static_cast<const QString *>(data);
+        if (string.isNull()) // Preserve null-ness, QDataStream does
+            return false;
+        ds << quint8(CompactTag::String);
+        writeCompactString(ds, string);
+        return true;
+    }
+    case QMetaType::QByteArray: {
+        const auto &array = *static_cast<const QByteArray *>(data);
+        if (array.isNull())
+            return false;
+        if (writeCompactBlob(ds, array))
+            return true;
+        ds << quint8(CompactTag::ByteArray);
+        writeVarint(ds, quint64(array.size()));
+        ds.writeRawData(array.constData(), int(array.size()));
+        if (array.size() >= CompactSharedSliceSize)
+            ds << quint8(0);
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+// Writes QSQ_/QAS_ values without the type names they start with
+static void writeCompactContainerValues(QDataStream &ds, const QByteArray &values,
+                                        qsizetype namesSize)
+{
+    writeVarint(ds, quint64(values.size() - namesSize));
+    ds.writeRawData(values.constData() + namesSize, int(values.size() - namesSize));
+}
+
+// Values of custom types that are sent as is, with their type name replaced by a reference
+// into types
+static bool writeCompactTyped(QDataStream &ds, const void *data, QMetaType metaType,
+                              CompactTypeTable &types)
+{
+    if (metaType.id() < QMetaType::User || !metaType.hasRegisteredDataStreamOperators())
+        return false;
+    ds << quint8(CompactTag::TypedVariant);
+    const char *name = metaType.name();
+    types.writeReference(ds, QByteArray::fromRawData(name, qstrlen(name)));
+    if (!metaType.save(ds, data)) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Unable to save value of type" << name;
+        ds.setStatus(QDataStream::WriteFailed);
+    }
+    return true;
+}
+
+// Values of custom types, with their type names replaced by references into types
+static bool writeCompactTyped(QDataStream &ds, const QVariant &value, CompactTypeTable &types)
+{
+    const QMetaType metaType = value.metaType();
+    if (metaType.id() < QMetaType::User)
+        return false;
+    // A serialized QByteArray is its quint32 size followed by the data
+    constexpr qsizetype sizeSize = sizeof(quint32);
+    if (metaType == QMetaType::fromType<QSQ_>()) {
+        const auto *sequence = static_cast<const QSQ_ *>(value.constData());
+        const qsizetype namesSize = sizeSize + sequence->valueTypeName.size();
+        if (sequence->values.size() < namesSize)
+            return false;
+        ds << quint8(CompactTag::Sequence);
+        types.writeReference(ds, sequence->typeName);
+        types.writeReference(ds, sequence->valueTypeName);
+        writeCompactContainerValues(ds, sequence->values, namesSize);
+        return true;
+    }
+    if (metaType == QMetaType::fromType<QAS_>()) {
+        const auto *map = static_cast<const QAS_ *>(value.constData());
+        const qsizetype namesSize = 2 * sizeSize + map->keyTypeName.size() + map->valueTypeName.size();
+        if (map->values.size() < namesSize)
+            return false;
+        ds << quint8(CompactTag::Map);
+        types.writeReference(ds, map->typeName);
+        types.writeReference(ds, map->keyTypeName);
+        types.writeReference(ds, map->valueTypeName);
+        writeCompactContainerValues(ds, map->values, namesSize);
+        return true;
+    }
+    return writeCompactTyped(ds, value.constData(), metaType, types);
+}
+
+static void writeCompactValue(QDataStream &ds, const QVariant &value, CompactTypeTable *types)
+{
+    if (writeCompactScalar(ds, value.constData(), value.metaType()))
+        return;
+    if (!types || !writeCompactTyped(ds, value, *types))
+        ds << quint8(CompactTag::Variant) << value;
+}
+
+// Same encoding as writeCompactValue(ds, encodeVariant(QVariant(type, data))), without
+// creating the QVariant for the natively encoded types, enums and custom types sent as is.
+// Containers and builtin types without a compact encoding still go through QVariant.
+static void writeCompactValue(QDataStream &ds, const void *data, QMetaType type,
+                              CompactTypeTable *types)
+{
+    if (type == QMetaType::fromType<QVariant>()) {
+        writeCompactValue(ds, encodeVariant(*static_cast<const QVariant *>(data)), types);
+        return;
+    }
+    if (writeCompactScalar(ds, data, type))
+        return;
+    const CodecPlan plan = codecPlan(type);
+    // The transfer type has the size of the enum, encodeVariant() converts to the same value
+    if (plan.kind == CodecPlan::Enum && writeCompactScalar(ds, data, plan.transferType))
+        return;
+    if (plan.kind == CodecPlan::Plain && types && writeCompactTyped(ds, data, type, *types))
+        return;
+    writeCompactValue(ds, encodeVariant(QVariant(type, data), plan), types);
+}
+
+static void writeCompactValue(QDataStream &ds, const void *data, const CodecPlan &plan,
+                              CompactTypeTable *types)
+{
+    if (plan.kind == CodecPlan::Dynamic)
+        writeCompactValue(ds, encodeVariant(*static_cast<const QVariant *>(data)), types);
+    else if (!writeCompactScalar(ds, data, plan.type))
+        writeCompactValue(ds, encodeVariant(QVariant(plan.type, data), plan), types);
+}
+
+// Type table of the packet repc generated code is currently writing to or reading from, see
+// QCompactCodec::serializeProperty(), QCompactCodec::deserializePropertyChangePacket() and
+// the QtPrivate::qtro_*_compact_value() functions
+struct CompactTypeContext
+{
+    const QDataStream *stream = nullptr;
+    CompactTypeTable *types = nullptr;
+};
+static thread_local CompactTypeContext t_compactWriteContext;
+static thread_local CompactTypeContext t_compactTypedReadContext;
+
+static QByteArray readCompactByteArray(QDataStream &ds, qsizetype size)
+{
+    if (size < CompactSharedSliceSize) {
+        QByteArray array(size, Qt::Uninitialized);
+        if (ds.readRawData(array.data(), int(size)) != int(size))
+            ds.setStatus(QDataStream::ReadPastEnd);
+        return array;
+    }
+
+    // Large arrays share the frame, the slice holds a reference to it like a copy of the
+    // frame would. The frame is therefore not reused for the next packet while the slice (or
+    // a copy of it) is alive, see QtROIoDeviceBasePrivate::startFrame(). The '\0' the sender
+    // wrote after the data terminates the slice, as any QByteArray is.
+    if (const QByteArrayView view = readFrameView(ds, size + 1); !view.isNull()) {
+        if (view.back() != '\0') {
+            ds.setStatus(QDataStream::ReadCorruptData);
+            return QByteArray();
+        }
+        const QByteArray &frame = static_cast<QBuffer *>(ds.device())->data();
+        QByteArray::DataPointer slice = frame.data_ptr();
+        slice.setBegin(const_cast<char *>(view.data()));
+        slice.size = size;
+        return QByteArray(std::move(slice));
+    }
+    QByteArray array(size, Qt::Uninitialized);
+    if (ds.readRawData(array.data(), int(size)) != int(size)) {
+        ds.setStatus(QDataStream::ReadPastEnd);
+        return array;
+    }
+    quint8 terminator;
+    ds >> terminator;
+    if (ds.status() == QDataStream::Ok && terminator != 0)
+        ds.setStatus(QDataStream::ReadCorruptData);
+    return array;
+}
+
+// The channel the blobs of the packet being decoded are taken from, see setBlobChannel()
+struct CompactReadContext
+{
+    const QIODevice *frame = nullptr;
+    BlobChannel *channel = nullptr;
+};
+static thread_local CompactReadContext t_compactReadContext;
+
+void setBlobChannel(const QIODevice *frame, BlobChannel *channel)
+{
+    t_compactReadContext = { frame, channel };
+}
+
+void releaseBlobChannel(const QIODevice *frame)
+{
+    if (t_compactReadContext.frame == frame)
+        t_compactReadContext = {};
+}
+
+static QByteArray readCompactBlob(QDataStream &ds, quint64 id, qsizetype size)
+{
+    const CompactReadContext &context = t_compactReadContext;
+    QByteArray array;
+    if (context.channel && context.frame == ds.device())
+        array = context.channel->takeBlob(id, size);
+    if (array.isNull()) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Unable to take blob" << id << "of" << size << "bytes";
+        ds.setStatus(QDataStream::ReadCorruptData);
+    }
+    return array;
+}
+
+// Rebuilds the values of a QSQ_/QAS_, which start with the type names sent as references
+static bool readCompactContainerValues(QDataStream &ds, std::initializer_list<QByteArray> names,
+                                       QByteArray &values)
+{
+    quint64 size;
+    if (!readVarint(ds, size))
+        return false;
+    if (size > quint64(std::numeric_limits<int>::max())) {
+        ds.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    {
+        QDataStream out(&values, QIODevice::WriteOnly);
+        for (const QByteArray &name : names)
+            out << name;
+    }
+    const qsizetype namesSize = values.size();
+    values.resize(namesSize + qsizetype(size));
+    if (ds.readRawData(values.data() + namesSize, int(size)) != int(size)) {
+        ds.setStatus(QDataStream::ReadPastEnd);
+        return false;
+    }
+    return true;
+}
+
+static bool readCompactReference(QDataStream &ds, CompactTypeTable *types,
+                                 CompactTypeTable::ReceivedType &type)
+{
+    if (types && types->readReference(ds, type))
+        return true;
+    if (ds.status() == QDataStream::Ok)
+        ds.setStatus(QDataStream::ReadCorruptData);
+    return false;
+}
+
+static bool readCompactValue(QDataStream &ds, QVariant &value, CompactTypeTable *types)
+{
+    quint8 tag;
+    quint64 v = 0;
+    ds >> tag;
+    auto readSigned = [&ds, &v]() { return readVarint(ds, v) ? zigZagDecode(v) : 0; };
+    auto readUnsigned = [&ds, &v]() { return readVarint(ds, v) ? v : 0; };
+    auto readReference = [&ds, types](CompactTypeTable::ReceivedType &type) {
+        return readCompactReference(ds, types, type);
+    };
+
+    switch (CompactTag(tag)) {
+    case CompactTag::Invalid: value = QVariant(); break;
+    case CompactTag::False: value = QVariant(false); break;
+    case CompactTag::True: value = QVariant(true); break;
+    case CompactTag::Int8: value = QVariant::fromValue(qint8(readSigned())); break;
+    case CompactTag::UInt8: value = QVariant::fromValue(quint8(readUnsigned())); break;
+    case CompactTag::Int16: value = QVariant::fromValue(qint16(readSigned())); break;
+    case CompactTag::UInt16: value = QVariant::fromValue(quint16(readUnsigned())); break;
+    case CompactTag::Int32: value = QVariant::fromValue(qint32(readSigned())); break;
+    case CompactTag::UInt32: value = QVariant::fromValue(quint32(readUnsigned())); break;
+    case CompactTag::Int64: value = QVariant::fromValue(qint64(readSigned())); break;
+    case CompactTag::UInt64: value = QVariant::fromValue(quint64(readUnsigned())); break;
+    case CompactTag::Float: {
+        quint32 bits;
+        ds >> bits;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        value = QVariant(f);
+        break;
+    }
+    case CompactTag::Double: {
+        quint64 bits;
+        ds >> bits;
+        double d;
+        memcpy(&d, &bits, sizeof(d));
+        value = QVariant(d);
+        break;
+    }
+    case CompactTag::String:
+        value = QVariant(readCompactString(ds));
+        break;
+    case CompactTag::ByteArray: {
+        const quint64 size = readUnsigned();
+        if (size > quint64(std::numeric_limits<int>::max())) {
+            ds.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        value = QVariant(readCompactByteArray(ds, qsizetype(size)));
+        break;
+    }
+    case CompactTag::Blob: {
+        // <varint size><varint id>, the data was passed out of band
+        const quint64 size = readUnsigned();
+        const quint64 id = readUnsigned();
+        if (ds.status() != QDataStream::Ok)
+            return false;
+        if (size > quint64(std::numeric_limits<int>::max())) {
+            ds.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        value = QVariant(readCompactBlob(ds, id, qsizetype(size)));
+        break;
+    }
+    case CompactTag::GadgetDelta: {
+        const quint64 count = readUnsigned();
+        if (count > quint64(std::numeric_limits<int>::max())) {
+            ds.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        GadgetDelta delta;
+        for (quint64 i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+            QVariant field;
+            delta.indices.append(int(readUnsigned()));
+            if (!readCompactValue(ds, field, types))
+                return false;
+            delta.values.append(std::move(field));
+        }
+        value = QVariant::fromValue(std::move(delta));
+        break;
+    }
+    case CompactTag::TypedVariant: {
+        CompactTypeTable::ReceivedType type;
+        if (!readReference(type))
+            return false;
+        if (!type.metaType.isValid()) {
+            qCWarning(QT_REMOTEOBJECT_IO) << "Received value of unknown type" << type.name;
+            ds.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        value = QVariant(type.metaType, nullptr);
+        if (!type.metaType.load(ds, value.data())) {
+            qCWarning(QT_REMOTEOBJECT_IO) << "Unable to load value of type" << type.name;
+            ds.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        break;
+    }
+    case CompactTag::Sequence: {
+        CompactTypeTable::ReceivedType type, valueType;
+        if (!readReference(type) || !readReference(valueType))
+            return false;
+        QSQ_ sequence;
+        sequence.typeName = type.name;
+        sequence.valueTypeName = valueType.name;
+        if (!readCompactContainerValues(ds, {valueType.name}, sequence.values))
+            return false;
+        value = QVariant::fromValue(std::move(sequence));
+        break;
+    }
+    case CompactTag::Map: {
+        CompactTypeTable::ReceivedType type, keyType, valueType;
+        if (!readReference(type) || !readReference(keyType) || !readReference(valueType))
+            return false;
+        QAS_ map;
+        map.typeName = type.name;
+        map.keyTypeName = keyType.name;
+        map.valueTypeName = valueType.name;
+        if (!readCompactContainerValues(ds, {keyType.name, valueType.name}, map.values))
+            return false;
+        value = QVariant::fromValue(std::move(map));
+        break;
+    }
+    case CompactTag::Variant:
+        ds >> value;
+        break;
+    default:
+        qCWarning(QT_REMOTEOBJECT_IO) << "Invalid compact type tag received" << tag;
+        ds.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    return ds.status() == QDataStream::Ok;
+}
+
+// Reads a natively encoded value of type into data, the counterpart of writeCompactScalar().
+// Returns false without reading anything when the next value is encoded differently.
+static bool readCompactScalar(QDataStream &ds, void *data, QMetaType type)
+{
+    char c;
+    if (!ds.device() || ds.device()->peek(&c, 1) != 1)
+        return false;
+    const CompactTag tag = CompactTag(quint8(c));
+    auto expect = [&ds, tag](CompactTag expected) {
+        if (tag != expected)
+            return false;
+        ds.skipRawData(1);
+        return true;
+    };
+    quint64 v = 0;
+    auto readSigned = [&ds, &v]() { return readVarint(ds, v) ? zigZagDecode(v) : 0; };
+    auto readUnsigned = [&ds, &v]() { return readVarint(ds, v) ? v : 0; };
+
+    switch (type.id()) {
+    case QMetaType::Bool:
+        if (tag != CompactTag::False && tag != CompactTag::True)
+            return false;
+        ds.skipRawData(1);
+        *static_cast<bool *>(data) = tag == CompactTag::True;
+        return true;
+    case QMetaType::SChar:
+        if (!expect(CompactTag::Int8))
+            return false;
+        *static_cast<qint8 *>(data) = qint8(readSigned());
+        return true;
+    case QMetaType::UChar:
+        if (!expect(CompactTag::UInt8))
+            return false;
+        *static_cast<quint8 *>(data) = quint8(readUnsigned());
+        return true;
+    case QMetaType::Short:
+        if (!expect(CompactTag::Int16))
+            return false;
+        *static_cast<qint16 *>(data) = qint16(readSigned());
+        return true;
+    case QMetaType::UShort:
+        if (!expect(CompactTag::UInt16))
+            return false;
+        *static_cast<quint16 *>(data) = quint16(readUnsigned());
+        return true;
+    case QMetaType::Int:
+        if (!expect(CompactTag::Int32))
+            return false;
+        *static_cast<qint32 *>(data) = qint32(readSigned());
+        return true;
+    case QMetaType::UInt:
+        if (!expect(CompactTag::UInt32))
+            return false;
+        *static_cast<quint32 *>(data) = quint32(readUnsigned());
+        return true;
+    case QMetaType::LongLong:
+        if (!expect(CompactTag::Int64))
+            return false;
+        *static_cast<qint64 *>(data) = readSigned();
+        return true;
+    case QMetaType::ULongLong:
+        if (!expect(CompactTag::UInt64))
+            return false;
+        *static_cast<quint64 *>(data) = readUnsigned();
+        return true;
+    case QMetaType::Float: {
+        if (!expect(CompactTag::Float))
+            return false;
+        quint32 bits;
+        ds >> bits;
+        memcpy(data, &bits, sizeof(bits));
+        return true;
+    }
+    case QMetaType::Double: {
+        if (!expect(CompactTag::Double))
+            return false;
+        quint64 bits;
+        ds >> bits;
+        memcpy(data, &bits, sizeof(bits));
+        return true;
+    }
+    case QMetaType::QString:
+        if (!expect(CompactTag::String))
+            return false;
+        *static_cast<QString *>(data) = readCompactString(ds);
+        return true;
+    case QMetaType::QByteArray: {
+        if (!expect(CompactTag::ByteArray))
+            return false;
+        const quint64 size = readUnsigned();
+        if (size > quint64(std::numeric_limits<int>::max()))
+            ds.setStatus(QDataStream::ReadCorruptData);
+        else
+            *static_cast<QByteArray *>(data) = readCompactByteArray(ds, qsizetype(size));
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+static bool readCompactVariantList(QDataStream &ds, QVariantList &l, CompactTypeTable *types)
+{
+    quint64 c;
+    if (!readVarint(ds, c) || c > quint64(std::numeric_limits<int>::max()))
+        return false;
+
+    const qsizetype count = static_cast<qsizetype>(c);
+    if (l.size() > count)
+        l.resize(count);
+    else
+        l.reserve(count);
+
+    for (qsizetype i = 0; i < l.size(); ++i) {
+        if (!readCompactValue(ds, l[i], types))
+            return false;
+    }
+    for (auto i = l.size(); i < count; ++i) {
+        if (!readCompactValue(ds, l.emplace_back(), types))
+            return false;
+    }
+    return true;
+}
+
+void QCompactCodec::setPeers(const QList<CodecBase *> &peers)
+{
+    QList<CompactTypeTable *> tables;
+    tables.reserve(peers.size());
+    for (CodecBase *peer : peers) {
+        if (peer != this && peer->wireFormat() == WireFormat::Compact)
+            tables << &static_cast<QCompactCodec *>(peer)->m_types;
+    }
+    m_types.setPeers(tables);
+}
+
+void QCompactCodec::startObjectPacket(QRemoteObjectPacketTypeEnum type, const QString &name)
+{
+    switch (m_handleMode) {
+    case HandleMode::Name:
+        m_compactPacket.setId(type);
+        writeCompactString(m_compactPacket, name);
+        break;
+    case HandleMode::Announce:
+        m_compactPacket.setId(type | CompactAnnounceHandleFlag);
+        writeCompactString(m_compactPacket, name);
+        writeVarint(m_compactPacket, quint64(m_handle));
+        if (!m_announcedHandles.contains(m_handle))
+            m_announcedHandles << m_handle;
+        break;
+    case HandleMode::Handle:
+        m_compactPacket.setId(type | CompactHandleFlag);
+        writeVarint(m_compactPacket, quint64(m_handle));
+        break;
+    }
+    m_compactPacket.setObject(name);
+}
+
+void QCompactCodec::serializeObjectListPacket(const ObjectInfoList &objects)
+{
+    m_compactPacket.setId(ObjectList);
+    m_compactPacket << objects;
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeInitPacket(const QRemoteObjectRootSource *source)
+{
+    startObjectPacket(InitPacket, source->name());
+    serializeProperties(source);
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeInitDynamicPacket(const QRemoteObjectRootSource *source)
+{
+    startObjectPacket(InitDynamicPacket, source->name());
+    serializeDefinition(m_compactPacket, source);
+    serializeProperties(source);
+    m_compactPacket.finishPacket();
+}
+
+// Written without type references and blobs, which depend on the connection
+void QCompactCodec::serializeInitParts(const QRemoteObjectRootSource *source,
+                                       QByteArray *definition, QByteArray *properties)
+{
+    if (definition) {
+        QDataStream ds(definition, QIODevice::WriteOnly);
+        initPartStream(ds);
+        serializeDefinition(ds, source);
+    }
+    QDataStream ds(properties, QIODevice::WriteOnly);
+    initPartStream(ds);
+    const int numProperties = source->m_api->propertyCount();
+    writeVarint(ds, quint64(numProperties));
+    for (int internalIndex = 0; internalIndex < numProperties; ++internalIndex)
+        serializeProperty(ds, source, internalIndex, nullptr);
+}
+
+void QCompactCodec::serializeInitPacket(const QRemoteObjectRootSource *source,
+                                        const QByteArray &properties)
+{
+    startObjectPacket(InitPacket, source->name());
+    m_compactPacket.writeRawData(properties.constData(), int(properties.size()));
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeInitDynamicPacket(const QRemoteObjectRootSource *source,
+                                               const QByteArray &definition,
+                                               const QByteArray &properties)
+{
+    startObjectPacket(InitDynamicPacket, source->name());
+    m_compactPacket.writeRawData(definition.constData(), int(definition.size()));
+    m_compactPacket.writeRawData(properties.constData(), int(properties.size()));
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeProperties(const QRemoteObjectSourceBase *source)
+{
+    const int numProperties = source->m_api->propertyCount();
+    writeVarint(m_compactPacket, quint64(numProperties));
+    for (int internalIndex = 0; internalIndex < numProperties; ++internalIndex)
+        serializeProperty(m_compactPacket, source, internalIndex);
+}
+
+void QCompactCodec::deserializeInitPacket(QDataStream &in, QVariantList &values)
+{
+    const bool success = readCompactVariantList(in, values, &m_types);
+    Q_ASSERT(success);
+    Q_UNUSED(success)
+}
+
+void QCompactCodec::serializeProperty(const QRemoteObjectSourceBase *source, int internalIndex)
+{
+    serializeProperty(m_compactPacket, source, internalIndex);
+}
+
+void QCompactCodec::serializeProperty(QDataStream &ds, const QRemoteObjectSourceBase *source, int internalIndex)
+{
+    serializeProperty(ds, source, internalIndex, &m_types);
+}
+
+void QCompactCodec::serializeProperty(QDataStream &ds, const QRemoteObjectSourceBase *source,
+                                      int internalIndex, CompactTypeTable *types)
+{
+    // repc generated sources write their values directly, unless a dynamic replica needs
+    // the type information that only the QVariant path below provides. The bytes are the
+    // same as the QVariant path writes, so dynamic and repc generated replicas (see
+    // deserializePropertyChangePacket()) read them without the two ends having to agree on it.
+    if (source->m_serializeCompactProperty && !source->d->isDynamic
+        && !source->m_api->isAdapterProperty(internalIndex)) {
+        const QScopedValueRollback<CompactTypeContext> context(t_compactWriteContext,
+                                                                { &ds, types });
+        if (source->m_serializeCompactProperty(ds, source->m_object, internalIndex))
+            return;
+    }
+    const int propertyIndex = source->m_api->sourcePropertyIndex(internalIndex);
+    Q_ASSERT (propertyIndex >= 0);
+    const auto target = source->m_api->isAdapterProperty(internalIndex) ? source->m_adapter : source->m_object;
+    const auto property = target->metaObject()->property(propertyIndex);
+    if (property.metaType().flags().testFlag(QMetaType::PointerToQObject)
+        || (source->d->isDynamic && property.userType() == QMetaType::QVariant)) {
+        // Child objects and gadgets the receiver might need to register first are
+        // sent as QRO_, with the nested values in the QDataStream encoding.
+        ds << quint8(CompactTag::Variant);
+        QDataStreamCodec::serializeProperty(ds, source, internalIndex);
+        return;
+    }
+    writeCompactValue(ds, encodeVariant(property.read(target), source->m_propertyPlans.at(internalIndex)),
+                      types);
+}
+
+void QCompactCodec::serializePropertyChangePacket(QRemoteObjectSourceBase *source, int signalIndex)
+{
+    int internalIndex = source->m_api->propertyRawIndexFromSignal(signalIndex);
+    startObjectPacket(PropertyChangePacket, source->name());
+    writeVarint(m_compactPacket, quint64(internalIndex));
+    if (!serializeGadgetDelta(source, internalIndex))
+        serializeProperty(m_compactPacket, source, internalIndex);
+    m_compactPacket.finishPacket();
+}
+
+bool QCompactCodec::serializeGadgetDelta(const QRemoteObjectSourceBase *source, int internalIndex)
+{
+    // Dynamic replicas register gadget types at runtime, send them the whole value
+    if (source->d->isDynamic || internalIndex >= source->m_sentValues.size())
+        return false;
+    const QVariant &previous = source->m_previousValue;
+    const QVariant &current = source->m_sentValues.at(internalIndex);
+    const QMetaType metaType = current.metaType();
+    const QMetaObject *meta = metaType.metaObject();
+    if (!meta || !metaType.flags().testFlag(QMetaType::IsGadget) || previous.metaType() != metaType)
+        return false;
+
+    const int count = meta->propertyCount();
+    QVarLengthArray<int, 16> changed;
+    QVarLengthArray<QVariant, 16> values;
+    for (int i = 0; i < count; ++i) {
+        const QMetaProperty property = meta->property(i);
+        QVariant value = property.readOnGadget(current.constData());
+        const QVariant old = property.readOnGadget(previous.constData());
+        if (value.metaType().isEqualityComparable() && value == old)
+            continue;
+        changed.append(i);
+        values.append(std::move(value));
+    }
+    // Nothing gained if every field changed (or no field seems to, e.g. NaN fields)
+    if (changed.isEmpty() || changed.size() == count)
+        return false;
+
+    m_compactPacket << quint8(CompactTag::GadgetDelta);
+    writeVarint(m_compactPacket, quint64(changed.size()));
+    for (qsizetype i = 0; i < changed.size(); ++i) {
+        writeVarint(m_compactPacket, quint64(changed.at(i)));
+        writeCompactValue(m_compactPacket, encodeVariant(values.at(i)), &m_types);
+    }
+    return true;
+}
+
+static void applyGadgetDelta(void *gadget, QMetaType type, GadgetDelta &&delta)
+{
+    const QMetaObject *meta = type.metaObject();
+    if (!meta || !type.flags().testFlag(QMetaType::IsGadget)) {
+        qCWarning(QT_REMOTEOBJECT) << "Received a field update for non-gadget value of type"
+                                   << type.name();
+        return;
+    }
+    for (qsizetype i = 0; i < delta.indices.size(); ++i) {
+        const QMetaProperty property = meta->property(delta.indices.at(i));
+        if (!property.isValid()) {
+            qCWarning(QT_REMOTEOBJECT) << "Received a field update for invalid field"
+                                       << delta.indices.at(i) << "of" << meta->className();
+            continue;
+        }
+        property.writeOnGadget(gadget,
+                               decodeVariant(std::move(delta.values[i]), property.metaType()));
+    }
+}
+
+QVariant applyGadgetDelta(QVariant value, GadgetDelta &&delta)
+{
+    const QMetaType type = value.metaType();
+    applyGadgetDelta(value.data(), type, std::move(delta));
+    return value;
+}
+
+void QCompactCodec::deserializePropertyChangePacket(QDataStream &in, int &index, QVariant &value)
+{
+    quint64 rxIndex;
+    readVarint(in, rxIndex);
+    index = int(rxIndex);
+    readCompactValue(in, value, &m_types);
+}
+
+bool QCompactCodec::deserializePropertyChangePacket(QDataStream &in, int &index, QVariant &value,
+                                                    CompactPropertyReader read,
+                                                    QVariantList &storage)
+{
+    quint64 rxIndex;
+    readVarint(in, rxIndex);
+    index = int(rxIndex);
+    if (rxIndex < quint64(storage.size())) {
+        const QScopedValueRollback<CompactTypeContext> context(t_compactTypedReadContext,
+                                                               { &in, &m_types });
+        if (read(in, storage[index], index))
+            return true;
+    }
+    readCompactValue(in, value, &m_types);
+    return false;
+}
+
+void QCompactCodec::serializePingPacket(const QString &name)
+{
+    startObjectPacket(Ping, name);
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializePongPacket(const QString &name)
+{
+    startObjectPacket(Pong, name);
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeInvokePacket(const QString &name, int call, int index, const QVariantList &args, int serialId, int propertyIndex)
+{
+    startObjectPacket(InvokePacket, name);
+    writeVarint(m_compactPacket, quint64(call));
+    writeVarint(m_compactPacket, quint64(index));
+
+    writeVarint(m_compactPacket, quint64(args.size()));
+    for (const auto &arg : args)
+        writeCompactValue(m_compactPacket, encodeVariant(arg), &m_types);
+
+    writeVarint(m_compactPacket, zigZagEncode(serialId));
+    writeVarint(m_compactPacket, zigZagEncode(propertyIndex));
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeSignalPacket(QRemoteObjectSourceBase *source, int call, int index, void **a, int propertyIndex)
+{
+    // Like source->marshalArgs(), but the arguments are written straight from the signal's
+    // argument array instead of being copied into a QVariantList first.
+    const SourceApiMap *api = source->m_api;
+    int count = api->signalParameterCount(index);
+    if (count == 1 && QMetaType(api->signalParameterType(index, 0)).flags().testFlag(QMetaType::PointerToQObject))
+        count = 0; // Pointers are handled by QRO_
+    // A property's notify signal is sent right after its PropertyChangePacket. If its only
+    // argument is the property value, the replica passes the value it just updated and we
+    // don't need to send a second copy.
+    if (propertyIndex >= 0 && count == 1 && !api->isAdapterProperty(propertyIndex)) {
+        const int sourceIndex = api->sourcePropertyIndex(propertyIndex);
+        const QMetaProperty property = source->m_object->metaObject()->property(sourceIndex);
+        if (property.metaType().id() == api->signalParameterType(index, 0))
+            count = 0;
+    }
+    startObjectPacket(InvokePacket, source->name());
+    writeVarint(m_compactPacket, quint64(call));
+    writeVarint(m_compactPacket, quint64(index));
+
+    writeVarint(m_compactPacket, quint64(std::max(count, 0)));
+    const CodecPlanList &plans = source->m_signalPlans.at(index);
+    for (int i = 0; i < count; ++i)
+        writeCompactValue(m_compactPacket, a[i + 1], plans.at(i), &m_types);
+
+    writeVarint(m_compactPacket, zigZagEncode(-1));
+    writeVarint(m_compactPacket, zigZagEncode(propertyIndex));
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::deserializeInvokePacket(QDataStream &in, int &call, int &index, QVariantList &args, int &serialId, int &propertyIndex)
+{
+    quint64 value;
+    readVarint(in, value);
+    call = int(value);
+    readVarint(in, value);
+    index = int(value);
+    const bool success = readCompactVariantList(in, args, &m_types);
+    Q_ASSERT(success);
+    Q_UNUSED(success)
+    readVarint(in, value);
+    serialId = int(zigZagDecode(value));
+    readVarint(in, value);
+    propertyIndex = int(zigZagDecode(value));
+}
+
+void QCompactCodec::serializeInvokeReplyPacket(const QString &name, int ackedSerialId, const QVariant &value)
+{
+    startObjectPacket(InvokeReplyPacket, name);
+    writeVarint(m_compactPacket, zigZagEncode(ackedSerialId));
+    writeCompactValue(m_compactPacket, value, &m_types);
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::deserializeInvokeReplyPacket(QDataStream &in, int &ackedSerialId, QVariant &value)
+{
+    quint64 rxSerialId;
+    readVarint(in, rxSerialId);
+    ackedSerialId = int(zigZagDecode(rxSerialId));
+    readCompactValue(in, value, &m_types);
+}
+
+void QCompactCodec::serializeHandshakePacket(const QString &protocol)
+{
+    m_compactPacket.setId(Handshake);
+    writeCompactString(m_compactPacket, protocol);
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeRemoveObjectPacket(const QString &name)
+{
+    m_compactPacket.setId(RemoveObject);
+    writeCompactString(m_compactPacket, name);
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeAddObjectPacket(const QString &name, bool isDynamic,
+                                             int updateInterval, const PropertyVersion &since,
+                                             const QByteArray &cachedSignature)
+{
+    m_compactPacket.setId(AddObject);
+    writeCompactString(m_compactPacket, name);
+    m_compactPacket << isDynamic;
+    if (updateInterval > 0 || since.epoch != 0 || !cachedSignature.isEmpty())
+        m_compactPacket << qint32(updateInterval);
+    if (since.epoch != 0 || !cachedSignature.isEmpty())
+        m_compactPacket << since.epoch << since.version;
+    if (!cachedSignature.isEmpty())
+        m_compactPacket << cachedSignature;
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::serializeSubscribePacket(const QString &name, const QBitArray &signalMask)
+{
+    startObjectPacket(Subscribe, name);
+    writeVarint(m_compactPacket, quint64(signalMask.size()));
+    const qsizetype bytes = (signalMask.size() + 7) / 8;
+    if (bytes > 0)
+        m_compactPacket.writeRawData(signalMask.bits(), int(bytes));
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::deserializeSubscribePacket(QDataStream &ds, QBitArray &signalMask)
+{
+    quint64 size;
+    if (!readVarint(ds, size) || size > quint64(std::numeric_limits<int>::max())) {
+        signalMask.clear();
+        return;
+    }
+    const qsizetype bytes = qsizetype((size + 7) / 8);
+    QByteArray data(bytes, Qt::Uninitialized);
+    if (ds.readRawData(data.data(), int(bytes)) != bytes) {
+        signalMask.clear();
+        return;
+    }
+    signalMask = QBitArray::fromBits(data.constData(), qsizetype(size));
+}
+
+// <address><varint token><varint sequence><varint count><varint index>...<varint count><value>...
+void QCompactCodec::serializeDatagramChannelPacket(const QString &name,
+                                                   const DatagramChannelInfo &info)
+{
+    startObjectPacket(DatagramChannel, name);
+    writeCompactString(m_compactPacket, info.address.toString());
+    writeVarint(m_compactPacket, info.token);
+    writeVarint(m_compactPacket, info.sequence);
+    writeVarint(m_compactPacket, quint64(info.properties.size()));
+    for (int index : info.properties)
+        writeVarint(m_compactPacket, quint64(index));
+    writeVarint(m_compactPacket, quint64(info.values.size()));
+    for (const QVariant &value : info.values)
+        writeCompactValue(m_compactPacket, value, &m_types);
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::deserializeDatagramChannelPacket(QDataStream &ds, DatagramChannelInfo &info)
+{
+    info = DatagramChannelInfo();
+    info.address = QUrl(readCompactString(ds));
+    quint64 count;
+    if (!readVarint(ds, info.token) || !readVarint(ds, info.sequence) || !readVarint(ds, count)
+        || count > quint64(std::numeric_limits<quint16>::max())) {
+        info = DatagramChannelInfo();
+        return;
+    }
+    info.properties.reserve(qsizetype(count));
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 index;
+        if (!readVarint(ds, index) || index > quint64(std::numeric_limits<int>::max())) {
+            info = DatagramChannelInfo();
+            return;
+        }
+        info.properties << int(index);
+    }
+    if (!readVarint(ds, count) || (count != 0 && count != quint64(info.properties.size()))) {
+        info = DatagramChannelInfo();
+        return;
+    }
+    info.values.resize(qsizetype(count));
+    for (QVariant &value : info.values)
+        readCompactValue(ds, value, &m_types);
+}
+
+void QCompactCodec::serializeDatagramResyncPacket(const QString &name, bool joined)
+{
+    startObjectPacket(DatagramResync, name);
+    m_compactPacket << joined;
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::deserializeDatagramResyncPacket(QDataStream &ds, bool &joined)
+{
+    ds >> joined;
+}
+
+// <quint64 epoch><varint version><varint count><varint index><value>...
+void QCompactCodec::serializeResyncPacket(const QRemoteObjectRootSource *source,
+                                          const PropertyVersion &version,
+                                          const QList<int> &properties)
+{
+    startObjectPacket(ResyncPacket, source->name());
+    m_compactPacket << version.epoch;
+    writeVarint(m_compactPacket, version.version);
+    writeVarint(m_compactPacket, quint64(properties.size()));
+    for (int internalIndex : properties) {
+        writeVarint(m_compactPacket, quint64(internalIndex));
+        serializeProperty(m_compactPacket, source, internalIndex);
+    }
+    m_compactPacket.finishPacket();
+}
+
+void QCompactCodec::deserializeResyncPacket(QDataStream &ds, PropertyVersion &version,
+                                            QList<int> &properties, QVariantList &values)
+{
+    properties.clear();
+    values.clear();
+    quint64 count;
+    ds >> version.epoch;
+    if (!readVarint(ds, version.version) || !readVarint(ds, count)
+        || count > quint64(std::numeric_limits<quint16>::max())) {
+        version = PropertyVersion();
+        return;
+    }
+    properties.reserve(qsizetype(count));
+    values.reserve(qsizetype(count));
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 index;
+        if (!readVarint(ds, index) || index > quint64(std::numeric_limits<int>::max())
+            || !readCompactValue(ds, values.emplace_back(), &m_types)) {
+            version = PropertyVersion();
+            properties.clear();
+            values.clear();
+            return;
+        }
+        properties << int(index);
+    }
+}
+
+QRO_::QRO_(QRemoteObjectSourceBase *source)
+    : name(source->name())
+    , typeName(source->m_api->typeName())
+    , type(source->m_adapter ? ObjectType::MODEL : getObjectType(typeName))
+    , isNull(source->m_object == nullptr)
+    , classDefinition()
+    , parameters()
+{}
+
+QRO_::QRO_(const QVariant &value)
+    : type(ObjectType::GADGET)
+    , isNull(false)
+{
+    const auto metaType = value.metaType();
+    auto meta = metaType.metaObject();
+    QDataStream out(&classDefinition, QIODevice::WriteOnly);
+    const int numProperties = meta->propertyCount();
+    const auto name = metaType.name();
+    const auto typeName = QByteArray::fromRawData(name, qsizetype(qstrlen(name)));
+    out << quint32(0) << quint32(1);
+    out << typeName;
+    out << numProperties;
+#ifdef QTRO_VERBOSE_PROTOCOL
+    qDebug("Serializing POD definition to QRO_ (name = %s)", typeName.constData());
+#endif
+    for (int i = 0; i < numProperties; ++i) {
+        const auto property = meta->property(i);
+#ifdef QTRO_VERBOSE_PROTOCOL
+        qDebug("  Data member %d (name = %s, type = %s):", i, property.name(), property.typeName());
+#endif
+        out << QByteArray::fromRawData(property.name(), qsizetype(qstrlen(property.name())));
+        out << QByteArray::fromRawData(property.typeName(), qsizetype(qstrlen(property.typeName())));
+    }
+    int enumCount = meta->enumeratorCount() - meta->enumeratorOffset();
+    out << quint32(enumCount);
+    for (int j = meta->enumeratorOffset(); j < meta->enumeratorCount(); j++) {
+        auto const enumMeta = meta->enumerator(j);
+        serializeEnum(out, enumMeta);
+    }
+    QDataStream ds(&parameters, QIODevice::WriteOnly);
+    ds << value;
+#ifdef QTRO_VERBOSE_PROTOCOL
+    qDebug() << "  Value:" << value;
+#endif
+}
+
+QDataStream &operator<<(QDataStream &stream, const QRO_ &info)
+{
+    stream << info.name << info.typeName << quint8(info.type) << info.classDefinition << info.isNull;
+    qCDebug(QT_REMOTEOBJECT) << "Serializing " << info;
+    // info.parameters will be filled in by serializeProperty
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, QRO_ &info)
+{
+    quint8 tmpType;
+    stream >> info.name >> info.typeName >> tmpType >> info.classDefinition >> info.isNull;
+    info.type = static_cast<ObjectType>(tmpType);
+    qCDebug(QT_REMOTEOBJECT) << "Deserializing " << info;
+    if (!info.isNull)
+        stream >> info.parameters;
+    return stream;
+}
+
+QSQ_::QSQ_(const QVariant &variant)
+{
+    QSequentialIterable sequence;
+    QMetaType valueType;
+    if (variant.metaType() == QMetaType::fromType<QtROSequentialContainer>()) {
+        auto container = static_cast<const QtROSequentialContainer *>(variant.constData());
+        typeName = container->m_typeName;
+        valueType = container->m_valueType;
+        valueTypeName = container->m_valueTypeName;
+        sequence = QSequentialIterable(reinterpret_cast<const QVariantList *>(variant.constData()));
+    } else {
+        sequence = variant.value<QSequentialIterable>();
+        typeName = QByteArray(variant.metaType().name());
+        valueType = sequence.metaContainer().valueMetaType();
+        valueTypeName = QByteArray(valueType.name());
+    }
+#ifdef QTRO_VERBOSE_PROTOCOL
+    qDebug("Serializing POD sequence to QSQ_ (type = %s, valueType = %s) with size = %lld",
+           typeName.constData(), valueTypeName.constData(), sequence.size());
+#endif
+    QDataStream ds(&values, QIODevice::WriteOnly);
+    ds << valueTypeName;
+    auto pos = ds.device()->pos();
+    ds << quint32(sequence.size());
+    for (const auto &v : sequence) {
+        if (!valueType.save(ds, v.data())) {
+            ds.device()->seek(pos);
+            ds.resetStatus();
+            ds << quint32(0);
+            values.resize(ds.device()->pos());
+            qWarning("QSQ_: unable to save type '%s', sending empty list.", valueType.name());
+            break;
+        }
+    }
+}
+
+QDataStream &operator<<(QDataStream &stream, const QSQ_ &sequence)
+{
+    stream << sequence.typeName << sequence.valueTypeName << sequence.values;
+    qCDebug(QT_REMOTEOBJECT) << "Serializing " << sequence;
+    return stream;
+}
+
+QDataStream &operator>>(QDataStream &stream, QSQ_ &sequence)
+{
+    stream >> sequence.typeName >> sequence.valueTypeName >> sequence.values;
+    qCDebug(QT_REMOTEOBJECT) << "Deserializing " << sequence;
+    return stream;
+}
+
+QAS_::QAS_(const QVariant &variant)
+{
+    QAssociativeIterable map;
+    QMetaType keyType, transferType, valueType;
+    const QtROAssociativeContainer *container = nullptr;
+    if (variant.metaType() == QMetaType::fromType<QtROAssociativeContainer>()) {
+        container = static_cast<const QtROAssociativeContainer *>(variant.constData());
+        typeName = container->m_typeName;
+        keyType = container->m_keyType;
+        keyTypeName = container->m_keyTypeName;
+        valueType = container->m_valueType;
+        valueTypeName = container->m_valueTypeName;
+        map = QAssociativeIterable(reinterpret_cast<const QVariantMap *>(variant.constData()));
+    } else {
+        map = variant.value<QAssociativeIterable>();
+        typeName = QByteArray(variant.metaType().name());
+        keyType = map.metaContainer().keyMetaType();
+        keyTypeName = QByteArray(keyType.name());
+        valueType = map.metaContainer().mappedMetaType();
+        valueTypeName = QByteArray(valueType.name());
     }
     // Special handling for enums...
     transferType = keyType;
@@ -1101,31 +2534,310 @@ DataStreamPacket::DataStreamPacket(quint16 id)
     *this << id;
 }
 
+CompactPacket::CompactPacket()
+    : QDataStream(&body, QIODevice::WriteOnly)
+{
+    this->setVersion(QtRemoteObjects::dataStreamVersion);
+    this->setByteOrder(QDataStream::LittleEndian);
+}
+
+CompactPacket::~CompactPacket()
+{
+    finishBlobs();
+    clearBlobs();
+}
+
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+// A memory file holding data, sealed so the receiver can rely on it not changing
+static int createSealedMemory(const QByteArray &data)
+{
+    const int fd = ::memfd_create("qtro-blob", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0)
+        return -1;
+    qsizetype written = 0;
+    while (written < data.size()) {
+        const ssize_t result = ::write(fd, data.constData() + written,
+                                       size_t(data.size() - written));
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0)
+            break;
+        written += result;
+    }
+    if (written < data.size()
+        || ::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+#endif
+
+// Byte arrays of at least blobThreshold bytes are copied into a sealed memory file, which
+// is passed to the peer next to the payload (see BlobChannel). The packet only holds
+// <quint8 Blob><varint size><varint id>.
+bool CompactPacket::writeBlob(const QByteArray &array)
+{
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    if (blobThreshold <= 0 || array.size() < blobThreshold)
+        return false;
+    const int fd = createSealedMemory(array);
+    if (fd < 0) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Unable to create a memory file, sending"
+                                      << array.size() << "bytes inline";
+        return false;
+    }
+    // Unique in the process, the payload can be sent to several connections
+    static QBasicAtomicInteger<quint64> nextBlobId = Q_BASIC_ATOMIC_INITIALIZER(0);
+    const quint64 blobId = nextBlobId.fetchAndAddRelaxed(1);
+    blobs.append({blobId, fd, array.size()});
+    *this << quint8(CompactTag::Blob);
+    writeVarint(*this, quint64(array.size()));
+    writeVarint(*this, blobId);
+    return true;
+#else
+    Q_UNUSED(array)
+    return false;
+#endif
+}
+
+void CompactPacket::startAnnouncements()
+{
+    announcements = types ? types->announcements() : 0;
+}
+
+bool CompactPacket::hasAnnouncements() const
+{
+    return types && types->announcements() != announcements;
+}
+
+void CompactPacket::startBlobs()
+{
+    t_compactBlobPacket = blobThreshold > 0 ? this : nullptr;
+}
+
+void CompactPacket::finishBlobs()
+{
+    if (t_compactBlobPacket == this)
+        t_compactBlobPacket = nullptr;
+}
+
+void CompactPacket::clearBlobs()
+{
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+    for (const OutgoingBlob &blob : std::as_const(blobs))
+        ::close(blob.fd);
+#endif
+    blobs.clear();
+}
+
+bool CompactPacket::appendCompressed(qint64 size)
+{
+    // Only worth it if the compressed packet, algorithm byte included, is smaller
+    if (size > maximumUncompressedSize || !compressPayload(compression, body.constData(), size, compressed)
+        || compressed.size() + 1 >= size) {
+        return false;
+    }
+    char header[12];
+    int headerSize = encodeVarint(header, quint64(compressed.size()) + 2);
+    header[headerSize++] = char(id | CompactCompressedFlag);
+    header[headerSize++] = char(compression);
+    array.append(header, headerSize);
+    array.append(compressed);
+    return true;
+}
+
+quint8 supportedCompressionAlgorithms()
+{
+    quint8 algorithms = 1 << QRemoteObjectNode::ZlibCompression;
+#if QT_CONFIG(remoteobjects_zstd)
+    algorithms |= 1 << QRemoteObjectNode::ZstdCompression;
+#endif
+    return algorithms;
+}
+
+bool compressPayload(QRemoteObjectNode::CompressionAlgorithm algorithm, const char *data,
+                     qsizetype size, QByteArray &compressed)
+{
+    // Packets are compressed on the fly, favor speed over ratio
+    switch (algorithm) {
+    case QRemoteObjectNode::ZlibCompression:
+        compressed = qCompress(reinterpret_cast<const uchar *>(data), size, 1);
+        return !compressed.isEmpty();
+    case QRemoteObjectNode::ZstdCompression:
+#if QT_CONFIG(remoteobjects_zstd)
+    {
+        compressed.resize(qsizetype(ZSTD_compressBound(size_t(size))));
+        const size_t result = ZSTD_compress(compressed.data(), size_t(compressed.size()), data,
+                                            size_t(size), 1);
+        if (ZSTD_isError(result))
+            return false;
+        compressed.truncate(qsizetype(result));
+        return true;
+    }
+#else
+        break;
+#endif
+    case QRemoteObjectNode::NoCompression:
+        break;
+    }
+    return false;
+}
+
+QByteArray uncompressPayload(QRemoteObjectNode::CompressionAlgorithm algorithm, const char *data,
+                             qsizetype size)
+{
+    switch (algorithm) {
+    case QRemoteObjectNode::ZlibCompression: {
+        // qCompress() prefixes the data with the uncompressed size, as a big endian quint32
+        if (size < 4 || qFromBigEndian<quint32>(data) > quint32(maximumUncompressedSize))
+            return QByteArray();
+        return qUncompress(reinterpret_cast<const uchar *>(data), size);
+    }
+    case QRemoteObjectNode::ZstdCompression:
+#if QT_CONFIG(remoteobjects_zstd)
+    {
+        const unsigned long long contentSize = ZSTD_getFrameContentSize(data, size_t(size));
+        if (contentSize == ZSTD_CONTENTSIZE_ERROR || contentSize == ZSTD_CONTENTSIZE_UNKNOWN
+            || contentSize > quint64(maximumUncompressedSize)) {
+            return QByteArray();
+        }
+        QByteArray uncompressed(qsizetype(contentSize), Qt::Uninitialized);
+        const size_t result = ZSTD_decompress(uncompressed.data(), size_t(uncompressed.size()),
+                                              data, size_t(size));
+        if (ZSTD_isError(result) || result != contentSize)
+            return QByteArray();
+        return uncompressed;
+    }
+#else
+        break;
+#endif
+    case QRemoteObjectNode::NoCompression:
+        break;
+    }
+    return QByteArray();
+}
+
+void CodecBase::serializeSignalPacket(QRemoteObjectSourceBase *source, int call, int index, void **a, int propertyIndex)
+{
+    serializeInvokePacket(source->name(), call, index, *source->marshalArgs(index, a), -1, propertyIndex);
+}
+
+// Writes the payload to the connection of d, which knows the announced handles and type
+// names afterwards
+void CodecBase::write(QtROIoDeviceBasePrivate *d, const QByteArray &payload)
+{
+    if (!d->isDeviceOpen() || !d->sendBlobs(getBlobs()))
+        return;
+    if (!d->writePackets(payload, getPacketSpans()))
+        return;
+    if (const QList<int> *handles = getAnnouncedHandles()) {
+        for (int handle : *handles)
+            d->setHandleAnnounced(handle);
+    }
+    const QList<int> *types = getAnnouncedTypes();
+    if (types && !types->isEmpty() && d->m_codec)
+        d->m_codec->setTypesAnnounced(*types);
+}
+
 void CodecBase::send(const QSet<QtROIoDeviceBase *> &connections)
 {
+    // Connections running on I/O threads share the payload, each thread is woken up
+    // once to write it to all of its connections
+    const QtROIoFanOut fanOut;
     const auto bytearray = getPayload();
     for (auto conn : connections)
-        conn->write(bytearray);
+        write(QtROIoDeviceBasePrivate::get(conn), bytearray);
     reset();
 }
 
 void CodecBase::send(const QList<QtROIoDeviceBase *> &connections)
 {
+    const QtROIoFanOut fanOut;
     const auto bytearray = getPayload();
     for (auto conn : connections)
-        conn->write(bytearray);
+        write(QtROIoDeviceBasePrivate::get(conn), bytearray);
     reset();
 }
 
 void CodecBase::send(QtROIoDeviceBase *connection)
 {
-    const auto bytearray = getPayload();
-    connection->write(bytearray);
+    write(QtROIoDeviceBasePrivate::get(connection), getPayload());
     reset();
 }
 
 } // namespace QRemoteObjectPackets
 
+namespace QtPrivate {
+
+void qtro_serialize_compact_value(QDataStream &out, const void *value, QMetaType type)
+{
+    using namespace QRemoteObjectPackets;
+    // Without the type table (when not called for a QCompactCodec packet) type names are sent
+    const CompactTypeContext &context = t_compactWriteContext;
+    writeCompactValue(out, value, type, context.stream == &out ? context.types : nullptr);
+}
+
+void qtro_deserialize_compact_value(QDataStream &in, void *value, QMetaType type)
+{
+    using namespace QRemoteObjectPackets;
+    if (readCompactScalar(in, value, type))
+        return;
+    const CompactTypeContext &context = t_compactTypedReadContext;
+    CompactTypeTable *types = context.stream == &in ? context.types : nullptr;
+    const CodecPlan plan = codecPlan(type);
+    if (plan.kind == CodecPlan::Enum && readCompactScalar(in, value, plan.transferType))
+        return;
+
+    QVariant received;
+    char tag;
+    if (in.device() && in.device()->peek(&tag, 1) == 1
+        && CompactTag(quint8(tag)) == CompactTag::TypedVariant) {
+        // Values of the property's own type are loaded in place
+        in.skipRawData(1);
+        CompactTypeTable::ReceivedType receivedType;
+        if (!readCompactReference(in, types, receivedType))
+            return;
+        const QMetaType loadType = receivedType.metaType;
+        if (!loadType.isValid()) {
+            qCWarning(QT_REMOTEOBJECT_IO) << "Received value of unknown type" << receivedType.name;
+            in.setStatus(QDataStream::ReadCorruptData);
+            return;
+        }
+        if (loadType != type)
+            received = QVariant(loadType, nullptr);
+        if (!loadType.load(in, loadType == type ? value : received.data())) {
+            qCWarning(QT_REMOTEOBJECT_IO) << "Unable to load value of type" << receivedType.name;
+            in.setStatus(QDataStream::ReadCorruptData);
+            return;
+        }
+        if (loadType == type)
+            return;
+    } else if (!readCompactValue(in, received, types)) {
+        return;
+    }
+
+    // Everything else is decoded as for a dynamic replica, and copied into value
+    if (received.metaType() == QMetaType::fromType<GadgetDelta>()) {
+        applyGadgetDelta(value, type, std::move(*static_cast<GadgetDelta *>(received.data())));
+        return;
+    }
+    received = decodeVariant(std::move(received), plan);
+    if (type == QMetaType::fromType<QVariant>()) {
+        *static_cast<QVariant *>(value) = std::move(received);
+        return;
+    }
+    if (received.metaType() != type && !received.convert(type)) {
+        qCWarning(QT_REMOTEOBJECT_IO) << "Unable to convert the received value to" << type.name();
+        return;
+    }
+    type.destruct(value);
+    type.construct(value, received.constData());
+}
+
+} // namespace QtPrivate
+
+QT_IMPL_METATYPE_EXTERN_TAGGED(QRemoteObjectPackets::GadgetDelta, QRemoteObjectPackets__GadgetDelta)
 QT_IMPL_METATYPE_EXTERN_TAGGED(QRemoteObjectPackets::QRO_, QRemoteObjectPackets__QRO_)
 
 QT_END_NAMESPACE
@@ -20,6 +20,8 @@
 #include "qconnectionfactories.h"
 
 #include <QtCore/qassociativeiterable.h>
+#include <QtCore/qbitarray.h>
+#include <QtCore/qbuffer.h>
 #include <QtCore/qhash.h>
 #include <QtCore/qmap.h>
 #include <QtCore/qpair.h>
@@ -31,18 +33,21 @@
 #include <QtCore/private/qglobal_p.h>
 
 #include <cstdlib>
+#include <limits>
 
 QT_BEGIN_NAMESPACE
 
 class QMetaObjectBuilder;
 class QRemoteObjectSourceBase;
 class QRemoteObjectRootSource;
+class QtROIoDeviceBasePrivate;
 
 namespace QRemoteObjectPackets {
 
 Q_NAMESPACE
 
 class DataStreamPacket;
+class CompactTypeTable;
 
 struct ObjectInfo
 {
@@ -87,6 +92,16 @@ public:
     QByteArray parameters;
 };
 
+// Changed fields of a gadget (or POD) property, sent by QCompactCodec instead of the whole
+// value. The receiver applies them to the value it already holds, see applyGadgetDelta().
+struct GadgetDelta
+{
+    QList<int> indices; // Property indices in the gadget's QMetaObject
+    QVariantList values;
+};
+
+QVariant applyGadgetDelta(QVariant value, GadgetDelta &&delta);
+
 inline QDebug operator<<(QDebug dbg, const QRO_ &info)
 {
     dbg.nospace() << "QRO_(name: " << info.name << ", typeName: " << info.typeName
@@ -152,6 +167,125 @@ QDataStream& operator<<(QDataStream &stream, const QAS_ &info);
 
 QDataStream& operator>>(QDataStream &stream, QAS_ &info);
 
+// Wire formats a connection can negotiate, see QCompactCodec
+enum class WireFormat : quint8 { DataStream, Compact };
+
+// How a packet addresses its object. Codecs that support numeric handles send the
+// handle together with the name the first time (Announce), and the handle alone
+// afterwards. The packet id carries a flag telling the receiver which form follows.
+enum class HandleMode : quint8 { Name, Announce, Handle };
+enum CompactPacketFlag : quint8 {
+    CompactAnnounceHandleFlag = 0x40,
+    CompactHandleFlag = 0x80,
+    CompactPacketFlagMask = CompactAnnounceHandleFlag | CompactHandleFlag,
+    // The id is followed by the compression algorithm and the compressed rest of the packet
+    CompactCompressedFlag = 0x20
+};
+// The flags of a Fragment packet, see QtROIoDeviceBasePrivate::writeBulk(). The first
+// fragment of a packet also carries the size of the packet and the object it addresses.
+enum FragmentFlag : quint8 {
+    LastFragmentFlag = 0x01,
+    FirstFragmentFlag = 0x02
+};
+
+// Payload compression, see QRemoteObjectNode::setCompression(). The supported
+// algorithms are returned as a mask of (1 << CompressionAlgorithm) bits. Larger
+// payloads are sent uncompressed, and a compressed payload claiming to be larger is
+// rejected before anything is allocated for it.
+static constexpr qsizetype maximumUncompressedSize = 64 * 1024 * 1024;
+quint8 supportedCompressionAlgorithms();
+bool compressPayload(QRemoteObjectNode::CompressionAlgorithm algorithm, const char *data,
+                     qsizetype size, QByteArray &compressed);
+QByteArray uncompressPayload(QRemoteObjectNode::CompressionAlgorithm algorithm, const char *data,
+                             qsizetype size);
+
+// Helpers for the compact wire format. Unsigned integers are sent as LEB128
+// varints, signed integers are zigzag encoded first.
+inline quint64 zigZagEncode(qint64 value)
+{
+    return (quint64(value) << 1) ^ quint64(value >> 63);
+}
+
+inline qint64 zigZagDecode(quint64 value)
+{
+    return qint64(value >> 1) ^ -qint64(value & 1);
+}
+
+inline int encodeVarint(char *buffer, quint64 value)
+{
+    int size = 0;
+    while (value >= 0x80) {
+        buffer[size++] = char((value & 0x7f) | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = char(value);
+    return size;
+}
+
+inline void writeVarint(QDataStream &ds, quint64 value)
+{
+    char buffer[10];
+    ds.writeRawData(buffer, encodeVarint(buffer, value));
+}
+
+inline bool readVarint(QDataStream &ds, quint64 &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        quint8 byte;
+        ds >> byte;
+        if (ds.status() != QDataStream::Ok)
+            return false;
+        value |= quint64(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    ds.setStatus(QDataStream::ReadCorruptData);
+    return false;
+}
+
+inline void writeCompactString(QDataStream &ds, QStringView string)
+{
+    const QByteArray utf8 = string.toUtf8();
+    writeVarint(ds, quint64(utf8.size()));
+    ds.writeRawData(utf8.constData(), int(utf8.size()));
+}
+
+// Received packets are decoded from an in-memory frame (see QtROIoDeviceBase::read()).
+// Returns a view of the next size bytes of that frame and skips them, or a null view if
+// ds doesn't read from a frame or the frame is too short.
+inline QByteArrayView readFrameView(QDataStream &ds, qsizetype size)
+{
+    auto buffer = qobject_cast<QBuffer *>(ds.device());
+    if (!buffer)
+        return QByteArrayView();
+    const QByteArray &frame = buffer->data();
+    const qint64 pos = buffer->pos();
+    if (size > frame.size() - pos)
+        return QByteArrayView();
+    buffer->seek(pos + size);
+    return QByteArrayView(frame.constData() + pos, size);
+}
+
+inline QString readCompactString(QDataStream &ds)
+{
+    quint64 size;
+    if (!readVarint(ds, size))
+        return QString();
+    if (size > quint64(std::numeric_limits<int>::max())) {
+        ds.setStatus(QDataStream::ReadCorruptData);
+        return QString();
+    }
+    if (const QByteArrayView utf8 = readFrameView(ds, qsizetype(size)); !utf8.isNull())
+        return QString::fromUtf8(utf8);
+    QByteArray utf8(qsizetype(size), Qt::Uninitialized);
+    if (ds.readRawData(utf8.data(), int(size)) != int(size)) {
+        ds.setStatus(QDataStream::ReadPastEnd);
+        return QString();
+    }
+    return QString::fromUtf8(utf8);
+}
+
 //Helper class for creating a QByteArray from a QRemoteObjectPacket
 class DataStreamPacket : public QDataStream
 {
@@ -194,6 +328,226 @@ private:
     Q_DISABLE_COPY(DataStreamPacket)
 };
 
+// A packet of a payload: where it ends, the object it is addressed to (empty for packets
+// concerning the connection), and whether it may overtake all other packets. Used to send
+// large packets in fragments, see QtROIoDeviceBasePrivate::writePackets().
+struct PacketSpan
+{
+    qsizetype end;
+    QString object;
+    bool urgent;
+    // The packet announces type names to the connection, later packets of any object
+    // can refer to them (see CompactTypeTable)
+    bool announcesTypes;
+};
+
+// A byte array of a payload sent out of band, as a sealed memory file (see CompactTag::Blob).
+// The file descriptor is owned by the CompactPacket and closed when the payload was sent.
+struct OutgoingBlob
+{
+    quint64 id;
+    int fd;
+    qsizetype size;
+};
+
+// Passes the blobs of the packets sent on a connection to the peer, and takes those the
+// peer sent. The host listens on an address it offers to the client, which connects to it,
+// see QtRemoteObjects::descriptorProtocolPrefix and QtRODescriptorChannel.
+class BlobChannel
+{
+public:
+    virtual ~BlobChannel() = default;
+    // Host side: starts listening, returns the address to offer or an empty string
+    virtual QString listen() = 0;
+    virtual bool isListening() const = 0;
+    // Host side: pairs with the client that connected to address
+    virtual bool accept(const QString &address) = 0;
+    // Client side: connects to the address the host offered
+    virtual bool connectToHost(const QString &address) = 0;
+    // Called before the packets referencing the blobs are written, false if the blobs
+    // can't reach the peer
+    virtual bool sendBlobs(const QList<OutgoingBlob> &blobs) = 0;
+    // The size of the blobs sent that the peer did not take yet
+    virtual qint64 bufferedBytes() = 0;
+    // The contents of the blob id the peer sent, or a null array
+    virtual QByteArray takeBlob(quint64 id, qsizetype size) = 0;
+};
+
+// The channel the blobs referenced by the packets decoded from frame are taken from.
+// Set when a packet was received, until releaseBlobChannel() is called for frame.
+void setBlobChannel(const QIODevice *frame, BlobChannel *channel);
+void releaseBlobChannel(const QIODevice *frame);
+
+// Helper class for creating a QByteArray of packets in the compact wire format.
+// Each packet is framed as <varint size><quint8 id><payload>, where size covers
+// the id and the payload. With compression enabled, payloads of at least
+// compressionThreshold bytes are framed as <varint size><quint8 id | CompactCompressedFlag>
+// <quint8 algorithm><compressed payload> instead, if that is smaller.
+class CompactPacket : public QDataStream
+{
+public:
+    CompactPacket();
+    ~CompactPacket();
+
+    void setId(quint8 packetId)
+    {
+        device()->seek(0);
+        id = packetId;
+        object.clear();
+        startBlobs();
+        startAnnouncements();
+    }
+
+    // The table type names are written with, to tell which packets announce names
+    void setTypeTable(const CompactTypeTable *table) { types = table; }
+
+    void setObject(const QString &name) { object = name; }
+
+    void setCompression(QRemoteObjectNode::CompressionAlgorithm algorithm, qint64 threshold)
+    {
+        compression = algorithm;
+        compressionThreshold = threshold;
+    }
+
+    // Byte arrays of at least threshold bytes are sent as blobs, 0 disables them
+    void setBlobThreshold(qsizetype threshold) { blobThreshold = threshold; }
+    // Writes array as a blob, returns false if it has to be written inline
+    bool writeBlob(const QByteArray &array);
+
+    void finishPacket()
+    {
+        finishBlobs();
+        const qint64 size = device()->pos();
+        if (compression == QRemoteObjectNode::NoCompression || size < compressionThreshold
+            || !appendCompressed(size)) {
+            char header[11];
+            int headerSize = encodeVarint(header, quint64(size) + 1);
+            header[headerSize++] = char(id);
+            array.append(header, headerSize);
+            array.append(body.constData(), size);
+        }
+        const quint8 type = id & ~CompactPacketFlagMask;
+        spans.append({array.size(), object,
+                      type == QtRemoteObjects::Ping || type == QtRemoteObjects::Pong,
+                      hasAnnouncements()});
+    }
+
+    const QByteArray &payload()
+    {
+        return array;
+    }
+
+    const QList<PacketSpan> &packetSpans() const
+    {
+        return spans;
+    }
+
+    const QList<OutgoingBlob> &outgoingBlobs() const
+    {
+        return blobs;
+    }
+
+    void reset()
+    {
+        array.clear();
+        spans.clear();
+        clearBlobs();
+    }
+
+private:
+    bool appendCompressed(qint64 size);
+    void startAnnouncements();
+    bool hasAnnouncements() const;
+    void startBlobs();
+    void finishBlobs();
+    void clearBlobs();
+
+    QByteArray body;
+    QByteArray array;
+    QByteArray compressed;
+    QList<PacketSpan> spans;
+    QList<OutgoingBlob> blobs;
+    QString object;
+    const CompactTypeTable *types = nullptr;
+    quint64 announcements = 0;
+    qint64 compressionThreshold = 0;
+    qsizetype blobThreshold = 0;
+    QRemoteObjectNode::CompressionAlgorithm compression = QRemoteObjectNode::NoCompression;
+    quint8 id = 0;
+
+    Q_DISABLE_COPY(CompactPacket)
+};
+
+// Names of the custom types sent by QCompactCodec. Every name gets a small id the first
+// time it is sent, a connection receives the name once (together with the id) and the id
+// only afterwards. The receiving side resolves each name to its QMetaType once.
+class CompactTypeTable
+{
+public:
+    struct ReceivedType
+    {
+        QByteArray name;
+        QMetaType metaType;
+    };
+
+    // Other tables the next packet is sent for, they need to see the names too
+    void setPeers(const QList<CompactTypeTable *> &peers) { m_peers = peers; }
+    void clearPeers() { m_peers.clear(); }
+    void writeReference(QDataStream &ds, const QByteArray &name);
+    bool readReference(QDataStream &ds, ReceivedType &type);
+    // The number of names written with their id so far
+    quint64 announcements() const { return m_announcements; }
+    // The ids of the names the payload being serialized announces. The tables of the
+    // connections only mark them announced once it was written, see CodecBase::write().
+    const QList<int> &pendingAnnouncements() const { return m_pending; }
+    void clearPendingAnnouncements() { m_pending.clear(); }
+    void setAnnounced(const QList<int> &ids)
+    {
+        for (int id : ids)
+            setAnnounced(id);
+    }
+
+private:
+    bool isAnnounced(int id) const { return id < m_announced.size() && m_announced.at(id); }
+    void setAnnounced(int id)
+    {
+        if (id >= m_announced.size())
+            m_announced.resize(id + 1);
+        m_announced[id] = true;
+    }
+
+    QList<bool> m_announced;
+    quint64 m_announcements = 0;
+    QList<int> m_pending;
+    QList<CompactTypeTable *> m_peers;
+    QList<ReceivedType> m_received;
+};
+
+// The datagram channel of a source, see QRemoteObjectHostBase::setDatagramChannel(). The lossy
+// properties are given by internal index. values is either empty, or holds their current values
+// (in the same order) as of the datagram with the given sequence number.
+struct DatagramChannelInfo
+{
+    QUrl address;
+    quint64 token = 0;
+    quint64 sequence = 0;
+    QList<int> properties;
+    QVariantList values;
+};
+
+// Identifies the property values a replica holds, see QRemoteObjectRootSource::addListener().
+// The epoch is chosen at random by the root source whenever its history starts over, version
+// counts the property changes since. An epoch of 0 means the replica has no baseline.
+struct PropertyVersion
+{
+    quint64 epoch = 0;
+    quint64 version = 0;
+};
+
+// Reads a property value into the storage of a repc generated replica, see
+// QtPrivate::ReplicaExtension and CodecBase::deserializePropertyChangePacket()
+using CompactPropertyReader = bool (*)(QDataStream &in, QVariant &value, int index);
+
 class CodecBase
 {
 public:
@@ -208,9 +562,29 @@ public:
     virtual void deserializeObjectListPacket(QDataStream &in, ObjectInfoList &) = 0;
     virtual void serializeInitPacket(const QRemoteObjectRootSource *) = 0;
     virtual void serializeInitDynamicPacket(const QRemoteObjectRootSource *) = 0;
+    // The parts of an init packet that don't depend on the connection, the class definition
+    // (if definition is set) and the properties. They can be shared by all listeners using
+    // the same wire format, see QRemoteObjectRootSource::addListener().
+    virtual void serializeInitParts(const QRemoteObjectRootSource *, QByteArray *definition,
+                                    QByteArray *properties) = 0;
+    virtual void serializeInitPacket(const QRemoteObjectRootSource *,
+                                     const QByteArray &properties) = 0;
+    virtual void serializeInitDynamicPacket(const QRemoteObjectRootSource *,
+                                            const QByteArray &definition,
+                                            const QByteArray &properties) = 0;
     virtual void serializePropertyChangePacket(QRemoteObjectSourceBase *source,
                                                int signalIndex) = 0;
     virtual void deserializePropertyChangePacket(QDataStream &in, int &index, QVariant &value) = 0;
+    // Reads the value with read into storage[index] where the codec supports it, returns false
+    // if the value was read into value instead
+    virtual bool deserializePropertyChangePacket(QDataStream &in, int &index, QVariant &value,
+                                                 CompactPropertyReader read, QVariantList &storage)
+    {
+        Q_UNUSED(read);
+        Q_UNUSED(storage);
+        deserializePropertyChangePacket(in, index, value);
+        return false;
+    }
     virtual void serializeProperty(const QRemoteObjectSourceBase *source, int internalIndex) = 0;
     // Heartbeat packets
     virtual void serializePingPacket(const QString &name) = 0;
@@ -222,14 +596,76 @@ public:
                                          int &serialId, int &propertyIndex) = 0;
     virtual void serializeInvokeReplyPacket(const QString &name, int ackedSerialId,
                                             const QVariant &value) = 0;
-    virtual void serializeHandshakePacket() = 0;
+    // Invoke packet for a signal emitted by source, a is the signal's argument array
+    virtual void serializeSignalPacket(QRemoteObjectSourceBase *source, int call, int index,
+                                       void **a, int propertyIndex);
+    virtual void serializeHandshakePacket(const QString &protocol) = 0;
     virtual void serializeRemoveObjectPacket(const QString &name) = 0;
     //There is no deserializeRemoveObjectPacket - no parameters other than id and name
-    virtual void serializeAddObjectPacket(const QString &name, bool isDynamic) = 0;
-    virtual void deserializeAddObjectPacket(QDataStream &, bool &isDynamic) = 0;
+    // cachedSignature is the signature of the class a dynamic replica has the definition of,
+    // see QRemoteObjectNode::setTypeCacheDirectory()
+    virtual void serializeAddObjectPacket(const QString &name, bool isDynamic, int updateInterval,
+                                          const PropertyVersion &since = {},
+                                          const QByteArray &cachedSignature = {}) = 0;
+    virtual void deserializeAddObjectPacket(QDataStream &, bool &isDynamic, int &updateInterval,
+                                            PropertyVersion &since,
+                                            QByteArray &cachedSignature) = 0;
+    // The signals (by index) a replica wants to receive, an empty mask subscribes to all
+    virtual void serializeSubscribePacket(const QString &name, const QBitArray &signalMask) = 0;
+    virtual void deserializeSubscribePacket(QDataStream &, QBitArray &signalMask) = 0;
+    // Announces the datagram channel of a source, or resynchronizes its lossy properties
+    virtual void serializeDatagramChannelPacket(const QString &name,
+                                                const DatagramChannelInfo &info) = 0;
+    virtual void deserializeDatagramChannelPacket(QDataStream &, DatagramChannelInfo &info) = 0;
+    // Tells the source whether the replica receives the datagrams, and asks for the values
+    virtual void serializeDatagramResyncPacket(const QString &name, bool joined) = 0;
+    virtual void deserializeDatagramResyncPacket(QDataStream &, bool &joined) = 0;
+    // The version of the root source, with the values of the given properties. Without
+    // properties, it tells the replica the version of the values it already has.
+    virtual void serializeResyncPacket(const QRemoteObjectRootSource *source,
+                                       const PropertyVersion &version,
+                                       const QList<int> &properties) = 0;
+    virtual void deserializeResyncPacket(QDataStream &, PropertyVersion &version,
+                                         QList<int> &properties, QVariantList &values) = 0;
     virtual void deserializeInitPacket(QDataStream &, QVariantList &) = 0;
     virtual void deserializeInvokeReplyPacket(QDataStream &in, int &ackedSerialId,
                                               QVariant &value) = 0;
+    virtual WireFormat wireFormat() const = 0;
+    // Addresses the packets serialized until the next send() by numeric handle.
+    // Codecs without handle support keep sending the name.
+    virtual void setObjectHandle(int handle, HandleMode mode)
+    {
+        Q_UNUSED(handle)
+        Q_UNUSED(mode)
+    }
+    // Compresses packets of at least threshold bytes. Codecs without compression
+    // support ignore it.
+    virtual void setCompression(QRemoteObjectNode::CompressionAlgorithm algorithm,
+                                qint64 threshold)
+    {
+        Q_UNUSED(algorithm)
+        Q_UNUSED(threshold)
+    }
+    virtual QRemoteObjectNode::CompressionAlgorithm compression() const
+    {
+        return QRemoteObjectNode::NoCompression;
+    }
+    virtual qint64 compressionThreshold() const { return 0; }
+    // Sends byte arrays of at least threshold bytes out of band (see BlobChannel), 0
+    // disables it. Codecs without blob support ignore it.
+    virtual void setBlobThreshold(qsizetype threshold) { Q_UNUSED(threshold) }
+    virtual qsizetype blobThreshold() const { return 0; }
+    // The packets serialized until the next send() are also sent with the codecs in peers
+    // (which produce the same payload), see CompactTypeTable
+    virtual void setPeers(const QList<CodecBase *> &peers) { Q_UNUSED(peers) }
+    // Whether other serializes packets to the same bytes, so a payload can be shared
+    bool producesSamePayload(const CodecBase &other) const
+    {
+        return wireFormat() == other.wireFormat() && compression() == other.compression()
+                && (compression() == QRemoteObjectNode::NoCompression
+                    || compressionThreshold() == other.compressionThreshold())
+                && blobThreshold() == other.blobThreshold();
+    }
     void send(const QSet<QtROIoDeviceBase *> &connections);
     void send(const QVector<QtROIoDeviceBase *> &connections);
     void send(QtROIoDeviceBase *connection);
@@ -237,7 +673,21 @@ public:
 protected:
     // A payload can consist of one or more packets
     virtual const QByteArray &getPayload() = 0;
+    // The packets of the payload, if the codec supports sending them in fragments
+    virtual const QList<PacketSpan> *getPacketSpans() const { return nullptr; }
+    // The blobs the packets of the payload reference
+    virtual const QList<OutgoingBlob> *getBlobs() const { return nullptr; }
+    // The object handles the packets of the payload announce, the connections only know
+    // them once the payload was written
+    virtual const QList<int> *getAnnouncedHandles() const { return nullptr; }
+    // Same for the ids of the type names the payload announces (compact codec only), which
+    // setTypesAnnounced() marks on the codec of every connection it was written to
+    virtual const QList<int> *getAnnouncedTypes() const { return nullptr; }
+    virtual void setTypesAnnounced(const QList<int> &ids) { Q_UNUSED(ids); }
     virtual void reset() {}
+
+private:
+    void write(QtROIoDeviceBasePrivate *d, const QByteArray &payload);
 };
 
 class QDataStreamCodec : public CodecBase
@@ -247,7 +697,13 @@ public:
     void deserializeObjectListPacket(QDataStream &in, ObjectInfoList &) override;
     void serializeInitPacket(const QRemoteObjectRootSource *) override;
     void serializeInitDynamicPacket(const QRemoteObjectRootSource*) override;
+    void serializeInitParts(const QRemoteObjectRootSource *, QByteArray *definition,
+                            QByteArray *properties) override;
+    void serializeInitPacket(const QRemoteObjectRootSource *, const QByteArray &properties) override;
+    void serializeInitDynamicPacket(const QRemoteObjectRootSource *, const QByteArray &definition,
+                                    const QByteArray &properties) override;
     void serializePropertyChangePacket(QRemoteObjectSourceBase *source, int signalIndex) override;
+    using CodecBase::deserializePropertyChangePacket;
     void deserializePropertyChangePacket(QDataStream &in, int &index, QVariant &value) override;
     void serializeProperty(const QRemoteObjectSourceBase *source, int internalIndex) override;
     void serializePingPacket(const QString &name) override;
@@ -258,13 +714,28 @@ public:
                                  int &serialId, int &propertyIndex) override;
     void serializeInvokeReplyPacket(const QString &name, int ackedSerialId,
                                     const QVariant &value) override;
-    void serializeHandshakePacket() override;
+    void serializeHandshakePacket(const QString &protocol) override;
     void serializeRemoveObjectPacket(const QString &name) override;
-    void serializeAddObjectPacket(const QString &name, bool isDynamic) override;
-    void deserializeAddObjectPacket(QDataStream &, bool &isDynamic) override;
+    void serializeAddObjectPacket(const QString &name, bool isDynamic, int updateInterval,
+                                  const PropertyVersion &since = {},
+                                  const QByteArray &cachedSignature = {}) override;
+    void deserializeAddObjectPacket(QDataStream &, bool &isDynamic, int &updateInterval,
+                                    PropertyVersion &since, QByteArray &cachedSignature) override;
+    void serializeSubscribePacket(const QString &name, const QBitArray &signalMask) override;
+    void deserializeSubscribePacket(QDataStream &, QBitArray &signalMask) override;
+    void serializeDatagramChannelPacket(const QString &name,
+                                        const DatagramChannelInfo &info) override;
+    void deserializeDatagramChannelPacket(QDataStream &, DatagramChannelInfo &info) override;
+    void serializeDatagramResyncPacket(const QString &name, bool joined) override;
+    void deserializeDatagramResyncPacket(QDataStream &, bool &joined) override;
+    void serializeResyncPacket(const QRemoteObjectRootSource *source, const PropertyVersion &version,
+                               const QList<int> &properties) override;
+    void deserializeResyncPacket(QDataStream &, PropertyVersion &version, QList<int> &properties,
+                                 QVariantList &values) override;
     void deserializeInitPacket(QDataStream &, QVariantList &) override;
     void deserializeInvokeReplyPacket(QDataStream &in, int &ackedSerialId,
                                       QVariant &value) override;
+    WireFormat wireFormat() const override { return WireFormat::DataStream; }
 
 protected:
     const QByteArray &getPayload() override {
@@ -273,21 +744,166 @@ protected:
     void reset() override {
         m_packet.reset();
     }
-private:
     void serializeDefinition(QDataStream &, const QRemoteObjectSourceBase *);
     void serializeProperty(QDataStream &ds, const QRemoteObjectSourceBase *source, int internalIndex);
+private:
     void serializeProperties(const QRemoteObjectSourceBase *source);
     DataStreamPacket m_packet;
 };
 
+// Codec negotiated during the handshake (see QtRemoteObjects::compactProtocolVersion).
+// Compared to QDataStreamCodec, object names are sent as UTF-8, indices and counts
+// as varints, and values of common built-in types with a one byte type tag instead
+// of the QVariant type name. Class definitions and types that need registration
+// on the receiving side keep the QDataStream encoding.
+class QCompactCodec : public QDataStreamCodec
+{
+public:
+    QCompactCodec() { m_compactPacket.setTypeTable(&m_types); }
+
+    void serializeObjectListPacket(const ObjectInfoList &) override;
+    void serializeInitPacket(const QRemoteObjectRootSource *) override;
+    void serializeInitDynamicPacket(const QRemoteObjectRootSource*) override;
+    void serializeInitParts(const QRemoteObjectRootSource *, QByteArray *definition,
+                            QByteArray *properties) override;
+    void serializeInitPacket(const QRemoteObjectRootSource *, const QByteArray &properties) override;
+    void serializeInitDynamicPacket(const QRemoteObjectRootSource *, const QByteArray &definition,
+                                    const QByteArray &properties) override;
+    void serializePropertyChangePacket(QRemoteObjectSourceBase *source, int signalIndex) override;
+    void deserializePropertyChangePacket(QDataStream &in, int &index, QVariant &value) override;
+    bool deserializePropertyChangePacket(QDataStream &in, int &index, QVariant &value,
+                                         CompactPropertyReader read, QVariantList &storage) override;
+    void serializeProperty(const QRemoteObjectSourceBase *source, int internalIndex) override;
+    void serializePingPacket(const QString &name) override;
+    void serializePongPacket(const QString &name) override;
+    void serializeInvokePacket(const QString &name, int call, int index, const QVariantList &args,
+                               int serialId = -1, int propertyIndex = -1) override;
+    void deserializeInvokePacket(QDataStream &in, int &call, int &index, QVariantList &args,
+                                 int &serialId, int &propertyIndex) override;
+    void serializeInvokeReplyPacket(const QString &name, int ackedSerialId,
+                                    const QVariant &value) override;
+    void serializeSignalPacket(QRemoteObjectSourceBase *source, int call, int index, void **a,
+                               int propertyIndex) override;
+    void serializeHandshakePacket(const QString &protocol) override;
+    void serializeRemoveObjectPacket(const QString &name) override;
+    void serializeAddObjectPacket(const QString &name, bool isDynamic, int updateInterval,
+                                  const PropertyVersion &since = {},
+                                  const QByteArray &cachedSignature = {}) override;
+    void serializeSubscribePacket(const QString &name, const QBitArray &signalMask) override;
+    void deserializeSubscribePacket(QDataStream &, QBitArray &signalMask) override;
+    void serializeDatagramChannelPacket(const QString &name,
+                                        const DatagramChannelInfo &info) override;
+    void deserializeDatagramChannelPacket(QDataStream &, DatagramChannelInfo &info) override;
+    void serializeDatagramResyncPacket(const QString &name, bool joined) override;
+    void deserializeDatagramResyncPacket(QDataStream &, bool &joined) override;
+    void serializeResyncPacket(const QRemoteObjectRootSource *source, const PropertyVersion &version,
+                               const QList<int> &properties) override;
+    void deserializeResyncPacket(QDataStream &, PropertyVersion &version, QList<int> &properties,
+                                 QVariantList &values) override;
+    void deserializeInitPacket(QDataStream &, QVariantList &) override;
+    void deserializeInvokeReplyPacket(QDataStream &in, int &ackedSerialId,
+                                      QVariant &value) override;
+    WireFormat wireFormat() const override { return WireFormat::Compact; }
+    void setObjectHandle(int handle, HandleMode mode) override
+    {
+        m_handle = handle;
+        m_handleMode = handle < 0 ? HandleMode::Name : mode;
+    }
+    void setCompression(QRemoteObjectNode::CompressionAlgorithm algorithm,
+                        qint64 threshold) override
+    {
+        m_compression = algorithm;
+        m_compressionThreshold = threshold;
+        m_compactPacket.setCompression(algorithm, threshold);
+    }
+    QRemoteObjectNode::CompressionAlgorithm compression() const override { return m_compression; }
+    qint64 compressionThreshold() const override { return m_compressionThreshold; }
+    void setBlobThreshold(qsizetype threshold) override
+    {
+        m_blobThreshold = threshold;
+        m_compactPacket.setBlobThreshold(threshold);
+    }
+    qsizetype blobThreshold() const override { return m_blobThreshold; }
+    void setPeers(const QList<CodecBase *> &peers) override;
+
+protected:
+    const QByteArray &getPayload() override {
+        return m_compactPacket.payload();
+    }
+    const QList<PacketSpan> *getPacketSpans() const override {
+        return &m_compactPacket.packetSpans();
+    }
+    const QList<OutgoingBlob> *getBlobs() const override {
+        return &m_compactPacket.outgoingBlobs();
+    }
+    const QList<int> *getAnnouncedHandles() const override {
+        return &m_announcedHandles;
+    }
+    const QList<int> *getAnnouncedTypes() const override {
+        return &m_types.pendingAnnouncements();
+    }
+    void setTypesAnnounced(const QList<int> &ids) override { m_types.setAnnounced(ids); }
+    void reset() override {
+        m_compactPacket.reset();
+        m_handleMode = HandleMode::Name;
+        m_announcedHandles.clear();
+        m_types.clearPeers();
+        m_types.clearPendingAnnouncements();
+    }
+private:
+    void startObjectPacket(QRemoteObjectPacketTypeEnum type, const QString &name);
+    void serializeProperty(QDataStream &ds, const QRemoteObjectSourceBase *source, int internalIndex);
+    void serializeProperty(QDataStream &ds, const QRemoteObjectSourceBase *source, int internalIndex,
+                           CompactTypeTable *types);
+    void serializeProperties(const QRemoteObjectSourceBase *source);
+    bool serializeGadgetDelta(const QRemoteObjectSourceBase *source, int internalIndex);
+    CompactPacket m_compactPacket;
+    CompactTypeTable m_types;
+    int m_handle = -1;
+    HandleMode m_handleMode = HandleMode::Name;
+    QList<int> m_announcedHandles;
+    QRemoteObjectNode::CompressionAlgorithm m_compression = QRemoteObjectNode::NoCompression;
+    qint64 m_compressionThreshold = 0;
+    qsizetype m_blobThreshold = 0;
+};
+
+// How values of a given type are converted for transmission by encodeVariant() and back
+// by decodeVariant(). Plans are resolved once per type (see codecPlan()) and kept by sources
+// and replicas for each property and parameter, so the per-value work is a switch.
+struct CodecPlan
+{
+    enum Kind : quint8 {
+        Plain,       // Sent as is
+        Enum,        // Sent as transferType
+        Sequential,  // Container of gadgets or QtROSequentialContainer, sent as QSQ_
+        Associative, // Container of gadgets or QtROAssociativeContainer, sent as QAS_
+        Dynamic      // QVariant, the plan depends on the type of the value
+    };
+    QMetaType type;
+    QMetaType transferType; // Enum only
+    QMetaType keyType;      // Key of a registered associative container
+    QMetaType valueType;    // Value of a registered sequential or associative container
+    Kind kind = Plain;
+};
+
+using CodecPlanList = QList<CodecPlan>;
+
 QMetaType transferTypeForEnum(QMetaType enumType);
+CodecPlan codecPlan(QMetaType metaType);
+// Drops the cached plan of metaType, which has to be called before a type is unregistered
+// as its id can be reused by the next registered type
+void forgetCodecPlan(QMetaType metaType);
 QVariant encodeVariant(const QVariant &value);
+QVariant encodeVariant(const QVariant &value, const CodecPlan &plan);
 QVariant decodeVariant(QVariant &&value, QMetaType metaType);
+QVariant decodeVariant(QVariant &&value, const CodecPlan &plan);
 
 } // namespace QRemoteObjectPackets
 
 QT_END_NAMESPACE
 
+QT_DECL_METATYPE_EXTERN_TAGGED(QRemoteObjectPackets::GadgetDelta, QRemoteObjectPackets__GadgetDelta,
+                               /* not exported */)
 QT_DECL_METATYPE_EXTERN_TAGGED(QRemoteObjectPackets::QRO_, QRemoteObjectPackets__QRO_,
                                /* not exported */)
 
@@ -15,6 +15,7 @@
 #include <QtCore/qcoreapplication.h>
 #include <QtCore/qdatastream.h>
 #include <QtCore/qelapsedtimer.h>
+#include <QtCore/qmutex.h>
 #include <QtCore/qvariant.h>
 #include <QtCore/qthread.h>
 
@@ -49,18 +50,52 @@ QRemoteObjectReplicaImplementation::QRemoteObjectReplicaImplementation(const QSt
     , m_objectSignature(QtPrivate::qtro_classinfo_signature(m_metaObject))
     , m_state(meta ? QRemoteObjectReplica::Default : QRemoteObjectReplica::Uninitialized)
 {
+    if (meta)
+        buildCodecPlans();
 }
 
 QRemoteObjectReplicaImplementation::~QRemoteObjectReplicaImplementation()
 {
 }
 
+namespace {
+struct ReplicaExtensionRegistry
+{
+    QMutex mutex;
+    QHash<const QMetaObject *, const QtPrivate::ReplicaExtension *> extensions;
+};
+}
+
+Q_GLOBAL_STATIC(ReplicaExtensionRegistry, replicaExtensionRegistry)
+
+void QtPrivate::qtro_register_replica_extension(const QMetaObject *metaObject,
+                                                const ReplicaExtension *extension)
+{
+    ReplicaExtensionRegistry *registry = replicaExtensionRegistry();
+    QMutexLocker lock(&registry->mutex);
+    registry->extensions.insert(metaObject, extension);
+}
+
+// The extension of the closest generated class, metaObject can be a subclass of it
+static const QtPrivate::ReplicaExtension *replicaExtension(const QMetaObject *metaObject)
+{
+    ReplicaExtensionRegistry *registry = replicaExtensionRegistry();
+    QMutexLocker lock(&registry->mutex);
+    for (; metaObject && metaObject != &QRemoteObjectReplica::staticMetaObject;
+         metaObject = metaObject->superClass()) {
+        if (const auto extension = registry->extensions.value(metaObject))
+            return extension;
+    }
+    return nullptr;
+}
+
 QConnectedReplicaImplementation::QConnectedReplicaImplementation(const QString &name, const QMetaObject *meta, QRemoteObjectNode *node)
     : QRemoteObjectReplicaImplementation(name, meta, node), connectionToSource(nullptr)
 {
     m_heartbeatTimer.setTimerType(Qt::CoarseTimer);
     m_heartbeatTimer.setSingleShot(true);
     m_heartbeatTimer.setInterval(node->heartbeatInterval());
+    m_subscriptionMode = node->subscriptionMode(name);
 
     connect(node, &QRemoteObjectNode::heartbeatIntervalChanged, this, [this](int interval) {
         m_heartbeatTimer.stop();
@@ -87,7 +122,7 @@ QConnectedReplicaImplementation::QConnectedReplicaImplementation(const QString &
                 qCDebug(QT_REMOTEOBJECT) << "Ignoring heartbeat as there is no source connected.";
                 return;
             }
-            connectionToSource->d_func()->m_codec->serializePingPacket(m_objectName);
+            codecForSource()->serializePingPacket(m_objectName);
             if (sendCommandWithReply(0).d->serialId == -1) {
                 m_heartbeatTimer.stop();
                 auto clientIo = qobject_cast<QtROClientIoDevice *>(connectionToSource);
@@ -160,6 +195,27 @@ void QRemoteObjectReplicaImplementation::emitNotified()
     QMetaObject::activate(this, metaObject(), notifiedIndex, args);
 }
 
+void QRemoteObjectReplicaImplementation::emitTransferProgress(qint64 bytesReceived,
+                                                              qint64 bytesTotal)
+{
+    const static int transferProgressIndex =
+            QRemoteObjectReplica::staticMetaObject.indexOfMethod("transferProgress(qint64,qint64)");
+    Q_ASSERT(transferProgressIndex != -1);
+    void *args[] = {nullptr, &bytesReceived, &bytesTotal};
+    QMetaObject::activate(this, metaObject(), transferProgressIndex, args);
+}
+
+QRemoteObjectPackets::CodecBase *QConnectedReplicaImplementation::codecForSource()
+{
+    Q_ASSERT(connectionToSource);
+    auto d = connectionToSource->d_func();
+    QRemoteObjectPackets::CodecBase *codec = d->m_codec.get();
+    // Only use the handle while it refers to us on the current connection
+    if (m_sourceHandle >= 0 && d->m_handleNames.value(m_sourceHandle) == m_objectName)
+        codec->setObjectHandle(m_sourceHandle, QRemoteObjectPackets::HandleMode::Handle);
+    return codec;
+}
+
 bool QConnectedReplicaImplementation::sendCommand()
 {
     Q_ASSERT(connectionToSource);
@@ -180,6 +236,16 @@ QList<int> QConnectedReplicaImplementation::childIndices() const
 void QConnectedReplicaImplementation::initialize(QVariantList &&values)
 {
     qCDebug(QT_REMOTEOBJECT) << "initialize()" << m_propertyStorage.size();
+    // Generated replicas register their extension from initialize(), which runs after we
+    // were created
+    if (!m_extensionResolved) {
+        m_extensionResolved = true;
+        const QtPrivate::ReplicaExtension *extension = replicaExtension(m_metaObject);
+        if (extension && extension->version >= 1)
+            m_deserializeCompactProperty = extension->deserializeCompactProperty;
+    }
+    // The source tells the version of the new values separately, if it keeps one
+    m_propertyVersion = {};
     const int nParam = int(values.size());
     QVarLengthArray<int> changedProperties(nParam);
     const int offset = m_propertyOffset;
@@ -187,8 +253,7 @@ void QConnectedReplicaImplementation::initialize(QVariantList &&values)
         qCDebug(QT_REMOTEOBJECT) << "  in loop" << i << m_propertyStorage.size();
         changedProperties[i] = -1;
         if (m_propertyStorage[i] != values.at(i)) {
-            const QMetaProperty property = m_metaObject->property(i+offset);
-            m_propertyStorage[i] = QRemoteObjectPackets::decodeVariant(std::move(values[i]), property.metaType());
+            m_propertyStorage[i] = QRemoteObjectPackets::decodeVariant(std::move(values[i]), m_propertyPlans.value(i));
             changedProperties[i] = i;
         }
         qCDebug(QT_REMOTEOBJECT) << "SETPROPERTY" << i << m_metaObject->property(i+offset).name()
@@ -215,6 +280,38 @@ void QConnectedReplicaImplementation::initialize(QVariantList &&values)
     qCDebug(QT_REMOTEOBJECT) << "isSet = true for" << m_objectName;
     if (node()->heartbeatInterval())
         m_heartbeatTimer.start();
+    m_canSubscribe = true;
+    updateSubscription();
+}
+
+// The source sent the version of our values. After we reconnected with a version of its
+// current epoch, it also sent the values of the properties that changed since instead of
+// all of them (see QRemoteObjectRootSource::addListener()).
+void QConnectedReplicaImplementation::resync(const QRemoteObjectPackets::PropertyVersion &version,
+                                             const QList<int> &properties, QVariantList &&values)
+{
+    const auto currentState = state();
+    if (currentState == QRemoteObjectReplica::Valid) {
+        m_propertyVersion = version;
+        return;
+    }
+    if (currentState != QRemoteObjectReplica::Suspect || version.epoch == 0
+        || version.epoch != m_propertyVersion.epoch) {
+        qCWarning(QT_REMOTEOBJECT) << "Unexpected resync of" << m_objectName << "in state" << currentState;
+        return;
+    }
+
+    qCDebug(QT_REMOTEOBJECT) << "resync()" << m_objectName << "from version"
+                             << m_propertyVersion.version << "to" << version.version
+                             << "with" << properties.size() << "changed properties";
+    QVariantList current = m_propertyStorage;
+    for (qsizetype i = 0; i < properties.size(); ++i) {
+        const int index = properties.at(i);
+        if (index >= 0 && index < current.size())
+            current[index] = std::move(values[i]);
+    }
+    initialize(std::move(current));
+    m_propertyVersion = version;
 }
 
 void QRemoteObjectReplicaImplementation::emitInitialized()
@@ -254,6 +351,24 @@ void QRemoteObjectReplicaImplementation::setDynamicMetaObject(const QMetaObject
     Q_ASSERT(!m_metaObject);
 
     m_metaObject = meta;
+    buildCodecPlans();
+}
+
+void QRemoteObjectReplicaImplementation::buildCodecPlans()
+{
+    m_propertyPlans.clear();
+    for (int index = m_propertyOffset; index < m_metaObject->propertyCount(); ++index)
+        m_propertyPlans << QRemoteObjectPackets::codecPlan(m_metaObject->property(index).metaType());
+
+    m_signalPlans.clear();
+    for (int index = m_signalOffset; index < m_metaObject->methodCount(); ++index) {
+        const QMetaMethod method = m_metaObject->method(index);
+        QRemoteObjectPackets::CodecPlanList plans;
+        const int count = method.parameterCount();
+        for (int i = 0; i < count; ++i)
+            plans << QRemoteObjectPackets::codecPlan(method.parameterMetaType(i));
+        m_signalPlans << plans;
+    }
 }
 
 void QConnectedReplicaImplementation::setDynamicMetaObject(const QMetaObject *meta)
@@ -269,12 +384,10 @@ void QConnectedReplicaImplementation::setDynamicMetaObject(const QMetaObject *me
 
 void QRemoteObjectReplicaImplementation::setDynamicProperties(QVariantList &&values)
 {
-    const int offset = m_propertyOffset;
     int propertyIndex = -1;
     for (auto &prop : values) {
         propertyIndex++;
-        const QMetaProperty property = m_metaObject->property(propertyIndex+offset);
-        prop = QRemoteObjectPackets::decodeVariant(std::move(prop), property.metaType());
+        prop = QRemoteObjectPackets::decodeVariant(std::move(prop), m_propertyPlans.value(propertyIndex));
     }
     //rely on order of properties;
     setProperties(std::move(values));
@@ -301,6 +414,8 @@ void QConnectedReplicaImplementation::setDynamicProperties(QVariantList &&values
     emitNotified();
 
     qCDebug(QT_REMOTEOBJECT) << "isSet = true for" << m_objectName;
+    m_canSubscribe = true;
+    updateSubscription();
 }
 
 bool QConnectedReplicaImplementation::isInitialized() const
@@ -359,7 +474,7 @@ void QConnectedReplicaImplementation::_q_send(QMetaObject::Call call, int index,
         if (index < m_methodOffset) //index - m_methodOffset < 0 is invalid, and can't be resolved on the Source side
             qCWarning(QT_REMOTEOBJECT) << "Skipping invalid method invocation.  Index not found:" << index << "( offset =" << m_methodOffset << ") object:" << m_objectName << this->m_metaObject->method(index).name();
         else {
-            connectionToSource->d_func()->m_codec->serializeInvokePacket(m_objectName, call, index - m_methodOffset, args);
+            codecForSource()->serializeInvokePacket(m_objectName, call, index - m_methodOffset, args);
             sendCommand();
         }
     } else {
@@ -367,7 +482,7 @@ void QConnectedReplicaImplementation::_q_send(QMetaObject::Call call, int index,
         if (index < m_propertyOffset) //index - m_propertyOffset < 0 is invalid, and can't be resolved on the Source side
             qCWarning(QT_REMOTEOBJECT) << "Skipping invalid property invocation.  Index not found:" << index << "( offset =" << m_propertyOffset << ") object:" << m_objectName << this->m_metaObject->property(index).name();
         else {
-            connectionToSource->d_func()->m_codec->serializeInvokePacket(m_objectName, call, index - m_propertyOffset, args);
+            codecForSource()->serializeInvokePacket(m_objectName, call, index - m_propertyOffset, args);
             sendCommand();
         }
     }
@@ -383,7 +498,7 @@ QRemoteObjectPendingCall QConnectedReplicaImplementation::_q_sendWithReply(QMeta
 
     qCDebug(QT_REMOTEOBJECT) << "Send" << call << this->m_metaObject->method(index).name() << index << args << connectionToSource;
     int serialId = (m_curSerialId == std::numeric_limits<int>::max() ? 1 : m_curSerialId++);
-    connectionToSource->d_func()->m_codec->serializeInvokePacket(m_objectName, call, index - m_methodOffset, args, serialId);
+    codecForSource()->serializeInvokePacket(m_objectName, call, index - m_methodOffset, args, serialId);
     return sendCommandWithReply(serialId);
 }
 
@@ -479,6 +594,8 @@ void QConnectedReplicaImplementation::setDisconnected()
 {
     Q_ASSERT(connectionToSource);
     connectionToSource.clear();
+    m_subscription.clear();
+    m_canSubscribe = false;
     setState(QRemoteObjectReplica::State::Suspect);
     for (const int index : childIndices()) {
         auto pointerToQObject = qvariant_cast<QObject *>(getProperty(index));
@@ -491,7 +608,116 @@ void QConnectedReplicaImplementation::setDisconnected()
 void QConnectedReplicaImplementation::requestRemoteObjectSource()
 {
     Q_ASSERT(connectionToSource);
-    connectionToSource->d_func()->m_codec->serializeAddObjectPacket(m_objectName, needsDynamicInitialization());
+    // Tell the source if the definition of its class is cached, to only get the values. The
+    // class is built right away, a definition that doesn't decode isn't announced.
+    QByteArray cachedSignature;
+    m_cachedMetaObject = nullptr;
+    if (needsDynamicInitialization()) {
+        QRemoteObjectNodePrivate *nodePrivate = m_node->d_func();
+        const QByteArray signature = nodePrivate->connectedSources.value(m_objectName).objectSignature;
+        m_cachedMetaObject = nodePrivate->addCachedDynamicType(connectionToSource, signature);
+        if (m_cachedMetaObject)
+            cachedSignature = signature;
+    }
+    connectionToSource->d_func()->m_codec->serializeAddObjectPacket(
+            m_objectName, needsDynamicInitialization(), m_node->minimumUpdateInterval(m_objectName),
+            m_propertyVersion, cachedSignature);
+    sendCommand();
+    // The source sends everything to a new listener, until we subscribe once initialized
+    m_subscription.clear();
+    m_canSubscribe = false;
+}
+
+void QConnectedReplicaImplementation::subscribeSignal(int index)
+{
+    if (m_subscriptionMode != QRemoteObjectNode::SubscribeOnUse)
+        return;
+    const int signalIndex = index - m_signalOffset;
+    if (signalIndex < 0 || (m_numSignals > 0 && signalIndex >= m_numSignals))
+        return;
+    if (signalIndex < m_usedSignals.size() && m_usedSignals.testBit(signalIndex))
+        return;
+    if (signalIndex >= m_usedSignals.size())
+        m_usedSignals.resize(std::max(signalIndex + 1, m_numSignals));
+    m_usedSignals.setBit(signalIndex);
+    updateSubscription();
+}
+
+void QConnectedReplicaImplementation::subscribeProperty(int i)
+{
+    if (m_subscriptionMode != QRemoteObjectNode::SubscribeOnUse || !m_metaObject)
+        return;
+    const int notifyIndex = m_metaObject->property(i + m_propertyOffset).notifySignalIndex();
+    if (notifyIndex >= 0)
+        subscribeSignal(notifyIndex);
+}
+
+void QConnectedReplicaImplementation::setSubscriptionMode(QRemoteObjectNode::SubscriptionMode mode)
+{
+    m_subscriptionMode = mode;
+    updateSubscription();
+}
+
+// The signals (by index - m_signalOffset) to subscribe to, an empty mask subscribes to all
+QBitArray QConnectedReplicaImplementation::subscriptionMask() const
+{
+    if (m_subscriptionMode == QRemoteObjectNode::SubscribeAll || !m_metaObject || m_numSignals == 0)
+        return QBitArray();
+
+    QBitArray mask(m_numSignals);
+    const auto subscribe = [this, &mask](int index) {
+        const int signalIndex = index - m_signalOffset;
+        if (signalIndex >= 0 && signalIndex < mask.size())
+            mask.setBit(signalIndex);
+    };
+    // Child replicas have their own subscription, but need to follow pointer changes
+    for (const int index : m_childIndices)
+        subscribe(m_metaObject->property(index + m_propertyOffset).notifySignalIndex());
+
+    const QStringList members = m_node->subscribedMembers(m_objectName);
+    for (const QString &member : members) {
+        const QByteArray name = member.toLatin1();
+        const int propertyIndex = m_metaObject->indexOfProperty(name.constData());
+        if (propertyIndex >= m_propertyOffset) {
+            subscribe(m_metaObject->property(propertyIndex).notifySignalIndex());
+            continue;
+        }
+        bool found = false;
+        for (int index = m_signalOffset; index < m_signalOffset + m_numSignals; ++index) {
+            if (m_metaObject->method(index).name() == name) {
+                subscribe(index);
+                found = true;
+            }
+        }
+        if (!found)
+            qCWarning(QT_REMOTEOBJECT) << "Ignoring subscription to unknown member" << member
+                                       << "of" << m_objectName;
+    }
+
+    if (m_subscriptionMode == QRemoteObjectNode::SubscribeOnUse) {
+        for (int signalIndex = 0; signalIndex < m_usedSignals.size(); ++signalIndex) {
+            if (m_usedSignals.testBit(signalIndex) && signalIndex < mask.size())
+                mask.setBit(signalIndex);
+        }
+    }
+    return mask;
+}
+
+// Sends the subscription to the source if it changed. Only sources using the compact codec
+// understand it, others keep sending everything.
+void QConnectedReplicaImplementation::updateSubscription()
+{
+    if (!m_canSubscribe || !connectionToSource)
+        return;
+    if (connectionToSource->d_func()->m_codec->wireFormat() != QRemoteObjectPackets::WireFormat::Compact)
+        return;
+
+    const QBitArray mask = subscriptionMask();
+    if (mask == m_subscription)
+        return;
+    qCDebug(QT_REMOTEOBJECT) << "Subscribing" << m_objectName << mask;
+    m_subscription = mask;
+    codecForSource()->serializeSubscribePacket(m_objectName, mask);
     sendCommand();
 }
 
@@ -564,6 +790,14 @@ void QConnectedReplicaImplementation::configurePrivate(QRemoteObjectReplica *rep
 
         QRemoteObjectReplicaImplementation::configurePrivate(rep);
 
+        // Connections made before the replica was acquired don't go through connectNotify()
+        if (m_subscriptionMode == QRemoteObjectNode::SubscribeOnUse) {
+            for (int index = m_signalOffset; index < m_signalOffset + m_numSignals; ++index) {
+                if (rep->isSignalConnected(m_metaObject->method(index)))
+                    subscribeSignal(index);
+            }
+        }
+
         // ensure that notify signals are emitted for the new replica, when
         // we are initializing an nth replica of the same type
         if (!firstReplicaInstance) {
@@ -624,7 +858,11 @@ void QConnectedReplicaImplementation::configurePrivate(QRemoteObjectReplica *rep
     and can be interacted with.
 
     \value Suspect Error state that occurs if the connection to the source is
-    lost after it is initialized.
+    lost after it is initialized. Since 6.9, when the replica reconnects to
+    the same source, the source only sends the properties that changed
+    while the replica was disconnected, provided both nodes use the compact
+    encoding and the source has no child objects, models, or properties
+    without notify signal.
 
     \value SignatureMismatch Error state that occurs if a connection to the
     source is made, but the source and replica are not derived from the same
@@ -666,6 +904,20 @@ void QConnectedReplicaImplementation::configurePrivate(QRemoteObjectReplica *rep
     and \c notified allows the developer to distinguish between these two cases.
 */
 
+/*!
+    \fn void QRemoteObjectReplica::transferProgress(qint64 bytesReceived, qint64 bytesTotal)
+    \since 6.9
+
+    This signal is emitted while a packet for this replica that is larger than
+    the transfer chunk size of the source's node is received, such as a
+    property holding a large QByteArray or the initial values of the replica.
+    \a bytesReceived is the number of bytes of the packet received so far,
+    \a bytesTotal its size. Once \a bytesReceived equals \a bytesTotal the
+    packet is decoded and the replica updated.
+
+    \sa QRemoteObjectNode::setTransferChunkSize()
+*/
+
 /*!
     \internal
     \enum QRemoteObjectReplica::ConstructorType
@@ -730,9 +982,32 @@ QRemoteObjectPendingCall QRemoteObjectReplica::sendWithReply(QMetaObject::Call c
 */
 const QVariant QRemoteObjectReplica::propAsVariant(int i) const
 {
+    d_impl->subscribeProperty(i);
     return d_impl->getProperty(i);
 }
 
+/*!
+    \internal
+    \since 6.9
+
+    Subscribes to \a signal when the node subscribes this replica on use, see
+    QRemoteObjectNode::setSubscription(). Connections can be made from any
+    thread, the subscription is updated in the thread of the replica.
+*/
+void QRemoteObjectReplica::connectNotify(const QMetaMethod &signal)
+{
+    const int index = signal.methodIndex();
+    if (QThread::currentThread() != thread()) {
+        QMetaObject::invokeMethod(this, [this, index]() {
+            if (d_impl)
+                d_impl->subscribeSignal(index);
+        }, Qt::QueuedConnection);
+        return;
+    }
+    if (d_impl)
+        d_impl->subscribeSignal(index);
+}
+
 /*!
     \internal
 */
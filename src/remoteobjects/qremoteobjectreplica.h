@@ -8,6 +8,7 @@
 
 #include <QtCore/qobject.h>
 #include <QtCore/qsharedpointer.h>
+#include <QtCore/qvariant.h>
 
 Q_MOC_INCLUDE(<QtRemoteObjects/qremoteobjectnode.h>)
 
@@ -19,6 +20,39 @@ class QRemoteObjectReplicaImplementation;
 class QReplicaImplementationInterface;
 class QRemoteObjectNode;
 
+namespace QtPrivate {
+
+Q_REMOTEOBJECTS_EXPORT
+void qtro_deserialize_compact_value(QDataStream &in, void *value, QMetaType type);
+
+// Used by repc generated replicas to read a property value into their storage, without
+// going through a QVariant of the transferred value first.
+template <typename T>
+static inline void qtro_deserialize_compact(QDataStream &in, QVariant &value)
+{
+    if (value.metaType() != QMetaType::fromType<T>())
+        value = QVariant(QMetaType::fromType<T>());
+    qtro_deserialize_compact_value(in, value.data(), QMetaType::fromType<T>());
+}
+
+// Capabilities of repc generated replicas that are not part of the QRemoteObjectReplica
+// vtable, registered once per class. Members are only appended, version tells which ones
+// the replica was compiled with.
+struct ReplicaExtension
+{
+    int version;
+    // Version 1: reads the value of the property index in the compact wire format into value,
+    // which holds the current value. Returns false, without reading anything, if the property
+    // has to be read into a QVariant.
+    bool (*deserializeCompactProperty)(QDataStream &in, QVariant &value, int index);
+};
+
+Q_REMOTEOBJECTS_EXPORT
+void qtro_register_replica_extension(const QMetaObject *metaObject,
+                                     const ReplicaExtension *extension);
+
+}
+
 class Q_REMOTEOBJECTS_EXPORT QRemoteObjectReplica : public QObject
 {
     Q_OBJECT
@@ -48,6 +82,7 @@ Q_SIGNALS:
     void initialized();
     void notified();
     void stateChanged(State state, State oldState);
+    void transferProgress(qint64 bytesReceived, qint64 bytesTotal);
 
 protected:
     enum ConstructorType {DefaultConstructor, ConstructWithNode};
@@ -62,6 +97,7 @@ protected:
     void setProperties(QVariantList &&);
     void setChild(int i, const QVariant &);
     const QVariant propAsVariant(int i) const;
+    void connectNotify(const QMetaMethod &signal) override;
     void persistProperties(const QString &repName, const QByteArray &repSig, const QVariantList &props) const;
     QVariantList retrieveProperties(const QString &repName, const QByteArray &repSig) const;
     void initializeNode(QRemoteObjectNode *node, const QString &name = QString());
@@ -21,6 +21,7 @@
 
 #include "qremoteobjectpacket_p.h"
 
+#include <QtCore/qbitarray.h>
 #include <QtCore/qcompilerdetection.h>
 #include <QtCore/qdatastream.h>
 #include <QtCore/qpointer.h>
@@ -43,6 +44,9 @@ public:
     virtual QRemoteObjectReplica::State state() const = 0;
     virtual bool waitForSource(int) = 0;
     virtual QRemoteObjectNode *node() const = 0;
+    // Members used on the replica, see QRemoteObjectNode::SubscribeOnUse
+    virtual void subscribeSignal(int index) { Q_UNUSED(index) }
+    virtual void subscribeProperty(int i) { Q_UNUSED(i) }
 
     virtual void _q_send(QMetaObject::Call call, int index, const QVariantList &args) = 0;
     virtual QRemoteObjectPendingCall _q_sendWithReply(QMetaObject::Call call, int index, const QVariantList &args) = 0;
@@ -88,6 +92,7 @@ public:
     virtual void configurePrivate(QRemoteObjectReplica *);
     void emitInitialized();
     void emitNotified();
+    void emitTransferProgress(qint64 bytesReceived, qint64 bytesTotal);
     QRemoteObjectNode *node() const override { return m_node; }
 
     void _q_send(QMetaObject::Call call, int index, const QVariantList &args) override = 0;
@@ -97,8 +102,14 @@ public:
     virtual void setDynamicMetaObject(const QMetaObject *meta);
     virtual void setDynamicProperties(QVariantList &&values);
 
+    void buildCodecPlans();
+
     QString m_objectName;
     const QMetaObject *m_metaObject;
+    // Decode plans of the properties (by property index) and of the method parameters (by
+    // method index - m_signalOffset), resolved once the meta object is known
+    QRemoteObjectPackets::CodecPlanList m_propertyPlans;
+    QList<QRemoteObjectPackets::CodecPlanList> m_signalPlans;
 
     //Dynamic Replica data
     int m_numSignals;//TODO maybe here too
@@ -123,14 +134,22 @@ public:
     bool waitForSource(int timeout) override;
     QList<int> childIndices() const;
     void initialize(QVariantList &&values);
+    void resync(const QRemoteObjectPackets::PropertyVersion &version, const QList<int> &properties,
+                QVariantList &&values);
     void configurePrivate(QRemoteObjectReplica *) override;
     void requestRemoteObjectSource();
+    QRemoteObjectPackets::CodecBase *codecForSource();
     bool sendCommand();
     QRemoteObjectPendingCall sendCommandWithReply(int serialId);
     bool waitForFinished(const QRemoteObjectPendingCall &call, int timeout) override;
     void notifyAboutReply(int ackedSerialId, const QVariant &value) override;
     void setConnection(QtROIoDeviceBase *conn);
     void setDisconnected();
+    void subscribeSignal(int index) override;
+    void subscribeProperty(int i) override;
+    void setSubscriptionMode(QRemoteObjectNode::SubscriptionMode mode);
+    QBitArray subscriptionMask() const;
+    void updateSubscription();
 
     void _q_send(QMetaObject::Call call, int index, const QVariantList &args) override;
     QRemoteObjectPendingCall _q_sendWithReply(QMetaObject::Call call, int index, const QVariantList& args) override;
@@ -139,8 +158,26 @@ public:
     void setDynamicProperties(QVariantList &&) override;
     QList<QRemoteObjectReplica *> m_parentsNeedingConnect;
     QVariantList m_propertyStorage;
+    // The typed property reader of the repc generated class (see QtPrivate::ReplicaExtension),
+    // resolved once initialized
+    QRemoteObjectPackets::CompactPropertyReader m_deserializeCompactProperty = nullptr;
+    bool m_extensionResolved = false;
     QList<int> m_childIndices;
     QPointer<QtROIoDeviceBase> connectionToSource;
+    // Handle the source announced for us, see codecForSource()
+    int m_sourceHandle = -1;
+    // See QRemoteObjectNode::setSubscription(). The signals (by index - m_signalOffset) used
+    // on the replica, and the mask sent to the source, which is only sent once initialized.
+    QRemoteObjectNode::SubscriptionMode m_subscriptionMode = QRemoteObjectNode::SubscribeAll;
+    QBitArray m_usedSignals;
+    QBitArray m_subscription;
+    bool m_canSubscribe = false;
+    // The version of the values as told by the source, sent with AddObject after reconnecting
+    // to only get the properties changed since
+    QRemoteObjectPackets::PropertyVersion m_propertyVersion;
+    // The class built from the cached definition announced with AddObject, the source only
+    // sends the values then
+    const QMetaObject *m_cachedMetaObject = nullptr;
 
     // pending call data
     int m_curSerialId = 1; // 0 is reserved for heartbeat signals
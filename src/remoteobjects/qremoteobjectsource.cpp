@@ -7,12 +7,17 @@
 #include "qremoteobjectdynamicreplica.h"
 
 #include "qconnectionfactories_p.h"
+#include "qremoteobjectdatagram_p.h"
 #include "qremoteobjectsourceio_p.h"
 #include "qremoteobjectabstractitemmodeladapter_p.h"
 
 #include <QtCore/qmetaobject.h>
+#include <QtCore/qmutex.h>
 #include <QtCore/qvarlengtharray.h>
 #include <QtCore/qabstractitemmodel.h>
+#include <QtCore/qrandom.h>
+#include <QtCore/qscopeguard.h>
+#include <QtCore/qtimer.h>
 
 #include <algorithm>
 #include <iterator>
@@ -152,8 +157,40 @@ inline bool qtro_is_cloned_method(const QMetaObject *mobj, int index)
     return false;
 }
 
+namespace {
+struct ApiExtensionRegistry
+{
+    QMutex mutex;
+    QHash<const SourceApiMap *, const QtPrivate::SourceApiMapExtension *> extensions;
+};
+}
+
+Q_GLOBAL_STATIC(ApiExtensionRegistry, apiExtensionRegistry)
+
+void QtPrivate::qtro_register_api_extension(const SourceApiMap *api,
+                                            const SourceApiMapExtension *extension)
+{
+    ApiExtensionRegistry *registry = apiExtensionRegistry();
+    QMutexLocker lock(&registry->mutex);
+    registry->extensions.insert(api, extension);
+}
+
+static const QtPrivate::SourceApiMapExtension *apiExtension(const SourceApiMap *api)
+{
+    ApiExtensionRegistry *registry = apiExtensionRegistry();
+    QMutexLocker lock(&registry->mutex);
+    return registry->extensions.value(api);
+}
+
 SourceApiMap::~SourceApiMap()
-    = default;
+{
+    // Maps can outlive the registry when they are static
+    if (apiExtensionRegistry.isDestroyed())
+        return;
+    ApiExtensionRegistry *registry = apiExtensionRegistry();
+    QMutexLocker lock(&registry->mutex);
+    registry->extensions.remove(this);
+}
 
 QRemoteObjectSourceBase::QRemoteObjectSourceBase(QObject *obj, Private *d, const SourceApiMap *api,
                                                  QObject *adapter)
@@ -168,7 +205,9 @@ QRemoteObjectSourceBase::QRemoteObjectSourceBase(QObject *obj, Private *d, const
         return;
     }
 
+    resolveApiExtension();
     setConnections();
+    buildCodecPlans();
 
     const auto nChildren = api->m_models.size() + api->m_subclasses.size();
     if (nChildren > 0) {
@@ -235,6 +274,10 @@ QRemoteObjectRootSource::QRemoteObjectRootSource(QObject *obj, const SourceApiMa
     , m_name(api->name())
 {
     d->m_sourceIo->registerSource(this);
+    m_versionTimer.setSingleShot(true);
+    m_versionTimer.setInterval(1000);
+    QObject::connect(&m_versionTimer, &QTimer::timeout, this, [this]() { sendVersions(); });
+    resetVersions();
 }
 
 QRemoteObjectSourceBase::~QRemoteObjectSourceBase()
@@ -312,8 +355,14 @@ void QRemoteObjectSourceBase::resetObject(QObject *newObject)
     }
 
     setParent(newObject);
-    if (newObject)
+    if (newObject) {
         setConnections();
+        buildCodecPlans();
+    }
+    // The values replicas hold can't be compared to the ones of the new object
+    d->root->m_initParts.clear();
+    if (isRoot())
+        d->root->resetVersions();
 
     const auto nChildren = m_api->m_models.size() + m_api->m_subclasses.size();
     if (nChildren == 0)
@@ -341,6 +390,7 @@ QRemoteObjectSource::~QRemoteObjectSource()
         // been deleted
         delete it;
     }
+    d->m_sourceIo->releaseHandle(this);
 }
 
 QRemoteObjectRootSource::~QRemoteObjectRootSource()
@@ -358,6 +408,7 @@ QRemoteObjectRootSource::~QRemoteObjectRootSource()
     for (QtROIoDeviceBase *io : std::exchange(d->m_listeners, {})) {
         removeListener(io, true);
     }
+    delete d->m_datagram;
     delete d;
 }
 
@@ -452,9 +503,425 @@ bool QRemoteObjectSourceBase::invoke(QMetaObject::Call c, int index, const QVari
 
 void QRemoteObjectSourceBase::handleMetaCall(int index, QMetaObject::Call call, void **a)
 {
+    const int internalIndex = m_api->propertyRawIndexFromSignal(index);
+    if (internalIndex >= 0) {
+        d->root->m_initParts.clear();
+        // Also while nobody listens, replicas coming back need the changes they missed
+        if (isRoot())
+            d->root->updateVersion(internalIndex);
+    }
+
     if (d->m_listeners.empty())
         return;
 
+    if (internalIndex >= 0 && !updateSentValue(internalIndex)) {
+        qCDebug(QT_REMOTEOBJECT) << "Skipping unchanged property" << name() << internalIndex;
+        return;
+    }
+    const auto previousValueCleanup = qScopeGuard([this] { m_previousValue.clear(); });
+
+    const bool sentAsDatagram = internalIndex >= 0 && sendDatagram(internalIndex);
+    // Members of the datagram channel can have lost the previous value, if the change has
+    // to go over their connections it is sent whole instead of as a gadget delta
+    if (!sentAsDatagram && internalIndex >= 0 && hasDatagramMembers(internalIndex))
+        m_previousValue.clear();
+    const QList<QtROIoDeviceBase *> receivers = listenersFor(index, sentAsDatagram);
+    if (receivers.isEmpty())
+        return;
+    qCDebug(QT_REMOTEOBJECT) << "# Listeners" << receivers.size();
+
+    // Listeners can have negotiated different codecs (or compression settings). Serialize
+    // once per group of listeners whose codecs produce the same bytes, and write that
+    // payload to every listener in the group.
+    CodecBase *codec = receivers.constFirst()->d_func()->m_codec.get();
+    // The payload is also written to the other listeners of the group, which need to see
+    // the type names it introduces (see QRemoteObjectPackets::CompactTypeTable)
+    const auto setPeerCodecs = [](CodecBase *groupCodec, const QList<QtROIoDeviceBase *> &group) {
+        if (group.size() < 2)
+            return;
+        QList<CodecBase *> peers;
+        peers.reserve(group.size());
+        for (QtROIoDeviceBase *io : group)
+            peers << io->d_func()->m_codec.get();
+        groupCodec->setPeers(peers);
+    };
+    const auto sameCodec = [&codec](QtROIoDeviceBase *io) {
+        return io->d_func()->m_codec->producesSamePayload(*codec);
+    };
+    if (std::all_of(receivers.cbegin(), receivers.cend(), sameCodec)) {
+        setObjectHandle(codec, receivers);
+        setPeerCodecs(codec, receivers);
+        serializeMetaCall(codec, index, call, a);
+        codec->send(receivers);
+        return;
+    }
+
+    // Serializing can register types as sent (dynamic sources), every group needs to see them
+    const auto sentTypes = d->sentTypes;
+    QList<QtROIoDeviceBase *> pending = receivers;
+    while (!pending.isEmpty()) {
+        codec = pending.constFirst()->d_func()->m_codec.get();
+        const auto groupEnd = std::stable_partition(pending.begin(), pending.end(), sameCodec);
+        const QList<QtROIoDeviceBase *> listeners(pending.begin(), groupEnd);
+        pending.erase(pending.begin(), groupEnd);
+        d->sentTypes = sentTypes;
+        setObjectHandle(codec, listeners);
+        setPeerCodecs(codec, listeners);
+        serializeMetaCall(codec, index, call, a);
+        codec->send(listeners);
+    }
+}
+
+// Whether the property is a lossy property of the root with listeners in its datagram channel
+bool QRemoteObjectSourceBase::hasDatagramMembers(int internalIndex) const
+{
+    const QtRODatagramSender *datagram = d->m_datagram;
+    return datagram && isRoot() && datagram->hasMembers() && datagram->isLossy(internalIndex);
+}
+
+// Sends the change of a lossy property of the root to the listeners that joined its datagram
+// channel. Returns false if there are none, or if the change has to go over their connections.
+bool QRemoteObjectSourceBase::sendDatagram(int internalIndex)
+{
+    if (!hasDatagramMembers(internalIndex))
+        return false;
+    QtRODatagramSender *datagram = d->m_datagram;
+    const QVariant value = encodeVariant(m_sentValues.at(internalIndex),
+                                         m_propertyPlans.at(internalIndex));
+    return datagram->send(name(), internalIndex, value);
+}
+
+// The listeners to send the signal index to. Listeners that did not subscribe to it are left
+// out, as are listeners congested by unsent data according to the back pressure policy (see
+// QRemoteObjectHostBase::setBackPressure()), listeners that got an update of a throttled
+// property too recently, and the members of the datagram channel if the change was sent as
+// a datagram.
+QList<QtROIoDeviceBase *> QRemoteObjectSourceBase::listenersFor(int index, bool sentAsDatagram)
+{
+    QRemoteObjectSourceIo *sourceIo = d->m_sourceIo;
+    const auto policy = sourceIo->m_backPressurePolicy;
+    const int internalIndex = m_api->propertyRawIndexFromSignal(index);
+    const bool isProperty = internalIndex >= 0;
+    const bool backPressure = policy != QRemoteObjectHostBase::NoBackPressure
+            && (isProperty || policy != QRemoteObjectHostBase::ConflatePropertyChanges);
+    const bool throttled = isProperty
+            && (m_throttleIntervals.value(internalIndex) > 0 || !d->m_updateIntervals.isEmpty());
+    const bool filtered = !m_subscriptions.isEmpty();
+    if (!backPressure && !throttled && !filtered && !sentAsDatagram)
+        return d->m_listeners;
+
+    QList<QtROIoDeviceBase *> listeners;
+    listeners.reserve(d->m_listeners.size());
+    for (QtROIoDeviceBase *io : std::as_const(d->m_listeners)) {
+        if (sentAsDatagram && d->m_datagram->isMember(io))
+            continue;
+        if (filtered && !isSubscribed(io, index))
+            continue;
+        if (backPressure && sourceIo->isCongested(io)) {
+            if (policy == QRemoteObjectHostBase::DisconnectConsumer)
+                continue;
+            // Only the latest value of a property is sent once the listener caught up,
+            // other signals are dropped
+            if (isProperty) {
+                ++sourceIo->m_backPressureCounts[policy];
+                QList<int> &pending = m_conflatedSignals[io];
+                if (!pending.contains(index))
+                    pending << index;
+            } else {
+                ++sourceIo->m_droppedSignals;
+            }
+            continue;
+        }
+        if (throttled && isThrottled(io, index))
+            continue;
+        listeners << io;
+    }
+    return listeners;
+}
+
+// Replaces the signals io subscribed to. Properties it gets updates of again are sent right
+// away, as the value the replica has can be outdated.
+void QRemoteObjectSourceBase::setSubscription(QtROIoDeviceBase *io, const QBitArray &signalMask)
+{
+    if (!d->m_listeners.contains(io))
+        return;
+
+    const QBitArray previous = m_subscriptions.value(io);
+    if (signalMask.isEmpty())
+        m_subscriptions.remove(io);
+    else
+        m_subscriptions.insert(io, signalMask);
+    if (previous.isEmpty())
+        return;
+
+    for (int index = 0; index < previous.size(); ++index) {
+        if (previous.testBit(index) || !isSubscribed(io, index))
+            continue;
+        if (index < m_api->signalCount() && m_api->propertyRawIndexFromSignal(index) >= 0)
+            sendLatest(io, index);
+    }
+}
+
+bool QRemoteObjectSourceBase::isSubscribed(QtROIoDeviceBase *io, int index) const
+{
+    const auto it = m_subscriptions.constFind(io);
+    if (it == m_subscriptions.cend())
+        return true;
+    // Signals the replica does not know about are not filtered
+    return index >= it->size() || it->testBit(index);
+}
+
+// The minimum interval between two updates of the property notified by the signal index,
+// as declared in the .rep file or requested by the replica
+int QRemoteObjectSourceBase::throttleInterval(QtROIoDeviceBase *io, int index) const
+{
+    const int internalIndex = m_api->propertyRawIndexFromSignal(index);
+    return qMax(m_throttleIntervals.value(internalIndex), d->m_updateIntervals.value(io));
+}
+
+// Returns true if an update of the property notified by the signal index must not be sent
+// to io yet. The latest value is then sent once the current window ends.
+bool QRemoteObjectSourceBase::isThrottled(QtROIoDeviceBase *io, int index)
+{
+    const int interval = throttleInterval(io, index);
+    if (interval <= 0)
+        return false;
+    // Until the pending update is sent, which is always the full value, io must not get
+    // gadget deltas relative to values it did not see
+    const auto it = m_throttledSignals.constFind(io);
+    if (it != m_throttledSignals.cend() && it->contains(index))
+        return true;
+    QDeadlineTimer &window = m_throttleWindows[io][index];
+    if (window.hasExpired()) {
+        window.setRemainingTime(interval, Qt::PreciseTimer);
+        return false;
+    }
+
+    m_throttledSignals[io] << index;
+    QTimer::singleShot(int(window.remainingTime()), Qt::PreciseTimer, this,
+                       [this, io = QPointer<QtROIoDeviceBase>(io), index]() {
+        if (io)
+            sendThrottled(io, index);
+    });
+    return true;
+}
+
+void QRemoteObjectSourceBase::sendThrottled(QtROIoDeviceBase *io, int index)
+{
+    auto it = m_throttledSignals.find(io);
+    if (it == m_throttledSignals.end() || !it->removeOne(index))
+        return;
+    if (it->isEmpty())
+        m_throttledSignals.erase(it);
+    if (!d->m_listeners.contains(io))
+        return;
+
+    // A congested listener gets the value once it caught up
+    if (d->m_sourceIo->isCongested(io)) {
+        QList<int> &pending = m_conflatedSignals[io];
+        if (!pending.contains(index))
+            pending << index;
+        return;
+    }
+    m_throttleWindows[io][index].setRemainingTime(throttleInterval(io, index), Qt::PreciseTimer);
+    sendLatest(io, index);
+}
+
+// Sends the current value of the properties whose changes were held back from io
+void QRemoteObjectSourceBase::sendConflated(QtROIoDeviceBase *io)
+{
+    const QList<int> pending = m_conflatedSignals.take(io);
+    if (pending.isEmpty() || !d->m_listeners.contains(io))
+        return;
+
+    for (int index : pending)
+        sendLatest(io, index);
+}
+
+// Sends the current value of the property notified by the signal index to io
+void QRemoteObjectSourceBase::sendLatest(QtROIoDeviceBase *io, int index)
+{
+    // The subscription can have changed while the update was held back
+    if (!isSubscribed(io, index))
+        return;
+    CodecBase *codec = io->d_func()->m_codec.get();
+    const int internalIndex = m_api->propertyRawIndexFromSignal(index);
+    const auto target = m_api->isAdapterProperty(internalIndex) ? m_adapter : m_object;
+    const QMetaProperty property = target->metaObject()->property(m_api->propertyIndexFromSignal(index));
+    // Emit the notify signal on the replica as well, if its argument can be recreated
+    QVariant value = property.read(target);
+    void *args[] = { nullptr, nullptr };
+    bool canInvoke = true;
+    const int parameterCount = m_api->signalParameterCount(index);
+    if (parameterCount == 1) {
+        const int type = m_api->signalParameterType(index, 0);
+        if (type == QMetaType::QVariant)
+            args[1] = &value;
+        else if (type == property.metaType().id())
+            args[1] = value.data();
+        else
+            canInvoke = false;
+    } else if (parameterCount > 1) {
+        canInvoke = false;
+    }
+
+    setObjectHandle(codec, {io});
+    if (canInvoke) {
+        // m_previousValue is not set, the full value is sent
+        serializeMetaCall(codec, index, QMetaObject::InvokeMetaMethod, args);
+    } else {
+        codec->serializePropertyChangePacket(this, index);
+    }
+    codec->send(io);
+}
+
+// Drops the updates held back from io, which stopped listening, and its subscription
+void QRemoteObjectSourceBase::forgetListener(QtROIoDeviceBase *io)
+{
+    m_conflatedSignals.remove(io);
+    m_throttledSignals.remove(io);
+    m_throttleWindows.remove(io);
+    m_subscriptions.remove(io);
+    for (const auto &child : std::as_const(m_children)) {
+        if (child)
+            child->forgetListener(io);
+    }
+}
+
+// Whether every change of the values sent to a new listener, including those of the
+// children, is notified by a signal
+bool QRemoteObjectSourceBase::notifiesChanges() const
+{
+    if (!m_object)
+        return true;
+    if (m_adapter)
+        return false;
+    const int numProperties = m_api->propertyCount();
+    for (int i = 0; i < numProperties; ++i) {
+        if (m_api->isAdapterProperty(i))
+            return false;
+        const auto property = m_object->metaObject()->property(m_api->sourcePropertyIndex(i));
+        if (!property.isConstant() && !property.hasNotifySignal())
+            return false;
+    }
+    for (const auto &child : std::as_const(m_children)) {
+        if (child && !child->notifiesChanges())
+            return false;
+    }
+    return true;
+}
+
+bool QRemoteObjectSourceBase::updateSentValue(int internalIndex)
+{
+    if (m_api->isAdapterProperty(internalIndex))
+        return true;
+    const QMetaProperty property = m_object->metaObject()->property(m_api->sourcePropertyIndex(internalIndex));
+    // Child objects have their own sources
+    if (property.metaType().flags().testFlag(QMetaType::PointerToQObject))
+        return true;
+
+    QVariant value = property.read(m_object);
+    if (m_sentValues.size() <= internalIndex)
+        m_sentValues.resize(m_api->propertyCount());
+    QVariant &sent = m_sentValues[internalIndex];
+    if (sent.isValid() && sent.metaType() == value.metaType()
+        && value.metaType().isEqualityComparable() && sent == value) {
+        return false;
+    }
+    m_previousValue = std::exchange(sent, std::move(value));
+    return true;
+}
+
+void QRemoteObjectSourceBase::resolveApiExtension()
+{
+    if (m_api->isDynamic()) {
+        m_throttleIntervals = static_cast<const DynamicApiMap *>(m_api)->m_throttleIntervals;
+        return;
+    }
+    const QtPrivate::SourceApiMapExtension *extension = apiExtension(m_api);
+    if (!extension || extension->version < 1)
+        return;
+    m_serializeCompactProperty = extension->serializeCompactProperty;
+    if (extension->propertyThrottleInterval) {
+        const int numProperties = m_api->propertyCount();
+        m_throttleIntervals.reserve(numProperties);
+        for (int i = 0; i < numProperties; ++i)
+            m_throttleIntervals << extension->propertyThrottleInterval(i);
+    }
+}
+
+void QRemoteObjectSourceBase::buildCodecPlans()
+{
+    m_propertyPlans.clear();
+    m_signalPlans.clear();
+    m_methodPlans.clear();
+
+    const int numProperties = m_api->propertyCount();
+    m_propertyPlans.reserve(numProperties);
+    for (int i = 0; i < numProperties; ++i) {
+        const auto target = m_api->isAdapterProperty(i) ? m_adapter : m_object;
+        const auto property = target->metaObject()->property(m_api->sourcePropertyIndex(i));
+        m_propertyPlans << codecPlan(property.metaType());
+    }
+
+    const int numSignals = m_api->signalCount();
+    m_signalPlans.reserve(numSignals);
+    for (int i = 0; i < numSignals; ++i) {
+        CodecPlanList plans;
+        const int count = m_api->signalParameterCount(i);
+        for (int pi = 0; pi < count; ++pi)
+            plans << codecPlan(QMetaType(m_api->signalParameterType(i, pi)));
+        m_signalPlans << plans;
+    }
+
+    // Only methods of the object decode their arguments, see QRemoteObjectSourceIo::onServerRead()
+    const int numMethods = m_api->methodCount();
+    m_methodPlans.reserve(numMethods);
+    for (int i = 0; i < numMethods; ++i) {
+        CodecPlanList plans;
+        if (!m_api->isAdapterMethod(i)) {
+            const auto method = m_object->metaObject()->method(m_api->sourceMethodIndex(i));
+            const int count = method.parameterCount();
+            for (int pi = 0; pi < count; ++pi)
+                plans << codecPlan(method.parameterMetaType(pi));
+        }
+        m_methodPlans << plans;
+    }
+}
+
+void QRemoteObjectSourceBase::clearSentValues()
+{
+    // A new listener gets the current values, which aren't necessarily the ones sent last
+    m_sentValues.clear();
+    for (const auto &child : std::as_const(m_children)) {
+        if (child)
+            child->clearSentValues();
+    }
+}
+
+void QRemoteObjectSourceBase::setObjectHandle(CodecBase *codec, const QList<QtROIoDeviceBase *> &listeners) const
+{
+    if (m_handle < 0 || codec->wireFormat() != WireFormat::Compact)
+        return;
+
+    // Listeners that knew a removed object by the same handle get the name only
+    const bool retired = std::any_of(listeners.cbegin(), listeners.cend(), [this](QtROIoDeviceBase *io) {
+        return io->d_func()->isHandleRetired(m_handle);
+    });
+    if (retired) {
+        codec->setObjectHandle(-1, HandleMode::Name);
+        return;
+    }
+    // The name is only sent until every listener has received it together with the handle,
+    // the codec marks the handle announced when it sends the packet (see CodecBase::send())
+    const bool announced = std::all_of(listeners.cbegin(), listeners.cend(), [this](QtROIoDeviceBase *io) {
+        return io->d_func()->isHandleAnnounced(m_handle);
+    });
+    codec->setObjectHandle(m_handle, announced ? HandleMode::Handle : HandleMode::Announce);
+}
+
+void QRemoteObjectSourceBase::serializeMetaCall(CodecBase *codec, int index, QMetaObject::Call call, void **a)
+{
     int propertyIndex = m_api->propertyIndexFromSignal(index);
     if (propertyIndex >= 0) {
         const int internalIndex = m_api->propertyRawIndexFromSignal(index);
@@ -462,46 +929,289 @@ void QRemoteObjectSourceBase::handleMetaCall(int index, QMetaObject::Call call,
         const QMetaProperty mp = target->metaObject()->property(propertyIndex);
         qCDebug(QT_REMOTEOBJECT) << "Sending Invoke Property" << (m_api->isAdapterSignal(internalIndex) ? "via adapter" : "") << internalIndex << propertyIndex << mp.name() << mp.read(target);
 
-        d->codec->serializePropertyChangePacket(this, index);
+        codec->serializePropertyChangePacket(this, index);
         propertyIndex = internalIndex;
     }
 
-    qCDebug(QT_REMOTEOBJECT) << "# Listeners" << d->m_listeners.size();
     qCDebug(QT_REMOTEOBJECT) << "Invoke args:" << m_object
                              << (call == 0 ? QLatin1String("InvokeMetaMethod") : QStringLiteral("Non-invoked call: %d").arg(call))
                              << m_api->signalSignature(index) << *marshalArgs(index, a);
 
-    d->codec->serializeInvokePacket(name(), call, index, *marshalArgs(index, a), -1, propertyIndex);
-
-    d->codec->send(d->m_listeners);
+    codec->serializeSignalPacket(this, call, index, a, propertyIndex);
 }
 
-void QRemoteObjectRootSource::addListener(QtROIoDeviceBase *io, bool dynamic)
+// Sends the values to the new listener io. Compact listeners are told the version of the
+// values as well, and when they come back with a version of the current epoch (after a
+// reconnect), only get the properties changed since. Dynamic listeners that have the
+// definition of a class with our signature cached get the values only.
+void QRemoteObjectRootSource::addListener(QtROIoDeviceBase *io, bool dynamic, int updateInterval,
+                                          const PropertyVersion &since,
+                                          const QByteArray &cachedSignature)
 {
     d->m_listeners.append(io);
+    // Properties are sent with their type information from now on
+    if (dynamic && !d->isDynamic)
+        m_initParts.clear();
     d->isDynamic = d->isDynamic || dynamic;
-
-    if (dynamic) {
-        d->sentTypes.clear();
-        d->codec->serializeInitDynamicPacket(this);
-        d->codec->send(io);
+    if (updateInterval > 0)
+        d->m_updateIntervals.insert(io, updateInterval);
+    clearSentValues();
+
+    const auto &codec = io->d_func()->m_codec;
+    const bool versioned = m_versioned && codec->wireFormat() == WireFormat::Compact;
+    if (versioned && !dynamic && since.epoch == m_version.epoch
+        && since.version <= m_version.version) {
+        QList<int> changed;
+        for (int i = 0; i < m_propertyVersions.size(); ++i) {
+            if (m_propertyVersions.at(i) > since.version)
+                changed << i;
+        }
+        qCDebug(QT_REMOTEOBJECT) << "Resyncing" << m_name << "from version" << since.version
+                                 << "with" << changed.size() << "of" << m_propertyVersions.size()
+                                 << "properties";
+        setObjectHandle(codec.get(), {io});
+        codec->serializeResyncPacket(this, m_version, changed);
+        codec->send(io);
     } else {
-        d->codec->serializeInitPacket(this);
-        d->codec->send(io);
+        const bool withDefinition = cachedSignature.isEmpty()
+                || cachedSignature != m_api->objectSignature();
+        sendInit(io, dynamic, withDefinition);
+        if (versioned) {
+            setObjectHandle(codec.get(), {io});
+            codec->serializeResyncPacket(this, m_version, {});
+            codec->send(io);
+        }
     }
+    if (versioned)
+        m_versionedListeners.insert(io, m_version.version);
+    if (d->m_datagram && codec->wireFormat() == WireFormat::Compact)
+        sendDatagramChannel(io, false);
 }
 
 int QRemoteObjectRootSource::removeListener(QtROIoDeviceBase *io, bool shouldSendRemove)
 {
     d->m_listeners.removeAll(io);
+    d->m_updateIntervals.remove(io);
+    m_versionedListeners.remove(io);
+    if (d->m_datagram)
+        d->m_datagram->removeMember(io);
+    forgetListener(io);
     if (shouldSendRemove)
     {
-        d->codec->serializeRemoveObjectPacket(m_api->name());
-        d->codec->send(io);
+        const auto &codec = io->d_func()->m_codec;
+        codec->serializeRemoveObjectPacket(m_api->name());
+        codec->send(io);
     }
     return int(d->m_listeners.size());
 }
 
+// Replaces the datagram channel. The compact listeners are told about the new channel (or
+// that there is none), members of the previous channel have to join the new one.
+void QRemoteObjectRootSource::setDatagramChannel(const QtRODatagramChannelSettings &settings)
+{
+    if (d->m_datagram) {
+        // The members can have missed the last datagrams
+        for (QtROIoDeviceBase *io : d->m_datagram->members())
+            sendDatagramChannel(io, true);
+        delete std::exchange(d->m_datagram, nullptr);
+    }
+
+    QHostAddress group;
+    quint16 port = 0;
+    if (settings.address.isValid()) {
+        if (!parseDatagramAddress(settings.address, &group, &port)) {
+            qCWarning(QT_REMOTEOBJECT) << "Invalid datagram channel address" << settings.address
+                                       << "for" << m_name;
+        } else {
+            QList<int> properties;
+            const int numProperties = m_api->propertyCount();
+            for (const QString &propertyName : settings.lossyProperties) {
+                int internalIndex = -1;
+                for (int i = 0; i < numProperties && internalIndex < 0; ++i) {
+                    if (m_api->isAdapterProperty(i))
+                        continue;
+                    const auto property = m_object->metaObject()->property(m_api->sourcePropertyIndex(i));
+                    if (property.metaType().flags().testFlag(QMetaType::PointerToQObject))
+                        continue;
+                    if (QLatin1String(property.name()) == propertyName)
+                        internalIndex = i;
+                }
+                if (internalIndex < 0)
+                    qCWarning(QT_REMOTEOBJECT) << "Cannot send" << propertyName << "of" << m_name
+                                               << "as datagrams";
+                else if (!properties.contains(internalIndex))
+                    properties << internalIndex;
+            }
+            if (!properties.isEmpty()) {
+                d->m_datagram = new QtRODatagramSender(group, port, settings.address, properties, this);
+                QObject::connect(d->m_datagram, &QtRODatagramSender::watermarkDue, this, [this]() {
+                    for (QtROIoDeviceBase *io : d->m_datagram->members())
+                        sendDatagramChannel(io, false);
+                });
+            }
+        }
+    }
+
+    for (QtROIoDeviceBase *io : std::as_const(d->m_listeners)) {
+        if (io->d_func()->m_codec->wireFormat() == WireFormat::Compact)
+            sendDatagramChannel(io, false);
+    }
+}
+
+// Called when io tells whether it receives the datagrams. Members get the current values
+// of the lossy properties, to recover from the datagrams they missed.
+void QRemoteObjectRootSource::setDatagramMember(QtROIoDeviceBase *io, bool joined)
+{
+    if (!d->m_datagram || !d->m_listeners.contains(io))
+        return;
+    if (!joined) {
+        d->m_datagram->removeMember(io);
+        return;
+    }
+    d->m_datagram->addMember(io);
+    sendDatagramChannel(io, true);
+}
+
+void QRemoteObjectRootSource::sendDatagramChannel(QtROIoDeviceBase *io, bool withValues)
+{
+    DatagramChannelInfo info;
+    if (d->m_datagram) {
+        info = d->m_datagram->channelInfo();
+        if (withValues) {
+            info.values.reserve(info.properties.size());
+            for (int index : std::as_const(info.properties)) {
+                const auto property = m_object->metaObject()->property(m_api->sourcePropertyIndex(index));
+                info.values << encodeVariant(property.read(m_object), m_propertyPlans.at(index));
+            }
+        }
+    }
+    const auto &codec = io->d_func()->m_codec;
+    setObjectHandle(codec.get(), {io});
+    codec->serializeDatagramChannelPacket(m_name, info);
+    codec->send(io);
+}
+
+// Sends the init packet to io. Many replicas connect at once when a host (re)starts, the
+// parts of the packet that don't depend on the connection are serialized once for all of
+// them, until a value changes. Listeners receiving byte arrays as blobs don't share them.
+// A dynamic listener gets an InitPacket without the definition if withDefinition is false.
+void QRemoteObjectRootSource::sendInit(QtROIoDeviceBase *io, bool dynamic, bool withDefinition)
+{
+    CodecBase *codec = io->d_func()->m_codec.get();
+    const WireFormat wireFormat = codec->wireFormat();
+    auto parts = std::find_if(m_initParts.begin(), m_initParts.end(),
+                              [wireFormat, dynamic](const InitParts &p) {
+                                  return p.wireFormat == wireFormat && p.dynamic == dynamic;
+                              });
+    // Without a definition, properties serialized for a dynamic replica can add to sentTypes
+    const bool share = codec->blobThreshold() <= 0 && (dynamic || !d->isDynamic)
+            && (parts != m_initParts.end() || notifiesChanges());
+    if (dynamic)
+        d->sentTypes.clear();
+    if (!share) {
+        if (dynamic && !withDefinition) {
+            // The types the definition introduces to the replica are not sent with the values
+            QByteArray definition, properties;
+            codec->serializeInitParts(this, &definition, &properties);
+            setObjectHandle(codec, {io});
+            codec->serializeInitPacket(this, properties);
+        } else {
+            setObjectHandle(codec, {io});
+            if (dynamic)
+                codec->serializeInitDynamicPacket(this);
+            else
+                codec->serializeInitPacket(this);
+        }
+        codec->send(io);
+        return;
+    }
+
+    if (parts == m_initParts.end()) {
+        InitParts newParts{wireFormat, dynamic, {}, {}, {}};
+        codec->serializeInitParts(this, dynamic ? &newParts.definition : nullptr,
+                                  &newParts.properties);
+        newParts.sentTypes = d->sentTypes;
+        parts = m_initParts.insert(m_initParts.end(), std::move(newParts));
+        ++m_initPartsSerialized;
+    } else {
+        if (dynamic)
+            d->sentTypes = parts->sentTypes;
+        ++m_initPartsReused;
+    }
+    setObjectHandle(codec, {io});
+    if (dynamic && withDefinition)
+        codec->serializeInitDynamicPacket(this, parts->definition, parts->properties);
+    else
+        codec->serializeInitPacket(this, parts->properties);
+    codec->send(io);
+}
+
+// Starts a new history of the values, replicas holding values of an older one get them all
+void QRemoteObjectRootSource::resetVersions()
+{
+    m_version.epoch = QRandomGenerator::global()->generate64() | 1;
+    m_version.version = 0;
+    m_versionedListeners.clear();
+    const int numProperties = m_api->propertyCount();
+    m_propertyVersions.fill(0, numProperties);
+
+    m_versioned = m_object && m_children.isEmpty() && notifiesChanges();
+    for (int i = 0; i < numProperties && m_versioned; ++i) {
+        const auto property = m_object->metaObject()->property(m_api->sourcePropertyIndex(i));
+        m_versioned = !property.metaType().flags().testFlag(QMetaType::PointerToQObject);
+    }
+}
+
+void QRemoteObjectRootSource::updateVersion(int internalIndex)
+{
+    if (!m_versioned)
+        return;
+    m_propertyVersions[internalIndex] = ++m_version.version;
+    if (!m_versionedListeners.isEmpty() && !m_versionTimer.isActive())
+        m_versionTimer.start();
+}
+
+// Whether io got every change up to the current version. *later is set if it will have
+// once the changes held back from it are sent.
+bool QRemoteObjectRootSource::canConfirmVersion(QtROIoDeviceBase *io, bool *later) const
+{
+    if (m_conflatedSignals.contains(io) || m_throttledSignals.contains(io)
+        || d->m_sourceIo->isOverHighWaterMark(io)) {
+        *later = true;
+        return false;
+    }
+    // Datagrams can be lost
+    if (d->m_datagram && d->m_datagram->isMember(io))
+        return false;
+    if (m_subscriptions.contains(io)) {
+        const int numSignals = m_api->signalCount();
+        for (int index = 0; index < numSignals; ++index) {
+            if (m_api->propertyRawIndexFromSignal(index) >= 0 && !isSubscribed(io, index))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Tells the versioned listeners the version of the values they have, a little after the
+// last change, so that they only need the properties changed since when they come back
+void QRemoteObjectRootSource::sendVersions()
+{
+    bool later = false;
+    for (auto it = m_versionedListeners.begin(); it != m_versionedListeners.end(); ++it) {
+        QtROIoDeviceBase *io = it.key();
+        if (it.value() == m_version.version || !canConfirmVersion(io, &later))
+            continue;
+        it.value() = m_version.version;
+        const auto &codec = io->d_func()->m_codec;
+        setObjectHandle(codec.get(), {io});
+        codec->serializeResyncPacket(this, m_version, {});
+        codec->send(io);
+    }
+    if (later)
+        m_versionTimer.start();
+}
+
 int QRemoteObjectSourceBase::qt_metacall(QMetaObject::Call call, int methodId, void **a)
 {
     methodId = QObject::qt_metacall(call, methodId, a);
@@ -570,6 +1280,12 @@ DynamicApiMap::DynamicApiMap(QObject *object, const QMetaObject *metaObject, con
             }
         }
         m_properties << i;
+        // Set by repc for PROP(... THROTTLE=<msecs>)
+        const QByteArray throttleInfo = QByteArray(property.name()).toUpper() + "_THROTTLE";
+        const int throttleIndex = metaObject->indexOfClassInfo(throttleInfo.constData());
+        m_throttleIntervals << (throttleIndex >= 0
+                                ? QByteArray(metaObject->classInfo(throttleIndex).value()).toInt()
+                                : 0);
         const int notifyIndex = metaObject->property(i).notifySignalIndex();
         if (notifyIndex != -1) {
             m_signals << notifyIndex;
@@ -644,7 +1360,7 @@ QByteArrayList DynamicApiMap::methodParameterNames(int index) const
 }
 
 QRemoteObjectSourceBase::Private::Private(QRemoteObjectSourceIo *io, QRemoteObjectRootSource *root)
-    : m_sourceIo(io), codec(io->m_codec.data()), isDynamic(false), root(root)
+    : m_sourceIo(io), isDynamic(false), root(root)
 {
 }
 
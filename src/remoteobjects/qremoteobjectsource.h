@@ -10,6 +10,8 @@
 
 QT_BEGIN_NAMESPACE
 
+class SourceApiMap;
+
 namespace QtPrivate {
 
 //Based on compile time checks for static connect() from qobjectdefs_impl.h
@@ -97,6 +99,35 @@ static inline QByteArray qtro_enum_signature(const char *enumName)
 
 QByteArray qtro_classinfo_signature(const QMetaObject *metaObject);
 
+Q_REMOTEOBJECTS_EXPORT
+void qtro_serialize_compact_value(QDataStream &out, const void *value, QMetaType type);
+
+// Used by repc generated SourceApiMap implementations to write a property value
+// without wrapping it in a QVariant first.
+template <typename T>
+static inline void qtro_serialize_compact(QDataStream &out, const T &value)
+{
+    qtro_serialize_compact_value(out, &value, QMetaType::fromType<T>());
+}
+
+// Capabilities of SourceApiMap implementations that are not part of its vtable, which has to
+// stay compatible with maps generated by earlier versions of repc. Generated maps register
+// them from their constructor, the registration ends with the map. Members are only appended,
+// version tells which ones the map was compiled with.
+struct SourceApiMapExtension
+{
+    int version;
+    // Version 1: writes the value of the property index of object in the compact wire
+    // format, returns false if the property has to be written from a QVariant
+    bool (*serializeCompactProperty)(QDataStream &out, QObject *object, int index);
+    // Version 1: the minimum interval in milliseconds between two updates of the property
+    // index, as declared in the .rep file
+    int (*propertyThrottleInterval)(int index);
+};
+
+Q_REMOTEOBJECTS_EXPORT
+void qtro_register_api_extension(const SourceApiMap *api, const SourceApiMapExtension *extension);
+
 }
 
 // TODO ModelInfo just needs roles, and no need for SubclassInfo
@@ -15,10 +15,15 @@
 // We mean it.
 //
 
+#include <QtCore/qbitarray.h>
+#include <QtCore/qdeadlinetimer.h>
+#include <QtCore/qhash.h>
 #include <QtCore/qlist.h>
 #include <QtCore/qmetaobject.h>
 #include <QtCore/qobject.h>
 #include <QtCore/qpointer.h>
+#include <QtCore/qset.h>
+#include <QtCore/qtimer.h>
 #include "qremoteobjectsource.h"
 #include "qremoteobjectpacket_p.h"
 
@@ -26,6 +31,8 @@ QT_BEGIN_NAMESPACE
 
 class QRemoteObjectSourceIo;
 class QtROIoDeviceBase;
+class QtRODatagramSender;
+struct QtRODatagramChannelSettings;
 
 class QRemoteObjectSourceBase : public QObject
 {
@@ -44,20 +51,65 @@ public:
 
     QVariantList* marshalArgs(int index, void **a);
     void handleMetaCall(int index, QMetaObject::Call call, void **a);
+    void serializeMetaCall(QRemoteObjectPackets::CodecBase *codec, int index, QMetaObject::Call call, void **a);
+    void setObjectHandle(QRemoteObjectPackets::CodecBase *codec, const QList<QtROIoDeviceBase *> &listeners) const;
     bool invoke(QMetaObject::Call c, int index, const QVariantList& args, QVariant* returnValue = nullptr);
     QByteArray m_objectChecksum;
+    // Numeric handle assigned by QRemoteObjectSourceIo, packets can address us by it
+    int m_handle = -1;
+    // Last value sent for each property (by internal index), and the value the current
+    // change replaces. Used to skip unchanged values and to send only changed gadget fields.
+    QVariantList m_sentValues;
+    QVariant m_previousValue;
+    bool updateSentValue(int internalIndex);
+    void clearSentValues();
+    // Encode/decode plans of the properties (by internal index), and of the signal and method
+    // parameters, resolved when the object is set instead of for every value
+    QRemoteObjectPackets::CodecPlanList m_propertyPlans;
+    QList<QRemoteObjectPackets::CodecPlanList> m_signalPlans;
+    QList<QRemoteObjectPackets::CodecPlanList> m_methodPlans;
+    void buildCodecPlans();
+    // Resolved from the extension m_api registered (see QtPrivate::SourceApiMapExtension),
+    // the throttle intervals are by internal property index
+    bool (*m_serializeCompactProperty)(QDataStream &out, QObject *object, int index) = nullptr;
+    QList<int> m_throttleIntervals;
+    void resolveApiExtension();
+    // Notify signals (by index) of the changes held back from congested listeners, see
+    // QRemoteObjectHostBase::setBackPressure()
+    QHash<QtROIoDeviceBase *, QList<int>> m_conflatedSignals;
+    // Notify signals of throttled properties (see m_throttleIntervals and
+    // QRemoteObjectNode::setMinimumUpdateInterval()) with a change held back until the throttle
+    // window of the listener ends, and the windows of the last updates sent
+    QHash<QtROIoDeviceBase *, QList<int>> m_throttledSignals;
+    QHash<QtROIoDeviceBase *, QHash<int, QDeadlineTimer>> m_throttleWindows;
+    // The signals (by index) listeners subscribed to, listeners without an entry get all
+    QHash<QtROIoDeviceBase *, QBitArray> m_subscriptions;
+    void setSubscription(QtROIoDeviceBase *io, const QBitArray &signalMask);
+    bool isSubscribed(QtROIoDeviceBase *io, int index) const;
+    QList<QtROIoDeviceBase *> listenersFor(int index, bool sentAsDatagram = false);
+    bool hasDatagramMembers(int internalIndex) const;
+    bool sendDatagram(int internalIndex);
+    int throttleInterval(QtROIoDeviceBase *io, int index) const;
+    bool isThrottled(QtROIoDeviceBase *io, int index);
+    void sendThrottled(QtROIoDeviceBase *io, int index);
+    void sendConflated(QtROIoDeviceBase *io);
+    void sendLatest(QtROIoDeviceBase *io, int index);
+    void forgetListener(QtROIoDeviceBase *io);
+    bool notifiesChanges() const;
     QMap<int, QPointer<QRemoteObjectSourceBase>> m_children;
     struct Private {
         Private(QRemoteObjectSourceIo *io, QRemoteObjectRootSource *root);
         QRemoteObjectSourceIo *m_sourceIo;
         QList<QtROIoDeviceBase*> m_listeners;
-        // Pointer to codec, not owned by Private.  We can assume it is valid.
-        QRemoteObjectPackets::CodecBase *codec;
+        // Minimum interval between property updates requested by the listeners
+        QHash<QtROIoDeviceBase*, int> m_updateIntervals;
 
         // Types needed during recursively sending a root to a new listener
         QSet<QString> sentTypes;
         bool isDynamic;
         QRemoteObjectRootSource *root;
+        // Sends the lossy properties of the root, see QRemoteObjectHostBase::setDatagramChannel()
+        QtRODatagramSender *m_datagram = nullptr;
     };
     Private *d;
     static const int qobjectPropertyOffset;
@@ -87,10 +139,45 @@ public:
 
     bool isRoot() const override { return true; }
     QString name() const override { return m_name; }
-    void addListener(QtROIoDeviceBase *io, bool dynamic = false);
+    void addListener(QtROIoDeviceBase *io, bool dynamic = false, int updateInterval = 0,
+                     const QRemoteObjectPackets::PropertyVersion &since = {},
+                     const QByteArray &cachedSignature = {});
     int removeListener(QtROIoDeviceBase *io, bool shouldSendRemove = false);
+    void setDatagramChannel(const QtRODatagramChannelSettings &settings);
+    void setDatagramMember(QtROIoDeviceBase *io, bool joined);
+    void sendDatagramChannel(QtROIoDeviceBase *io, bool withValues);
+    void sendInit(QtROIoDeviceBase *io, bool dynamic, bool withDefinition = true);
+    void resetVersions();
+    void updateVersion(int internalIndex);
+    bool canConfirmVersion(QtROIoDeviceBase *io, bool *later) const;
+    void sendVersions();
 
     QString m_name;
+    // The parts of the init packets sent to new listeners (see sendInit()), by wire format and
+    // whether they include the class definition. Dropped when a value changes.
+    struct InitParts
+    {
+        QRemoteObjectPackets::WireFormat wireFormat;
+        bool dynamic;
+        QByteArray definition;
+        QByteArray properties;
+        // d->sentTypes once the parts were serialized
+        QSet<QString> sentTypes;
+    };
+    QList<InitParts> m_initParts;
+    // How often the parts were serialized and reused, checked by the auto tests
+    qint64 m_initPartsSerialized = 0;
+    qint64 m_initPartsReused = 0;
+    // The version of the property values, and the version each property (by internal index)
+    // last changed in. Only kept if every change of the values is sent as a property change,
+    // which rules out children, models and properties without notify signal.
+    bool m_versioned = false;
+    QRemoteObjectPackets::PropertyVersion m_version;
+    QList<quint64> m_propertyVersions;
+    // The compact listeners that get told which version they have, see sendVersions(), and
+    // the version they were told last
+    QHash<QtROIoDeviceBase *, quint64> m_versionedListeners;
+    QTimer m_versionTimer;
 };
 
 class DynamicApiMap final : public SourceApiMap
@@ -176,6 +263,7 @@ public:
     QList<int> m_signals;
     QList<int> m_methods;
     QList<int> m_propertyAssociatedWithSignal;
+    QList<int> m_throttleIntervals;
     const QMetaObject *m_metaObject;
     mutable QMetaMethod m_cachedMetamethod;
     mutable int m_cachedMetamethodIndex;
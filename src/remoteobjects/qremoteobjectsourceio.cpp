@@ -9,7 +9,9 @@
 #include "qremoteobjectpendingcall.h"
 #include "qtremoteobjectglobal.h"
 #include "qconnection_local_backend_p.h"
+#include "qconnection_iothread_p.h"
 
+#include <QtCore/qcoreevent.h>
 #include <QtCore/qstringlist.h>
 
 QT_BEGIN_NAMESPACE
@@ -69,9 +71,15 @@ bool QRemoteObjectSourceIo::enableRemoting(QObject *object, const SourceApiMap *
         return false;
     }
 
-    new QRemoteObjectRootSource(object, api, adapter, this);
-    m_codec->serializeObjectListPacket({QRemoteObjectPackets::ObjectInfo{api->name(), api->typeName(), api->objectSignature()}});
-    m_codec->send(m_connections);
+    auto root = new QRemoteObjectRootSource(object, api, adapter, this);
+    if (const auto it = m_datagramChannels.constFind(name); it != m_datagramChannels.cend())
+        root->setDatagramChannel(*it);
+    const QRemoteObjectPackets::ObjectInfoList infos{QRemoteObjectPackets::ObjectInfo{api->name(), api->typeName(), api->objectSignature()}};
+    for (QtROIoDeviceBase *conn : std::as_const(m_connections)) {
+        const auto &codec = conn->d_func()->m_codec;
+        codec->serializeObjectListPacket(infos);
+        codec->send(conn);
+    }
     if (const int count = m_connections.size())
         qRODebug(this) << "Wrote new QObjectListPacket for" << api->name() << "to" << count << "connections";
     return true;
@@ -100,11 +108,135 @@ void QRemoteObjectSourceIo::setSocketOptions(QLocalServer::SocketOptions options
     }
 }
 
+void QRemoteObjectSourceIo::setWriteBuffering(QRemoteObjectNode::WriteBufferingMode mode,
+                                              std::chrono::microseconds delay, qint64 threshold)
+{
+    m_writeBufferingMode = mode;
+    m_writeBufferingDelay = delay;
+    m_writeBufferingThreshold = threshold;
+    for (QtROIoDeviceBase *conn : std::as_const(m_connections))
+        conn->setWriteBuffering(mode, delay, threshold);
+}
+
+void QRemoteObjectSourceIo::setCompression(QRemoteObjectNode::CompressionAlgorithm algorithm,
+                                           qint64 threshold)
+{
+    m_compression = algorithm;
+    m_compressionThreshold = threshold;
+    for (QtROIoDeviceBase *conn : std::as_const(m_connections))
+        conn->setCompression(algorithm, threshold);
+}
+
+void QRemoteObjectSourceIo::setTransferChunkSize(qint64 size)
+{
+    m_transferChunkSize = size;
+    for (QtROIoDeviceBase *conn : std::as_const(m_connections))
+        conn->setTransferChunkSize(size);
+}
+
+// Accepted connections run on threads from now on, see QRemoteObjectNode::setIoThreadEnabled()
+void QRemoteObjectSourceIo::setIoThreads(QtROIoThreadPool *threads)
+{
+    m_ioThreads = threads;
+}
+
+void QRemoteObjectSourceIo::setBackPressure(QRemoteObjectHostBase::BackPressurePolicy policy,
+                                            qint64 highWaterMark)
+{
+    m_backPressurePolicy = policy;
+    m_highWaterMark = highWaterMark;
+    if (policy == QRemoteObjectHostBase::NoBackPressure) {
+        // Let the next timer event resume all congested connections
+        if (!m_congested.isEmpty())
+            m_drainTimer.start(0, this);
+    }
+}
+
+// Sets up the datagram channels of the sources, replacing the ones that changed
+void QRemoteObjectSourceIo::setDatagramChannels(const QHash<QString, QtRODatagramChannelSettings> &channels)
+{
+    const auto previous = std::exchange(m_datagramChannels, channels);
+    for (auto it = m_sourceRoots.cbegin(), end = m_sourceRoots.cend(); it != end; ++it) {
+        const QtRODatagramChannelSettings settings = channels.value(it.key());
+        const QtRODatagramChannelSettings old = previous.value(it.key());
+        if (settings.address != old.address || settings.lossyProperties != old.lossyProperties)
+            it.value()->setDatagramChannel(settings);
+    }
+}
+
+// Returns true if data for conn is held back because too much of it is still waiting to
+// be written. Applies the back pressure policy when the high-water mark is reached.
+bool QRemoteObjectSourceIo::isCongested(QtROIoDeviceBase *conn)
+{
+    if (!isOverHighWaterMark(conn))
+        return false;
+    if (m_congested.contains(conn))
+        return true;
+    const qint64 buffered = conn->d_func()->bufferedBytes();
+
+    qROWarning(this) << "Connection reached the high-water mark with" << buffered
+                     << "bytes buffered, applying" << m_backPressurePolicy;
+    m_congested.insert(conn);
+    if (m_backPressurePolicy == QRemoteObjectHostBase::DisconnectConsumer) {
+        ++m_backPressureCounts[m_backPressurePolicy];
+        // Not while the source is sending to its listeners
+        QMetaObject::invokeMethod(this, [this, conn = QPointer<QtROIoDeviceBase>(conn)]() {
+            if (conn && m_connections.contains(conn.data()))
+                onServerDisconnect(conn.data());
+        }, Qt::QueuedConnection);
+    } else if (!m_drainTimer.isActive()) {
+        m_drainTimer.start(10, this);
+    }
+    emit highWaterMarkReached(buffered);
+    return true;
+}
+
+// Like isCongested(), without applying the policy to a connection that just became congested
+bool QRemoteObjectSourceIo::isOverHighWaterMark(const QtROIoDeviceBase *conn) const
+{
+    if (m_backPressurePolicy == QRemoteObjectHostBase::NoBackPressure)
+        return false;
+    return m_congested.contains(const_cast<QtROIoDeviceBase *>(conn))
+            || conn->d_func()->bufferedBytes() >= m_highWaterMark;
+}
+
+void QRemoteObjectSourceIo::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != m_drainTimer.timerId()) {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    const bool enabled = m_backPressurePolicy != QRemoteObjectHostBase::NoBackPressure;
+    for (auto it = m_congested.begin(); it != m_congested.end(); /*erasing*/) {
+        QtROIoDeviceBase *conn = *it;
+        if (enabled && conn->d_func()->bufferedBytes() > m_highWaterMark / 2) {
+            ++it;
+            continue;
+        }
+        it = m_congested.erase(it);
+        // Catch up with the changes the connection missed
+        for (QRemoteObjectSourceBase *source : std::as_const(m_sourceObjects))
+            source->sendConflated(conn);
+    }
+    if (m_congested.isEmpty())
+        m_drainTimer.stop();
+}
+
 void QRemoteObjectSourceIo::registerSource(QRemoteObjectSourceBase *source)
 {
     Q_ASSERT(source);
     const QString &name = source->name();
     m_sourceObjects[name] = source;
+    if (source->m_handle < 0) {
+        if (m_freeHandles.isEmpty()) {
+            source->m_handle = int(m_sourceHandles.size());
+            m_sourceHandles.append(source);
+        } else {
+            source->m_handle = m_freeHandles.takeLast();
+            m_sourceHandles[source->m_handle] = source;
+        }
+    }
     if (source->isRoot()) {
         QRemoteObjectRootSource *root = static_cast<QRemoteObjectRootSource *>(source);
         qRODebug(this) << "Registering" << name;
@@ -122,6 +254,7 @@ void QRemoteObjectSourceIo::unregisterSource(QRemoteObjectSourceBase *source)
     Q_ASSERT(source);
     const QString &name = source->name();
     m_sourceObjects.remove(name);
+    releaseHandle(source);
     if (source->isRoot()) {
         const auto type = source->m_api->typeName();
         m_objectToSourceMap.remove(source->m_object);
@@ -131,10 +264,25 @@ void QRemoteObjectSourceIo::unregisterSource(QRemoteObjectSourceBase *source)
     }
 }
 
+// Makes the handle of source available to the next source registered. Connections that knew
+// it keep addressing the removed source by it for a while, they address the next source by
+// name instead (see QRemoteObjectSourceBase::setObjectHandle()).
+void QRemoteObjectSourceIo::releaseHandle(QRemoteObjectSourceBase *source)
+{
+    const int handle = std::exchange(source->m_handle, -1);
+    if (handle < 0)
+        return;
+    for (QtROIoDeviceBase *connection : std::as_const(m_connections))
+        connection->d_func()->retireHandle(handle);
+    m_sourceHandles[handle] = nullptr;
+    m_freeHandles.append(handle);
+}
+
 void QRemoteObjectSourceIo::onServerDisconnect(QObject *conn)
 {
     QtROIoDeviceBase *connection = qobject_cast<QtROIoDeviceBase*>(conn);
     m_connections.remove(connection);
+    m_congested.remove(connection);
 
     qRODebug(this) << "OnServerDisconnect";
 
@@ -153,6 +301,9 @@ void QRemoteObjectSourceIo::onServerRead(QObject *conn)
     // Assert the invariant here conn is of type QIODevice
     QtROIoDeviceBase *connection = qobject_cast<QtROIoDeviceBase*>(conn);
     QRemoteObjectPacketTypeEnum packetType;
+    // Incoming packets are decoded by m_readCodec, m_codec is used for replies
+    auto &codec = connection->d_func()->m_codec;
+    auto &readCodec = connection->d_func()->m_readCodec;
 
     do {
 
@@ -161,24 +312,95 @@ void QRemoteObjectSourceIo::onServerRead(QObject *conn)
 
         using namespace QRemoteObjectPackets;
 
+        // Compact clients address sources by the handle we announced to them
+        QRemoteObjectSourceBase *source = nullptr;
+        if (const int handle = connection->d_func()->m_rxHandle; handle >= 0) {
+            if (handle >= m_sourceHandles.size()) {
+                qROWarning(this) << "Packet received for unknown object handle" << handle
+                                 << ", closing the connection";
+                connection->close();
+                return;
+            }
+            if (!connection->d_func()->isHandleRetired(handle))
+                source = m_sourceHandles.at(handle);
+            if (!source) {
+                // The source was removed since, read() consumed the whole packet
+                qRODebug(this) << "Packet received for removed object handle" << handle;
+                continue;
+            }
+            m_rxName = source->name();
+        }
+
         switch (packetType) {
+        case Handshake:
+            if (connection->d_func()->handleCompressionHandshake(m_rxName)) {
+                qRODebug(this) << "Client supports compression" << m_rxName;
+            } else if (connection->d_func()->handleDescriptorHandshake(m_rxName)) {
+                qRODebug(this) << "Client asked for out of band blobs" << m_rxName;
+            } else if (m_rxName != compactProtocolVersion) {
+                qRODebug(this) << "Ignoring unexpected Handshake" << m_rxName;
+            } else if (codec->wireFormat() != WireFormat::Compact) {
+                // The client offers the compact codec. Accept, everything sent from now on uses it.
+                codec->serializeHandshakePacket(compactProtocolVersion);
+                codec->send(connection);
+                codec.reset(new QCompactCodec);
+                connection->d_func()->sendCompressionHandshake();
+            } else {
+                // The client acknowledged the switch, everything it sends from now on uses it.
+                readCodec.reset(new QCompactCodec);
+                qRODebug(this) << "Switched to the compact codec";
+            }
+            break;
         case Ping:
-            m_codec->serializePongPacket(m_rxName);
-            m_codec->send(connection);
+            if (!source)
+                source = m_sourceObjects.value(m_rxName);
+            if (source)
+                source->setObjectHandle(codec.get(), {connection});
+            codec->serializePongPacket(m_rxName);
+            codec->send(connection);
             break;
         case AddObject:
         {
             bool isDynamic;
-            m_codec->deserializeAddObjectPacket(connection->d_func()->stream(), isDynamic);
-            qRODebug(this) << "AddObject" << m_rxName << isDynamic;
+            int updateInterval;
+            PropertyVersion since;
+            QByteArray cachedSignature;
+            readCodec->deserializeAddObjectPacket(connection->d_func()->stream(), isDynamic,
+                                                  updateInterval, since, cachedSignature);
+            qRODebug(this) << "AddObject" << m_rxName << isDynamic << updateInterval << since.version
+                           << cachedSignature;
             if (m_sourceRoots.contains(m_rxName)) {
                 QRemoteObjectRootSource *root = m_sourceRoots[m_rxName];
-                root->addListener(connection, isDynamic);
+                root->addListener(connection, isDynamic, updateInterval, since, cachedSignature);
             } else {
                 qROWarning(this) << "Request to attach to non-existent RemoteObjectSource:" << m_rxName;
             }
             break;
         }
+        case Subscribe:
+        {
+            QBitArray signalMask;
+            readCodec->deserializeSubscribePacket(connection->d_func()->stream(), signalMask);
+            if (!source)
+                source = m_sourceObjects.value(m_rxName);
+            qRODebug(this) << "Subscribe" << m_rxName << signalMask;
+            if (source)
+                source->setSubscription(connection, signalMask);
+            else
+                qROWarning(this) << "Subscription to non-existent RemoteObjectSource:" << m_rxName;
+            break;
+        }
+        case DatagramResync:
+        {
+            bool joined;
+            readCodec->deserializeDatagramResyncPacket(connection->d_func()->stream(), joined);
+            qRODebug(this) << "DatagramResync" << m_rxName << joined;
+            if (QRemoteObjectRootSource *root = m_sourceRoots.value(m_rxName))
+                root->setDatagramMember(connection, joined);
+            else
+                qROWarning(this) << "Datagram resync for non-existent RemoteObjectSource:" << m_rxName;
+            break;
+        }
         case RemoveObject:
         {
             qRODebug(this) << "RemoveObject" << m_rxName;
@@ -196,13 +418,14 @@ void QRemoteObjectSourceIo::onServerRead(QObject *conn)
         case InvokePacket:
         {
             int call, index, serialId, propertyId;
-            m_codec->deserializeInvokePacket(connection->d_func()->stream(), call, index, m_rxArgs, serialId, propertyId);
+            readCodec->deserializeInvokePacket(connection->d_func()->stream(), call, index, m_rxArgs, serialId, propertyId);
             if (m_rxName == QLatin1String("Registry") && !m_registryMapping.contains(connection)) {
                 const QRemoteObjectSourceLocation loc = m_rxArgs.first().value<QRemoteObjectSourceLocation>();
                 m_registryMapping[connection] = loc.second.hostUrl;
             }
-            if (m_sourceObjects.contains(m_rxName)) {
-                QRemoteObjectSourceBase *source = m_sourceObjects[m_rxName];
+            if (!source)
+                source = m_sourceObjects.value(m_rxName);
+            if (source) {
                 if (call == QMetaObject::InvokeMetaMethod) {
                     const int resolvedIndex = source->m_api->sourceMethodIndex(index);
                     if (resolvedIndex < 0) { //Invalid index
@@ -214,10 +437,10 @@ void QRemoteObjectSourceIo::onServerRead(QObject *conn)
                         qRODebug(this) << "Adapter (method) Invoke-->" << m_rxName << source->m_adapter->metaObject()->method(resolvedIndex).name();
                     else {
                         qRODebug(this) << "Source (method) Invoke-->" << m_rxName << source->m_object->metaObject()->method(resolvedIndex).methodSignature();
-                        auto method = source->m_object->metaObject()->method(resolvedIndex);
-                        const int parameterCount = method.parameterCount();
+                        const auto &plans = source->m_methodPlans.at(index);
+                        const int parameterCount = int(qMin(plans.size(), m_rxArgs.size()));
                         for (int i = 0; i < parameterCount; i++)
-                            m_rxArgs[i] = decodeVariant(std::move(m_rxArgs[i]), method.parameterMetaType(i));
+                            m_rxArgs[i] = decodeVariant(std::move(m_rxArgs[i]), plans.at(i));
                     }
                     auto metaType = QMetaType::fromName(source->m_api->typeName(index).constData());
                     if (!metaType.sizeOf())
@@ -234,16 +457,22 @@ void QRemoteObjectSourceIo::onServerRead(QObject *conn)
                             QRemoteObjectPendingCall call = returnValue.value<QRemoteObjectPendingCall>();
                             // Watcher will be destroyed when connection is, or when the finished lambda is called
                             QRemoteObjectPendingCallWatcher *watcher = new QRemoteObjectPendingCallWatcher(call, connection);
-                            QObject::connect(watcher, &QRemoteObjectPendingCallWatcher::finished, connection, [this, serialId, connection, watcher]() {
+                            QPointer<QRemoteObjectSourceBase> replySource(source);
+                            const QString replyName = m_rxName;
+                            QObject::connect(watcher, &QRemoteObjectPendingCallWatcher::finished, connection, [replySource, replyName, serialId, connection, watcher]() {
                                 if (watcher->error() == QRemoteObjectPendingCall::NoError) {
-                                    m_codec->serializeInvokeReplyPacket(this->m_rxName, serialId, encodeVariant(watcher->returnValue()));
-                                    m_codec->send(connection);
+                                    const auto &replyCodec = connection->d_func()->m_codec;
+                                    if (replySource)
+                                        replySource->setObjectHandle(replyCodec.get(), {connection});
+                                    replyCodec->serializeInvokeReplyPacket(replyName, serialId, encodeVariant(watcher->returnValue()));
+                                    replyCodec->send(connection);
                                 }
                                 watcher->deleteLater();
                             });
                         } else {
-                            m_codec->serializeInvokeReplyPacket(m_rxName, serialId, encodeVariant(returnValue));
-                            m_codec->send(connection);
+                            source->setObjectHandle(codec.get(), {connection});
+                            codec->serializeInvokeReplyPacket(m_rxName, serialId, encodeVariant(returnValue));
+                            codec->send(connection);
                         }
                     }
                 } else {
@@ -273,12 +502,22 @@ void QRemoteObjectSourceIo::handleConnection()
     qRODebug(this) << "handleConnection" << m_connections;
 
     QtROServerIoDevice *conn = m_server->nextPendingConnection();
+    if (m_ioThreads)
+        conn = new QtROThreadedServerIo(conn, m_ioThreads->nextThread(), m_server.data());
     newConnection(conn);
 }
 
 void QRemoteObjectSourceIo::newConnection(QtROIoDeviceBase *conn)
 {
     m_connections.insert(conn);
+    conn->setWriteBuffering(m_writeBufferingMode, m_writeBufferingDelay, m_writeBufferingThreshold);
+    conn->setCompression(m_compression, m_compressionThreshold);
+    conn->setTransferChunkSize(m_transferChunkSize);
+    // Every connection starts with the QDataStreamCodec, the client can negotiate
+    // a different one after receiving our Handshake.
+    auto &codec = conn->d_func()->m_codec;
+    codec.reset(new QRemoteObjectPackets::QDataStreamCodec);
+    conn->d_func()->m_readCodec.reset(new QRemoteObjectPackets::QDataStreamCodec);
     connect(conn, &QtROIoDeviceBase::readyRead, this, [this, conn]() {
         onServerRead(conn);
     });
@@ -286,16 +525,16 @@ void QRemoteObjectSourceIo::newConnection(QtROIoDeviceBase *conn)
         onServerDisconnect(conn);
     });
 
-    m_codec->serializeHandshakePacket();
-    m_codec->send(conn);
+    codec->serializeHandshakePacket(protocolVersion);
+    codec->send(conn);
 
     QRemoteObjectPackets::ObjectInfoList infos;
     infos.reserve(m_sourceRoots.size());
     for (auto remoteObject : std::as_const(m_sourceRoots)) {
         infos << QRemoteObjectPackets::ObjectInfo{remoteObject->m_api->name(), remoteObject->m_api->typeName(), remoteObject->m_api->objectSignature()};
     }
-    m_codec->serializeObjectListPacket(infos);
-    m_codec->send(conn);
+    codec->serializeObjectListPacket(infos);
+    codec->send(conn);
     qRODebug(this) << "Wrote ObjectList packet from Server" << QStringList(m_sourceRoots.keys());
 }
 
@@ -18,8 +18,11 @@
 #include "qconnectionfactories_p.h"
 #include "qtremoteobjectglobal.h"
 #include "qremoteobjectpacket_p.h"
+#include "qremoteobjectdatagram_p.h"
 
+#include <QtCore/qbasictimer.h>
 #include <QtCore/qiodevice.h>
+#include <QtCore/qpointer.h>
 #include <QtCore/qscopedpointer.h>
 #include <QtNetwork/qlocalserver.h>
 
@@ -29,6 +32,7 @@ class QRemoteObjectSourceBase;
 class QRemoteObjectRootSource;
 class SourceApiMap;
 class QRemoteObjectHostBase;
+class QtROIoThreadPool;
 
 class QRemoteObjectSourceIo : public QObject
 {
@@ -45,6 +49,15 @@ public:
     bool disableRemoting(QObject *object);
     void newConnection(QtROIoDeviceBase *conn);
     void setSocketOptions(QLocalServer::SocketOptions options);
+    void setWriteBuffering(QRemoteObjectNode::WriteBufferingMode mode,
+                           std::chrono::microseconds delay, qint64 threshold);
+    void setCompression(QRemoteObjectNode::CompressionAlgorithm algorithm, qint64 threshold);
+    void setTransferChunkSize(qint64 size);
+    void setIoThreads(QtROIoThreadPool *threads);
+    void setBackPressure(QRemoteObjectHostBase::BackPressurePolicy policy, qint64 highWaterMark);
+    bool isCongested(QtROIoDeviceBase *conn);
+    bool isOverHighWaterMark(const QtROIoDeviceBase *conn) const;
+    void setDatagramChannels(const QHash<QString, QtRODatagramChannelSettings> &channels);
 
     QUrl serverAddress() const;
 
@@ -57,23 +70,49 @@ Q_SIGNALS:
     void remoteObjectAdded(const QRemoteObjectSourceLocation &);
     void remoteObjectRemoved(const QRemoteObjectSourceLocation &);
     void serverRemoved(const QUrl& url);
+    void highWaterMarkReached(qint64 bufferedBytes);
 
 public:
     void registerSource(QRemoteObjectSourceBase *source);
     void unregisterSource(QRemoteObjectSourceBase *source);
+    void releaseHandle(QRemoteObjectSourceBase *source);
 
     QHash<QIODevice*, quint32> m_readSize;
     QSet<QtROIoDeviceBase*> m_connections;
     QHash<QObject *, QRemoteObjectRootSource*> m_objectToSourceMap;
     QMap<QString, QRemoteObjectSourceBase*> m_sourceObjects;
     QMap<QString, QRemoteObjectRootSource*> m_sourceRoots;
+    // Indexed by QRemoteObjectSourceBase::m_handle. The handles of removed sources are
+    // reused, see releaseHandle().
+    QList<QPointer<QRemoteObjectSourceBase>> m_sourceHandles;
+    QList<int> m_freeHandles;
     QHash<QtROIoDeviceBase*, QUrl> m_registryMapping;
     QScopedPointer<QConnectionAbstractServer> m_server;
-    // TODO should have some sort of manager for the codec
-    QScopedPointer<QRemoteObjectPackets::CodecBase> m_codec{new QRemoteObjectPackets::QDataStreamCodec};
     QString m_rxName;
     QVariantList m_rxArgs;
     QUrl m_address;
+    QRemoteObjectNode::WriteBufferingMode m_writeBufferingMode = QRemoteObjectNode::FlushImmediately;
+    std::chrono::microseconds m_writeBufferingDelay { 0 };
+    qint64 m_writeBufferingThreshold = 0;
+    QRemoteObjectNode::CompressionAlgorithm m_compression = QRemoteObjectNode::NoCompression;
+    qint64 m_compressionThreshold = 0;
+    qint64 m_transferChunkSize = QtRemoteObjects::bulkFragmentSize;
+    QtROIoThreadPool *m_ioThreads = nullptr;
+    // Back pressure, see QRemoteObjectHostBase::setBackPressure(). m_congested holds the
+    // connections over the high-water mark, they are checked by m_drainTimer until they
+    // are below half of it. m_backPressureCounts is indexed by policy, m_droppedSignals
+    // counts the signals PauseUpdates did not send.
+    QRemoteObjectHostBase::BackPressurePolicy m_backPressurePolicy = QRemoteObjectHostBase::NoBackPressure;
+    qint64 m_highWaterMark = 0;
+    QSet<QtROIoDeviceBase *> m_congested;
+    QBasicTimer m_drainTimer;
+    qint64 m_backPressureCounts[QRemoteObjectHostBase::DisconnectConsumer + 1] = {};
+    qint64 m_droppedSignals = 0;
+    // Datagram channels by source name, see QRemoteObjectHostBase::setDatagramChannel()
+    QHash<QString, QtRODatagramChannelSettings> m_datagramChannels;
+
+protected:
+    void timerEvent(QTimerEvent *event) override;
 };
 
 QT_END_NAMESPACE
@@ -70,6 +70,9 @@ namespace QRemoteObjectStringLiterals {
 inline QString local() { return QStringLiteral("local"); }
 inline QString localabstract() { return QStringLiteral("localabstract"); }
 inline QString tcp() { return QStringLiteral("tcp"); }
+inline QString shm() { return QStringLiteral("shm"); }
+inline QString tcpEpoll() { return QStringLiteral("tcp+epoll"); }
+inline QString udp() { return QStringLiteral("udp"); }
 inline QString CLASS() { return QStringLiteral("Class::%1"); }
 inline QString MODEL() { return QStringLiteral("Model::%1"); }
 inline QString QAIMADAPTER() { return QStringLiteral("QAbstractItemModelAdapter"); }
@@ -126,7 +129,12 @@ enum QRemoteObjectPacketTypeEnum
     PropertyChangePacket,
     ObjectList,
     Ping,
-    Pong
+    Pong,
+    Subscribe,
+    Fragment,
+    DatagramChannel,
+    DatagramResync,
+    ResyncPacket
 };
 Q_ENUM_NS(QRemoteObjectPacketTypeEnum)
 
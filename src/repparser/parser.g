@@ -88,6 +88,8 @@ struct ASTProperty
     Modifier modifier;
     bool persisted;
     bool isPointer;
+    /// Minimum interval between two updates sent by the Source (THROTTLE=<msecs>), 0 if unthrottled
+    int throttleInterval;
 };
 Q_DECLARE_TYPEINFO(ASTProperty, Q_RELOCATABLE_TYPE);
 
@@ -288,6 +290,7 @@ private:
     bool parseProperty(ASTClass &astClass, const QString &propertyDeclaration);
     /// A helper function to parse modifier flag of property declaration
     bool parseModifierFlag(const QString &flag, ASTProperty::Modifier &modifier, bool &persisted);
+    bool parseThrottle(QString &input, int &throttleInterval);
 
     bool parseRoles(ASTModel &astModel, const QString &modelRoles);
 
@@ -364,12 +367,13 @@ QString SignedType::typeName() const
 }
 
 ASTProperty::ASTProperty()
-    : modifier(ReadPush), persisted(false), isPointer(false)
+    : modifier(ReadPush), persisted(false), isPointer(false), throttleInterval(0)
 {
 }
 
 ASTProperty::ASTProperty(const QString &type, const QString &name, const QString &defaultValue, Modifier modifier, bool persisted, bool isPointer)
-    : type(type), name(name), defaultValue(defaultValue), modifier(modifier), persisted(persisted), isPointer(isPointer)
+    : type(type), name(name), defaultValue(defaultValue), modifier(modifier), persisted(persisted), isPointer(isPointer),
+      throttleInterval(0)
 {
 }
 
@@ -636,6 +640,30 @@ bool RepParser::parseModifierFlag(const QString &flag, ASTProperty::Modifier &mo
     return true;
 }
 
+// Removes the THROTTLE=<msecs> flag from the property declaration input, it can be combined
+// with any other flag and is not part of the comma separated list parseModifierFlag() handles
+bool RepParser::parseThrottle(QString &input, int &throttleInterval)
+{
+    // Only look behind a string default value
+    const qsizetype from = input.lastIndexOf(QLatin1Char('"')) + 1;
+    const QRegularExpression regex(QStringLiteral("(,\\s*)?\\bTHROTTLE\\s*=\\s*([^\\s,]*)(\\s*,)?"));
+    const QRegularExpressionMatch match = regex.match(input, from);
+    if (!match.hasMatch())
+        return true;
+
+    bool ok;
+    throttleInterval = match.captured(2).toInt(&ok);
+    if (!ok || throttleInterval <= 0) {
+        setErrorString(QLatin1String("Invalid property declaration: THROTTLE needs a positive interval in milliseconds (%1)").arg(match.captured(0)));
+        return false;
+    }
+    // Keep the separator if THROTTLE was between two other flags
+    const bool betweenFlags = match.hasCaptured(1) && match.hasCaptured(3);
+    input.replace(match.capturedStart(0), match.capturedLength(0),
+                  betweenFlags ? QStringLiteral(", ") : QStringLiteral(" "));
+    return true;
+}
+
 QString stripArgs(const QString &arguments)
 {
     // This repc parser searches for the longest possible matches, which can be multiline.
@@ -657,6 +685,7 @@ bool RepParser::parseProperty(ASTClass &astClass, const QString &propertyDeclara
     QString propertyDefaultValue;
     ASTProperty::Modifier propertyModifier = ASTProperty::ReadPush;
     bool persisted = false;
+    int throttleInterval = 0;
 
     // parse type declaration which could be a nested template as well
     bool inTemplate = false;
@@ -693,6 +722,9 @@ bool RepParser::parseProperty(ASTClass &astClass, const QString &propertyDeclara
 
     // parse the name of the property
     input = input.mid(nameIndex).trimmed();
+    if (!parseThrottle(input, throttleInterval))
+        return false;
+    input = input.trimmed();
 
     const int equalSignIndex = input.indexOf(QLatin1Char('='));
     if (equalSignIndex != -1) { // we have a default value
@@ -731,7 +763,9 @@ bool RepParser::parseProperty(ASTClass &astClass, const QString &propertyDeclara
         }
     }
 
-    astClass.properties << ASTProperty(propertyType, propertyName, propertyDefaultValue, propertyModifier, persisted);
+    ASTProperty property(propertyType, propertyName, propertyDefaultValue, propertyModifier, persisted);
+    property.throttleInterval = throttleInterval;
+    astClass.properties << property;
     if (persisted)
         astClass.hasPersisted = true;
     return true;
@@ -11,10 +11,13 @@
 #include <QFileInfo>
 #include <QTcpServer>
 #include <QTcpSocket>
+#include <QUrlQuery>
 
 #include <QRemoteObjectReplica>
 #include <QRemoteObjectNode>
 #include <QRemoteObjectSettingsStore>
+#include <QtRemoteObjects/private/qremoteobjectnode_p.h>
+#include <QtRemoteObjects/private/qremoteobjectsource_p.h>
 #include "engine.h"
 #include "speedometer.h"
 #include "rep_engine_replica.h"
@@ -44,6 +47,14 @@ Q_SIGNALS:
     void send(const QByteArray &data);
 };
 
+class TestTypedData: public QObject
+{
+    Q_OBJECT
+
+Q_SIGNALS:
+    void send(const QByteArray &data, const Temperature &temperature);
+};
+
 class TestDynamicBase : public QObject
 {
     Q_OBJECT
@@ -112,6 +123,77 @@ private:
     EngineReplica::EngineType type;
 };
 
+// Passes the data of a device through, counting the writes to it
+class WriteCountingDevice : public QIODevice
+{
+    Q_OBJECT
+
+public:
+    explicit WriteCountingDevice(QIODevice *device, QObject *parent = nullptr)
+        : QIODevice(parent), m_device(device)
+    {
+        connect(device, &QIODevice::readyRead, this, &QIODevice::readyRead);
+        open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+    bool isSequential() const override { return true; }
+    qint64 bytesAvailable() const override
+    {
+        return QIODevice::bytesAvailable() + (m_device ? m_device->bytesAvailable() : 0);
+    }
+    qint64 bytesToWrite() const override { return m_device ? m_device->bytesToWrite() : 0; }
+    qsizetype writes() const { return m_writes; }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override
+    {
+        return m_device ? m_device->read(data, maxSize) : -1;
+    }
+    qint64 writeData(const char *data, qint64 size) override
+    {
+        ++m_writes;
+        return m_device ? m_device->write(data, size) : -1;
+    }
+
+private:
+    QPointer<QIODevice> m_device;
+    qsizetype m_writes = 0;
+};
+
+// The packets of the given type received by the connection of node to the source name
+static qint64 receivedPackets(QRemoteObjectNode *node, const QString &name,
+                              QtRemoteObjects::QRemoteObjectPacketTypeEnum type)
+{
+    auto d = static_cast<QRemoteObjectNodePrivate *>(QObjectPrivate::get(node));
+    QtROIoDeviceBase *connection = d->connectedSources.value(name).device;
+    return connection ? QtROIoDeviceBasePrivate::get(connection)->m_receivedPackets[type] : 0;
+}
+
+// The packets of the given type received by all connections of host
+static qint64 receivedPackets(QRemoteObjectHostBase *host,
+                              QtRemoteObjects::QRemoteObjectPacketTypeEnum type)
+{
+    auto d = static_cast<QRemoteObjectHostBasePrivate *>(QObjectPrivate::get(host));
+    qint64 received = 0;
+    for (QtROIoDeviceBase *connection : std::as_const(d->remoteObjectIo->m_connections))
+        received += QtROIoDeviceBasePrivate::get(connection)->m_receivedPackets[type];
+    return received;
+}
+
+// The compressed packets received by the connection of node to the source name
+static qint64 compressedPackets(QRemoteObjectNode *node, const QString &name)
+{
+    auto d = static_cast<QRemoteObjectNodePrivate *>(QObjectPrivate::get(node));
+    QtROIoDeviceBase *connection = d->connectedSources.value(name).device;
+    return connection ? QtROIoDeviceBasePrivate::get(connection)->m_compressedPackets : 0;
+}
+
+static QRemoteObjectRootSource *rootSource(QRemoteObjectHostBase *host, const QString &name)
+{
+    auto d = static_cast<QRemoteObjectHostBasePrivate *>(QObjectPrivate::get(host));
+    return d->remoteObjectIo->m_sourceRoots.value(name);
+}
+
 class MyClass : public MyClassSimpleSource
 {
 public:
@@ -210,6 +292,10 @@ private slots:
         QTest::newRow("local") << QUrl(QLatin1String(LOCAL_SOCKET ":replicaLocalIntegration")) << QUrl(QLatin1String(LOCAL_SOCKET ":registryLocalIntegration"));
 #ifdef Q_OS_LINUX
         QTest::newRow("localabstract") << QUrl(QLatin1String("localabstract:replicaAbstractIntegration")) << QUrl(QLatin1String("localabstract:registryAbstractIntegration"));
+#endif
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+        QTest::newRow("shm") << QUrl(QLatin1String("shm:replicaShmIntegration")) << QUrl(QLatin1String("shm:registryShmIntegration"));
+        QTest::newRow("tcp+epoll") << QUrl(QLatin1String("tcp+epoll://127.0.0.1:65513")) << QUrl(QLatin1String("tcp+epoll://127.0.0.1:65514"));
 #endif
         QTest::newRow("external") << QUrl() << QUrl();
     }
@@ -1048,6 +1134,290 @@ private slots:
         QCOMPARE(engine_r->started(), true);
     }
 
+    void writeBufferingTest_data()
+    {
+        QTest::addColumn<QRemoteObjectNode::WriteBufferingMode>("mode");
+        QTest::addColumn<int>("delayUs");
+        QTest::addColumn<qint64>("threshold");
+
+        QTest::newRow("immediate") << QRemoteObjectNode::FlushImmediately << 0 << qint64(0);
+        QTest::newRow("endOfEventLoop") << QRemoteObjectNode::FlushAtEndOfEventLoop << 0 << qint64(0);
+        QTest::newRow("delay") << QRemoteObjectNode::FlushAfterDelay << 2000 << qint64(0);
+        QTest::newRow("threshold") << QRemoteObjectNode::FlushAfterDelay << 1000000 << qint64(64);
+    }
+
+    void writeBufferingTest()
+    {
+        QFETCH(QRemoteObjectNode::WriteBufferingMode, mode);
+        QFETCH(int, delayUs);
+        QFETCH(qint64, threshold);
+        const std::chrono::microseconds delay(delayUs);
+
+        // Through the external backend, the test sees how often the host writes
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        WriteCountingDevice *counter = nullptr;
+        if (hostUrl.isEmpty()) {
+            host = new QRemoteObjectHost;
+            SET_NODE_NAME(*host);
+            setupTcp();
+            counter = new WriteCountingDevice(socketServer, host);
+            host->addHostSideConnection(counter);
+        } else {
+            setupHost();
+        }
+        host->setWriteBuffering(mode, delay, threshold);
+        QCOMPARE(host->writeBufferingMode(), mode);
+        QCOMPARE(host->writeBufferingDelay(), delay);
+        QCOMPARE(host->writeBufferingThreshold(), threshold);
+        Engine e(6);
+        host->enableRemoting(&e);
+
+        setupClient();
+        client->setWriteBuffering(mode, delay, threshold);
+
+        const QScopedPointer<EngineReplica> engine_r(client->acquire<EngineReplica>());
+        QVERIFY(engine_r->waitForSource());
+        QCOMPARE(engine_r->cylinders(), 6);
+
+        QSignalSpy spy(engine_r.data(), &EngineReplica::rpmChanged);
+        const qsizetype writesBefore = counter ? counter->writes() : 0;
+        for (int i = 1; i <= 10; ++i)
+            e.setRpm(i);
+        QTRY_COMPARE(engine_r->rpm(), 10);
+        QCOMPARE(spy.size(), 10);
+        // The ten property changes are written to the device together unless flushed
+        // immediately
+        if (counter) {
+            const qsizetype writes = counter->writes() - writesBefore;
+            if (mode == QRemoteObjectNode::FlushImmediately) {
+                QVERIFY(writes >= 10);
+            } else {
+                QVERIFY(writes >= 1);
+                QVERIFY2(writes < 10, qPrintable(QString::number(writes)));
+            }
+        }
+
+        engine_r->setRpm(42);
+        QTRY_COMPARE(e.rpm(), 42);
+    }
+
+    void updateIntervalTest()
+    {
+        setupHost();
+        Engine e;
+        host->enableRemoting(&e);
+
+        setupClient();
+        QCOMPARE(client->minimumUpdateInterval(QStringLiteral("Engine")), 0);
+        client->setMinimumUpdateInterval(QStringLiteral("Engine"), 200);
+        QCOMPARE(client->minimumUpdateInterval(QStringLiteral("Engine")), 200);
+        const QScopedPointer<EngineReplica> engine_r(client->acquire<EngineReplica>());
+        QVERIFY(engine_r->waitForSource());
+
+        // The first change is sent right away, the final value once the interval passed
+        QSignalSpy spy(engine_r.data(), &EngineReplica::rpmChanged);
+        for (int i = 1; i <= 100; ++i)
+            e.setRpm(i);
+        QTRY_COMPARE(engine_r->rpm(), 100);
+        QVERIFY(spy.size() < 10);
+
+        // Each property has its own interval
+        e.setStarted(true);
+        QTRY_COMPARE(engine_r->started(), true);
+    }
+
+    void subscriptionTest()
+    {
+        setupHost();
+        Engine e;
+        e.setRpm(1);
+        host->enableRemoting(&e);
+
+        setupClient();
+        const QString name = QStringLiteral("Engine");
+        QCOMPARE(client->subscriptionMode(name), QRemoteObjectNode::SubscribeAll);
+        client->setSubscription(name, QRemoteObjectNode::SubscribeExplicitly,
+                                { QStringLiteral("started") });
+        QCOMPARE(client->subscriptionMode(name), QRemoteObjectNode::SubscribeExplicitly);
+        QCOMPARE(client->subscribedMembers(name), QStringList(QStringLiteral("started")));
+        const QScopedPointer<EngineReplica> engine_r(client->acquire<EngineReplica>());
+        QVERIFY(engine_r->waitForSource());
+        QCOMPARE(engine_r->rpm(), 1);
+        // The subscription is sent once initialized, a call returns after it was handled
+        QVERIFY(engine_r->myTestString().waitForFinished());
+
+        // Packets arrive in order, rpm would have been updated before started
+        e.setRpm(2);
+        e.setStarted(true);
+        QTRY_COMPARE(engine_r->started(), true);
+        QCOMPARE(engine_r->rpm(), 1);
+
+        // Subscribing to a property again sends its current value
+        client->setSubscription(name, QRemoteObjectNode::SubscribeExplicitly,
+                                { QStringLiteral("started"), QStringLiteral("rpm") });
+        QTRY_COMPARE(engine_r->rpm(), 2);
+
+        // Reading a property subscribes to it
+        client->setSubscription(name, QRemoteObjectNode::SubscribeOnUse);
+        QVERIFY(engine_r->myTestString().waitForFinished());
+        e.setRpm(3);
+        QVERIFY(engine_r->myTestString().waitForFinished());
+        QCOMPARE(engine_r->rpm(), 2);
+        QTRY_COMPARE(engine_r->rpm(), 3);
+
+        // Connecting from another thread subscribes in the thread of the replica
+        bool engineTypeChanged = false;
+        const std::unique_ptr<QThread> connector(QThread::create([&]() {
+            connect(engine_r.data(), &EngineReplica::engineTypeChanged, engine_r.data(),
+                    [&engineTypeChanged]() { engineTypeChanged = true; });
+        }));
+        connector->start();
+        QVERIFY(connector->wait());
+        QCoreApplication::processEvents();
+        QVERIFY(engine_r->myTestString().waitForFinished());
+        e.setEngineType(EngineSimpleSource::ELECTRIC);
+        QTRY_VERIFY(engineTypeChanged);
+    }
+
+    void backPressureTest_data()
+    {
+        QTest::addColumn<QRemoteObjectHostBase::BackPressurePolicy>("policy");
+
+        QTest::newRow("conflate") << QRemoteObjectHostBase::ConflatePropertyChanges;
+        QTest::newRow("pause") << QRemoteObjectHostBase::PauseUpdates;
+    }
+
+    void backPressureTest()
+    {
+        QFETCH(QRemoteObjectHostBase::BackPressurePolicy, policy);
+
+        setupHost();
+        QCOMPARE(host->backPressurePolicy(), QRemoteObjectHostBase::NoBackPressure);
+        Engine e;
+        host->enableRemoting(&e);
+        TestLargeData t;
+        host->enableRemoting(&t, QStringLiteral("large"));
+
+        setupClient();
+        const QScopedPointer<EngineReplica> engine_r(client->acquire<EngineReplica>());
+        QVERIFY(engine_r->waitForSource());
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep(client->acquireDynamic(QStringLiteral("large")));
+        QVERIFY(rep->waitForSource());
+        const QMetaMethod mm = rep->metaObject()->method(rep->metaObject()->indexOfSignal("send(QByteArray)"));
+        QSignalSpy sendSpy(rep.data(), QByteArray(QByteArrayLiteral("2") + mm.methodSignature().constData()));
+
+        // Every connection with unwritten data is congested
+        QSignalSpy spy(host, &QRemoteObjectHostBase::highWaterMarkReached);
+        host->setBackPressure(policy, 1);
+        QCOMPARE(host->backPressurePolicy(), policy);
+        QCOMPARE(host->highWaterMark(), qint64(1));
+        for (int i = 1; i <= 100; ++i) {
+            e.setRpm(i);
+            emit t.send(QByteArray::number(i));
+        }
+        QTRY_COMPARE(engine_r->rpm(), 100);
+        QVERIFY(host->backPressureCount(policy) > 0);
+        QVERIFY(spy.size() > 0);
+        if (policy == QRemoteObjectHostBase::PauseUpdates) {
+            // Signals are dropped while paused, and counted apart from property changes
+            QVERIFY(host->droppedSignalCount() > 0);
+            QTRY_COMPARE(sendSpy.size() + host->droppedSignalCount(), qint64(100));
+        } else {
+            QCOMPARE(host->droppedSignalCount(), qint64(0));
+            QTRY_COMPARE(sendSpy.size(), 100);
+        }
+
+        host->setBackPressure(QRemoteObjectHostBase::NoBackPressure);
+        e.setRpm(42);
+        QTRY_COMPARE(engine_r->rpm(), 42);
+    }
+
+    void ioThreadTest_data()
+    {
+        QTest::addColumn<int>("threadCount");
+
+        QTest::newRow("single") << 1;
+        QTest::newRow("sharded") << 3;
+    }
+
+    void ioThreadTest()
+    {
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        QFETCH(int, threadCount);
+
+        setupHost();
+        QCOMPARE(host->isIoThreadEnabled(), false);
+        QCOMPARE(host->ioThreadCount(), 1);
+        host->setIoThreadEnabled(true);
+        host->setIoThreadCount(threadCount);
+        QCOMPARE(host->isIoThreadEnabled(), true);
+        QCOMPARE(host->ioThreadCount(), threadCount);
+        host->setCompression(QRemoteObjectNode::ZlibCompression, 256);
+        Engine e(6);
+        host->enableRemoting(&e);
+        TestLargeData t;
+        host->enableRemoting(&t, QStringLiteral("large"));
+
+        client = new QRemoteObjectNode;
+        Q_SET_OBJECT_NAME(*client);
+        client->setIoThreadEnabled(true);
+        client->setCompression(QRemoteObjectNode::ZlibCompression, 256);
+        if (!hostUrl.isEmpty()) {
+            client->connectToNode(hostUrl);
+        } else {
+            setupTcp();
+            client->addClientSideConnection(socketClient);
+        }
+
+        const QScopedPointer<EngineReplica> engine_r(client->acquire<EngineReplica>());
+        QVERIFY(engine_r->waitForSource());
+        QCOMPARE(engine_r->cylinders(), 6);
+
+        // More clients, so the host has connections on every I/O thread
+        std::vector<std::unique_ptr<QRemoteObjectNode>> otherClients;
+        std::vector<std::unique_ptr<EngineReplica>> otherReplicas;
+        if (!hostUrl.isEmpty()) {
+            for (int i = 0; i < threadCount * 2; ++i) {
+                otherClients.emplace_back(new QRemoteObjectNode);
+                otherClients.back()->setIoThreadEnabled(true);
+                QVERIFY(otherClients.back()->connectToNode(hostUrl));
+                otherReplicas.emplace_back(otherClients.back()->acquire<EngineReplica>());
+                QVERIFY(otherReplicas.back()->waitForSource());
+            }
+        }
+
+        QSignalSpy spy(engine_r.data(), &EngineReplica::rpmChanged);
+        for (int i = 1; i <= 100; ++i)
+            e.setRpm(i);
+        QTRY_COMPARE(engine_r->rpm(), 100);
+        QCOMPARE(spy.size(), 100);
+        for (const auto &replica : otherReplicas)
+            QTRY_COMPARE(replica->rpm(), 100);
+
+        engine_r->setRpm(42);
+        QTRY_COMPARE(e.rpm(), 42);
+
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep(client->acquireDynamic(QStringLiteral("large")));
+        QVERIFY(rep->waitForSource());
+        const QMetaMethod mm = rep->metaObject()->method(rep->metaObject()->indexOfSignal("send(QByteArray)"));
+        QSignalSpy largeSpy(rep.data(), QByteArray(QByteArrayLiteral("2") + mm.methodSignature().constData()));
+        const QByteArray large(1 << 20, 'z');
+        emit t.send(large);
+        QTRY_COMPARE(largeSpy.size(), 1);
+        QCOMPARE(largeSpy.first().at(0).toByteArray(), large);
+        QVERIFY(host->disableRemoting(&t));
+
+        // Heartbeats are answered by the I/O threads of the host, without its node. Devices
+        // passed to addHostSideConnection() don't run on I/O threads.
+        if (!hostUrl.isEmpty()) {
+            const qint64 pongs = receivedPackets(client, QStringLiteral("Engine"), QtRemoteObjects::Pong);
+            client->setHeartbeatInterval(10);
+            QTRY_VERIFY(receivedPackets(client, QStringLiteral("Engine"), QtRemoteObjects::Pong) >= pongs + 3);
+            QCOMPARE(receivedPackets(host, QtRemoteObjects::Ping), qint64(0));
+            QCOMPARE(engine_r->state(), QRemoteObjectReplica::Valid);
+        }
+    }
+
     void dynamicSetterTest()
     {
         setupHost();
@@ -1375,6 +1745,243 @@ private slots:
         QVERIFY(host->disableRemoting(&t));
     }
 
+    void largeDataLifetimeTest()
+    {
+        TestLargeData t;
+        setupHost();
+        host->enableRemoting(&t, QStringLiteral("large"));
+
+        setupClient();
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep(client->acquireDynamic(QStringLiteral("large")));
+        QVERIFY(rep->waitForSource());
+        const QMetaMethod mm = rep->metaObject()->method(rep->metaObject()->indexOfSignal("send(QByteArray)"));
+        QSignalSpy spy(rep.data(), QByteArray(QByteArrayLiteral("2") + mm.methodSignature().constData()));
+
+        // Arrays received earlier must not be affected by the packets received later
+        const QByteArray first(32768, 'a');
+        const QByteArray second(32768, 'b');
+        emit t.send(first);
+        QTRY_COMPARE(spy.size(), 1);
+        emit t.send(second);
+        emit t.send(QByteArray(8, 'c'));
+        QTRY_COMPARE(spy.size(), 3);
+        QCOMPARE(spy.at(0).at(0).toByteArray(), first);
+        QCOMPARE(spy.at(1).at(0).toByteArray(), second);
+        QCOMPARE(spy.at(2).at(0).toByteArray(), QByteArray(8, 'c'));
+
+        // Arrays sharing the received packet are terminated like any other
+        const QByteArray received = spy.at(1).at(0).toByteArray();
+        QCOMPARE(received.constData()[received.size()], '\0');
+
+        QByteArray modified = spy.at(1).at(0).toByteArray();
+        modified[0] = 'x';
+        QCOMPARE(spy.at(1).at(0).toByteArray(), second);
+        QVERIFY(host->disableRemoting(&t));
+    }
+
+    void compressionTest_data()
+    {
+        QTest::addColumn<QRemoteObjectNode::CompressionAlgorithm>("algorithm");
+
+        QTest::newRow("zlib") << QRemoteObjectNode::ZlibCompression;
+        QTest::newRow("zstd") << QRemoteObjectNode::ZstdCompression;
+    }
+
+    void compressionTest()
+    {
+        QFETCH(QRemoteObjectNode::CompressionAlgorithm, algorithm);
+
+        TestLargeData t;
+        setupHost();
+        host->setCompression(algorithm, 256);
+        QCOMPARE(host->compression(), algorithm);
+        QCOMPARE(host->compressionThreshold(), qint64(256));
+        QCOMPARE(host->compression(QStringLiteral("tcp")), algorithm);
+        host->enableRemoting(&t, QStringLiteral("large"));
+
+        setupClient();
+        client->setCompression(QRemoteObjectNode::NoCompression, 0, QStringLiteral("local"));
+        QCOMPARE(client->compression(QStringLiteral("local")), QRemoteObjectNode::NoCompression);
+        client->setCompression(algorithm, 256);
+
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep(client->acquireDynamic(QStringLiteral("large")));
+        QVERIFY(rep->waitForSource());
+
+        // A client that doesn't compress, listening to the same source
+        QScopedPointer<QRemoteObjectNode> plainClient;
+        QScopedPointer<QRemoteObjectDynamicReplica> plainRep;
+        if (host->hostUrl().isValid()) {
+            plainClient.reset(new QRemoteObjectNode);
+            QVERIFY(plainClient->connectToNode(host->hostUrl()));
+            plainRep.reset(plainClient->acquireDynamic(QStringLiteral("large")));
+            QVERIFY(plainRep->waitForSource());
+        }
+
+        const QMetaMethod mm = rep->metaObject()->method(rep->metaObject()->indexOfSignal("send(QByteArray)"));
+        QSignalSpy spy(rep.data(), QByteArray(QByteArrayLiteral("2") + mm.methodSignature().constData()));
+        const QByteArray small("small");
+        const QByteArray large(65536, 'y');
+        emit t.send(small);
+        emit t.send(large);
+        QTRY_COMPARE(spy.size(), 2);
+        QCOMPARE(spy.at(0).at(0).toByteArray(), small);
+        QCOMPARE(spy.at(1).at(0).toByteArray(), large);
+        // Peers without Zstandard support fall back to zlib, the large value is compressed either way
+        QVERIFY(compressedPackets(client, QStringLiteral("large")) >= 1);
+
+        if (plainRep) {
+            QSignalSpy plainSpy(plainRep.data(), QByteArray(QByteArrayLiteral("2") + mm.methodSignature().constData()));
+            emit t.send(large);
+            QTRY_COMPARE(plainSpy.size(), 1);
+            QCOMPARE(plainSpy.first().at(0).toByteArray(), large);
+        }
+        QVERIFY(host->disableRemoting(&t));
+    }
+
+    void priorityLanesTest()
+    {
+        TestLargeData t1, t2;
+        setupHost();
+        host->enableRemoting(&t1, QStringLiteral("large1"));
+        host->enableRemoting(&t2, QStringLiteral("large2"));
+
+        setupClient();
+        client->setHeartbeatInterval(20);
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep1(client->acquireDynamic(QStringLiteral("large1")));
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep2(client->acquireDynamic(QStringLiteral("large2")));
+        QVERIFY(rep1->waitForSource());
+        QVERIFY(rep2->waitForSource());
+
+        const QByteArray signature = QByteArray(QByteArrayLiteral("2") + "send(QByteArray)");
+        QSignalSpy spy1(rep1.data(), signature.constData());
+        QSignalSpy spy2(rep2.data(), signature.constData());
+
+        // Large packets are sent in fragments interleaved with those of the other object,
+        // the packets of each object keep their order
+        QList<QByteArray> sent;
+        for (int i = 0; i < 4; ++i) {
+            sent << QByteArray(100000 + i, char('a' + i));
+            emit t1.send(sent.last());
+            emit t2.send(sent.last());
+        }
+        const QByteArray small("small");
+        emit t1.send(small);
+        sent << small;
+
+        QTRY_COMPARE(spy1.size(), sent.size());
+        QTRY_COMPARE(spy2.size(), sent.size() - 1);
+        for (int i = 0; i < sent.size(); ++i)
+            QCOMPARE(spy1.at(i).at(0).toByteArray(), sent.at(i));
+        for (int i = 0; i < spy2.size(); ++i)
+            QCOMPARE(spy2.at(i).at(0).toByteArray(), sent.at(i));
+        QCOMPARE(rep1->state(), QRemoteObjectReplica::Valid);
+        QCOMPARE(rep2->state(), QRemoteObjectReplica::Valid);
+
+        // Packets of other objects can refer to the type names a large packet announces,
+        // they wait for it
+        qRegisterMetaType<Temperature>();
+        TestTypedData typed1, typed2;
+        host->enableRemoting(&typed1, QStringLiteral("typed1"));
+        host->enableRemoting(&typed2, QStringLiteral("typed2"));
+        const QScopedPointer<QRemoteObjectDynamicReplica> typedRep1(client->acquireDynamic(QStringLiteral("typed1")));
+        const QScopedPointer<QRemoteObjectDynamicReplica> typedRep2(client->acquireDynamic(QStringLiteral("typed2")));
+        QVERIFY(typedRep1->waitForSource());
+        QVERIFY(typedRep2->waitForSource());
+        const QByteArray typedSignature = QByteArray(QByteArrayLiteral("2") + "send(QByteArray,Temperature)");
+        QSignalSpy typedSpy1(typedRep1.data(), typedSignature.constData());
+        QSignalSpy typedSpy2(typedRep2.data(), typedSignature.constData());
+        const Temperature temperature(21.5, QStringLiteral("Celsius"));
+        emit typed1.send(QByteArray(100000, 't'), temperature);
+        emit typed2.send(small, temperature);
+        QTRY_COMPARE(typedSpy2.size(), 1);
+        QTRY_COMPARE(typedSpy1.size(), 1);
+        QCOMPARE(typedSpy1.at(0).at(1).value<Temperature>(), temperature);
+        QCOMPARE(typedSpy2.at(0).at(1).value<Temperature>(), temperature);
+        QCOMPARE(typedRep2->state(), QRemoteObjectReplica::Valid);
+    }
+
+    void transferProgressTest()
+    {
+        TestLargeData t;
+        setupHost();
+        host->setTransferChunkSize(4096);
+        QCOMPARE(host->transferChunkSize(), qint64(4096));
+        host->enableRemoting(&t, QStringLiteral("large"));
+
+        setupClient();
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep(client->acquireDynamic(QStringLiteral("large")));
+        QVERIFY(rep->waitForSource());
+
+        const QByteArray signature = QByteArray(QByteArrayLiteral("2") + "send(QByteArray)");
+        QSignalSpy spy(rep.data(), signature.constData());
+        QSignalSpy progressSpy(rep.data(), &QRemoteObjectReplica::transferProgress);
+
+        // Below the size local connections on Linux pass out of band (see blobTest())
+        const QByteArray data(60000, 'x');
+        emit t.send(data);
+        QTRY_COMPARE(spy.size(), 1);
+        QCOMPARE(spy.at(0).at(0).toByteArray(), data);
+
+        // One signal per chunk, the last one once the packet is complete
+        QVERIFY(progressSpy.size() > data.size() / 4096);
+        qint64 received = 0;
+        const qint64 total = progressSpy.at(0).at(1).toLongLong();
+        QVERIFY(total > data.size());
+        for (const QList<QVariant> &args : std::as_const(progressSpy)) {
+            QVERIFY(args.at(0).toLongLong() > received);
+            QCOMPARE(args.at(1).toLongLong(), total);
+            received = args.at(0).toLongLong();
+        }
+        QCOMPARE(received, total);
+
+        // Small packets are sent in one piece
+        progressSpy.clear();
+        emit t.send(QByteArray("small"));
+        QTRY_COMPARE(spy.size(), 2);
+        QCOMPARE(progressSpy.size(), 0);
+    }
+
+    void blobTest()
+    {
+        TestLargeData t;
+        setupHost();
+        host->setTransferChunkSize(4096);
+        host->enableRemoting(&t, QStringLiteral("large"));
+
+        setupClient();
+        const QScopedPointer<QRemoteObjectDynamicReplica> rep(client->acquireDynamic(QStringLiteral("large")));
+        QVERIFY(rep->waitForSource());
+
+        const QByteArray signature = QByteArray(QByteArrayLiteral("2") + "send(QByteArray)");
+        QSignalSpy spy(rep.data(), signature.constData());
+        QSignalSpy progressSpy(rep.data(), &QRemoteObjectReplica::transferProgress);
+
+        QByteArray data(1024 * 1024, Qt::Uninitialized);
+        for (qsizetype i = 0; i < data.size(); ++i)
+            data[i] = char(i % 251);
+        emit t.send(data);
+        QTRY_COMPARE(spy.size(), 1);
+        QCOMPARE(spy.at(0).at(0).toByteArray(), data);
+
+        // Once the channel is set up, local connections on Linux pass large arrays as
+        // memory files instead of sending them in fragments
+        progressSpy.clear();
+        data[0] = 'x';
+        emit t.send(data);
+        emit t.send(QByteArray("small"));
+        QTRY_COMPARE(spy.size(), 3);
+        QCOMPARE(spy.at(1).at(0).toByteArray(), data);
+        QCOMPARE(spy.at(2).at(0).toByteArray(), QByteArray("small"));
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+        const QString scheme = host->hostUrl().scheme();
+        if (scheme == QLatin1String("local") || scheme == QLatin1String("localabstract"))
+            QCOMPARE(progressSpy.size(), 0);
+        else
+#endif
+            QVERIFY(!progressSpy.isEmpty());
+        QCOMPARE(rep->state(), QRemoteObjectReplica::Valid);
+    }
+
     void PODTest()
     {
         setupHost();
@@ -1405,6 +2012,39 @@ private slots:
         QCOMPARE(podList, m.myPodList());
     }
 
+    void PODFieldUpdateTest()
+    {
+        setupHost();
+
+        setupClient();
+
+        MyClass m;
+        m.setMyPOD(MyPOD(1, 2.0, QStringLiteral("initial")));
+        host->enableRemoting(&m);
+        const QScopedPointer<MyClassReplica> myclass_r(client->acquire<MyClassReplica>());
+        QVERIFY(myclass_r->waitForSource());
+        QCOMPARE(myclass_r->myPOD(), m.myPOD());
+
+        QSignalSpy spy(myclass_r.data(), &MyClassReplica::myPODChanged);
+        MyPOD pod = m.myPOD();
+        for (int i = 2; i <= 5; ++i) {
+            pod.setI(i);
+            m.setMyPOD(pod);
+        }
+        pod.setS(QStringLiteral("changed"));
+        m.setMyPOD(pod);
+        QTRY_COMPARE(spy.size(), 5);
+        QCOMPARE(myclass_r->myPOD(), pod);
+        QCOMPARE(spy.last().constFirst().value<MyPOD>(), pod);
+
+        // Notifications without a change are not sent
+        emit m.myPODChanged(m.myPOD());
+        pod.setF(3.0);
+        m.setMyPOD(pod);
+        QTRY_COMPARE(spy.size(), 6);
+        QCOMPARE(myclass_r->myPOD(), pod);
+    }
+
     void SchemeTest()
     {
         QFETCH_GLOBAL(QUrl, hostUrl);
@@ -1501,6 +2141,71 @@ private slots:
 
     }
 
+    void tcpSocketOptionsTest()
+    {
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        if (hostUrl.scheme() != QRemoteObjectStringLiterals::tcp())
+            QSKIP("Skipping test for non-tcp backends.");
+
+        QUrl url = hostUrl;
+        url.setQuery(QLatin1String("nodelay=1&keepalive=1&sndbuf=65536"));
+        QRemoteObjectHost srcNode(url);
+        QCOMPARE(QUrlQuery(srcNode.hostUrl()).queryItemValue(QLatin1String("nodelay")), QLatin1String("1"));
+        Engine e;
+        e.setRpm(7);
+        QVERIFY(srcNode.enableRemoting(&e));
+
+        QRemoteObjectNode repNode;
+        QVERIFY(repNode.connectToNode(srcNode.hostUrl()));
+        QScopedPointer<EngineReplica> replica(repNode.acquire<EngineReplica>());
+        QVERIFY(replica->waitForSource(1000));
+        QCOMPARE(replica->rpm(), 7);
+
+        const QVariantMap clientOptions = repNode.socketOptions(srcNode.hostUrl());
+        QVERIFY(clientOptions.value(QLatin1String("nodelay")).toBool());
+        QVERIFY(clientOptions.value(QLatin1String("keepalive")).toBool());
+        QVERIFY(clientOptions.value(QLatin1String("sndbuf")).toInt() >= 65536);
+        const QVariantMap hostOptions = srcNode.socketOptions(srcNode.hostUrl());
+        QVERIFY(hostOptions.value(QLatin1String("nodelay")).toBool());
+        QVERIFY(hostOptions.value(QLatin1String("keepalive")).toBool());
+
+        // Packets are still delivered with the writes of an event loop iteration coalesced
+        e.setRpm(8);
+        e.setRpm(9);
+        QTRY_COMPARE(replica->rpm(), 9);
+    }
+
+    void datagramChannelTest()
+    {
+        setupHost();
+        const QUrl channel(QStringLiteral("udp://239.255.43.21:45454"));
+        QTest::ignoreMessage(QtWarningMsg, " Invalid datagram channel address QUrl(\"udp://127.0.0.1:45454\")");
+        QVERIFY(!host->setDatagramChannel(QStringLiteral("Engine"), QUrl(QStringLiteral("udp://127.0.0.1:45454")),
+                                          {QStringLiteral("rpm")}));
+        QVERIFY(host->setDatagramChannel(QStringLiteral("Engine"), channel, {QStringLiteral("rpm")}));
+        QCOMPARE(host->datagramChannel(QStringLiteral("Engine")), channel);
+        Engine e(6);
+        host->enableRemoting(&e);
+
+        setupClient();
+        const QScopedPointer<EngineReplica> engine_r(client->acquire<EngineReplica>());
+        QVERIFY(engine_r->waitForSource());
+
+        // Whether or not the replica joined the group, it ends up with the latest values
+        QSignalSpy spy(engine_r.data(), &EngineReplica::rpmChanged);
+        for (int i = 1; i <= 100; ++i)
+            e.setRpm(i);
+        QTRY_COMPARE(engine_r->rpm(), 100);
+        QVERIFY(spy.size() > 0);
+        e.setStarted(true);
+        QTRY_VERIFY(engine_r->started());
+
+        QVERIFY(host->setDatagramChannel(QStringLiteral("Engine"), QUrl(), {}));
+        QVERIFY(host->datagramChannel(QStringLiteral("Engine")).isEmpty());
+        e.setRpm(7);
+        QTRY_COMPARE(engine_r->rpm(), 7);
+    }
+
     void invalidExternalTest()
     {
         QFETCH_GLOBAL(QUrl, hostUrl);
@@ -1532,6 +2237,273 @@ private slots:
         QVERIFY(replica->waitForSource());
         QCOMPARE(replica->rpm(), e.rpm());
     }
+
+    void reconnectBackoffTest()
+    {
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        if (hostUrl.isEmpty())
+            QSKIP("Skipping test for the external backend.");
+
+        client = new QRemoteObjectNode;
+        Q_SET_OBJECT_NAME(*client);
+        client->setReconnectBackoff(std::chrono::milliseconds(20), std::chrono::milliseconds(80), 0.0);
+        QCOMPARE(client->reconnectInitialDelay(), std::chrono::milliseconds(20));
+        QCOMPARE(client->reconnectMaximumDelay(), std::chrono::milliseconds(80));
+        QCOMPARE(client->reconnectJitter(), 0.0);
+        QSignalSpy scheduledSpy(client, &QRemoteObjectNode::reconnectScheduled);
+        QSignalSpy reconnectedSpy(client, &QRemoteObjectNode::reconnected);
+        client->connectToNode(hostUrl);
+        const QScopedPointer<EngineReplica> replica(client->acquire<EngineReplica>());
+
+        // Without a host, every failed attempt schedules the next one
+        QTRY_VERIFY(scheduledSpy.size() >= 4);
+        for (int i = 0; i < 4; ++i) {
+            QCOMPARE(scheduledSpy.at(i).at(0).toUrl(), hostUrl);
+            QCOMPARE(scheduledSpy.at(i).at(1).toInt(), i + 1);
+            QVERIFY(scheduledSpy.at(i).at(2).toInt() <= 80);
+        }
+        QVERIFY(scheduledSpy.at(0).at(2).toInt() <= 20);
+        QCOMPARE(reconnectedSpy.size(), 0);
+
+        setupHost();
+        Engine e;
+        e.setRpm(42);
+        host->enableRemoting(&e);
+        QVERIFY(replica->waitForSource());
+        QCOMPARE(replica->rpm(), 42);
+        QTRY_COMPARE(reconnectedSpy.size(), 1);
+        QCOMPARE(reconnectedSpy.at(0).at(0).toUrl(), hostUrl);
+        QVERIFY(reconnectedSpy.at(0).at(1).toInt() >= 4);
+    }
+
+    void sharedInitTest()
+    {
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        if (hostUrl.isEmpty())
+            QSKIP("Skipping test for the external backend.");
+
+        setupHost();
+        Engine e;
+        e.setRpm(1);
+        host->enableRemoting(&e);
+        // Local connections on Linux can pass byte arrays out of band, depending on when
+        // their channel is set up their listeners get init packets of their own
+        bool counted = true;
+#if defined(Q_OS_LINUX) && !defined(Q_OS_ANDROID)
+        const QString scheme = hostUrl.scheme();
+        counted = scheme != QLatin1String("local") && scheme != QLatin1String("localabstract");
+#endif
+        const QRemoteObjectRootSource *source = rootSource(host, QStringLiteral("Engine"));
+        QVERIFY(source);
+
+        // New listeners share the serialized values until one changes
+        QRemoteObjectNode first, second, third;
+        Q_SET_OBJECT_NAME(first);
+        Q_SET_OBJECT_NAME(second);
+        Q_SET_OBJECT_NAME(third);
+        first.connectToNode(hostUrl);
+        second.connectToNode(hostUrl);
+        third.connectToNode(hostUrl);
+        const QScopedPointer<EngineReplica> r1(first.acquire<EngineReplica>());
+        const QScopedPointer<EngineReplica> r2(second.acquire<EngineReplica>());
+        QVERIFY(r1->waitForSource());
+        QVERIFY(r2->waitForSource());
+        QCOMPARE(r1->rpm(), 1);
+        QCOMPARE(r2->rpm(), 1);
+        if (counted) {
+            QCOMPARE(source->m_initPartsSerialized, qint64(1));
+            QCOMPARE(source->m_initPartsReused, qint64(1));
+        }
+
+        e.setRpm(2);
+        QTRY_COMPARE(r1->rpm(), 2);
+        const QScopedPointer<EngineReplica> r3(third.acquire<EngineReplica>());
+        QVERIFY(r3->waitForSource());
+        QCOMPARE(r3->rpm(), 2);
+        if (counted) {
+            QCOMPARE(source->m_initPartsSerialized, qint64(2));
+            QCOMPARE(source->m_initPartsReused, qint64(1));
+        }
+
+        // Dynamic replicas share the class definition as well
+        QRemoteObjectNode fourth, fifth;
+        Q_SET_OBJECT_NAME(fourth);
+        Q_SET_OBJECT_NAME(fifth);
+        fourth.connectToNode(hostUrl);
+        fifth.connectToNode(hostUrl);
+        const QScopedPointer<QRemoteObjectDynamicReplica> d1(fourth.acquireDynamic(QStringLiteral("Engine")));
+        const QScopedPointer<QRemoteObjectDynamicReplica> d2(fifth.acquireDynamic(QStringLiteral("Engine")));
+        QVERIFY(d1->waitForSource());
+        QVERIFY(d2->waitForSource());
+        QCOMPARE(d1->property("rpm").toInt(), 2);
+        QCOMPARE(d2->property("rpm").toInt(), 2);
+        if (counted) {
+            QCOMPARE(source->m_initPartsSerialized, qint64(3));
+            QCOMPARE(source->m_initPartsReused, qint64(2));
+        }
+
+        e.setRpm(3);
+        QTRY_COMPARE(r3->rpm(), 3);
+        QTRY_COMPARE(d2->property("rpm").toInt(), 3);
+    }
+
+    void typeCacheTest()
+    {
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        if (hostUrl.isEmpty())
+            QSKIP("Skipping test for the external backend.");
+
+        setupHost();
+        Engine e;
+        e.setRpm(1);
+        host->enableRemoting(&e);
+
+        QTemporaryDir cache;
+        QVERIFY(cache.isValid());
+        const QString cachePath = cache.filePath(QStringLiteral("types"));
+
+        // The first node receives the definition and caches it
+        QRemoteObjectNode first;
+        Q_SET_OBJECT_NAME(first);
+        first.setTypeCacheDirectory(cachePath);
+        QCOMPARE(first.typeCacheDirectory(), cachePath);
+        first.connectToNode(hostUrl);
+        const QScopedPointer<QRemoteObjectDynamicReplica> d1(first.acquireDynamic(QStringLiteral("Engine")));
+        QVERIFY(d1->waitForSource());
+        QCOMPARE(d1->property("rpm").toInt(), 1);
+        QCOMPARE(QDir(cachePath).entryList(QDir::Files).size(), 1);
+
+        // The second one builds the class from the cache, so the source skips the definition
+        e.setRpm(2);
+        QRemoteObjectNode second;
+        Q_SET_OBJECT_NAME(second);
+        second.setTypeCacheDirectory(cachePath);
+        second.connectToNode(hostUrl);
+        const QScopedPointer<QRemoteObjectDynamicReplica> d2(second.acquireDynamic(QStringLiteral("Engine")));
+        QVERIFY(d2->waitForSource());
+        QCOMPARE(d2->property("rpm").toInt(), 2);
+        QVERIFY(d2->metaObject()->indexOfProperty("started") >= 0);
+        QCOMPARE(receivedPackets(&second, QStringLiteral("Engine"), QtRemoteObjects::InitPacket), qint64(1));
+        QCOMPARE(receivedPackets(&second, QStringLiteral("Engine"), QtRemoteObjects::InitDynamicPacket), qint64(0));
+        QCOMPARE(QDir(cachePath).entryList(QDir::Files).size(), 1);
+
+        e.setRpm(3);
+        QTRY_COMPARE(d1->property("rpm").toInt(), 3);
+        QTRY_COMPARE(d2->property("rpm").toInt(), 3);
+
+        // A definition that doesn't decode isn't announced, the source sends it again
+        const QDir cacheDir(cachePath);
+        QFile file(cacheDir.filePath(cacheDir.entryList(QDir::Files).constFirst()));
+        QVERIFY(file.open(QIODevice::ReadWrite));
+        QDataStream ds(&file);
+        ds.setVersion(QtRemoteObjects::dataStreamVersion);
+        quint32 magic = 0;
+        QString protocol;
+        QByteArray definition;
+        ds >> magic >> protocol >> definition;
+        QVERIFY(file.seek(0) && file.resize(0));
+        ds << magic << protocol << definition.first(definition.size() / 2);
+        file.close();
+
+        QRemoteObjectNode third;
+        Q_SET_OBJECT_NAME(third);
+        third.setTypeCacheDirectory(cachePath);
+        third.connectToNode(hostUrl);
+        const QScopedPointer<QRemoteObjectDynamicReplica> d3(third.acquireDynamic(QStringLiteral("Engine")));
+        QVERIFY(d3->waitForSource());
+        QCOMPARE(d3->property("rpm").toInt(), 3);
+        QCOMPARE(receivedPackets(&third, QStringLiteral("Engine"), QtRemoteObjects::InitPacket), qint64(0));
+        QCOMPARE(receivedPackets(&third, QStringLiteral("Engine"), QtRemoteObjects::InitDynamicPacket), qint64(1));
+        QCOMPARE(cacheDir.entryList(QDir::Files).size(), 1);
+    }
+
+    void incrementalResyncTest()
+    {
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        if (!hostUrl.isEmpty())
+            QSKIP("Only the external backend lets the test drop the connection.");
+
+        setupHost();
+        Engine e;
+        e.setRpm(1);
+        host->enableRemoting(&e);
+        setupClient();
+        const QScopedPointer<EngineReplica> engine_r(client->acquire<EngineReplica>());
+        QVERIFY(engine_r->waitForSource());
+        e.setStarted(true);
+        QTRY_COMPARE(engine_r->started(), true);
+        // The source tells the replica the version it has
+        QTRY_VERIFY(receivedPackets(client, QStringLiteral("Engine"), QtRemoteObjects::ResyncPacket) > 0);
+
+        socketClient->abort();
+        QTRY_COMPARE(engine_r->state(), QRemoteObjectReplica::Suspect);
+        e.setRpm(2);
+
+        // Reconnect over a new pair of sockets, the replica gets the change it missed
+        socketClient->deleteLater();
+        socketServer->deleteLater();
+        delete std::exchange(tcpServer, nullptr);
+        setupTcp();
+        QSignalSpy rpmSpy(engine_r.data(), &EngineReplica::rpmChanged);
+        QSignalSpy startedSpy(engine_r.data(), &EngineReplica::startedChanged);
+        host->addHostSideConnection(socketServer);
+        client->addClientSideConnection(socketClient);
+        QTRY_COMPARE(engine_r->state(), QRemoteObjectReplica::Valid);
+        QCOMPARE(engine_r->rpm(), 2);
+        QCOMPARE(engine_r->started(), true);
+        QCOMPARE(rpmSpy.size(), 1);
+        QCOMPARE(startedSpy.size(), 0);
+        // Resynced over the new connection, not initialized again
+        QVERIFY(receivedPackets(client, QStringLiteral("Engine"), QtRemoteObjects::ResyncPacket) > 0);
+        QCOMPARE(receivedPackets(client, QStringLiteral("Engine"), QtRemoteObjects::InitPacket), qint64(0));
+
+        // Changes keep coming after the resync
+        e.setRpm(3);
+        QTRY_COMPARE(engine_r->rpm(), 3);
+    }
+
+    void handleReuseTest()
+    {
+        QFETCH_GLOBAL(QUrl, hostUrl);
+        if (hostUrl.isEmpty())
+            QSKIP("Skipping test for the external backend.");
+
+        setupHost();
+        Engine first, other;
+        host->enableRemoting(&first, QStringLiteral("First"));
+        host->enableRemoting(&other, QStringLiteral("Other"));
+        const int handle = rootSource(host, QStringLiteral("First"))->m_handle;
+        QVERIFY(handle >= 0);
+
+        setupClient();
+        const QScopedPointer<EngineReplica> r1(client->acquire<EngineReplica>(QStringLiteral("First")));
+        const QScopedPointer<EngineReplica> r2(client->acquire<EngineReplica>(QStringLiteral("Other")));
+        QVERIFY(r1->waitForSource());
+        QVERIFY(r2->waitForSource());
+        QVERIFY(host->disableRemoting(&first));
+        QTRY_COMPARE(r1->state(), QRemoteObjectReplica::Suspect);
+
+        // The next source gets the handle of the removed one
+        Engine second;
+        second.setRpm(2);
+        host->enableRemoting(&second, QStringLiteral("Second"));
+        QCOMPARE(rootSource(host, QStringLiteral("Second"))->m_handle, handle);
+
+        QRemoteObjectNode late;
+        Q_SET_OBJECT_NAME(late);
+        late.connectToNode(hostUrl);
+        const QScopedPointer<EngineReplica> r3(late.acquire<EngineReplica>(QStringLiteral("Second")));
+        QVERIFY(r3->waitForSource());
+        QCOMPARE(r3->rpm(), 2);
+        r3->setRpm(3);
+        QTRY_COMPARE(second.rpm(), 3);
+
+        // The replicas of the other sources are not affected
+        other.setRpm(4);
+        QTRY_COMPARE(r2->rpm(), 4);
+        r2->setRpm(5);
+        QTRY_COMPARE(other.rpm(), 5);
+    }
 };
 
 QTEST_MAIN(tst_Integration)
@@ -3,6 +3,7 @@
 
 #include "rep_preprocessortest_merged.h"
 #include "rep_classinnamespace_merged.h"
+#include "rep_classwiththrottletest_merged.h"
 
 #include <QTest>
 
@@ -12,6 +13,9 @@ class tst_RepCodeGenerator : public QObject {
 private Q_SLOTS:
     void testPreprocessorTestFile();
     void testNamespaceTestFile();
+    void testSerializeCompactProperty();
+    void testDeserializeCompactProperty();
+    void testPropertyThrottle();
 };
 
 void tst_RepCodeGenerator::testPreprocessorTestFile()
@@ -29,6 +33,68 @@ void tst_RepCodeGenerator::testNamespaceTestFile()
             Test::MyNamespace::MyNamespaceEnumEnum::Value1;
 }
 
+void tst_RepCodeGenerator::testSerializeCompactProperty()
+{
+    using namespace Test::MyNamespace;
+    using SourceAPI = MyNamespaceClassSourceAPI<MyNamespaceClassSimpleSource>;
+    MyNamespaceClassSimpleSource source;
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    QVERIFY(SourceAPI::qtro_serializeCompactProperty(out, &source, 0)); // myProp, a single tag byte
+    QCOMPARE(data.size(), 1);
+    QVERIFY(SourceAPI::qtro_serializeCompactProperty(out, &source, 1)); // myEnum
+    QVERIFY(data.size() > 1);
+
+    // Models are sent as QRO_, not through the typed serializer
+    const auto size = data.size();
+    QVERIFY(!SourceAPI::qtro_serializeCompactProperty(out, &source, 2));
+    QVERIFY(!SourceAPI::qtro_serializeCompactProperty(out, &source, 3));
+    QCOMPARE(data.size(), size);
+}
+
+void tst_RepCodeGenerator::testDeserializeCompactProperty()
+{
+    using namespace Test::MyNamespace;
+
+    // What the source API writes for the properties
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    QtPrivate::qtro_serialize_compact(out, true);
+    QtPrivate::qtro_serialize_compact(out, MyNamespaceEnumEnum::Value2);
+
+    // The values are read into the storage of the replica, which has their type already
+    QVariant myProp = QVariant::fromValue(false);
+    QVariant myEnum = QVariant::fromValue(MyNamespaceEnumEnum::Value1);
+    QDataStream in(data);
+    QVERIFY(MyNamespaceClassReplica::qtro_deserializeCompactProperty(in, myProp, 0));
+    QVERIFY(MyNamespaceClassReplica::qtro_deserializeCompactProperty(in, myEnum, 1));
+    QCOMPARE(in.status(), QDataStream::Ok);
+    QVERIFY(in.atEnd());
+    QCOMPARE(myProp.value<bool>(), true);
+    QCOMPARE(myEnum.value<MyNamespaceEnumEnum::MyNamespaceEnum>(), MyNamespaceEnumEnum::Value2);
+
+    // Models are read into a QVariant by the node
+    QVariant model;
+    QVERIFY(!MyNamespaceClassReplica::qtro_deserializeCompactProperty(in, model, 2));
+    QVERIFY(!model.isValid());
+}
+
+void tst_RepCodeGenerator::testPropertyThrottle()
+{
+    MyThrottledClassSimpleSource source;
+    using SourceAPI = MyThrottledClassSourceAPI<MyThrottledClassSimpleSource>;
+    QCOMPARE(SourceAPI::qtro_propertyThrottleInterval(0), 50); // speed
+    QCOMPARE(SourceAPI::qtro_propertyThrottleInterval(1), 0);
+
+    // For sources remoted without the SourceAPI
+    const QMetaObject *meta = source.metaObject();
+    const int index = meta->indexOfClassInfo("SPEED_THROTTLE");
+    QVERIFY(index >= 0);
+    QCOMPARE(meta->classInfo(index).value(), "50");
+    QCOMPARE(meta->indexOfClassInfo("GEAR_THROTTLE"), -1);
+}
+
 QTEST_APPLESS_MAIN(tst_RepCodeGenerator)
 
 #include "tst_repcodegenerator.moc"
@@ -18,6 +18,8 @@ private Q_SLOTS:
     void testBasic();
     void testProperties_data();
     void testProperties();
+    void testPropertyThrottle_data();
+    void testPropertyThrottle();
     void testSlots_data();
     void testSlots();
     void testSignals_data();
@@ -159,6 +161,59 @@ void tst_Parser::testProperties()
     QCOMPARE(property.persisted, expectedPersistence);
 }
 
+void tst_Parser::testPropertyThrottle_data()
+{
+    QTest::addColumn<QString>("propertyDeclaration");
+    QTest::addColumn<QString>("expectedName");
+    QTest::addColumn<QString>("expectedDefaultValue");
+    QTest::addColumn<ASTProperty::Modifier>("expectedModifier");
+    QTest::addColumn<bool>("expectedPersistence");
+    QTest::addColumn<int>("expectedThrottle");
+
+    QTest::newRow("none") << "PROP(double speed READONLY)" << "speed" << QString() << ASTProperty::ReadOnly << false << 0;
+    QTest::newRow("only") << "PROP(double speed THROTTLE=50)" << "speed" << QString() << ASTProperty::ReadPush << false << 50;
+    QTest::newRow("after flag") << "PROP(double speed READONLY THROTTLE=50)" << "speed" << QString() << ASTProperty::ReadOnly << false << 50;
+    QTest::newRow("before flag") << "PROP(double speed THROTTLE = 50 READONLY)" << "speed" << QString() << ASTProperty::ReadOnly << false << 50;
+    QTest::newRow("comma") << "PROP(double speed READONLY, THROTTLE=50)" << "speed" << QString() << ASTProperty::ReadOnly << false << 50;
+    QTest::newRow("between flags") << "PROP(double speed READONLY, THROTTLE=50, PERSISTED)" << "speed" << QString() << ASTProperty::ReadOnly << true << 50;
+    QTest::newRow("default value") << "PROP(double speed=1.5 READWRITE THROTTLE=20)" << "speed" << "1.5" << ASTProperty::ReadWrite << false << 20;
+    QTest::newRow("string default value") << "PROP(QString speed=\"THROTTLE=5\" THROTTLE=20)" << "speed" << "\"THROTTLE=5\"" << ASTProperty::ReadPush << false << 20;
+}
+
+void tst_Parser::testPropertyThrottle()
+{
+    QFETCH(QString, propertyDeclaration);
+    QFETCH(QString, expectedName);
+    QFETCH(QString, expectedDefaultValue);
+    QFETCH(ASTProperty::Modifier, expectedModifier);
+    QFETCH(bool, expectedPersistence);
+    QFETCH(int, expectedThrottle);
+
+    QTemporaryFile file;
+    file.open();
+    QTextStream stream(&file);
+    stream << "class TestClass" << Qt::endl;
+    stream << "{" << Qt::endl;
+    stream << propertyDeclaration << Qt::endl;
+    stream << "};" << Qt::endl;
+    file.seek(0);
+
+    RepParser parser(file);
+    QVERIFY(parser.parse());
+
+    const AST ast = parser.ast();
+    QCOMPARE(ast.classes.size(), 1);
+    const QList<ASTProperty> properties = ast.classes.first().properties;
+    QCOMPARE(properties.size(), 1);
+
+    const ASTProperty property = properties.first();
+    QCOMPARE(property.name, expectedName);
+    QCOMPARE(property.defaultValue, expectedDefaultValue);
+    QCOMPARE(property.modifier, expectedModifier);
+    QCOMPARE(property.persisted, expectedPersistence);
+    QCOMPARE(property.throttleInterval, expectedThrottle);
+}
+
 void tst_Parser::testSlots_data()
 {
     QTest::addColumn<QString>("slotDeclaration");
@@ -680,6 +735,8 @@ void tst_Parser::testInvalid_data()
     QTest::newRow("prop_outsideclass") << "PROP(int foo)" << ".?PROP: Can only be used in class scope";
     QTest::newRow("prop_toomanyargs") << "class Foo\n{\nPROP(int int foo)\n}" << ".?Invalid property declaration: flag foo is unknown";
     QTest::newRow("prop_toomanymodifiers") << "class Foo\n{\nPROP(int foo READWRITE, READONLY)\n}" << ".?Invalid property declaration: combination not allowed .READWRITE, READONLY.";
+    QTest::newRow("prop_invalidthrottle") << "class Foo\n{\nPROP(int foo THROTTLE=fast)\n}" << ".?Invalid property declaration: THROTTLE needs a positive interval in milliseconds";
+    QTest::newRow("prop_zerothrottle") << "class Foo\n{\nPROP(int foo READONLY THROTTLE=0)\n}" << ".?Invalid property declaration: THROTTLE needs a positive interval in milliseconds";
     QTest::newRow("prop_noargs") << "class Foo\n{\nPROP()\n}" << ".?Unknown token encountered";
     QTest::newRow("prop_unbalancedparens") << "class Foo\n{\nPROP(int foo\n}" << ".?Unknown token encountered";
     QTest::newRow("signal_outsideclass") << "SIGNAL(foo())" << ".?SIGNAL: Can only be used in class scope";
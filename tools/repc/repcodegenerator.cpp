@@ -8,6 +8,8 @@
 #include <QCryptographicHash>
 #include <QRegularExpression>
 
+#include <algorithm>
+
 using namespace Qt;
 
 QT_BEGIN_NAMESPACE
@@ -614,6 +616,15 @@ void RepCodeGenerator::generateClass(Mode mode, const ASTClass &astClass,
                          << Qt::endl;
             }
         }
+        // Lets sources remoted without the SourceAPI (see DynamicApiMap) throttle as well
+        if (mode == SOURCE) {
+            for (const ASTProperty &property : astClass.properties) {
+                if (property.throttleInterval > 0)
+                    m_stream << QString::fromLatin1("    Q_CLASSINFO(\"%1_THROTTLE\", \"%2\")")
+                                .arg(property.name.toUpper()).arg(property.throttleInterval)
+                             << Qt::endl;
+            }
+        }
 
 
         //First output properties
@@ -655,6 +666,17 @@ void RepCodeGenerator::generateClass(Mode mode, const ASTClass &astClass,
     m_stream << "" << Qt::endl;
     m_stream << "public:" << Qt::endl;
 
+    // Child objects, models and QVariant properties (which can carry QRO_) are read into a
+    // QVariant by the node
+    QList<int> typedProperties;
+    if (mode == REPLICA) {
+        for (int index = 0; index < astClass.properties.size(); ++index) {
+            const ASTProperty &property = astClass.properties.at(index);
+            if (!property.isPointer && property.type != QLatin1String("QVariant"))
+                typedProperties << index;
+        }
+    }
+
     if (mode == REPLICA) {
         m_stream << "    " << className << "() : QRemoteObjectReplica() { initialize(); }"
                  << Qt::endl;
@@ -668,8 +690,34 @@ void RepCodeGenerator::generateClass(Mode mode, const ASTClass &astClass,
         if (!metaTypeRegistrationCode.isEmpty())
             m_stream << metaTypeRegistrationCode << Qt::endl;
 
+        // Typed deserialization is registered as an extension, adding virtuals to
+        // QRemoteObjectReplica would break replicas generated by earlier versions of repc
+        if (!typedProperties.isEmpty()) {
+            m_stream << "        static const QtPrivate::ReplicaExtension extension = {"
+                     << Qt::endl;
+            m_stream << "            1, &qtro_deserializeCompactProperty" << Qt::endl;
+            m_stream << "        };" << Qt::endl;
+            m_stream << "        QtPrivate::qtro_register_replica_extension(&staticMetaObject, "
+                        "&extension);" << Qt::endl;
+        }
+
         m_stream << "    }" << Qt::endl;
 
+        if (!typedProperties.isEmpty()) {
+            m_stream << "    static bool qtro_deserializeCompactProperty(QDataStream &in, "
+                        "QVariant &value, int index)" << Qt::endl;
+            m_stream << "    {" << Qt::endl;
+            m_stream << "        switch (index) {" << Qt::endl;
+            for (int index : std::as_const(typedProperties))
+                m_stream << "        case " << index << ": QtPrivate::qtro_deserialize_compact<"
+                         << astClass.properties.at(index).type << ">(in, value); return true;"
+                         << Qt::endl;
+            m_stream << "        }" << Qt::endl;
+            m_stream << "        return false;" << Qt::endl;
+            m_stream << "    }" << Qt::endl;
+        }
+
+
         if (astClass.hasPointerObjects())
         {
             m_stream << "    void setNode(QRemoteObjectNode *node) override" << Qt::endl;
@@ -1194,6 +1242,37 @@ void RepCodeGenerator::generateSourceAPI(const ASTClass &astClass)
                                 " QStringLiteral(\"%1\"));")
                                 .arg(child.name, child.type) << Qt::endl;
     }
+    // Typed serialization and throttling are registered as an extension, adding virtuals to
+    // SourceApiMap would break the maps generated by earlier versions of repc
+    const bool hasThrottle = std::any_of(astClass.properties.cbegin(), astClass.properties.cend(),
+                                         [](const ASTProperty &property) {
+                                             return property.throttleInterval > 0;
+                                         });
+    // Child objects and models keep using QRO_
+    QList<qsizetype> typedProperties;
+    for (qsizetype i = 0; i < propCount; ++i) {
+        const bool isModel = std::any_of(astClass.modelMetadata.cbegin(),
+                                         astClass.modelMetadata.cend(),
+                                         [i](const ASTModel &model) {
+                                             return model.propertyIndex == i;
+                                         });
+        if (!isModel && !astClass.subClassPropertyIndices.contains(int(i)))
+            typedProperties << i;
+    }
+    if (hasThrottle || !typedProperties.isEmpty()) {
+        m_stream << QStringLiteral("        static const QtPrivate::SourceApiMapExtension "
+                                   "extension = {") << Qt::endl;
+        m_stream << QString::fromLatin1("            1, %1, %2")
+                                        .arg(typedProperties.isEmpty()
+                                             ? QStringLiteral("nullptr")
+                                             : QStringLiteral("&qtro_serializeCompactProperty"),
+                                             hasThrottle
+                                             ? QStringLiteral("&qtro_propertyThrottleInterval")
+                                             : QStringLiteral("nullptr")) << Qt::endl;
+        m_stream << QStringLiteral("        };") << Qt::endl;
+        m_stream << QStringLiteral("        QtPrivate::qtro_register_api_extension(this, "
+                                   "&extension);") << Qt::endl;
+    }
     m_stream << QStringLiteral("    }") << Qt::endl;
     m_stream << QStringLiteral("") << Qt::endl;
     m_stream << QString::fromLatin1("    QString name() const override { return m_name; }")
@@ -1503,6 +1582,42 @@ void RepCodeGenerator::generateSourceAPI(const ASTClass &astClass)
         << QLatin1String(classSignature(astClass))
         << QStringLiteral("\"}; }") << Qt::endl;
 
+    //qtro_propertyThrottleInterval extension
+    if (hasThrottle) {
+        m_stream << QStringLiteral("    static int qtro_propertyThrottleInterval(int index)")
+                 << Qt::endl;
+        m_stream << QStringLiteral("    {") << Qt::endl;
+        m_stream << QStringLiteral("        switch (index) {") << Qt::endl;
+        for (qsizetype i = 0; i < propCount; ++i) {
+            const int interval = astClass.properties.at(i).throttleInterval;
+            if (interval > 0)
+                m_stream << QString::fromLatin1("        case %1: return %2;")
+                                                .arg(QString::number(i), QString::number(interval))
+                         << Qt::endl;
+        }
+        m_stream << QStringLiteral("        }") << Qt::endl;
+        m_stream << QStringLiteral("        return 0;") << Qt::endl;
+        m_stream << QStringLiteral("    }") << Qt::endl;
+    }
+
+    //qtro_serializeCompactProperty extension
+    if (!typedProperties.isEmpty()) {
+        m_stream << QStringLiteral("    static bool qtro_serializeCompactProperty(QDataStream &out, "
+                                   "QObject *object, int index)") << Qt::endl;
+        m_stream << QStringLiteral("    {") << Qt::endl;
+        m_stream << QStringLiteral("        const auto source = static_cast<ObjectType *>(object);")
+                 << Qt::endl;
+        m_stream << QStringLiteral("        switch (index) {") << Qt::endl;
+        for (qsizetype i : std::as_const(typedProperties))
+            m_stream << QString::fromLatin1("        case %1: QtPrivate::qtro_serialize_compact("
+                                            "out, source->%2()); return true;")
+                                            .arg(QString::number(i),
+                                                 astClass.properties.at(i).name) << Qt::endl;
+        m_stream << QStringLiteral("        }") << Qt::endl;
+        m_stream << QStringLiteral("        return false;") << Qt::endl;
+        m_stream << QStringLiteral("    }") << Qt::endl;
+    }
+
     m_stream << QStringLiteral("") << Qt::endl;
     m_stream << QString::fromLatin1("    int m_enums[%1];").arg(totalCount + 1) << Qt::endl;
     m_stream << QString::fromLatin1("    int m_properties[%1];").arg(propCount+1) << Qt::endl;